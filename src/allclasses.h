@@ -285,6 +285,8 @@ REGISTER_CLASS_NAME(Accelerometer,"flash.sensors")
 REGISTER_CLASS_NAME(ApplicationDomain,"flash.system")
 REGISTER_CLASS_NAME(Capabilities,"flash.system")
 REGISTER_CLASS_NAME(LoaderContext,"flash.system")
+REGISTER_CLASS_NAME(MessageChannel,"flash.system")
+REGISTER_CLASS_NAME(MessageChannelState,"flash.system")
 REGISTER_CLASS_NAME(Security,"flash.system")
 REGISTER_CLASS_NAME(SecurityDomain,"flash.system")
 REGISTER_CLASS_NAME(System,"flash.system")
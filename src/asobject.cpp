@@ -30,6 +30,7 @@
 #include "scripting/toplevel/XML.h"
 #include "scripting/toplevel/XMLList.h"
 #include "scripting/toplevel/Error.h"
+#include "scripting/flash/utils/Dictionary.h"
 #include <3rdparty/pugixml/src/pugixml.hpp>
 
 using namespace lightspark;
@@ -1676,8 +1677,9 @@ void ASObject::dumpObjectCounters(uint32_t threshhold)
 }
 #endif
 ASObject::ASObject(Class_base* c,SWFOBJECT_TYPE t,CLASS_SUBTYPE st):objfreelist(c && c->getSystemState()->singleworker && c->isReusable ? c->freelist : NULL),Variables((c)?c->memoryAccount:NULL),varcount(0),classdef(c),proxyMultiName(NULL),sys(c?c->sys:NULL),
-	stringId(UINT32_MAX),type(t),subtype(st),traitsInitialized(false),constructIndicator(false),constructorCallComplete(false),implEnable(true)
+	stringId(UINT32_MAX),type(t),subtype(st),traitsInitialized(false),constructIndicator(false),constructorCallComplete(false),implEnable(true),isWeakKey(false)
 {
+	setCycleTraceable(true);
 #ifndef NDEBUG
 	//Stuff only used in debugging
 	initialized=false;
@@ -1691,8 +1693,9 @@ ASObject::ASObject(Class_base* c,SWFOBJECT_TYPE t,CLASS_SUBTYPE st):objfreelist(
 }
 
 ASObject::ASObject(const ASObject& o):objfreelist(o.classdef && o.classdef->getSystemState()->singleworker && o.classdef->isReusable ? o.classdef->freelist : NULL),Variables((o.classdef)?o.classdef->memoryAccount:NULL),varcount(0),classdef(NULL),proxyMultiName(NULL),sys(o.classdef? o.classdef->sys : NULL),
-	stringId(o.stringId),type(o.type),subtype(o.subtype),traitsInitialized(false),constructIndicator(false),constructorCallComplete(false),implEnable(true)
+	stringId(o.stringId),type(o.type),subtype(o.subtype),traitsInitialized(false),constructIndicator(false),constructorCallComplete(false),implEnable(true),isWeakKey(false)
 {
+	setCycleTraceable(true);
 #ifndef NDEBUG
 	//Stuff only used in debugging
 	initialized=false;
@@ -1714,6 +1717,32 @@ bool ASObject::destruct()
 	return destructIntern();
 }
 
+void ASObject::purgeWeakKey()
+{
+	Dictionary::purgeWeakKey(this);
+}
+
+void ASObject::traceReferences(std::vector<ASObject*>& refs)
+{
+	for (auto it=Variables.Variables.begin(); it != Variables.Variables.end(); ++it)
+	{
+		if (!it->second.isrefcounted)
+			continue;
+		if (asAtomHandler::isObject(it->second.var))
+			refs.push_back(asAtomHandler::getObjectNoCheck(it->second.var));
+		if (asAtomHandler::isObject(it->second.setter))
+			refs.push_back(asAtomHandler::getObjectNoCheck(it->second.setter));
+		if (asAtomHandler::isObject(it->second.getter))
+			refs.push_back(asAtomHandler::getObjectNoCheck(it->second.getter));
+	}
+}
+
+void ASObject::clearReferences()
+{
+	Variables.destroyContents();
+	varcount=0;
+}
+
 bool ASObject::AVM1HandleKeyboardEvent(KeyboardEvent *e) 
 { 
 	if (e->type =="keyDown")
@@ -1925,9 +1954,9 @@ unsigned int ASObject::numVariables() const
 	return varcount;
 }
 
-void ASObject::serializeDynamicProperties(ByteArray* out, std::map<tiny_string, uint32_t>& stringMap,
-				std::map<const ASObject*, uint32_t>& objMap,
-				std::map<const Class_base*, uint32_t> traitsMap,bool usedynamicPropertyWriter)
+void ASObject::serializeDynamicProperties(ByteArray* out, std::unordered_map<tiny_string, uint32_t>& stringMap,
+				std::unordered_map<const ASObject*, uint32_t>& objMap,
+				std::unordered_map<const Class_base*, uint32_t>& traitsMap,bool usedynamicPropertyWriter)
 {
 	if (usedynamicPropertyWriter && 
 			!out->getSystemState()->static_ObjectEncoding_dynamicPropertyWriter.isNull() &&
@@ -1957,9 +1986,9 @@ void ASObject::serializeDynamicProperties(ByteArray* out, std::map<tiny_string,
 		Variables.serialize(out, stringMap, objMap, traitsMap);
 }
 
-void variables_map::serialize(ByteArray* out, std::map<tiny_string, uint32_t>& stringMap,
-				std::map<const ASObject*, uint32_t>& objMap,
-				std::map<const Class_base*, uint32_t>& traitsMap)
+void variables_map::serialize(ByteArray* out, std::unordered_map<tiny_string, uint32_t>& stringMap,
+				std::unordered_map<const ASObject*, uint32_t>& objMap,
+				std::unordered_map<const Class_base*, uint32_t>& traitsMap)
 {
 	bool amf0 = out->getObjectEncoding() == ObjectEncoding::AMF0;
 	//Pairs of name, value
@@ -1980,9 +2009,36 @@ void variables_map::serialize(ByteArray* out, std::map<tiny_string, uint32_t>& s
 	if (!amf0) out->writeStringVR(stringMap, "");
 }
 
-void ASObject::serialize(ByteArray* out, std::map<tiny_string, uint32_t>& stringMap,
-				std::map<const ASObject*, uint32_t>& objMap,
-				std::map<const Class_base*, uint32_t>& traitsMap)
+/*
+ * Collects the public declared traits of an instance, as pairs of name id
+ * and slot id (0 if the trait has no slot). Variables with a namespace,
+ * like protected ones, are not serialized
+ */
+static void collectSerializedTraits(const variables_map& vars, std::vector<std::pair<uint32_t,uint32_t>>& traits)
+{
+	for(variables_map::const_var_iterator varIt=vars.Variables.cbegin(); varIt != vars.Variables.cend(); ++varIt)
+	{
+		if(varIt->second.kind==DECLARED_TRAIT && varIt->second.ns.hasEmptyName())
+			traits.emplace_back(varIt->first,varIt->second.slotid);
+	}
+}
+
+static asAtom getSerializedTrait(variables_map& vars, const std::pair<uint32_t,uint32_t>& trait)
+{
+	if(trait.second)
+		return vars.getSlot(trait.second);
+	auto range=vars.Variables.equal_range(trait.first);
+	for(auto it=range.first; it!=range.second; ++it)
+	{
+		if(it->second.kind==DECLARED_TRAIT && it->second.ns.hasEmptyName())
+			return it->second.var;
+	}
+	return asAtomHandler::undefinedAtom;
+}
+
+void ASObject::serialize(ByteArray* out, std::unordered_map<tiny_string, uint32_t>& stringMap,
+				std::unordered_map<const ASObject*, uint32_t>& objMap,
+				std::unordered_map<const Class_base*, uint32_t>& traitsMap)
 {
 	bool amf0 = out->getObjectEncoding() == ObjectEncoding::AMF0;
 	if (amf0)
@@ -2010,61 +2066,77 @@ void ASObject::serialize(ByteArray* out, std::map<tiny_string, uint32_t>& string
 	Class_base* type=getClass();
 	assert_and_throw(type);
 
-	//Check if an alias is registered
-	auto aliasIt=getSystemState()->aliasMap.begin();
-	const auto aliasEnd=getSystemState()->aliasMap.end();
-	//Linear search for alias
+	//Check if the class traits has been already serialized to send it by reference.
+	//The alias is only needed when the traits are written, and classes
+	//already in traitsMap are known not to be externalizable
+	auto it2=traitsMap.find(type);
 	tiny_string alias;
-	for(;aliasIt!=aliasEnd;++aliasIt)
+	if(it2==traitsMap.end())
 	{
-		if(aliasIt->second==type)
+		//Check if an alias is registered
+		auto aliasIt=getSystemState()->aliasMap.begin();
+		const auto aliasEnd=getSystemState()->aliasMap.end();
+		//Linear search for alias
+		for(;aliasIt!=aliasEnd;++aliasIt)
 		{
-			alias=aliasIt->first;
-			break;
+			if(aliasIt->second==type)
+			{
+				alias=aliasIt->first;
+				break;
+			}
 		}
-	}
-	bool serializeTraits = alias.empty()==false;
+		bool serializeTraits = alias.empty()==false;
 
-	if(type->isSubClass(InterfaceClass<IExternalizable>::getClass(getSystemState())))
-	{
-		//Custom serialization necessary
-		if(!serializeTraits)
-			throwError<TypeError>(kInvalidParamError);
-		if (amf0)
+		if(type->isSubClass(InterfaceClass<IExternalizable>::getClass(getSystemState())))
 		{
-			LOG(LOG_NOT_IMPLEMENTED,"serializing IExternalizable in AMF0 not implemented");
-			out->writeShort(0);
-			out->writeByte(amf0_object_end_marker);
+			//Custom serialization necessary
+			if(!serializeTraits)
+				throwError<TypeError>(kInvalidParamError);
+			if (amf0)
+			{
+				LOG(LOG_NOT_IMPLEMENTED,"serializing IExternalizable in AMF0 not implemented");
+				out->writeShort(0);
+				out->writeByte(amf0_object_end_marker);
+				return;
+			}
+			out->writeU29(0x7);
+			out->writeStringVR(stringMap, alias);
+
+			//Invoke writeExternal
+			multiname writeExternalName(NULL);
+			writeExternalName.name_type=multiname::NAME_STRING;
+			writeExternalName.name_s_id=getSystemState()->getUniqueStringId("writeExternal");
+			writeExternalName.ns.emplace_back(getSystemState(),BUILTIN_STRINGS::EMPTY,NAMESPACE);
+			writeExternalName.isAttribute = false;
+
+			asAtom o=asAtomHandler::invalidAtom;
+			getVariableByMultiname(o,writeExternalName,SKIP_IMPL);
+			assert_and_throw(asAtomHandler::isFunction(o));
+			asAtom tmpArg[1] = { asAtomHandler::fromObject(out) };
+			asAtom v=asAtomHandler::fromObject(this);
+			asAtom r=asAtomHandler::invalidAtom;
+			asAtomHandler::callFunction(o,r,v, tmpArg, 1,false);
 			return;
 		}
-		out->writeU29(0x7);
-		out->writeStringVR(stringMap, alias);
-
-		//Invoke writeExternal
-		multiname writeExternalName(NULL);
-		writeExternalName.name_type=multiname::NAME_STRING;
-		writeExternalName.name_s_id=getSystemState()->getUniqueStringId("writeExternal");
-		writeExternalName.ns.emplace_back(getSystemState(),BUILTIN_STRINGS::EMPTY,NAMESPACE);
-		writeExternalName.isAttribute = false;
-
-		asAtom o=asAtomHandler::invalidAtom;
-		getVariableByMultiname(o,writeExternalName,SKIP_IMPL);
-		assert_and_throw(asAtomHandler::isFunction(o));
-		asAtom tmpArg[1] = { asAtomHandler::fromObject(out) };
-		asAtom v=asAtomHandler::fromObject(this);
-		asAtom r=asAtomHandler::invalidAtom;
-		asAtomHandler::callFunction(o,r,v, tmpArg, 1,false);
-		return;
 	}
 
 	//Add the object to the map
 	objMap.insert(make_pair(this, objMap.size()));
 
-	uint32_t traitsCount=0;
-	const variables_map::var_iterator beginIt = Variables.Variables.begin();
-	const variables_map::var_iterator endIt = Variables.Variables.end();
-	//Check if the class traits has been already serialized to send it by reference
-	auto it2=traitsMap.find(type);
+	//The public sealed traits only depend on the class, so they are
+	//collected once. Class objects have their own static traits
+	std::vector<std::pair<uint32_t,uint32_t>> classTraits;
+	const std::vector<std::pair<uint32_t,uint32_t>>* sealedTraits=&type->serializedTraits;
+	if(is<Class_base>())
+	{
+		collectSerializedTraits(Variables,classTraits);
+		sealedTraits=&classTraits;
+	}
+	else if(!type->serializedTraitsBuilt)
+	{
+		collectSerializedTraits(Variables,type->serializedTraits);
+		type->serializedTraitsBuilt=true;
+	}
 
 	if (amf0)
 	{
@@ -2073,18 +2145,11 @@ void ASObject::serialize(ByteArray* out, std::map<tiny_string, uint32_t>& string
 		{
 			out->writeByte(amf0_reference_marker);
 			out->writeShort(it2->second);
-			for(variables_map::var_iterator varIt=beginIt; varIt != endIt; ++varIt)
+			for(auto trait=sealedTraits->cbegin(); trait!=sealedTraits->cend(); ++trait)
 			{
-				if(varIt->second.kind==DECLARED_TRAIT)
-				{
-					if(!varIt->second.ns.hasEmptyName())
-					{
-						//Skip variable with a namespace, like protected ones
-						continue;
-					}
-					out->writeStringAMF0(getSystemState()->getStringFromUniqueId(varIt->first));
-					asAtomHandler::toObject(varIt->second.var,getSystemState())->serialize(out, stringMap, objMap, traitsMap);
-				}
+				out->writeStringAMF0(getSystemState()->getStringFromUniqueId(trait->first));
+				asAtom v=getSerializedTrait(Variables,*trait);
+				asAtomHandler::toObject(v,getSystemState())->serialize(out, stringMap, objMap, traitsMap);
 			}
 		}
 		if(!type->isSealed)
@@ -2099,45 +2164,17 @@ void ASObject::serialize(ByteArray* out, std::map<tiny_string, uint32_t>& string
 	else
 	{
 		traitsMap.insert(make_pair(type, traitsMap.size()));
-		for(variables_map::const_var_iterator varIt=beginIt; varIt != endIt; ++varIt)
-		{
-			if(varIt->second.kind==DECLARED_TRAIT)
-			{
-				if(!varIt->second.ns.hasEmptyName())
-				{
-					//Skip variable with a namespace, like protected ones
-					continue;
-				}
-				traitsCount++;
-			}
-		}
+		uint32_t traitsCount=sealedTraits->size();
 		uint32_t dynamicFlag=(type->isSealed)?0:(1 << 3);
 		out->writeU29((traitsCount << 4) | dynamicFlag | 0x03);
 		out->writeStringVR(stringMap, alias);
-		for(variables_map::const_var_iterator varIt=beginIt; varIt != endIt; ++varIt)
-		{
-			if(varIt->second.kind==DECLARED_TRAIT)
-			{
-				if(!varIt->second.ns.hasEmptyName())
-				{
-					//Skip variable with a namespace, like protected ones
-					continue;
-				}
-				out->writeStringVR(stringMap, getSystemState()->getStringFromUniqueId(varIt->first));
-			}
-		}
+		for(auto trait=sealedTraits->cbegin(); trait!=sealedTraits->cend(); ++trait)
+			out->writeStringVR(stringMap, getSystemState()->getStringFromUniqueId(trait->first));
 	}
-	for(variables_map::var_iterator varIt=beginIt; varIt != endIt; ++varIt)
+	for(auto trait=sealedTraits->cbegin(); trait!=sealedTraits->cend(); ++trait)
 	{
-		if(varIt->second.kind==DECLARED_TRAIT)
-		{
-			if(!varIt->second.ns.hasEmptyName())
-			{
-				//Skip variable with a namespace, like protected ones
-				continue;
-			}
-			asAtomHandler::toObject(varIt->second.var,getSystemState())->serialize(out, stringMap, objMap, traitsMap);
-		}
+		asAtom v=getSerializedTrait(Variables,*trait);
+		asAtomHandler::toObject(v,getSystemState())->serialize(out, stringMap, objMap, traitsMap);
 	}
 	if(!type->isSealed)
 		serializeDynamicProperties(out, stringMap, objMap, traitsMap);
@@ -2987,10 +3024,8 @@ bool asAtomHandler::add(asAtom& a,asAtom &v2, SystemState* sys)
 	}
 	else if(isString(a) || isString(v2))
 	{
-		tiny_string sa = toString(a,sys);
-		sa += toString(v2,sys);
 		LOG_CALL("add " << toString(a,sys) << '+' << toString(v2,sys));
-		a.uintval = (LIGHTSPARK_ATOM_VALTYPE)(abstract_s(sys,sa))|ATOM_STRINGPTR;
+		a.uintval = (LIGHTSPARK_ATOM_VALTYPE)(ASString::concatenate(sys,a,v2))|ATOM_STRINGPTR;
 	}
 	else
 	{
@@ -3075,11 +3110,11 @@ void asAtomHandler::addreplace(asAtom& ret, SystemState* sys,asAtom& v1, asAtom
 	}
 	else if(isString(v1) || isString(v2))
 	{
-		tiny_string sa = toString(v1,sys);
-		sa += toString(v2,sys);
 		LOG_CALL("add " << toString(v1,sys) << '+' << toString(v2,sys));
+		// ret may be v1, so the result has to be created first
+		ASObject* res = ASString::concatenate(sys,v1,v2);
 		ASATOM_DECREF(ret);
-		ret.uintval = (LIGHTSPARK_ATOM_VALTYPE)(abstract_s(sys,sa))|ATOM_STRINGPTR;
+		ret.uintval = (LIGHTSPARK_ATOM_VALTYPE)(res)|ATOM_STRINGPTR;
 	}
 	else
 	{
@@ -783,9 +783,9 @@ public:
 	int getNextEnumerable(unsigned int i) const;
 	~variables_map();
 	void check() const;
-	void serialize(ByteArray* out, std::map<tiny_string, uint32_t>& stringMap,
-				std::map<const ASObject*, uint32_t>& objMap,
-				std::map<const Class_base*, uint32_t>& traitsMap);
+	void serialize(ByteArray* out, std::unordered_map<tiny_string, uint32_t>& stringMap,
+				std::unordered_map<const ASObject*, uint32_t>& objMap,
+				std::unordered_map<const Class_base*, uint32_t>& traitsMap);
 	void dumpVariables();
 	void destroyContents();
 	bool cloneInstance(variables_map& map);
@@ -832,8 +832,9 @@ private:
 	SystemState* sys;
 protected:
 	ASObject(MemoryAccount* m):objfreelist(NULL),Variables(m),varcount(0),classdef(NULL),proxyMultiName(NULL),sys(NULL),
-		stringId(UINT32_MAX),type(T_OBJECT),subtype(SUBTYPE_NOT_SET),traitsInitialized(false),constructIndicator(false),constructorCallComplete(false),implEnable(true)
+		stringId(UINT32_MAX),type(T_OBJECT),subtype(SUBTYPE_NOT_SET),traitsInitialized(false),constructIndicator(false),constructorCallComplete(false),implEnable(true),isWeakKey(false)
 	{
+		setCycleTraceable(true);
 #ifndef NDEBUG
 		//Stuff only used in debugging
 		initialized=false;
@@ -852,9 +853,9 @@ protected:
 	bool traitsInitialized:1;
 	bool constructIndicator:1;
 	bool constructorCallComplete:1; // indicates that the constructor including all super constructors has been called
-	void serializeDynamicProperties(ByteArray* out, std::map<tiny_string, uint32_t>& stringMap,
-				std::map<const ASObject*, uint32_t>& objMap,
-				std::map<const Class_base*, uint32_t> traitsMap,bool usedynamicPropertyWriter=true);
+	void serializeDynamicProperties(ByteArray* out, std::unordered_map<tiny_string, uint32_t>& stringMap,
+				std::unordered_map<const ASObject*, uint32_t>& objMap,
+				std::unordered_map<const Class_base*, uint32_t>& traitsMap,bool usedynamicPropertyWriter=true);
 	void setClass(Class_base* c);
 	static variable* findSettableImpl(SystemState* sys,variables_map& map, const multiname& name, bool* has_getter);
 	static FORCE_INLINE const variable* findGettableImplConst(SystemState* sys, const variables_map& map, const multiname& name, uint32_t* nsRealId = NULL)
@@ -895,8 +896,13 @@ protected:
 	// called when object is really destroyed
 	virtual void destroy(){}
 
+	void purgeWeakKey();
 	FORCE_INLINE bool destructIntern()
 	{
+		if (isWeakKey)
+			purgeWeakKey();
+		if (getCycleBuffered())
+			removeCycleCandidate();
 		if (varcount)
 			destroyContents();
 		if (proxyMultiName)
@@ -945,6 +951,8 @@ public:
 	static void dumpObjectCounters(uint32_t threshhold);
 #endif
 	bool implEnable:1;
+	// set while this object is a key of a Dictionary with weak keys
+	bool isWeakKey:1;
 
 	inline Class_base* getClass() const { return classdef; }
 	ASFUNCTION_ATOM(_constructor);
@@ -982,6 +990,15 @@ public:
 	   The finalize method must be callable multiple time with the same effects (no double frees).
 	*/
 	inline virtual void finalize() {}
+	/*
+	   Cycle collector support (see scripting/cyclecollector.h)
+	   traceReferences adds every object this object holds a reference to.
+	   clearReferences releases exactly the references reported by traceReferences.
+	   Classes holding references outside of their variables should override both
+	   and call the base class implementation.
+	*/
+	virtual void traceReferences(std::vector<ASObject*>& refs);
+	virtual void clearReferences();
 
 	virtual GET_VARIABLE_RESULT getVariableByMultiname(asAtom& ret, const multiname& name, GET_VARIABLE_OPTION opt=NONE)
 	{
@@ -1167,9 +1184,9 @@ public:
 
 	  The various maps are used to implement reference type of the AMF3 spec
 	*/
-	virtual void serialize(ByteArray* out, std::map<tiny_string, uint32_t>& stringMap,
-				std::map<const ASObject*, uint32_t>& objMap,
-				std::map<const Class_base*, uint32_t>& traitsMap);
+	virtual void serialize(ByteArray* out, std::unordered_map<tiny_string, uint32_t>& stringMap,
+				std::unordered_map<const ASObject*, uint32_t>& objMap,
+				std::unordered_map<const Class_base*, uint32_t>& traitsMap);
 
 	virtual ASObject *describeType() const;
 
@@ -1251,6 +1268,7 @@ class AVM1Function;
 class Activation_object;
 class ApplicationDomain;
 class Array;
+class ASCondition;
 class ASMutex;
 class ASQName;
 class ASString;
@@ -1294,6 +1312,7 @@ class LoaderContext;
 class LoaderInfo;
 class Matrix;
 class Matrix3D;
+class MessageChannel;
 class MouseEvent;
 class MovieClip;
 class Namespace;
@@ -1344,6 +1363,7 @@ template<> inline bool ASObject::is<AVM1Function>() const { return subtype==SUBT
 template<> inline bool ASObject::is<Activation_object>() const { return subtype==SUBTYPE_ACTIVATIONOBJECT; }
 template<> inline bool ASObject::is<ApplicationDomain>() const { return subtype==SUBTYPE_APPLICATIONDOMAIN; }
 template<> inline bool ASObject::is<Array>() const { return type==T_ARRAY; }
+template<> inline bool ASObject::is<ASCondition>() const { return subtype==SUBTYPE_CONDITION; }
 template<> inline bool ASObject::is<ASMutex>() const { return subtype==SUBTYPE_MUTEX; }
 template<> inline bool ASObject::is<ASObject>() const { return true; }
 template<> inline bool ASObject::is<ASQName>() const { return type==T_QNAME; }
@@ -1391,6 +1411,7 @@ template<> inline bool ASObject::is<Namespace>() const { return type==T_NAMESPAC
 template<> inline bool ASObject::is<NetStream>() const { return subtype==SUBTYPE_NETSTREAM; }
 template<> inline bool ASObject::is<Matrix>() const { return subtype==SUBTYPE_MATRIX; }
 template<> inline bool ASObject::is<Matrix3D>() const { return subtype==SUBTYPE_MATRIX3D; }
+template<> inline bool ASObject::is<MessageChannel>() const { return subtype==SUBTYPE_MESSAGECHANNEL; }
 template<> inline bool ASObject::is<MouseEvent>() const { return subtype==SUBTYPE_MOUSE_EVENT; }
 template<> inline bool ASObject::is<MovieClip>() const { return subtype==SUBTYPE_ROOTMOVIECLIP || subtype == SUBTYPE_MOVIECLIP; }
 template<> inline bool ASObject::is<Null>() const { return type==T_NULL; }
@@ -23,6 +23,9 @@
 #include <iostream>
 #include "logger.h"
 #include <sys/time.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 
 using namespace lightspark;
@@ -37,12 +40,17 @@ uint32_t AudioStream::getPlayedTime()
 	ret = playedtime + (now.tv_sec * 1000 + now.tv_usec / 1000) - (starttime.tv_sec * 1000 + starttime.tv_usec / 1000);
 	return ret;
 }
+void AudioStream::setPlayedTime(uint32_t time)
+{
+	playedtime = time;
+	gettimeofday(&starttime, NULL);
+}
+
 bool AudioStream::init()
 {
-	unmutevolume = curvolume = 1.0;
 	playedtime = 0;
 	gettimeofday(&starttime, NULL);
-	mixer_channel = manager->engineData->audio_StreamInit(this);
+	updateGains();
 	isPaused = false;
 	return true;
 }
@@ -59,7 +67,6 @@ void AudioStream::SetPause(bool pause_on)
 		gettimeofday(&starttime, NULL);
 		isPaused = false;
 	}
-	manager->engineData->audio_StreamPause(mixer_channel,pause_on);
 }
 
 bool AudioStream::ispaused()
@@ -78,19 +85,44 @@ void AudioStream::unmute()
 }
 void AudioStream::setVolume(double volume)
 {
-	manager->engineData->audio_StreamSetVolume(mixer_channel, volume);
 	curvolume = volume;
+	updateGains();
+}
+void AudioStream::setPan(double pan)
+{
+	curpan = dmax(-1.0,dmin(1.0,pan));
+	updateGains();
+}
+void AudioStream::updateGains()
+{
+	//Panning attenuates the opposite channel, like SoundTransform does
+	//with the default leftToLeft/rightToRight values
+	leftgain = curvolume * (curpan > 0 ? 1.0-curpan : 1.0);
+	rightgain = curvolume * (curpan < 0 ? 1.0+curpan : 1.0);
 }
 
 AudioStream::~AudioStream()
 {
-	manager->engineData->audio_StreamDeinit(mixer_channel);
 	manager->removeStream(this);
 }
 
-AudioManager::AudioManager(EngineData *engine):muteAllStreams(false),audio_available(false),mixeropened(0),engineData(engine)
+AudioManager::AudioManager(EngineData *engine):muteAllStreams(false),audio_available(false),mixeropened(0),engineData(engine),
+	useSink(false),sinkThread(NULL),sinkRunning(false),pastUnderruns(0)
 {
-	audio_available = engine->audio_ManagerInit();
+	const std::string& output = Config::getConfig()->getAudioOutput();
+	if (!output.empty())
+	{
+		useSink = true;
+		if (output != "null")
+		{
+			sinkFile.open(output.c_str(), std::ios::out|std::ios::binary|std::ios::trunc);
+			if (!sinkFile.is_open())
+				LOG(LOG_ERROR,"Couldn't open audio output file "<<output);
+		}
+		audio_available = true;
+	}
+	else
+		audio_available = engine->audio_ManagerInit();
 	mixeropened = 0;
 }
 void AudioManager::muteAll()
@@ -112,32 +144,161 @@ void AudioManager::unmuteAll()
 	}
 }
 
-void AudioManager::removeStream(AudioStream *s)
+static void accumulateSamples(float* mix, const int16_t* samples, uint32_t count, float leftgain, float rightgain)
+{
+	uint32_t i = 0;
+#ifdef __SSE2__
+	//Interleaved stereo: even samples are left, odd samples are right
+	const __m128 gains = _mm_set_ps(rightgain, leftgain, rightgain, leftgain);
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128i in = _mm_loadu_si128((const __m128i*)(samples+i));
+		__m128 lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(in, in), 16));
+		__m128 hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(in, in), 16));
+		_mm_storeu_ps(mix+i, _mm_add_ps(_mm_loadu_ps(mix+i), _mm_mul_ps(lo, gains)));
+		_mm_storeu_ps(mix+i+4, _mm_add_ps(_mm_loadu_ps(mix+i+4), _mm_mul_ps(hi, gains)));
+	}
+#endif
+	for (; i < count; i++)
+		mix[i] += samples[i] * ((i&1) ? rightgain : leftgain);
+}
+
+static void convertSamples(int16_t* dest, const float* mix, uint32_t count)
 {
+	uint32_t i = 0;
+#ifdef __SSE2__
+	//Clamp before converting, out of range values would wrap to INT_MIN
+	const __m128 maxval = _mm_set1_ps(32767.0f);
+	const __m128 minval = _mm_set1_ps(-32768.0f);
+	for (; i + 8 <= count; i += 8)
+	{
+		__m128 lo = _mm_max_ps(minval, _mm_min_ps(maxval, _mm_loadu_ps(mix+i)));
+		__m128 hi = _mm_max_ps(minval, _mm_min_ps(maxval, _mm_loadu_ps(mix+i+4)));
+		_mm_storeu_si128((__m128i*)(dest+i), _mm_packs_epi32(_mm_cvtps_epi32(lo), _mm_cvtps_epi32(hi)));
+	}
+#endif
+	for (; i < count; i++)
+		dest[i] = (int16_t)dmax(-32768.0, dmin(32767.0, round(mix[i])));
+}
+
+void AudioManager::mixStreams(int16_t* dest, uint32_t len)
+{
+	uint32_t count = len/sizeof(int16_t);
 	Locker l(streamMutex);
-	streams.remove(s);
-	if (streams.empty())
+	if (mixBuffer.size() < count)
+	{
+		mixBuffer.resize(count);
+		streamBuffer.resize(count);
+	}
+	memset(mixBuffer.data(), 0, count*sizeof(float));
+	for (stream_iterator it = streams.begin(); it != streams.end(); ++it)
+	{
+		AudioStream* s = *it;
+		if (s->isPaused || !s->decoder)
+			continue;
+		uint32_t readcount = 0;
+		while (readcount < count*sizeof(int16_t))
+		{
+			uint32_t ret = s->decoder->copyFrame(streamBuffer.data()+readcount/sizeof(int16_t), count*sizeof(int16_t)-readcount);
+			if (!ret)
+				break;
+			readcount += ret;
+		}
+		//Running out of samples after the start is an underrun, unless
+		//the decoder is draining its last frames
+		if (readcount < count*sizeof(int16_t) && s->hasOutput && !s->decoder->isFlushing())
+			s->underruns++;
+		if (readcount)
+			s->hasOutput = true;
+		float leftgain = s->leftgain;
+		float rightgain = s->rightgain;
+		if (readcount && (leftgain != 0 || rightgain != 0))
+			accumulateSamples(mixBuffer.data(), streamBuffer.data(), readcount/sizeof(int16_t), leftgain, rightgain);
+	}
+	convertSamples(dest, mixBuffer.data(), count);
+}
+
+void AudioManager::sinkWorker()
+{
+	//Drain the streams in real time, as a sound device would
+	const uint32_t samplerate = engineData->audio_getSampleRate();
+	const uint32_t framesPerBuffer = LIGHTSPARK_AUDIO_BUFFERSIZE/(2*sizeof(int16_t));
+	std::vector<int16_t> buf(LIGHTSPARK_AUDIO_BUFFERSIZE/sizeof(int16_t));
+	uint64_t start = compat_msectiming();
+	uint64_t framesdone = 0;
+	while (sinkRunning)
+	{
+		mixStreams(buf.data(), LIGHTSPARK_AUDIO_BUFFERSIZE);
+		if (sinkFile.is_open())
+			sinkFile.write((const char*)buf.data(), LIGHTSPARK_AUDIO_BUFFERSIZE);
+		framesdone += framesPerBuffer;
+		uint64_t due = start + framesdone*1000/samplerate;
+		uint64_t now = compat_msectiming();
+		if (due > now)
+			compat_msleep(due-now);
+	}
+	if (sinkFile.is_open())
+		sinkFile.flush();
+}
+
+bool AudioManager::openMixer()
+{
+	if (!useSink)
+		return engineData->audio_ManagerOpenMixer(this);
+	sinkRunning = true;
+#ifdef HAVE_NEW_GLIBMM_THREAD_API
+	sinkThread = Thread::create(sigc::mem_fun(this,&AudioManager::sinkWorker));
+#else
+	sinkThread = Thread::create(sigc::mem_fun(this,&AudioManager::sinkWorker),true);
+#endif
+	return true;
+}
+
+void AudioManager::closeMixer()
+{
+	if (!useSink)
 	{
 		engineData->audio_ManagerCloseMixer();
+		return;
+	}
+	sinkRunning = false;
+	if (sinkThread)
+	{
+		sinkThread->join();
+		sinkThread = NULL;
+	}
+}
+
+void AudioManager::removeStream(AudioStream *s)
+{
+	Locker m(mixerMutex);
+	bool empty;
+	{
+		Locker l(streamMutex);
+		streams.remove(s);
+		empty = streams.empty();
+		pastUnderruns += s->underruns;
+	}
+	if (empty && mixeropened)
+	{
+		closeMixer();
 		mixeropened = false;
 	}
 }
 
-AudioStream* AudioManager::createStream(AudioDecoder* decoder, bool startpaused)
+uint32_t AudioManager::getUnderrunCount()
 {
 	Locker l(streamMutex);
+	uint32_t ret = pastUnderruns;
+	for (stream_iterator it = streams.begin(); it != streams.end(); ++it)
+		ret += (*it)->underruns;
+	return ret;
+}
+
+AudioStream* AudioManager::createStream(AudioDecoder* decoder, bool startpaused)
+{
 	if (!audio_available)
 		return NULL;
-	if (!mixeropened)
-	{
-		if (!engineData->audio_ManagerOpenMixer())
-		{
-			LOG(LOG_ERROR,"Couldn't open mixer");
-			audio_available = 0;
-			return NULL;
-		}
-		mixeropened = 1;
-	}
 
 	AudioStream *stream = new AudioStream(this);
 	stream->decoder = decoder;
@@ -150,23 +311,55 @@ AudioStream* AudioManager::createStream(AudioDecoder* decoder, bool startpaused)
 		stream->pause();
 	else
 		stream->hasStarted=true;
-	streams.push_back(stream);
-
-	return stream;
+	{
+		Locker m(mixerMutex);
+		if (audio_available && !mixeropened)
+		{
+			if (openMixer())
+				mixeropened = 1;
+			else
+			{
+				LOG(LOG_ERROR,"Couldn't open mixer");
+				audio_available = 0;
+			}
+		}
+		if (audio_available)
+		{
+			Locker l(streamMutex);
+			if (muteAllStreams)
+				stream->mute();
+			streams.push_back(stream);
+			return stream;
+		}
+	}
+	//Deleted outside of mixerMutex, as the destructor takes it
+	delete stream;
+	return NULL;
 }
 
 
 AudioManager::~AudioManager()
 {
-	Locker l(streamMutex);
-	for (stream_iterator it = streams.begin(); it != streams.end(); ++it) {
-		delete *it;
+	//Streams remove themselves from the list, so they must be
+	//deleted without holding any of the locks
+	while (true)
+	{
+		AudioStream* s;
+		{
+			Locker l(streamMutex);
+			if (streams.empty())
+				break;
+			s = streams.front();
+		}
+		delete s;
 	}
+	Locker m(mixerMutex);
 	if (mixeropened)
 	{
-		engineData->audio_ManagerCloseMixer();
+		closeMixer();
+		mixeropened = false;
 	}
-	if (audio_available)
+	if (audio_available && !useSink)
 	{
 		engineData->audio_ManagerDeinit();
 	}
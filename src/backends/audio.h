@@ -22,8 +22,11 @@
 
 
 #include "compat.h"
+#include "threading.h"
 #include "backends/decoder.h"
 #include <iostream>
+#include <fstream>
+#include <vector>
 
 namespace lightspark
 {
@@ -40,10 +43,34 @@ private:
 	EngineData* engineData;
 	std::list<AudioStream *> streams;
 	typedef std::list<AudioStream *>::iterator stream_iterator;
+	//Protects the stream list, taken by the mixing callback
 	Mutex streamMutex;
+	//Serializes opening and closing the output. It is never taken
+	//while streamMutex is held, so closing the output can wait for
+	//a running mixing callback without deadlocking
+	Mutex mixerMutex;
+	//Scratch buffers of the mixing callback, protected by streamMutex
+	std::vector<float> mixBuffer;
+	std::vector<int16_t> streamBuffer;
+	//Headless output configured by [audio] output
+	bool useSink;
+	std::ofstream sinkFile;
+	Thread* sinkThread;
+	ACQUIRE_RELEASE_FLAG(sinkRunning);
+	//Underruns of streams that have already been removed
+	ACQUIRE_RELEASE_VARIABLE(uint32_t,pastUnderruns);
+	void sinkWorker();
+	bool openMixer();
+	void closeMixer();
 public:
 	AudioManager(EngineData* engine);
 
+	/*
+	 * Mixes all running streams into dest as signed 16 bit stereo
+	 * samples. len is in bytes. Called by the output callback
+	 */
+	void mixStreams(int16_t* dest, uint32_t len);
+
 	AudioStream *createStream(AudioDecoder *decoder, bool startpaused);
 
 	void toggleMuteAll() { muteAllStreams ? unmuteAll() : muteAll(); }
@@ -51,6 +78,11 @@ public:
 	void muteAll();
 	void unmuteAll();
 	void removeStream(AudioStream* s);
+	/*
+	 * Number of times a running stream could not provide enough
+	 * samples to the mixer, since the manager was created
+	 */
+	uint32_t getUnderrunCount();
 	~AudioManager();
 };
 
@@ -62,26 +94,40 @@ private:
 	AudioManager* manager;
 	AudioDecoder *decoder;
 	bool hasStarted;
-	bool isPaused;
+	ACQUIRE_RELEASE_FLAG(isPaused);
 	double curvolume;
+	double curpan;
 	double unmutevolume;
+	//Per channel gains derived from volume and pan, read by the mixer
+	ACQUIRE_RELEASE_VARIABLE(float,leftgain);
+	ACQUIRE_RELEASE_VARIABLE(float,rightgain);
+	//Set once the decoder provided samples, counted by the mixer
+	bool hasOutput;
+	ACQUIRE_RELEASE_VARIABLE(uint32_t,underruns);
+	void updateGains();
 	uint32_t playedtime;
 	struct timeval starttime;
-	int mixer_channel;
 public:
 	bool init();
-	AudioStream(AudioManager* _manager):manager(_manager),decoder(NULL),hasStarted(false),isPaused(true) { }
+	AudioStream(AudioManager* _manager):manager(_manager),decoder(NULL),hasStarted(false),isPaused(true),
+		curvolume(1.0),curpan(0.0),unmutevolume(1.0),leftgain(1.0),rightgain(1.0),hasOutput(false),underruns(0) { }
 
 	void SetPause(bool pause_on);
 	uint32_t getPlayedTime();
+	//Restarts counting the played time from the given value, used after seeking
+	void setPlayedTime(uint32_t time);
 	bool ispaused();
 	void mute();
 	void unmute();
 	void pause() { SetPause(true); }
 	void resume() { SetPause(false); }
 	void setVolume(double volume);
+	//-1.0 is full left, 1.0 is full right
+	void setPan(double pan);
 	inline double getVolume() const { return curvolume; }
+	inline double getPan() const { return curpan; }
 	inline AudioDecoder *getDecoder() const { return decoder; }
+	inline uint32_t getUnderrunCount() const { return underruns; }
 	~AudioStream();
 };
 
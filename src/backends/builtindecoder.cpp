@@ -21,6 +21,7 @@
 #include "scripting/flash/display/DisplayObject.h"
 #include "scripting/flash/display/flashdisplay.h"
 #include "scripting/flash/net/flashnet.h"
+#include "scripting/toplevel/Array.h"
 #include "swf.h"
 
 using namespace lightspark;
@@ -34,6 +35,9 @@ BuiltinStreamDecoder::BuiltinStreamDecoder(std::istream& _s, NetStream* _ns):
 		FLV_HEADER h(stream);
 		valid=h.isValid();
 		hasvideo=h.hasVideo();
+		int64_t firstTag=stream.tellg();
+		if(firstTag>=0)
+			keyframes.setIndexedOffset(firstTag);
 	}
 	else
 		valid=false;
@@ -62,8 +66,72 @@ BuiltinStreamDecoder::STREAM_TYPE BuiltinStreamDecoder::classifyStream(std::istr
 	return ret;
 }
 
+static bool getMetadataValue(ASObject* o, const char* name, asAtom& ret)
+{
+	multiname m(nullptr);
+	m.name_type=multiname::NAME_STRING;
+	m.name_s_id=getSys()->getUniqueStringId(name);
+	m.ns.emplace_back(getSys(),BUILTIN_STRINGS::EMPTY,NAMESPACE);
+	m.isAttribute = false;
+	if(!o->hasPropertyByMultiname(m,true,false))
+		return false;
+	o->getVariableByMultiname(ret,m);
+	return asAtomHandler::isValid(ret);
+}
+
+void BuiltinStreamDecoder::readMetadataKeyframes(ASObject* metadata)
+{
+	//Many encoders store the keyframe positions as
+	//keyframes: { times: [seconds], filepositions: [tag offsets] }
+	asAtom k=asAtomHandler::invalidAtom;
+	if(!getMetadataValue(metadata,"keyframes",k) || !asAtomHandler::isObject(k))
+		return;
+	ASObject* kobj=asAtomHandler::getObjectNoCheck(k);
+	asAtom times=asAtomHandler::invalidAtom;
+	asAtom positions=asAtomHandler::invalidAtom;
+	if(!getMetadataValue(kobj,"times",times) || !asAtomHandler::isArray(times) ||
+	   !getMetadataValue(kobj,"filepositions",positions) || !asAtomHandler::isArray(positions))
+		return;
+	Array* t=asAtomHandler::as<Array>(times);
+	Array* p=asAtomHandler::as<Array>(positions);
+	uint32_t count=dmin(t->size(),p->size());
+	for(uint32_t i=0;i<count;i++)
+	{
+		number_t time=asAtomHandler::toNumber(t->at(i));
+		number_t pos=asAtomHandler::toNumber(p->at(i));
+		//The positions point to the tag, the index to the PreviousTagSize before it
+		if(std::isnan(time) || std::isnan(pos) || time<0 || pos<4)
+			continue;
+		keyframes.addKeyframe(time*1000,pos-4);
+	}
+}
+
+bool BuiltinStreamDecoder::seek(uint32_t time, uint64_t availableBytes, uint32_t& keyframeTime)
+{
+	uint64_t current=stream.tellg();
+	//Index the downloaded tags up to the requested time, unless
+	//onMetaData already gave the keyframe positions
+	keyframes.scan(stream,availableBytes,time);
+	uint64_t offset;
+	if(!keyframes.find(time,availableBytes,keyframeTime,offset))
+	{
+		stream.clear();
+		stream.seekg(current);
+		return false;
+	}
+	stream.clear();
+	stream.seekg(offset);
+	resetDecoders();
+	//Restart the timing from the keyframe
+	decodedTime=keyframeTime;
+	decodedAudioBytes=audioDecoder ? keyframeTime*audioDecoder->getBytesPerMSec() : 0;
+	decodedVideoFrames=keyframeTime*frameRate/1000;
+	return true;
+}
+
 bool BuiltinStreamDecoder::decodeNextFrame()
 {
+	int64_t tagOffset=stream.tellg();
 	UI32_FLV PreviousTagSize;
 	stream >> PreviousTagSize;
 	// It seems that Adobe simply ignores invalid values for PreviousTagSize
@@ -193,6 +261,8 @@ bool BuiltinStreamDecoder::decodeNextFrame()
 					decodedVideoFrames++;
 				}
 			}
+			if(tag.frameType==1 && tagOffset>=0)
+				keyframes.addKeyframe(tag.getTimestamp(),tagOffset);
 			break;
 		}
 		case 18:
@@ -220,6 +290,12 @@ bool BuiltinStreamDecoder::decodeNextFrame()
 					}
 					it++;
 				}
+				for (it = tag.dataobjectlist.begin(); it != tag.dataobjectlist.end(); it++)
+				{
+					ASObject* o = asAtomHandler::getObject((*it));
+					if(o)
+						readMetadataKeyframes(o);
+				}
 			}
 			
 			netstream->sendClientNotification(tag.methodName,tag.dataobjectlist);
@@ -229,5 +305,8 @@ bool BuiltinStreamDecoder::decodeNextFrame()
 			LOG(LOG_ERROR,_("Unexpected tag type ") << (int)TagType << _(" in FLV"));
 			return false;
 	}
+	int64_t nextOffset=stream.tellg();
+	if(nextOffset>=0)
+		keyframes.setIndexedOffset(nextOffset);
 	return true;
 }
@@ -39,6 +39,8 @@ private:
 	uint32_t decodedTime;
 	double frameRate;
 	ScriptDataTag metadataTag;
+	FLVKeyframeIndex keyframes;
+	void readMetadataKeyframes(ASObject* metadata);
 	enum STREAM_TYPE { FLV_STREAM=0, UNKOWN_STREAM=1 };
 	STREAM_TYPE classifyStream(std::istream& s);
 	NetStream* netstream;
@@ -48,6 +50,7 @@ public:
 	BuiltinStreamDecoder(std::istream& _s, NetStream* _ns);
 	~BuiltinStreamDecoder();
 	bool decodeNextFrame();
+	bool seek(uint32_t time, uint64_t availableBytes, uint32_t& keyframeTime);
 };
 
 };
@@ -84,7 +84,8 @@ Config::Config():
 	//DEFAULT SETTINGS
 	defaultCacheDirectory((string) g_get_user_cache_dir() + "/lightspark"),
 	cacheDirectory(defaultCacheDirectory),cachePrefix("cache"),
-	renderingEnabled(true)
+	renderingEnabled(true),sampleDataBufferSize(4096),
+	httpCacheSize(64),httpCacheMemorySize(16),streamCacheMemorySize(256)
 {
 #ifdef _WIN32
 	const char* exePath = getExectuablePath();
@@ -219,6 +220,20 @@ void Config::handleEntry()
 	//Cache prefix
 	else if(group == "cache" && key == "prefix")
 		cachePrefix = value;
+	//Audio output
+	else if(group == "audio" && key == "output")
+		audioOutput = value;
+	//Dynamic sound buffer size
+	else if(group == "audio" && key == "sampledatabuffer")
+		sampleDataBufferSize = max(2048,min(8192,atoi(value.c_str())));
+	//HTTP response cache limits
+	else if(group == "cache" && key == "httpsize")
+		httpCacheSize = max(0,atoi(value.c_str()));
+	else if(group == "cache" && key == "httpmemory")
+		httpCacheMemorySize = max(0,atoi(value.c_str()));
+	//Memory limit of the downloaded streams
+	else if(group == "cache" && key == "streammemory")
+		streamCacheMemorySize = max(0,atoi(value.c_str()));
 	else
 		LOG(LOG_ERROR,_("Invalid entry encountered in configuration file") << ": '" << group << "/" << key << "'='" << value << "'");
 }
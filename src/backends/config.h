@@ -51,6 +51,16 @@ namespace lightspark
 
 		//Specifies if rendering should be done
 		bool renderingEnabled;
+		//Specifies where mixed audio goes: empty for the sound device,
+		//"null" to discard it or a file name to write raw s16le stereo to
+		std::string audioOutput;
+		//Samples queued at once for dynamic sounds (sampleData events), 2048-8192
+		uint32_t sampleDataBufferSize;
+		//Megabytes of HTTP responses cached on disk (0 disables the cache) and in memory
+		uint32_t httpCacheSize;
+		uint32_t httpCacheMemorySize;
+		//Megabytes of downloaded streams kept in memory before spilling to disk, 0 for no limit
+		uint32_t streamCacheMemorySize;
 		Config();
 		~Config();
 	public:
@@ -64,6 +74,11 @@ namespace lightspark
 		const std::string& getGnashPath() const { return gnashPath; }
 
 		bool isRenderingEnabled() const { return renderingEnabled; }
+		const std::string& getAudioOutput() const { return audioOutput; }
+		uint32_t getSampleDataBufferSize() const { return sampleDataBufferSize; }
+		uint32_t getHTTPCacheSize() const { return httpCacheSize; }
+		uint32_t getHTTPCacheMemorySize() const { return httpCacheMemorySize; }
+		uint32_t getStreamCacheMemorySize() const { return streamCacheMemorySize; }
 	};
 }
 
@@ -170,6 +170,7 @@ void FFMpegVideoDecoder::switchCodec(LS_VIDEO_CODEC codecId, uint8_t *initdata,
 		codecContext->extradata=initdata;
 		codecContext->extradata_size=datalen;
 	}
+	setupThreading();
 #ifdef HAVE_AVCODEC_OPEN2
 	if(avcodec_open2(codecContext, codec, NULL)<0)
 #else
@@ -209,6 +210,7 @@ FFMpegVideoDecoder::FFMpegVideoDecoder(AVCodecParameters* codecPar, double frame
 	}
 	avcodec_parameters_to_context(codecContext,codecPar);
 	AVCodec* codec=avcodec_find_decoder(codecPar->codec_id);
+	setupThreading();
 #ifdef HAVE_AVCODEC_OPEN2
 	if(avcodec_open2(codecContext, codec, NULL)<0)
 #else
@@ -244,6 +246,7 @@ FFMpegVideoDecoder::FFMpegVideoDecoder(AVCodecContext* _c, double frameRateHint)
 			return;
 	}
 	AVCodec* codec=avcodec_find_decoder(codecContext->codec_id);
+	setupThreading();
 #ifdef HAVE_AVCODEC_OPEN2
 	if(avcodec_open2(codecContext, codec, NULL)<0)
 #else
@@ -301,6 +304,19 @@ void FFMpegVideoDecoder::skipAll()
 		discardFrame();
 }
 
+void FFMpegVideoDecoder::reset()
+{
+	{
+		//Frames dropped here are not late, so framesdropped is left alone
+		Locker locker(mutex);
+		while(buffers.nonBlockingPopFront());
+	}
+	avcodec_flush_buffers(codecContext);
+	//The playback clock is unknown until the next tick, don't drop frames against the old one
+	presentationTime=0;
+	codecContext->skip_frame=AVDISCARD_DEFAULT;
+}
+
 bool FFMpegVideoDecoder::discardFrame()
 {
 	Locker locker(mutex);
@@ -325,28 +341,14 @@ bool FFMpegVideoDecoder::decodeData(uint8_t* data, uint32_t datalen, uint32_t ti
 	av_init_packet(&pkt);
 	pkt.data=data;
 	pkt.size=datalen;
+	pkt.pts=time;
 	int ret = avcodec_send_packet(codecContext, &pkt);
-	while (ret == 0)
+	if (ret != 0)
 	{
-		ret = avcodec_receive_frame(codecContext,frameIn);
-		if (ret != 0)
-		{
-			if (ret != AVERROR(EAGAIN))
-			{
-				LOG(LOG_INFO,"not decoded:"<<ret);
-				return false;
-			}
-		}
-		else
-		{
-			if(status==INIT && fillDataAndCheckValidity())
-				status=VALID;
-	
-			assert(frameIn->pts==(int64_t)AV_NOPTS_VALUE || frameIn->pts==0);
-	
-			copyFrameToBuffers(frameIn, time);
-		}
+		LOG(LOG_INFO,"not decoded:"<<ret);
+		return false;
 	}
+	return receiveFrames();
 #else
 	int frameOk=0;
 #if HAVE_AVCODEC_DECODE_VIDEO2
@@ -381,28 +383,15 @@ bool FFMpegVideoDecoder::decodeData(uint8_t* data, uint32_t datalen, uint32_t ti
 bool FFMpegVideoDecoder::decodePacket(AVPacket* pkt, uint32_t time)
 {
 #if defined HAVE_AVCODEC_SEND_PACKET && defined HAVE_AVCODEC_RECEIVE_FRAME
+	//The codec threads hand the timestamp back with the decoded frame
+	pkt->pts=time;
 	int ret = avcodec_send_packet(codecContext, pkt);
-	while (ret == 0)
+	if (ret != 0)
 	{
-		ret = avcodec_receive_frame(codecContext,frameIn);
-		if (ret != 0)
-		{
-			if (ret != AVERROR(EAGAIN))
-			{
-				LOG(LOG_INFO,"not decoded:"<<ret);
-				return false;
-			}
-		}
-		else
-		{
-			if(status==INIT && fillDataAndCheckValidity())
-				status=VALID;
-	
-			assert(frameIn->pts==(int64_t)AV_NOPTS_VALUE || frameIn->pts==0);
-	
-			copyFrameToBuffers(frameIn, time);
-		}
+		LOG(LOG_INFO,"not decoded:"<<ret);
+		return false;
 	}
+	return receiveFrames();
 #else
 	int frameOk=0;
 
@@ -433,8 +422,67 @@ bool FFMpegVideoDecoder::decodePacket(AVPacket* pkt, uint32_t time)
 	return true;
 }
 
+#if defined HAVE_AVCODEC_SEND_PACKET && defined HAVE_AVCODEC_RECEIVE_FRAME
+bool FFMpegVideoDecoder::receiveFrames()
+{
+	while(true)
+	{
+		int ret = avcodec_receive_frame(codecContext,frameIn);
+		if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+			return true;
+		if (ret != 0)
+		{
+			LOG(LOG_INFO,"not decoded:"<<ret);
+			return false;
+		}
+		if(status==INIT && fillDataAndCheckValidity())
+			status=VALID;
+
+		int64_t time=frameIn->pts;
+		if(time==(int64_t)AV_NOPTS_VALUE)
+			time=frameIn->best_effort_timestamp;
+		copyFrameToBuffers(frameIn, time);
+	}
+}
+#endif
+
+void FFMpegVideoDecoder::drain()
+{
+#if defined HAVE_AVCODEC_SEND_PACKET && defined HAVE_AVCODEC_RECEIVE_FRAME
+	//An empty packet makes the codec output the frames it still holds
+	if (avcodec_send_packet(codecContext, NULL) == 0)
+		receiveFrames();
+#endif
+}
+
+void FFMpegVideoDecoder::setupThreading()
+{
+#ifdef FF_THREAD_SLICE
+	//Let libavcodec choose the number of threads from the available cores
+	codecContext->thread_count=0;
+#if defined HAVE_AVCODEC_SEND_PACKET && defined HAVE_AVCODEC_RECEIVE_FRAME
+	//Frame threading delays the output by a few frames, which the
+	//send/receive API handles, and drain() flushes at the end
+	codecContext->thread_type=FF_THREAD_FRAME|FF_THREAD_SLICE;
+#else
+	codecContext->thread_type=FF_THREAD_SLICE;
+#endif
+#endif
+}
+
 void FFMpegVideoDecoder::copyFrameToBuffers(const AVFrame* frameIn, uint32_t time)
 {
+	uint32_t now=presentationTime;
+	uint32_t tolerance=frameRate ? 1000/frameRate : 0;
+	if(now && time+tolerance<now)
+	{
+		//The frame is already late, don't queue it and let the codec skip
+		//the frames no other frame depends on until decoding catches up
+		framesdropped++;
+		codecContext->skip_frame=AVDISCARD_NONREF;
+		return;
+	}
+	codecContext->skip_frame=AVDISCARD_DEFAULT;
 	YUVBuffer& curTail=buffers.acquireLast();
 	//Only one thread may access the tail
 	int offset[3]={0,0,0};
@@ -570,6 +618,73 @@ void AudioDecoder::skipAll()
 		discardFrame();
 }
 
+SampleDataAudioDecoder::SampleDataAudioDecoder(uint32_t outputRate, uint32_t _chunkSize)
+	:chunkSize(_chunkSize),decodedFrames(0),resampleStep(44100.0/outputRate),resamplePos(0),lastLeft(0),lastRight(0)
+{
+	//A chunk is resampled to at most this many samples
+	uint32_t chunkSamples=ceil(chunkSize/resampleStep)+1;
+	framesPerChunk=(chunkSamples+maxFrameSamples-1)/maxFrameSamples;
+	status=VALID;
+	sampleRate=outputRate;
+	channelCount=2;
+	initialTime=0;
+}
+
+static inline float readSampleFloat(const uint8_t* p, bool littleEndian)
+{
+	uint32_t v;
+	memcpy(&v,p,sizeof(v));
+	v = littleEndian ? GUINT32_FROM_LE(v) : GUINT32_FROM_BE(v);
+	float f;
+	memcpy(&f,&v,sizeof(f));
+	return f;
+}
+
+static inline int16_t sampleFloatToS16(float f)
+{
+	return (int16_t)(dmax(-1.0,dmin(1.0,f))*32767);
+}
+
+void SampleDataAudioDecoder::decodeFloatSamples(const uint8_t* data, uint32_t count, bool littleEndian)
+{
+	for(uint32_t chunkStart=0;chunkStart<count;chunkStart+=chunkSize)
+	{
+		const uint32_t chunkLen=min(chunkSize,count-chunkStart);
+		const uint8_t* chunk=data+chunkStart*2*sizeof(float);
+		//The whole chunk is resampled, a full frame is queued and the chunk continues in the next one
+		while(resamplePos < chunkLen-1)
+		{
+			FrameSamples& frame=samplesBuffer.acquireLast();
+			frame.current=frame.samples;
+			frame.time=decodedFrames*1000/sampleRate;
+			uint32_t produced=0;
+			//Interpolate between consecutive input samples, index -1 is the
+			//last sample of the previous chunk
+			while(resamplePos < chunkLen-1 && produced < maxFrameSamples)
+			{
+				int32_t i=(int32_t)floor(resamplePos);
+				float frac=resamplePos-i;
+				float l0=(i<0) ? lastLeft : readSampleFloat(chunk+i*8,littleEndian);
+				float r0=(i<0) ? lastRight : readSampleFloat(chunk+i*8+4,littleEndian);
+				float l1=readSampleFloat(chunk+(i+1)*8,littleEndian);
+				float r1=readSampleFloat(chunk+(i+1)*8+4,littleEndian);
+				frame.samples[produced*2]=sampleFloatToS16(l0+(l1-l0)*frac);
+				frame.samples[produced*2+1]=sampleFloatToS16(r0+(r1-r0)*frac);
+				produced++;
+				resamplePos+=resampleStep;
+			}
+			frame.len=produced*2*sizeof(int16_t);
+			decodedFrames+=produced;
+			samplesBuffer.commitLast();
+		}
+		resamplePos-=chunkLen;
+		//The next chunk starts interpolating from the last sample of this one
+		assert(resamplePos>=-1 && resamplePos<0);
+		lastLeft=readSampleFloat(chunk+(chunkLen-1)*8,littleEndian);
+		lastRight=readSampleFloat(chunk+(chunkLen-1)*8+4,littleEndian);
+	}
+}
+
 #ifdef ENABLE_LIBAVCODEC
 FFMpegAudioDecoder::FFMpegAudioDecoder(EngineData* eng,LS_AUDIO_CODEC audioCodec, uint8_t* initdata, uint32_t datalen):engine(eng),ownedContext(true)
 #if defined HAVE_LIBAVRESAMPLE || defined HAVE_LIBSWRESAMPLE
@@ -732,6 +847,13 @@ FFMpegAudioDecoder::~FFMpegAudioDecoder()
 #endif
 }
 
+void FFMpegAudioDecoder::reset()
+{
+	skipAll();
+	overflowBuffer.clear();
+	avcodec_flush_buffers(codecContext);
+}
+
 CodecID FFMpegAudioDecoder::LSToFFMpegCodec(LS_AUDIO_CODEC LSCodec)
 {
 	switch(LSCodec)
@@ -1098,6 +1220,17 @@ StreamDecoder::~StreamDecoder()
 	delete videoDecoder;
 }
 
+void StreamDecoder::resetDecoders()
+{
+	if(videoDecoder)
+	{
+		videoDecoder->reset();
+		videoDecoder->framesdecoded=0;
+	}
+	if(audioDecoder)
+		audioDecoder->reset();
+}
+
 #ifdef ENABLE_LIBAVCODEC
 FFMpegStreamDecoder::FFMpegStreamDecoder(EngineData *eng, std::istream& s, AudioFormat* format, int streamsize)
  : audioFound(false),videoFound(false),stream(s),formatCtx(NULL),audioIndex(-1),
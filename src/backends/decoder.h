@@ -88,6 +88,10 @@ public:
 		return status>=VALID;
 	}
 	virtual void setFlushing()=0;
+	bool isFlushing() const
+	{
+		return flushing;
+	}
 	void waitFlushed()
 	{
 		flushed.wait();
@@ -97,13 +101,34 @@ public:
 class VideoDecoder: public Decoder, public ITextureUploadable
 {
 public:
-	VideoDecoder():frameRate(0),framesdecoded(0),framesdropped(0),frameWidth(0),frameHeight(0),fenceCount(0),resizeGLBuffers(false){}
+	VideoDecoder():frameRate(0),framesdecoded(0),framesdropped(0),presentationTime(0),frameWidth(0),frameHeight(0),fenceCount(0),resizeGLBuffers(false){}
 	virtual ~VideoDecoder(){}
 	virtual void switchCodec(LS_VIDEO_CODEC codecId, uint8_t* initdata, uint32_t datalen, double frameRateHint)=0;
 	virtual bool decodeData(uint8_t* data, uint32_t datalen, uint32_t time)=0;
 	virtual bool discardFrame()=0;
 	virtual void skipUntil(uint32_t time)=0;
 	virtual void skipAll()=0;
+	/*
+		Drops the queued frames and the state of the codec, used when the
+		stream is moved to another keyframe
+	*/
+	virtual void reset() { skipAll(); }
+	/*
+		Outputs the frames still held by the codec at the end of the stream
+	*/
+	virtual void drain(){}
+	/*
+		Number of decoded frames waiting to be presented
+	*/
+	virtual uint32_t getQueuedFrames() const { return 0; }
+	/*
+		Tells the decoder which frame time is on screen, frames that are
+		already late when decoded are dropped instead of being queued
+	*/
+	void setPresentationTime(uint32_t time)
+	{
+		presentationTime=time;
+	}
 	uint32_t getWidth()
 	{
 		return frameWidth;
@@ -114,7 +139,8 @@ public:
 	}
 	double frameRate;
 	uint32_t framesdecoded;
-	uint32_t framesdropped;
+	ACQUIRE_RELEASE_VARIABLE(uint32_t,framesdropped);
+	ACQUIRE_RELEASE_VARIABLE(uint32_t,presentationTime);
 	/*
 		Useful to avoid destruction of the object while a pending upload is waiting
 	*/
@@ -194,6 +220,10 @@ private:
 	BlockingCircularQueue<YUVBuffer,80> buffers;
 	Mutex mutex;
 	AVFrame* frameIn;
+	void setupThreading();
+#if defined HAVE_AVCODEC_SEND_PACKET && defined HAVE_AVCODEC_RECEIVE_FRAME
+	bool receiveFrames();
+#endif
 	void copyFrameToBuffers(const AVFrame* frameIn, uint32_t time);
 	void setSize(uint32_t w, uint32_t h);
 	bool fillDataAndCheckValidity();
@@ -218,6 +248,9 @@ public:
 	bool discardFrame();
 	void skipUntil(uint32_t time);
 	void skipAll();
+	void reset();
+	void drain();
+	uint32_t getQueuedFrames() const { return buffers.len(); }
 	void setFlushing()
 	{
 		flushing=true;
@@ -285,6 +318,10 @@ public:
 	  	Skip all the samples
 	*/
 	void skipAll() DLL_PUBLIC;
+	/**
+	  	Drop the samples and the state of the codec, used when seeking
+	*/
+	virtual void reset() { skipAll(); }
 	bool discardFrame();
 	void setFlushing()
 	{
@@ -313,6 +350,40 @@ public:
 	uint32_t decodeData(uint8_t* data, int32_t datalen, uint32_t time){return 0;}
 };
 
+/*
+ * Decoder for the samples written by sampleData listeners of a dynamic
+ * Sound: 44100Hz stereo floats, converted to the mixer rate. Every
+ * chunkSize input samples are queued as one frame, or as framesPerChunk
+ * frames if they don't fit, so the number of queued chunks tells the
+ * producer how far ahead of the mixer it is
+ */
+class SampleDataAudioDecoder: public AudioDecoder
+{
+private:
+	uint32_t chunkSize;
+	//An output frame can hold this many stereo samples
+	static const uint32_t maxFrameSamples=MAX_AUDIO_FRAME_SIZE/(2*sizeof(int16_t));
+	//Frames needed to queue a chunk, 1 unless MAX_AUDIO_FRAME_SIZE is small
+	uint32_t framesPerChunk;
+	uint64_t decodedFrames;
+	//Linear resampler state, carried over between calls
+	double resampleStep;
+	double resamplePos;
+	float lastLeft;
+	float lastRight;
+public:
+	SampleDataAudioDecoder(uint32_t outputRate, uint32_t _chunkSize);
+	void switchCodec(LS_AUDIO_CODEC codecId, uint8_t* initdata, uint32_t datalen){};
+	uint32_t decodeData(uint8_t* data, int32_t datalen, uint32_t time){return 0;}
+	/*
+	 * Converts count stereo float samples stored with the given
+	 * endianness and queues them for playback
+	 */
+	void decodeFloatSamples(const uint8_t* data, uint32_t count, bool littleEndian);
+	uint32_t getChunkSize() const { return chunkSize; }
+	uint32_t queuedChunks() const { return (samplesBuffer.len()+framesPerChunk-1)/framesPerChunk; }
+};
+
 #ifdef ENABLE_LIBAVCODEC
 class EngineData;
 class FFMpegAudioDecoder: public AudioDecoder
@@ -351,6 +422,7 @@ public:
 	uint32_t decodePacket(AVPacket* pkt, uint32_t time);
 	void switchCodec(LS_AUDIO_CODEC audioCodec, uint8_t* initdata, uint32_t datalen);
 	uint32_t decodeData(uint8_t* data, int32_t datalen, uint32_t time);
+	void reset();
 };
 #endif
 
@@ -360,6 +432,12 @@ public:
 	StreamDecoder():audioDecoder(NULL),videoDecoder(NULL),valid(false),hasvideo(false){}
 	virtual ~StreamDecoder();
 	virtual bool decodeNextFrame() = 0;
+	/*
+		Moves decoding to the last keyframe at or before time, if it is
+		within the first availableBytes of the stream. On success the
+		decoders are reset and keyframeTime is the time of that keyframe
+	*/
+	virtual bool seek(uint32_t time, uint64_t availableBytes, uint32_t& keyframeTime) { return false; }
 	bool isValid() const { return valid; }
 	AudioDecoder* audioDecoder;
 	VideoDecoder* videoDecoder;
@@ -367,6 +445,7 @@ public:
 protected:
 	bool valid;
 	bool hasvideo;
+	void resetDecoders();
 };
 
 #ifdef ENABLE_LIBAVCODEC
@@ -449,3 +449,161 @@ GeomToken::GeomToken(GEOM_TOKEN_TYPE _t, const MORPHLINESTYLE2& _s):fillStyle(0x
 {
 	
 }
+
+//Maximum distance in pixels between a curve and its flattened segments
+#define FLATTEN_TOLERANCE 0.1
+#define FLATTEN_MAX_SEGMENTS 64
+
+void FlattenedOutline::startPolygon(const Vector2f& p)
+{
+	closePolygon();
+	points.push_back(p);
+	xmin=dmin(xmin,p.x);
+	xmax=dmax(xmax,p.x);
+	ymin=dmin(ymin,p.y);
+	ymax=dmax(ymax,p.y);
+}
+
+void FlattenedOutline::closePolygon()
+{
+	uint32_t start=polygonEnds.empty() ? 0 : polygonEnds.back();
+	//Polygons with less than 3 points have no area
+	if(points.size()-start>=3)
+		polygonEnds.push_back(points.size());
+	else
+		points.resize(start);
+}
+
+void FlattenedOutline::lineTo(const Vector2f& p)
+{
+	points.push_back(p);
+	xmin=dmin(xmin,p.x);
+	xmax=dmax(xmax,p.x);
+	ymin=dmin(ymin,p.y);
+	ymax=dmax(ymax,p.y);
+}
+
+void FlattenedOutline::curveTo(const Vector2f& p1, const Vector2f& p2, const Vector2f& p3)
+{
+	const Vector2f p0=points.back();
+	//Wang's formula gives the number of segments needed for the tolerance
+	number_t ddx=dmax(fabs(p0.x-2*p1.x+p2.x),fabs(p1.x-2*p2.x+p3.x));
+	number_t ddy=dmax(fabs(p0.y-2*p1.y+p2.y),fabs(p1.y-2*p2.y+p3.y));
+	number_t dd=sqrt(ddx*ddx+ddy*ddy);
+	int segments=ceil(sqrt(0.75*dd/FLATTEN_TOLERANCE));
+	segments=max(1,min(segments,FLATTEN_MAX_SEGMENTS));
+	for(int i=1;i<segments;i++)
+	{
+		number_t t=number_t(i)/segments;
+		number_t u=1-t;
+		number_t a=u*u*u;
+		number_t b=3*u*u*t;
+		number_t c=3*u*t*t;
+		number_t d=t*t*t;
+		lineTo(Vector2f(a*p0.x+b*p1.x+c*p2.x+d*p3.x,a*p0.y+b*p1.y+c*p2.y+d*p3.y));
+	}
+	lineTo(p3);
+}
+
+void FlattenedOutline::build(const tokensVector& tokens, float scaleFactor)
+{
+	points.clear();
+	polygonEnds.clear();
+	xmin=numeric_limits<double>::infinity();
+	ymin=numeric_limits<double>::infinity();
+	xmax=-numeric_limits<double>::infinity();
+	ymax=-numeric_limits<double>::infinity();
+	bool hasCurrentPoint=false;
+	auto scaled=[scaleFactor](const Vector2& v) { return Vector2f(v.x*scaleFactor,v.y*scaleFactor); };
+	for(auto it=tokens.filltokens.begin();it!=tokens.filltokens.end();++it)
+	{
+		const GeomToken* token=it->getPtr();
+		switch(token->type)
+		{
+			case MOVE:
+				startPolygon(scaled(token->p1));
+				hasCurrentPoint=true;
+				break;
+			case STRAIGHT:
+				if(hasCurrentPoint)
+					lineTo(scaled(token->p1));
+				else
+					startPolygon(scaled(token->p1));
+				hasCurrentPoint=true;
+				break;
+			case CURVE_QUADRATIC:
+			{
+				if(!hasCurrentPoint)
+					startPolygon(scaled(token->p1));
+				hasCurrentPoint=true;
+				//Raise the degree, the same as the cairo path does
+				const Vector2f start=points.back();
+				const Vector2f control=scaled(token->p1);
+				const Vector2f end=scaled(token->p2);
+				curveTo(Vector2f(control.x*(2.0/3.0)+start.x*(1.0/3.0),control.y*(2.0/3.0)+start.y*(1.0/3.0)),
+					Vector2f(control.x*(2.0/3.0)+end.x*(1.0/3.0),control.y*(2.0/3.0)+end.y*(1.0/3.0)),end);
+				break;
+			}
+			case CURVE_CUBIC:
+				if(!hasCurrentPoint)
+					startPolygon(scaled(token->p1));
+				hasCurrentPoint=true;
+				curveTo(scaled(token->p1),scaled(token->p2),scaled(token->p3));
+				break;
+			default:
+				break;
+		}
+	}
+	closePolygon();
+}
+
+bool FlattenedOutline::contains(number_t x, number_t y) const
+{
+	if(polygonEnds.empty() || x<xmin || x>xmax || y<ymin || y>ymax)
+		return false;
+	int winding=0;
+	uint32_t start=0;
+	for(auto it=polygonEnds.begin();it!=polygonEnds.end();++it)
+	{
+		uint32_t end=*it;
+		for(uint32_t i=start;i<end;i++)
+		{
+			const Vector2f& a=points[i];
+			const Vector2f& b=points[i+1==end ? start : i+1];
+			number_t side=(b.x-a.x)*(y-a.y)-(x-a.x)*(b.y-a.y);
+			if(a.y<=y)
+			{
+				//Upward crossing with the point on the left
+				if(b.y>y && side>0)
+					winding++;
+			}
+			else if(b.y<=y && side<0)
+				winding--;
+		}
+		start=end;
+	}
+	return winding!=0;
+}
+
+bool OutlineCache::isValidFor(const tokensVector& tokens, float _scaleFactor) const
+{
+	if(scaleFactor!=_scaleFactor || fillCount!=tokens.filltokens.size())
+		return false;
+	if(fillCount && (firstFill!=tokens.filltokens.front() || lastFill!=tokens.filltokens.back()))
+		return false;
+	return true;
+}
+
+bool OutlineCache::hitTest(const tokensVector& tokens, float _scaleFactor, number_t x, number_t y)
+{
+	Locker l(mutex);
+	if(!isValidFor(tokens,_scaleFactor))
+	{
+		fillCount=tokens.filltokens.size();
+		firstFill=fillCount ? tokens.filltokens.front() : NullRef;
+		lastFill=fillCount ? tokens.filltokens.back() : NullRef;
+		scaleFactor=_scaleFactor;
+		outline.build(tokens,scaleFactor);
+	}
+	return outline.contains(x,y);
+}
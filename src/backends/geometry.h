@@ -21,6 +21,7 @@
 
 #include "compat.h"
 #include "swftypes.h"
+#include "threading.h"
 #include <list>
 #include <vector>
 #include <map>
@@ -144,6 +145,62 @@ public:
 	void clear();
 };
 
+/*
+ * Polygons flattened from the fill paths of a tokensVector, used to test if a point is
+ * inside of a shape without building a cairo path. Like the path used for hit testing
+ * before, strokes are not part of it and the polygons are filled with the non-zero
+ * winding rule
+ */
+class FlattenedOutline
+{
+private:
+	std::vector<Vector2f> points;
+	//End of each polygon in points, polygons are implicitly closed
+	std::vector<uint32_t> polygonEnds;
+	number_t xmin, xmax, ymin, ymax;
+	void startPolygon(const Vector2f& p);
+	void closePolygon();
+	void lineTo(const Vector2f& p);
+	void curveTo(const Vector2f& p1, const Vector2f& p2, const Vector2f& p3);
+public:
+	FlattenedOutline():xmin(0),xmax(0),ymin(0),ymax(0){}
+	void build(const tokensVector& tokens, float scaleFactor);
+	bool contains(number_t x, number_t y) const;
+};
+
+/*
+ * Keeps the flattened outline of a tokensVector until the fill tokens or the scale change.
+ * Tokens are never modified once created and are only appended to or cleared from a
+ * tokensVector, so comparing the number of tokens and the first and last ones is enough
+ * to detect changes. References to those are kept so that their addresses can't be
+ * reused by new tokens
+ */
+class OutlineCache
+{
+private:
+	Mutex mutex;
+	_NR<GeomToken> firstFill;
+	_NR<GeomToken> lastFill;
+	uint32_t fillCount;
+	float scaleFactor;
+	FlattenedOutline outline;
+	bool isValidFor(const tokensVector& tokens, float _scaleFactor) const;
+public:
+	OutlineCache():fillCount(0),scaleFactor(0){}
+	//The cache is not copied, the copy builds its own outline
+	OutlineCache(const OutlineCache&):fillCount(0),scaleFactor(0){}
+	OutlineCache& operator=(const OutlineCache&) { return *this; }
+	/*
+	   Hit testing helper, finds if a point is inside the shape
+
+	   @param tokens The tokens of the shape being tested
+	   @param scaleFactor The scale factor to be applied
+	   @param x The X in local coordinates
+	   @param y The Y in local coordinates
+	*/
+	bool hitTest(const tokensVector& tokens, float _scaleFactor, number_t x, number_t y);
+};
+
 std::ostream& operator<<(std::ostream& s, const Vector2& p);
 
 };
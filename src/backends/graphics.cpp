@@ -636,28 +636,6 @@ uint8_t* CairoRenderer::getPixelBuffer()
 	return ret;
 }
 
-bool CairoTokenRenderer::hitTest(const tokensVector& tokens, float scaleFactor, number_t x, number_t y)
-{
-	cairo_surface_t* cairoSurface=cairo_image_surface_create_for_data(NULL, CAIRO_FORMAT_ARGB32, 0, 0, 0);
-	cairo_t *cr=cairo_create(cairoSurface);
-	cairo_set_operator (cr, CAIRO_OPERATOR_OVER);
-	cairo_set_fill_rule(cr, CAIRO_FILL_RULE_WINDING);
-
-	bool empty=cairoPathFromTokens(cr, tokens, scaleFactor, true,nullptr);
-	bool ret=false;
-	if(!empty)
-	{
-		/* reset the matrix so x and y are not scaled
-		 * by the current cairo transformation
-		 */
-		cairo_identity_matrix(cr);
-		ret=cairo_in_fill(cr, x, y);
-	}
-	cairo_destroy(cr);
-	cairo_surface_destroy(cairoSurface);
-	return ret;
-}
-
 void CairoTokenRenderer::applyCairoMask(cairo_t* cr,int32_t xOffset,int32_t yOffset) const
 {
 	cairo_matrix_t tmp=matrix;
@@ -979,6 +957,8 @@ void CairoPangoRenderer::applyCairoMask(cairo_t* cr, int32_t xOffset, int32_t yO
 
 AsyncDrawJob::AsyncDrawJob(IDrawable* d, _R<DisplayObject> o):drawable(d),owner(o),surfaceBytes(NULL),uploadNeeded(false)
 {
+	//The job is released by the thread pool
+	owner->setShared();
 }
 
 AsyncDrawJob::~AsyncDrawJob()
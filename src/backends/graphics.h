@@ -252,15 +252,6 @@ public:
 			int32_t _x, int32_t _y, int32_t _w, int32_t _h,
 		    float _s, float _a, const std::vector<MaskData>& _ms,bool _smoothing,
 			ColorTransform* _ct);
-	/*
-	   Hit testing helper. Uses cairo to find if a point in inside the shape
-
-	   @param tokens The tokens of the shape being tested
-	   @param scaleFactor The scale factor to be applied
-	   @param x The X in local coordinates
-	   @param y The Y in local coordinates
-	*/
-	static bool hitTest(const tokensVector& tokens, float scaleFactor, number_t x, number_t y);
 };
 
 class TextData
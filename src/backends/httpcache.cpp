@@ -0,0 +1,488 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2010-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include <glib.h>
+#include <fstream>
+#include <boost/filesystem.hpp>
+#ifdef ENABLE_CURL
+#include <curl/curl.h>
+#endif
+#include "backends/httpcache.h"
+#include "logger.h"
+
+using namespace lightspark;
+using namespace std;
+using namespace boost::filesystem;
+
+//Heuristic freshness is capped, as for browsers, when only Last-Modified is sent
+#define HEURISTIC_MAX_AGE 86400
+
+HTTPCache::HTTPCache(const string& _directory, uint64_t _diskLimit, uint64_t _memoryLimit):
+	directory(_directory),diskLimit(_diskLimit),memoryLimit(_memoryLimit),diskUsed(0),memoryUsed(0),
+	hits(0),revalidated(0),shared(0),misses(0),indexChanges(0),indexSaveTime(g_get_real_time()/1000000)
+{
+	try
+	{
+		create_directories(path(directory));
+	}
+	catch(const filesystem_error& e)
+	{
+		LOG(LOG_ERROR,"NET: could not create the HTTP cache directory " << directory);
+	}
+	loadIndex();
+}
+
+HTTPCache::~HTTPCache()
+{
+	logStats();
+	saveIndex();
+}
+
+string HTTPCache::contentPath(const string& hash) const
+{
+	return directory + G_DIR_SEPARATOR_S + hash;
+}
+
+static string lowercaseHeader(const map<tiny_string, tiny_string>& headers, const char* name)
+{
+	auto it=headers.find(tiny_string(name));
+	if(it==headers.end())
+		return "";
+	return it->second.lowercase().raw_buf();
+}
+
+int64_t HTTPCache::parseDate(const tiny_string& date)
+{
+#ifdef ENABLE_CURL
+	if(date.empty())
+		return -1;
+	return curl_getdate(date.raw_buf(), NULL);
+#else
+	return -1;
+#endif
+}
+
+/*
+ * Returns when the response stops being fresh, 0 if it must always be
+ * revalidated and -1 if it must not be stored at all
+ */
+int64_t HTTPCache::computeExpiry(const map<tiny_string, tiny_string>& headers, int64_t now)
+{
+	string cacheControl=lowercaseHeader(headers,"cache-control");
+	if(cacheControl.find("no-store")!=string::npos)
+		return -1;
+	if(cacheControl.find("no-cache")!=string::npos)
+		return 0;
+	size_t maxAge=cacheControl.find("max-age=");
+	if(maxAge!=string::npos)
+		return now+atoll(cacheControl.c_str()+maxAge+8);
+
+	//Use the server clock to compute the lifetime, in case it differs from ours
+	auto it=headers.find("date");
+	int64_t date=(it!=headers.end()) ? parseDate(it->second) : -1;
+	if(date<0)
+		date=now;
+	it=headers.find("expires");
+	if(it!=headers.end())
+	{
+		int64_t expires=parseDate(it->second);
+		//Invalid dates mean already expired
+		return (expires>date) ? now+(expires-date) : 0;
+	}
+	it=headers.find("last-modified");
+	if(it!=headers.end())
+	{
+		int64_t lastModified=parseDate(it->second);
+		if(lastModified>0 && date>lastModified)
+			return now+min<int64_t>((date-lastModified)/10,HEURISTIC_MAX_AGE);
+	}
+	return 0;
+}
+
+void HTTPCache::touch(const tiny_string& url)
+{
+	Entry& e=entries[url];
+	lru.splice(lru.begin(),lru,e.lruPos);
+}
+
+void HTTPCache::removeEntry(const tiny_string& url)
+{
+	auto it=entries.find(url);
+	if(it==entries.end())
+		return;
+	const Entry& e=it->second;
+	lru.erase(e.lruPos);
+	auto ref=contentRefs.find(e.contentHash);
+	if(ref!=contentRefs.end() && --ref->second==0)
+	{
+		contentRefs.erase(ref);
+		diskUsed-=e.size;
+		auto m=memoryBodies.find(e.contentHash);
+		if(m!=memoryBodies.end())
+		{
+			memoryUsed-=m->second.size();
+			memoryBodies.erase(m);
+		}
+		boost::system::error_code ec;
+		remove(path(contentPath(e.contentHash)),ec);
+	}
+	entries.erase(it);
+}
+
+void HTTPCache::evict()
+{
+	//Memory copies go first, the bodies are still on disk
+	auto it=lru.end();
+	while(memoryUsed>memoryLimit && it!=lru.begin())
+	{
+		--it;
+		auto m=memoryBodies.find(entries[*it].contentHash);
+		if(m!=memoryBodies.end())
+		{
+			memoryUsed-=m->second.size();
+			memoryBodies.erase(m);
+		}
+	}
+	while(diskUsed>diskLimit && !lru.empty())
+		removeEntry(lru.back());
+}
+
+HTTPCache::LOOKUP_RESULT HTTPCache::beginRequest(const tiny_string& url, Entry& entry)
+{
+	Locker l(mutex);
+	bool waited=false;
+	while(inFlight.find(url)!=inFlight.end())
+	{
+		waited=true;
+		requestDone.wait(mutex);
+	}
+	auto it=entries.find(url);
+	if(it==entries.end() && uncacheable.find(url)!=uncacheable.end())
+	{
+		misses++;
+		return BYPASS;
+	}
+	if(it!=entries.end())
+	{
+		touch(url);
+		entry=it->second;
+		if(entry.expires>g_get_real_time()/1000000)
+		{
+			hits++;
+			if(waited)
+				shared++;
+			return HIT;
+		}
+		if(!entry.etag.empty() || !entry.lastModified.empty())
+		{
+			inFlight[url]=true;
+			return REVALIDATE;
+		}
+		removeEntry(url);
+	}
+	misses++;
+	inFlight[url]=false;
+	return MISS;
+}
+
+void HTTPCache::endRequest(const tiny_string& url)
+{
+	Locker l(mutex);
+	auto it=inFlight.find(url);
+	if(it==inFlight.end())
+		return;
+	//A revalidation that did not end with 304 downloaded the resource again
+	if(it->second)
+		misses++;
+	inFlight.erase(it);
+	requestDone.broadcast();
+}
+
+void HTTPCache::abandonRequest(const tiny_string& url)
+{
+	{
+		Locker l(mutex);
+		if(uncacheable.size()>=maxUncacheable)
+			uncacheable.clear();
+		uncacheable.insert(url);
+	}
+	endRequest(url);
+}
+
+bool HTTPCache::isStorable(const map<tiny_string, tiny_string>& headers, uint64_t length) const
+{
+	if(length>getMaxEntrySize())
+		return false;
+	//The request headers are not kept, so responses depending on them can't be reused
+	string vary=lowercaseHeader(headers,"vary");
+	if(!vary.empty() && vary!="accept-encoding")
+		return false;
+	int64_t now=g_get_real_time()/1000000;
+	int64_t expires=computeExpiry(headers,now);
+	if(expires<0)
+		return false;
+	//Responses that are stale at once are only useful with validators
+	return expires>now || headers.find("etag")!=headers.end() || headers.find("last-modified")!=headers.end();
+}
+
+bool HTTPCache::readBody(const Entry& entry, vector<uint8_t>& body)
+{
+	{
+		Locker l(mutex);
+		auto m=memoryBodies.find(entry.contentHash);
+		if(m!=memoryBodies.end())
+		{
+			body=m->second;
+			return true;
+		}
+	}
+	//Body files are never modified, only removed. An already opened file
+	//stays readable if it is evicted meanwhile
+	std::ifstream file(contentPath(entry.contentHash).c_str(),ios::in|ios::binary);
+	if(!file.is_open())
+		return false;
+	body.resize(entry.size);
+	file.read((char*)body.data(),entry.size);
+	if((uint64_t)file.gcount()!=entry.size)
+		return false;
+
+	Locker l(mutex);
+	if(contentRefs.find(entry.contentHash)!=contentRefs.end() && entry.size<=memoryLimit &&
+	   memoryBodies.find(entry.contentHash)==memoryBodies.end())
+	{
+		memoryBodies[entry.contentHash]=body;
+		memoryUsed+=entry.size;
+		evict();
+	}
+	return true;
+}
+
+void HTTPCache::storeResponse(const tiny_string& url, const map<tiny_string, tiny_string>& headers,
+			      const vector<uint8_t>& body)
+{
+	if(!isStorable(headers,body.size()))
+		return;
+	int64_t now=g_get_real_time()/1000000;
+	int64_t expires=computeExpiry(headers,now);
+	auto etag=headers.find("etag");
+	auto lastModified=headers.find("last-modified");
+
+	gchar* hash=g_compute_checksum_for_data(G_CHECKSUM_SHA256,body.data(),body.size());
+	Entry e;
+	e.url=url;
+	e.status=200;
+	e.headers=headers;
+	e.contentHash=hash;
+	e.size=body.size();
+	e.expires=expires;
+	if(etag!=headers.end())
+		e.etag=etag->second;
+	if(lastModified!=headers.end())
+		e.lastModified=lastModified->second;
+	g_free(hash);
+
+	Locker l(mutex);
+	removeEntry(url);
+	if(contentRefs.find(e.contentHash)==contentRefs.end())
+	{
+		//The file is written under a temporary name, so an interrupted
+		//write never leaves a truncated body behind
+		string target=contentPath(e.contentHash);
+		string temp=target+".part";
+		std::ofstream file(temp.c_str(),ios::out|ios::binary|ios::trunc);
+		file.write((const char*)body.data(),body.size());
+		file.close();
+		boost::system::error_code ec;
+		if(file.fail())
+		{
+			remove(path(temp),ec);
+			return;
+		}
+		rename(path(temp),path(target),ec);
+		if(ec)
+			return;
+		contentRefs[e.contentHash]=0;
+		diskUsed+=e.size;
+		if(e.size<=memoryLimit)
+		{
+			memoryBodies[e.contentHash]=body;
+			memoryUsed+=e.size;
+		}
+	}
+	contentRefs[e.contentHash]++;
+	lru.push_front(url);
+	e.lruPos=lru.begin();
+	entries[url]=e;
+	evict();
+	if(++indexChanges>=indexSaveChanges || now-indexSaveTime>=indexSaveInterval)
+	{
+		l.release();
+		saveIndex();
+	}
+}
+
+void HTTPCache::refreshEntry(const tiny_string& url, const map<tiny_string, tiny_string>& headers)
+{
+	Locker l(mutex);
+	auto it=entries.find(url);
+	if(it==entries.end())
+		return;
+	//The 304 carries the current caching headers, the others are kept
+	Entry& e=it->second;
+	for(auto h=headers.begin();h!=headers.end();++h)
+		e.headers[h->first]=h->second;
+	int64_t now=g_get_real_time()/1000000;
+	e.expires=max<int64_t>(computeExpiry(e.headers,now),0);
+	indexChanges++;
+	auto req=inFlight.find(url);
+	if(req!=inFlight.end() && req->second)
+	{
+		req->second=false;
+		revalidated++;
+	}
+}
+
+void HTTPCache::invalidate(const tiny_string& url)
+{
+	Locker l(mutex);
+	removeEntry(url);
+}
+
+void HTTPCache::getStats(uint64_t& _hits, uint64_t& _revalidated, uint64_t& _shared, uint64_t& _misses)
+{
+	Locker l(mutex);
+	_hits=hits;
+	_revalidated=revalidated;
+	_shared=shared;
+	_misses=misses;
+}
+
+void HTTPCache::logStats()
+{
+	uint64_t h,r,s,m;
+	getStats(h,r,s,m);
+	uint64_t total=h+r+m;
+	if(total==0)
+		return;
+	LOG(LOG_INFO,"NET: HTTP cache: " << h << " hits (" << s << " shared with a concurrent request), "
+	    << r << " revalidated, " << m << " misses, hit rate " << (h+r)*100/total << "%, "
+	    << diskUsed << " bytes on disk, " << memoryUsed << " in memory");
+}
+
+void HTTPCache::loadIndex()
+{
+	GKeyFile* index=g_key_file_new();
+	string indexPath=contentPath("index");
+	if(g_key_file_load_from_file(index,indexPath.c_str(),G_KEY_FILE_NONE,NULL))
+	{
+		//Groups are saved from the most to the least recently used
+		gsize count=0;
+		gchar** groups=g_key_file_get_groups(index,&count);
+		for(gsize i=0;i<count;i++)
+		{
+			gchar* url=g_key_file_get_string(index,groups[i],"url",NULL);
+			gchar* content=g_key_file_get_string(index,groups[i],"content",NULL);
+			if(url==NULL || content==NULL || !exists(path(contentPath(content))))
+			{
+				g_free(url);
+				g_free(content);
+				continue;
+			}
+			Entry e;
+			e.url=tiny_string(url,true);
+			e.status=g_key_file_get_integer(index,groups[i],"status",NULL);
+			e.contentHash=content;
+			e.size=g_key_file_get_uint64(index,groups[i],"size",NULL);
+			e.expires=g_key_file_get_int64(index,groups[i],"expires",NULL);
+			gchar* etag=g_key_file_get_string(index,groups[i],"etag",NULL);
+			if(etag)
+				e.etag=tiny_string(etag,true);
+			gchar* lastModified=g_key_file_get_string(index,groups[i],"lastmodified",NULL);
+			if(lastModified)
+				e.lastModified=tiny_string(lastModified,true);
+			gchar** headers=g_key_file_get_string_list(index,groups[i],"headers",NULL,NULL);
+			for(gchar** h=headers;h && *h;h++)
+			{
+				const char* sep=strchr(*h,':');
+				if(sep)
+					e.headers[tiny_string(string(*h,sep-*h))]=tiny_string(sep+1,true);
+			}
+			g_strfreev(headers);
+			g_free(lastModified);
+			g_free(etag);
+			g_free(content);
+			g_free(url);
+			if(entries.find(e.url)!=entries.end())
+				continue;
+			if(contentRefs[e.contentHash]++==0)
+				diskUsed+=e.size;
+			lru.push_back(e.url);
+			e.lruPos=--lru.end();
+			entries[e.url]=e;
+		}
+		g_strfreev(groups);
+	}
+	g_key_file_free(index);
+
+	//Remove the bodies left half written, like after a crash, and the
+	//ones stored after the index was last written, which would never be
+	//counted nor evicted
+	boost::system::error_code ec;
+	for(directory_iterator it(path(directory),ec);!ec && it!=directory_iterator();it.increment(ec))
+	{
+		string name=it->path().filename().string();
+		if(it->path().extension()==".part" || (name!="index" && contentRefs.find(name)==contentRefs.end()))
+			remove(it->path(),ec);
+	}
+	evict();
+}
+
+void HTTPCache::saveIndex()
+{
+	Locker l(mutex);
+	indexChanges=0;
+	indexSaveTime=g_get_real_time()/1000000;
+	GKeyFile* index=g_key_file_new();
+	for(auto it=lru.begin();it!=lru.end();++it)
+	{
+		const Entry& e=entries[*it];
+		gchar* group=g_compute_checksum_for_string(G_CHECKSUM_SHA256,e.url.raw_buf(),-1);
+		g_key_file_set_string(index,group,"url",e.url.raw_buf());
+		g_key_file_set_integer(index,group,"status",e.status);
+		g_key_file_set_string(index,group,"content",e.contentHash.c_str());
+		g_key_file_set_uint64(index,group,"size",e.size);
+		g_key_file_set_int64(index,group,"expires",e.expires);
+		g_key_file_set_string(index,group,"etag",e.etag.raw_buf());
+		g_key_file_set_string(index,group,"lastmodified",e.lastModified.raw_buf());
+		vector<string> headers;
+		vector<const gchar*> headerPtrs;
+		for(auto h=e.headers.begin();h!=e.headers.end();++h)
+			headers.push_back(string(h->first.raw_buf())+":"+h->second.raw_buf());
+		for(size_t i=0;i<headers.size();i++)
+			headerPtrs.push_back(headers[i].c_str());
+		g_key_file_set_string_list(index,group,"headers",headerPtrs.data(),headerPtrs.size());
+		g_free(group);
+	}
+	gsize len=0;
+	gchar* data=g_key_file_to_data(index,&len,NULL);
+	if(!g_file_set_contents(contentPath("index").c_str(),data,len,NULL))
+		LOG(LOG_ERROR,"NET: could not write the HTTP cache index");
+	g_free(data);
+	g_key_file_free(index);
+}
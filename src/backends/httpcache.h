@@ -0,0 +1,159 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2010-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef BACKENDS_HTTPCACHE_H
+#define BACKENDS_HTTPCACHE_H 1
+
+#include <list>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "compat.h"
+#include "threading.h"
+#include "tiny_string.h"
+
+namespace lightspark
+{
+
+/*
+ * Private cache of HTTP GET responses, shared by the downloaders of the
+ * standalone download manager.
+ *
+ * Bodies are stored on disk in files named after the SHA-256 of their
+ * content, so identical resources served from different URLs are kept
+ * once. The most recently used bodies are also kept in memory. Both the
+ * disk and the memory usage are bounded, the least recently used entries
+ * are evicted first. The index survives across runs, it is written
+ * regularly and bodies missing from it are removed when it is loaded.
+ *
+ * Concurrent requests for the same URL are serialized: the first one
+ * downloads, the others wait and then use its result. They stop waiting
+ * as soon as the headers show that the response can't be stored, and
+ * later requests for such an URL are not serialized anymore.
+ */
+class DLL_PUBLIC HTTPCache
+{
+public:
+	class Entry
+	{
+	public:
+		tiny_string url;
+		uint16_t status;
+		std::map<tiny_string, tiny_string> headers;
+		//SHA-256 of the body, also the name of the file storing it
+		std::string contentHash;
+		uint64_t size;
+		//Seconds since the epoch after which the response must be revalidated
+		int64_t expires;
+		tiny_string etag;
+		tiny_string lastModified;
+		//Position in the LRU list of the cache
+		std::list<tiny_string>::iterator lruPos;
+		Entry():status(0),size(0),expires(0){}
+	};
+	enum LOOKUP_RESULT { HIT=0, REVALIDATE, MISS, BYPASS };
+private:
+	Mutex mutex;
+	//Signalled when a request leaves the in-flight set
+	Cond requestDone;
+	//URLs being downloaded, mapped to true while a revalidation is pending
+	std::map<tiny_string, bool> inFlight;
+	//URLs whose last response could not be stored, cleared when it grows too big
+	std::set<tiny_string> uncacheable;
+	static const uint32_t maxUncacheable=1024;
+	std::map<tiny_string, Entry> entries;
+	//URLs from the most to the least recently used
+	std::list<tiny_string> lru;
+	//Number of entries sharing each body file
+	std::map<std::string, uint32_t> contentRefs;
+	//Bodies kept in memory, by content hash
+	std::map<std::string, std::vector<uint8_t> > memoryBodies;
+	std::string directory;
+	uint64_t diskLimit;
+	uint64_t memoryLimit;
+	uint64_t diskUsed;
+	uint64_t memoryUsed;
+	uint64_t hits;
+	uint64_t revalidated;
+	uint64_t shared;
+	uint64_t misses;
+	//Changes since the index was last written, it is written again after
+	//enough changes or time, so that a crash loses little of it
+	uint32_t indexChanges;
+	int64_t indexSaveTime;
+	static const uint32_t indexSaveChanges=32;
+	//Seconds
+	static const int64_t indexSaveInterval=60;
+	std::string contentPath(const std::string& hash) const;
+	void touch(const tiny_string& url);
+	void removeEntry(const tiny_string& url);
+	void evict();
+	void loadIndex();
+	void saveIndex();
+	static int64_t parseDate(const tiny_string& date);
+	static int64_t computeExpiry(const std::map<tiny_string, tiny_string>& headers, int64_t now);
+public:
+	HTTPCache(const std::string& _directory, uint64_t _diskLimit, uint64_t _memoryLimit);
+	~HTTPCache();
+	/*
+	   Responses bigger than this are not cached
+	*/
+	uint64_t getMaxEntrySize() const { return diskLimit/8; }
+	/*
+	   Looks up url before a GET request, waiting while another request
+	   for it is in flight. HIT means entry can be used as is. On
+	   REVALIDATE (entry holds the validators) and MISS the caller becomes
+	   the in-flight request for url and must call endRequest or
+	   abandonRequest when done. BYPASS means the earlier response for url
+	   could not be stored, the caller downloads it without the cache.
+	*/
+	LOOKUP_RESULT beginRequest(const tiny_string& url, Entry& entry);
+	void endRequest(const tiny_string& url);
+	/*
+	   Ends the in-flight request for url as soon as its response is known
+	   not to be storable, the requests waiting for it go on without it
+	*/
+	void abandonRequest(const tiny_string& url);
+	/*
+	   Returns true if a 200 response with these headers and length (0 if unknown) can be stored
+	*/
+	bool isStorable(const std::map<tiny_string, tiny_string>& headers, uint64_t length) const;
+	/*
+	   Copies the body of entry, returns false if it is not available anymore
+	*/
+	bool readBody(const Entry& entry, std::vector<uint8_t>& body);
+	/*
+	   Stores a complete 200 response if its headers allow caching it
+	*/
+	void storeResponse(const tiny_string& url, const std::map<tiny_string, tiny_string>& headers,
+			   const std::vector<uint8_t>& body);
+	/*
+	   Updates the freshness of url after a 304 Not Modified response
+	*/
+	void refreshEntry(const tiny_string& url, const std::map<tiny_string, tiny_string>& headers);
+	void invalidate(const tiny_string& url);
+	void getStats(uint64_t& _hits, uint64_t& _revalidated, uint64_t& _shared, uint64_t& _misses);
+	void logStats();
+};
+
+};
+
+#endif /* BACKENDS_HTTPCACHE_H */
@@ -148,14 +148,32 @@ bool DownloadManager::removeDownloader(Downloader* downloader)
  * The standalone download manager produces \c ThreadedDownloader-type \c Downloaders.
  * It should only be used in the standalone version of LS.
  */
-StandaloneDownloadManager::StandaloneDownloadManager()
+StandaloneDownloadManager::StandaloneDownloadManager():httpCache(NULL),transferLoop(NULL)
 {
 	type = STANDALONE;
+	uint64_t cacheSize = Config::getConfig()->getHTTPCacheSize();
+	if(cacheSize)
+	{
+		uint64_t memorySize = Config::getConfig()->getHTTPCacheMemorySize();
+		httpCache = new HTTPCache(Config::getConfig()->getCacheDirectory() + G_DIR_SEPARATOR_S + "http",
+					  cacheSize<<20, memorySize<<20);
+	}
 }
 
 StandaloneDownloadManager::~StandaloneDownloadManager()
 {
 	cleanUp();
+	//All the downloaders are gone, no transfer is left in the loop
+	delete transferLoop;
+	delete httpCache;
+}
+
+CurlTransferLoop* StandaloneDownloadManager::getTransferLoop()
+{
+	Mutex::Lock l(transferLoopMutex);
+	if(transferLoop==NULL)
+		transferLoop=new CurlTransferLoop();
+	return transferLoop;
 }
 
 /**
@@ -164,10 +182,12 @@ StandaloneDownloadManager::~StandaloneDownloadManager()
  * Returns a pointer to a newly created \c Downloader for the given URL.
  * \param[in] url The URL (as a \c URLInfo) the \c Downloader is requested for
  * \param[in] cached Whether or not to disk-cache the download (default=false)
+ * \param[in] priority The order in which the download is started when transfers are queued
  * \return A pointer to a newly created \c Downloader for the given URL.
  * \see DownloadManager::destroy()
  */
-Downloader* StandaloneDownloadManager::download(const URLInfo& url, _R<StreamCache> cache, ILoadable* owner)
+Downloader* StandaloneDownloadManager::download(const URLInfo& url, _R<StreamCache> cache, ILoadable* owner,
+		PRIORITY priority)
 {
 	bool cached = dynamic_cast<FileStreamCache *>(cache.getPtr()) != NULL;
 	LOG(LOG_INFO, _("NET: STANDALONE: DownloadManager::download '") << url.getParsedURL()
@@ -192,7 +212,9 @@ Downloader* StandaloneDownloadManager::download(const URLInfo& url, _R<StreamCac
 	else
 	{
 		LOG(LOG_INFO, _("NET: STANDALONE: DownloadManager: remote file"));
-		downloader=new CurlDownloader(url.getParsedURL(), cache, owner);
+		bool cacheable = url.getProtocol() == "http" || url.getProtocol() == "https";
+		downloader=new CurlDownloader(url.getParsedURL(), cache, owner, cacheable ? httpCache : NULL,
+					      getTransferLoop(), priority);
 	}
 	downloader->enableFencingWaiting();
 	addDownloader(downloader);
@@ -207,12 +229,13 @@ Downloader* StandaloneDownloadManager::download(const URLInfo& url, _R<StreamCac
  * \param[in] url The URL (as a \c URLInfo) the \c Downloader is requested for
  * \param[in] data The binary data to send to the host
  * \param[in] headers Request headers in the full form, f.e. "Content-Type: ..."
+ * \param[in] priority The order in which the download is started when transfers are queued
  * \return A pointer to a newly created \c Downloader for the given URL.
  * \see DownloadManager::destroy()
  */
 Downloader* StandaloneDownloadManager::downloadWithData(const URLInfo& url, _R<StreamCache> cache, 
 		const std::vector<uint8_t>& data,
-		const std::list<tiny_string>& headers, ILoadable* owner)
+		const std::list<tiny_string>& headers, ILoadable* owner, PRIORITY priority)
 {
 	LOG(LOG_INFO, _("NET: STANDALONE: DownloadManager::downloadWithData '") << url.getParsedURL());
 	ThreadedDownloader* downloader;
@@ -226,7 +249,8 @@ Downloader* StandaloneDownloadManager::downloadWithData(const URLInfo& url, _R<S
 	else
 	{
 		LOG(LOG_INFO, _("NET: STANDALONE: DownloadManager: remote file"));
-		downloader=new CurlDownloader(url.getParsedURL(), cache, data, headers, owner);
+		downloader=new CurlDownloader(url.getParsedURL(), cache, data, headers, owner,
+					      getTransferLoop(), priority);
 	}
 	downloader->enableFencingWaiting();
 	addDownloader(downloader);
@@ -244,7 +268,7 @@ Downloader* StandaloneDownloadManager::downloadWithData(const URLInfo& url, _R<S
 Downloader::Downloader(const tiny_string& _url, _R<StreamCache> _cache, ILoadable* o):
 	url(_url),originalURL(url),                                   //PROPERTIES
 	cache(_cache),                                                //CACHING
-	owner(o),                                                     //PROGRESS
+	owner(o),batchProgress(false),progressPending(false),         //PROGRESS
 	redirected(false),requestStatus(0),                           //HTTP REDIR, STATUS & HEADERS
 	length(0),                                                    //DOWNLOADED DATA
 	emptyanswer(false)
@@ -261,7 +285,7 @@ Downloader::Downloader(const tiny_string& _url, _R<StreamCache> _cache, ILoadabl
 Downloader::Downloader(const tiny_string& _url, _R<StreamCache> _cache, const std::vector<uint8_t>& _data, const std::list<tiny_string>& h, ILoadable* o):
 	url(_url),originalURL(url),                                      //PROPERTIES
 	cache(_cache),                                                   //CACHING
-	owner(o),                                                        //PROGRESS
+	owner(o),batchProgress(false),progressPending(false),            //PROGRESS
 	redirected(false),requestStatus(0),requestHeaders(h),data(_data),//HTTP REDIR, STATUS & HEADERS
 	length(0),                                                       //DOWNLOADED DATA
 	emptyanswer(false)
@@ -331,6 +355,7 @@ void Downloader::setLength(uint32_t _length)
  * Appends a given amount of received data to the buffer/cache.
  * This method will grow the expected length of the download on-the-fly as needed.
  * So when \c length == 0 this call will call \c setLength(added)
+ * When \c batchProgress is set the owner is notified later by \c flushProgress().
  * Waits for mutex at start and releases mutex when finished.
  * \post \c buffer/cache contains the added data
  * \post \c length = \c receivedLength + \c added
@@ -347,6 +372,23 @@ void Downloader::append(uint8_t* buf, uint32_t added)
 	if (cache->getReceivedLength() > length)
 		setLength(cache->getReceivedLength());
 
+	if (batchProgress)
+		progressPending = true;
+	else
+		notifyOwnerAboutBytesLoaded();
+}
+
+/**
+ * \brief Notifies the owner about the data appended since the last notification
+ *
+ * Many small appends are reported with a single \c setBytesLoaded call.
+ * \see Downloader::append()
+ */
+void Downloader::flushProgress()
+{
+	if(!progressPending)
+		return;
+	progressPending = false;
 	notifyOwnerAboutBytesLoaded();
 }
 
@@ -532,15 +574,283 @@ ThreadedDownloader::~ThreadedDownloader()
 	//-- Fenced signalled
 }*/
 
+/**
+ * \brief Constructor for the CurlTransferLoop class.
+ *
+ * Creates the multi handle shared by the transfers and starts the thread running them.
+ */
+CurlTransferLoop::CurlTransferLoop():multi(NULL),thread(NULL),stopping(false),finishing(NULL),
+	transfers(0),connections(0)
+{
+#ifdef ENABLE_CURL
+	CURLM* m=curl_multi_init();
+	multi=m;
+#if LIBCURL_VERSION_NUM >= 0x071e00
+	curl_multi_setopt(m, CURLMOPT_MAX_HOST_CONNECTIONS, (long)maxHostConnections);
+#endif
+#if LIBCURL_VERSION_NUM >= 0x072b00
+	//Transfers to an HTTP/2 server share one connection
+	curl_multi_setopt(m, CURLMOPT_PIPELINING, (long)CURLPIPE_MULTIPLEX);
+#endif
+#ifdef HAVE_NEW_GLIBMM_THREAD_API
+	thread = Thread::create(sigc::mem_fun(this,&CurlTransferLoop::worker));
+#else
+	thread = Thread::create(sigc::mem_fun(this,&CurlTransferLoop::worker),true);
+#endif
+#endif
+}
+
+/**
+ * \brief Destructor for the CurlTransferLoop class.
+ *
+ * Stops the thread, all the downloaders must have been destroyed already.
+ */
+CurlTransferLoop::~CurlTransferLoop()
+{
+	{
+		Mutex::Lock l(mutex);
+		stopping=true;
+		wakeUp();
+	}
+	if(thread)
+		thread->join();
+	assert(running.empty());
+#ifdef ENABLE_CURL
+	curl_multi_cleanup(static_cast<CURLM*>(multi));
+#endif
+	LOG(LOG_INFO, _("NET: curl transfers: ") << transfers << _(", connections opened: ") << connections);
+}
+
+/**
+ * \brief Queues the transfer of a downloader
+ *
+ * The easy handle of \c d must have been created. The loop will call \c d->finishTransfer
+ * when the transfer completes.
+ */
+void CurlTransferLoop::add(CurlDownloader* d, DownloadManager::PRIORITY priority)
+{
+	Mutex::Lock l(mutex);
+	pending[priority].push_back(d);
+	wakeUp();
+}
+
+/**
+ * \brief Stops using a downloader
+ *
+ * Drops the transfer of \c d if it is queued or running, and waits until the loop
+ * does not use \c d anymore. Called by the destructor of \c d.
+ */
+void CurlTransferLoop::remove(CurlDownloader* d)
+{
+	Mutex::Lock l(mutex);
+	for(uint32_t i=0;i<DownloadManager::PRIORITY_COUNT;i++)
+	{
+		std::deque<CurlDownloader*>::iterator it=std::find(pending[i].begin(), pending[i].end(), d);
+		if(it!=pending[i].end())
+		{
+			pending[i].erase(it);
+			return;
+		}
+	}
+	if(running.count(d))
+	{
+		cancelled.insert(d);
+		wakeUp();
+	}
+	while(running.count(d) || finishing==d)
+		transferReleased.wait(mutex);
+}
+
+/**
+ * \brief Interrupts the wait of the loop for network activity
+ *
+ * Without curl_multi_wakeup the loop wakes up periodically instead.
+ */
+void CurlTransferLoop::wakeUp()
+{
+#if defined(ENABLE_CURL) && LIBCURL_VERSION_NUM >= 0x074400
+	curl_multi_wakeup(static_cast<CURLM*>(multi));
+#endif
+}
+
+/**
+ * \brief Starts the queued transfers, the most important first
+ *
+ * Must be called with the mutex held. The downloaders whose transfer could
+ * not be started are returned in \c rejected and must be finished by the caller.
+ */
+void CurlTransferLoop::startPending(std::vector<CurlDownloader*>& rejected)
+{
+#ifdef ENABLE_CURL
+	uint32_t i=0;
+	while(i<DownloadManager::PRIORITY_COUNT && running.size()<maxTransfers)
+	{
+		if(pending[i].empty())
+		{
+			i++;
+			continue;
+		}
+		CurlDownloader* d=pending[i].front();
+		pending[i].pop_front();
+		running.insert(d);
+		d->lastProgressTime=compat_msectiming();
+		if(curl_multi_add_handle(static_cast<CURLM*>(multi), static_cast<CURL*>(d->curl))!=CURLM_OK)
+			rejected.push_back(d);
+	}
+#endif
+}
+
+/**
+ * \brief Drops the transfers of the downloaders being destroyed
+ *
+ * Must be called with the mutex held.
+ */
+void CurlTransferLoop::releaseCancelled()
+{
+	if(cancelled.empty())
+		return;
+#ifdef ENABLE_CURL
+	for(std::set<CurlDownloader*>::iterator it=cancelled.begin();it!=cancelled.end();++it)
+	{
+		curl_multi_remove_handle(static_cast<CURLM*>(multi), static_cast<CURL*>((*it)->curl));
+		running.erase(*it);
+	}
+#endif
+	cancelled.clear();
+	transferReleased.broadcast();
+}
+
+/**
+ * \brief Hands a transfer back to its downloader
+ *
+ * \c d must not be in the multi handle anymore. Unless \c d is being destroyed
+ * \c d->finishTransfer is called, outside of the mutex.
+ */
+void CurlTransferLoop::finish(CurlDownloader* d, int result)
+{
+	{
+		Mutex::Lock l(mutex);
+		running.erase(d);
+		if(cancelled.erase(d))
+		{
+			//The destructor of d only waits for the loop to release it
+			transferReleased.broadcast();
+			return;
+		}
+		finishing=d;
+	}
+	d->finishTransfer(result);
+	Mutex::Lock l(mutex);
+	finishing=NULL;
+	transferReleased.broadcast();
+}
+
+/**
+ * \brief Finishes the transfers reported as done by curl
+ */
+void CurlTransferLoop::completeTransfers()
+{
+#ifdef ENABLE_CURL
+	CURLM* m=static_cast<CURLM*>(multi);
+	CURLMsg* msg;
+	int queued;
+	while((msg=curl_multi_info_read(m, &queued))!=NULL)
+	{
+		if(msg->msg!=CURLMSG_DONE)
+			continue;
+		//msg is not valid anymore after removing the handle
+		CURL* easy=msg->easy_handle;
+		CURLcode result=msg->data.result;
+		char* priv=NULL;
+		curl_easy_getinfo(easy, CURLINFO_PRIVATE, &priv);
+		long newConnections=0;
+		curl_easy_getinfo(easy, CURLINFO_NUM_CONNECTS, &newConnections);
+		curl_multi_remove_handle(m, easy);
+		transfers++;
+		connections+=newConnections;
+		finish(reinterpret_cast<CurlDownloader*>(priv), result);
+	}
+#endif
+}
+
+/**
+ * \brief Notifies the owners about the progress of the running transfers
+ *
+ * All the data received by a transfer since its last notification is reported at
+ * once, at most every \c progressInterval ms.
+ */
+void CurlTransferLoop::flushProgress()
+{
+	//running is only modified by the loop thread, it can be read without the mutex here
+	uint64_t now=compat_msectiming();
+	for(std::set<CurlDownloader*>::iterator it=running.begin();it!=running.end();++it)
+	{
+		CurlDownloader* d=*it;
+		if(d->progressPending && now-d->lastProgressTime>=progressInterval)
+		{
+			d->lastProgressTime=now;
+			d->flushProgress();
+		}
+	}
+}
+
+/**
+ * \brief Body of the loop thread
+ */
+void CurlTransferLoop::worker()
+{
+#ifdef ENABLE_CURL
+	CURLM* m=static_cast<CURLM*>(multi);
+	std::vector<CurlDownloader*> rejected;
+	while(true)
+	{
+		bool idle;
+		{
+			Mutex::Lock l(mutex);
+			if(stopping)
+				break;
+			releaseCancelled();
+			startPending(rejected);
+			idle=running.empty();
+		}
+		for(uint32_t i=0;i<rejected.size();i++)
+			finish(rejected[i], CURLE_FAILED_INIT);
+		rejected.clear();
+
+		int stillRunning=0;
+		curl_multi_perform(m, &stillRunning);
+		completeTransfers();
+		flushProgress();
+
+		//Wait for network activity, a change of the transfers or the next progress notification
+#if LIBCURL_VERSION_NUM >= 0x074400
+		curl_multi_poll(m, NULL, 0, idle ? 1000 : progressInterval, NULL);
+#elif LIBCURL_VERSION_NUM >= 0x071c00
+		curl_multi_wait(m, NULL, 0, wakeUpInterval, NULL);
+#else
+		compat_msleep(wakeUpInterval);
+#endif
+	}
+#endif
+}
+
 /**
  * \brief Constructor for the CurlDownloader class.
  *
  * \param[in] _url The URL for the Downloader.
  * \param[in] _cached Whether or not to cache this download.
+ * \param[in] _httpCache The HTTP response cache to use, or NULL
+ * \param[in] _transferLoop The loop running the transfer, or NULL to run it in \c execute
+ * \param[in] _priority The order in which the transfer is started by the loop
  */
-CurlDownloader::CurlDownloader(const tiny_string& _url, _R<StreamCache> _cache, ILoadable* o):
-	ThreadedDownloader(_url, _cache, o)
+CurlDownloader::CurlDownloader(const tiny_string& _url, _R<StreamCache> _cache, ILoadable* o, HTTPCache* _httpCache,
+			       CurlTransferLoop* _transferLoop, DownloadManager::PRIORITY _priority):
+	ThreadedDownloader(_url, _cache, o),httpCache(_httpCache),cacheBodyValid(_httpCache!=NULL),
+	cacheRequestOpen(false),cacheResult(HTTPCache::MISS),transferLoop(_transferLoop),priority(_priority),
+	curl(NULL),headerList(NULL),lastProgressTime(0)
 {
+	//The loop notifies the owner about the progress of the transfer
+	batchProgress=(transferLoop!=NULL);
 }
 
 /**
@@ -548,12 +858,52 @@ CurlDownloader::CurlDownloader(const tiny_string& _url, _R<StreamCache> _cache,
  *
  * \param[in] _url The URL for the Downloader.
  * \param[in] data Additional data to send to the host
+ * \param[in] _transferLoop The loop running the transfer, or NULL to run it in \c execute
+ * \param[in] _priority The order in which the transfer is started by the loop
  */
 CurlDownloader::CurlDownloader(const tiny_string& _url, _R<StreamCache> _cache,
 			       const std::vector<uint8_t>& _data,
-			       const std::list<tiny_string>& _headers, ILoadable* o):
-	ThreadedDownloader(_url, _cache, _data, _headers, o)
+			       const std::list<tiny_string>& _headers, ILoadable* o,
+			       CurlTransferLoop* _transferLoop, DownloadManager::PRIORITY _priority):
+	ThreadedDownloader(_url, _cache, _data, _headers, o),httpCache(NULL),cacheBodyValid(false),
+	cacheRequestOpen(false),cacheResult(HTTPCache::MISS),transferLoop(_transferLoop),priority(_priority),
+	curl(NULL),headerList(NULL),lastProgressTime(0)
+{
+	batchProgress=(transferLoop!=NULL);
+}
+
+/**
+ * \brief Destructor for the CurlDownloader class.
+ *
+ * Takes the transfer back from the loop if it did not complete.
+ */
+CurlDownloader::~CurlDownloader()
 {
+	if(transferLoop)
+		transferLoop->remove(this);
+	releaseHandle();
+	if(cacheRequestOpen)
+		httpCache->endRequest(originalURL);
+}
+
+/**
+ * \brief Serves the download from the HTTP cache
+ *
+ * Replays the status and the headers of the cached response and appends its body.
+ * \return false if the body is not available anymore
+ */
+bool CurlDownloader::serveFromCache(const HTTPCache::Entry& entry)
+{
+	std::vector<uint8_t> body;
+	if(!httpCache->readBody(entry, body))
+		return false;
+	requestStatus = entry.status;
+	headers = entry.headers;
+	emptyanswer = body.empty();
+	setLength(body.size());
+	if(!body.empty())
+		append(&body.front(), body.size());
+	return true;
 }
 
 /**
@@ -568,6 +918,8 @@ void CurlDownloader::threadAbort()
 
 /**
  * \brief Called by \c ThreadPool to start executing this thread
+ *
+ * When a transfer loop is used the download is queued there and completes after this returns.
  */
 void CurlDownloader::execute()
 {
@@ -578,91 +930,181 @@ void CurlDownloader::execute()
 	}
 	LOG(LOG_INFO, _("NET: CurlDownloader::execute: reading remote file: ") << url.raw_buf());
 #ifdef ENABLE_CURL
-	CURL *curl;
-	CURLcode res;
-	curl = curl_easy_init();
-	if(curl)
+	if(httpCache)
 	{
-		curl_easy_setopt(curl, CURLOPT_URL, url.raw_buf());
-		//Needed for thread-safety reasons.
-		//This makes CURL not respect DNS resolving timeouts.
-		//TODO: openssl needs locking callbacks. We should implement these.
-		curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1);
-		//ALlow self-signed and incorrect certificates.
-		//TODO: decide if we should allow them.
-		curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0);
-		curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0);
-		curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_data);
-		curl_easy_setopt(curl, CURLOPT_WRITEDATA, this);
-		curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, write_header);
-		curl_easy_setopt(curl, CURLOPT_HEADERDATA, this);
-		curl_easy_setopt(curl, CURLOPT_PROGRESSFUNCTION, progress_callback);
-		curl_easy_setopt(curl, CURLOPT_PROGRESSDATA, this);
-		curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0);
-		curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1);
-		//Its probably a good idea to limit redirections, 100 should be more than enough
-		curl_easy_setopt(curl, CURLOPT_MAXREDIRS, 100);
-		curl_easy_setopt(curl, CURLOPT_USERAGENT, "Mozilla/5.0");
-		// Empty string means that CURL will decompress if the
-		// server send a compressed file. (This has been
-		// renamed to CURLOPT_ACCEPT_ENCODING in newer CURL,
-		// we use the old name to support the old versions.)
-		curl_easy_setopt(curl, CURLOPT_ENCODING, "");
-		if (URLInfo(url).sameHost(getSys()->mainClip->getOrigin()) &&
-		    !getSys()->getCookies().empty())
-			curl_easy_setopt(curl, CURLOPT_COOKIE, getSys()->getCookies().c_str());
-
-		struct curl_slist *headerList=NULL;
-		bool hasContentType=false;
-		if(!requestHeaders.empty())
+		cacheResult=httpCache->beginRequest(originalURL, cacheEntry);
+		if(cacheResult==HTTPCache::HIT)
 		{
-			std::list<tiny_string>::const_iterator it;
-			for(it=requestHeaders.begin(); it!=requestHeaders.end(); ++it)
+			if(serveFromCache(cacheEntry))
 			{
-				headerList=curl_slist_append(headerList, it->raw_buf());
-				hasContentType |= it->lowercase().startsWith("content-type:");
+				LOG(LOG_INFO, _("NET: CurlDownloader::execute: using cached response"));
+				flushProgress();
+				setFinished();
+				return;
 			}
+			//The body has been evicted meanwhile
+			httpCache->invalidate(originalURL);
+			cacheResult=httpCache->beginRequest(originalURL, cacheEntry);
 		}
+		cacheRequestOpen=(cacheResult==HTTPCache::MISS || cacheResult==HTTPCache::REVALIDATE);
+		if(!cacheRequestOpen)
+			cacheBodyValid=false;
+	}
+	if(!createHandle())
+	{
+		finishTransfer(CURLE_FAILED_INIT);
+		return;
+	}
+	if(transferLoop)
+		transferLoop->add(this, priority);
+	else
+		finishTransfer(curl_easy_perform(static_cast<CURL*>(curl)));
+#else
+	//ENABLE_CURL not defined
+	LOG(LOG_ERROR,_("NET: CURL not enabled in this build. Downloader will always fail."));
+	setFailed();
+#endif
+}
 
-		if(!data.empty())
-		{
-			curl_easy_setopt(curl, CURLOPT_POST, 1);
-			//data is const, it would not be invalidated
-			curl_easy_setopt(curl, CURLOPT_POSTFIELDS, &data.front());
-			curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, data.size());
+/**
+ * \brief Creates the CURL handle of the request
+ *
+ * \return false if the handle could not be created
+ */
+bool CurlDownloader::createHandle()
+{
+#ifdef ENABLE_CURL
+	CURL* handle=curl_easy_init();
+	if(!handle)
+		return false;
+	curl=handle;
+	curl_easy_setopt(handle, CURLOPT_URL, url.raw_buf());
+	//Needed for thread-safety reasons.
+	//This makes CURL not respect DNS resolving timeouts.
+	//TODO: openssl needs locking callbacks. We should implement these.
+	curl_easy_setopt(handle, CURLOPT_NOSIGNAL, 1);
+	//ALlow self-signed and incorrect certificates.
+	//TODO: decide if we should allow them.
+	curl_easy_setopt(handle, CURLOPT_SSL_VERIFYPEER, 0);
+	curl_easy_setopt(handle, CURLOPT_SSL_VERIFYHOST, 0);
+	curl_easy_setopt(handle, CURLOPT_WRITEFUNCTION, write_data);
+	curl_easy_setopt(handle, CURLOPT_WRITEDATA, this);
+	curl_easy_setopt(handle, CURLOPT_HEADERFUNCTION, write_header);
+	curl_easy_setopt(handle, CURLOPT_HEADERDATA, this);
+	curl_easy_setopt(handle, CURLOPT_PROGRESSFUNCTION, progress_callback);
+	curl_easy_setopt(handle, CURLOPT_PROGRESSDATA, this);
+	curl_easy_setopt(handle, CURLOPT_NOPROGRESS, 0);
+	//Used by the transfer loop to find the downloader of a completed transfer
+	curl_easy_setopt(handle, CURLOPT_PRIVATE, this);
+	curl_easy_setopt(handle, CURLOPT_FOLLOWLOCATION, 1);
+	//Its probably a good idea to limit redirections, 100 should be more than enough
+	curl_easy_setopt(handle, CURLOPT_MAXREDIRS, 100);
+	curl_easy_setopt(handle, CURLOPT_USERAGENT, "Mozilla/5.0");
+	// Empty string means that CURL will decompress if the
+	// server send a compressed file. (This has been
+	// renamed to CURLOPT_ACCEPT_ENCODING in newer CURL,
+	// we use the old name to support the old versions.)
+	curl_easy_setopt(handle, CURLOPT_ENCODING, "");
+#if LIBCURL_VERSION_NUM >= 0x072b00
+	//Wait for a connection to the host that can be multiplexed instead of opening a new one
+	curl_easy_setopt(handle, CURLOPT_PIPEWAIT, 1L);
+#endif
+	if (URLInfo(url).sameHost(getSys()->mainClip->getOrigin()) &&
+	    !getSys()->getCookies().empty())
+		curl_easy_setopt(handle, CURLOPT_COOKIE, getSys()->getCookies().c_str());
 
-			//For POST it's mandatory to set the Content-Type
-			assert(hasContentType);
+	struct curl_slist *list=NULL;
+	bool hasContentType=false;
+	if(!requestHeaders.empty())
+	{
+		std::list<tiny_string>::const_iterator it;
+		for(it=requestHeaders.begin(); it!=requestHeaders.end(); ++it)
+		{
+			list=curl_slist_append(list, it->raw_buf());
+			hasContentType |= it->lowercase().startsWith("content-type:");
 		}
+	}
+
+	if(!data.empty())
+	{
+		curl_easy_setopt(handle, CURLOPT_POST, 1);
+		//data is const, it would not be invalidated
+		curl_easy_setopt(handle, CURLOPT_POSTFIELDS, &data.front());
+		curl_easy_setopt(handle, CURLOPT_POSTFIELDSIZE, data.size());
 
-		if(headerList)
-			curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headerList);
+		//For POST it's mandatory to set the Content-Type
+		assert(hasContentType);
+	}
 
-		//curl_easy_setopt(curl, CURLOPT_VERBOSE, 1);
-		res = curl_easy_perform(curl);
+	//Ask the server whether the cached response is still valid
+	if(cacheResult==HTTPCache::REVALIDATE)
+	{
+		if(!cacheEntry.etag.empty())
+			list=curl_slist_append(list, (tiny_string("If-None-Match: ")+cacheEntry.etag).raw_buf());
+		if(!cacheEntry.lastModified.empty())
+			list=curl_slist_append(list, (tiny_string("If-Modified-Since: ")+cacheEntry.lastModified).raw_buf());
+	}
 
-		curl_slist_free_all(headerList);
+	headerList=list;
+	if(list)
+		curl_easy_setopt(handle, CURLOPT_HTTPHEADER, list);
 
-		curl_easy_cleanup(curl);
-		if(res!=0)
+	//curl_easy_setopt(handle, CURLOPT_VERBOSE, 1);
+	return true;
+#else
+	return false;
+#endif
+}
+
+/**
+ * \brief Frees the CURL handle and the request headers
+ */
+void CurlDownloader::releaseHandle()
+{
+#ifdef ENABLE_CURL
+	if(curl)
+		curl_easy_cleanup(static_cast<CURL*>(curl));
+	curl_slist_free_all(static_cast<curl_slist*>(headerList));
+#endif
+	curl=NULL;
+	headerList=NULL;
+}
+
+/**
+ * \brief Completes the download with the result of the transfer
+ *
+ * Updates the HTTP cache and marks the download as finished or failed.
+ * Nothing may use the downloader after this, it can be destroyed as soon
+ * as it is marked finished.
+ */
+void CurlDownloader::finishTransfer(int result)
+{
+#ifdef ENABLE_CURL
+	releaseHandle();
+	bool failed=(result!=CURLE_OK);
+	if(cacheRequestOpen)
+	{
+		if(!failed)
 		{
-			setFailed();
-			return;
+			if(cacheResult==HTTPCache::REVALIDATE && getRequestStatus()==304)
+			{
+				httpCache->refreshEntry(originalURL, headers);
+				failed=!serveFromCache(cacheEntry);
+			}
+			//Redirected responses are not stored, the headers of all the hops are mixed
+			else if(getRequestStatus()==200 && cacheBodyValid && !isRedirected())
+				httpCache->storeResponse(originalURL, headers, cacheBody);
 		}
+		httpCache->endRequest(originalURL);
+		cacheRequestOpen=false;
 	}
-	else
-	{
+	flushProgress();
+	if(failed)
 		setFailed();
-		return;
-	}
-#else
-	//ENABLE_CURL not defined
-	LOG(LOG_ERROR,_("NET: CURL not enabled in this build. Downloader will always fail."));
-	setFailed();
-	return;
+	else
+		//Notify the downloader no more data should be expected
+		setFinished();
 #endif
-	//Notify the downloader no more data should be expected
-	setFinished();
 }
 
 /**
@@ -687,10 +1129,36 @@ size_t CurlDownloader::write_data(void *buffer, size_t size, size_t nmemb, void
 	CurlDownloader* th=static_cast<CurlDownloader*>(userp);
 	size_t added=size*nmemb;
 	if(th->getRequestStatus()/100 == 2 || th->getRequestStatus()/100 == 3)
+	{
 		th->append((uint8_t*)buffer,added);
+		//The headers are complete with the first data, don't keep the
+		//concurrent requests for the URL waiting if nothing will be stored
+		if(th->cacheRequestOpen && th->cacheBody.empty() && th->getRequestStatus()!=304 &&
+		   (th->getRequestStatus()!=200 || th->isRedirected() ||
+		    !th->httpCache->isStorable(th->headers,th->getLength())))
+			th->abandonCacheRequest();
+		if(th->cacheBodyValid)
+		{
+			if(th->cacheBody.size()+added > th->httpCache->getMaxEntrySize())
+				th->abandonCacheRequest();
+			else
+				th->cacheBody.insert(th->cacheBody.end(),(uint8_t*)buffer,(uint8_t*)buffer+added);
+		}
+	}
 	return added;
 }
 
+void CurlDownloader::abandonCacheRequest()
+{
+	cacheBodyValid=false;
+	std::vector<uint8_t>().swap(cacheBody);
+	if(cacheRequestOpen)
+	{
+		httpCache->abandonRequest(originalURL);
+		cacheRequestOpen=false;
+	}
+}
+
 /**
  * \brief Header callback for CURL
  *
@@ -761,6 +1229,20 @@ void LocalDownloader::execute()
 			notifyOwnerAboutBytesLoaded();
 			notifyOwnerAboutBytesTotal();
 		}
+		//Mapped caches read the file in place, without copying it
+		else if (MappedFileStreamCache *mappedCache = dynamic_cast<MappedFileStreamCache *>(cache.getPtr()))
+		{
+			if (!mappedCache->mapFile(url))
+			{
+				LOG(LOG_ERROR, _("NET: LocalDownloader::execute: could not map local file: ") << url.raw_buf());
+				setFailed();
+				return;
+			}
+
+			length = mappedCache->getReceivedLength();
+			notifyOwnerAboutBytesLoaded();
+			notifyOwnerAboutBytesTotal();
+		}
 		//Otherwise we follow the normal procedure
 		else {
 			std::ifstream file;
@@ -822,7 +1304,8 @@ DownloaderThreadBase::DownloaderThreadBase(_NR<URLRequest> request, IDownloaderT
 bool DownloaderThreadBase::createDownloader(_R<StreamCache> cache,
 					    _NR<EventDispatcher> dispatcher,
 					    ILoadable* owner,
-					    bool checkPolicyFile)
+					    bool checkPolicyFile,
+					    DownloadManager::PRIORITY priority)
 {
 	if(checkPolicyFile)
 	{
@@ -854,11 +1337,11 @@ bool DownloaderThreadBase::createDownloader(_R<StreamCache> cache,
 	if(postData.empty())
 	{
 		//This is a GET request
-		downloader=dispatcher->getSystemState()->downloadManager->download(url, cache, owner);
+		downloader=dispatcher->getSystemState()->downloadManager->download(url, cache, owner, priority);
 	}
 	else
 	{
-		downloader=dispatcher->getSystemState()->downloadManager->downloadWithData(url, cache, postData, requestHeaders, owner);
+		downloader=dispatcher->getSystemState()->downloadManager->downloadWithData(url, cache, postData, requestHeaders, owner, priority);
 	}
 
 	return true;
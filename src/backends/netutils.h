@@ -24,18 +24,23 @@
 #include "compat.h"
 #include <streambuf>
 #include <fstream>
+#include <deque>
 #include <list>
 #include <map>
+#include <set>
 #include "swftypes.h"
 #include "thread_pool.h"
 #include "backends/urlutils.h"
 #include "backends/streamcache.h"
+#include "backends/httpcache.h"
 #include "smartrefs.h"
 
 namespace lightspark
 {
 
 class Downloader;
+class CurlDownloader;
+class CurlTransferLoop;
 
 class ILoadable
 {
@@ -57,11 +62,16 @@ protected:
 	bool removeDownloader(Downloader* downloader);
 	void cleanUp();
 public:
+	//Order in which queued transfers are started: the movies and the
+	//policy files first, then the assets and finally the streams
+	enum PRIORITY { PRIORITY_HIGH=0, PRIORITY_NORMAL, PRIORITY_LOW, PRIORITY_COUNT };
 	virtual ~DownloadManager();
-	virtual Downloader* download(const URLInfo& url, _R<StreamCache> cache, ILoadable* owner)=0;
+	virtual Downloader* download(const URLInfo& url, _R<StreamCache> cache, ILoadable* owner,
+			PRIORITY priority=PRIORITY_NORMAL)=0;
 	virtual Downloader* downloadWithData(const URLInfo& url, _R<StreamCache> cache, 
 			const std::vector<uint8_t>& data,
-			const std::list<tiny_string>& headers, ILoadable* owner)=0;
+			const std::list<tiny_string>& headers, ILoadable* owner,
+			PRIORITY priority=PRIORITY_NORMAL)=0;
 	virtual void destroy(Downloader* downloader)=0;
 	void stopAll();
 
@@ -71,14 +81,24 @@ public:
 
 class DLL_PUBLIC StandaloneDownloadManager:public DownloadManager
 {
+private:
+	//Shared by the GET downloads over HTTP, NULL if disabled
+	HTTPCache* httpCache;
+	Mutex transferLoopMutex;
+	//Runs the transfers of all the CurlDownloaders, created on first use
+	CurlTransferLoop* transferLoop;
+	CurlTransferLoop* getTransferLoop();
 public:
 	StandaloneDownloadManager();
 	~StandaloneDownloadManager();
-	Downloader* download(const URLInfo& url, _R<StreamCache> cache, ILoadable* owner);
+	Downloader* download(const URLInfo& url, _R<StreamCache> cache, ILoadable* owner,
+			PRIORITY priority=PRIORITY_NORMAL);
 	Downloader* downloadWithData(const URLInfo& url, _R<StreamCache> cache,
 			const std::vector<uint8_t>& data,
-			const std::list<tiny_string>& headers, ILoadable* owner);
+			const std::list<tiny_string>& headers, ILoadable* owner,
+			PRIORITY priority=PRIORITY_NORMAL);
 	void destroy(Downloader* downloader);
+	HTTPCache* getHTTPCache() const { return httpCache; }
 };
 
 class DLL_PUBLIC Downloader
@@ -106,6 +126,11 @@ protected:
 	ILoadable* owner;
 	void notifyOwnerAboutBytesTotal() const;
 	void notifyOwnerAboutBytesLoaded() const;
+	//When set, append leaves notifying the owner about the loaded bytes to flushProgress
+	bool batchProgress:1;
+	bool progressPending:1;
+	//Notifies the owner if data has been appended since the last notification
+	void flushProgress();
 
 	//-- HTTP REDIRECTION, STATUS & HEADERS
 	bool redirected:1;
@@ -188,19 +213,95 @@ protected:
 //	virtual ~ThreadedDownloader();
 };
 
+/*
+ * Thread running the transfers of the CurlDownloaders through a single
+ * curl multi handle. Connections are kept alive and reused by the
+ * following downloads, at most maxHostConnections connections are opened
+ * to a host and HTTP/2 transfers to the same host share one connection.
+ * At most maxTransfers downloads run at the same time, the others wait
+ * and are started by priority.
+ */
+class CurlTransferLoop
+{
+private:
+	Mutex mutex;
+	//Signalled when the loop stops using a transfer
+	Cond transferReleased;
+	//CURLM handle
+	void* multi;
+	Thread* thread;
+	bool stopping;
+	std::deque<CurlDownloader*> pending[DownloadManager::PRIORITY_COUNT];
+	std::set<CurlDownloader*> running;
+	//Running transfers to drop, their downloaders are being destroyed
+	std::set<CurlDownloader*> cancelled;
+	//Transfer being completed outside of the mutex
+	CurlDownloader* finishing;
+	//Completed transfers and connections they opened, for the statistics
+	uint64_t transfers;
+	uint64_t connections;
+	void worker();
+	void wakeUp();
+	void startPending(std::vector<CurlDownloader*>& rejected);
+	void releaseCancelled();
+	void finish(CurlDownloader* d, int result);
+	void completeTransfers();
+	void flushProgress();
+	static const uint32_t maxTransfers=32;
+	static const uint32_t maxHostConnections=6;
+	//Minimum interval in ms between two progress notifications of a transfer
+	static const uint32_t progressInterval=40;
+	//Polling interval in ms when the loop cannot be woken up by curl_multi_wakeup
+	static const uint32_t wakeUpInterval=20;
+public:
+	CurlTransferLoop();
+	~CurlTransferLoop();
+	void add(CurlDownloader* d, DownloadManager::PRIORITY priority);
+	//On return the loop does not use d anymore, its transfer is dropped if needed
+	void remove(CurlDownloader* d);
+};
+
 //CurlDownloader can be used as a thread job, standalone or as a streambuf
 class CurlDownloader: public ThreadedDownloader
 {
+friend class CurlTransferLoop;
 private:
 	static size_t write_data(void *buffer, size_t size, size_t nmemb, void *userp);
 	static size_t write_header(void *buffer, size_t size, size_t nmemb, void *userp);
 	static int progress_callback(void *clientp, double dltotal, double dlnow, double ultotal, double ulnow);
 	void execute();
 	void threadAbort();
+	HTTPCache* httpCache;
+	//Copy of the response body for httpCache, dropped when it grows too big
+	std::vector<uint8_t> cacheBody;
+	bool cacheBodyValid;
+	//True between HTTPCache::beginRequest and HTTPCache::endRequest
+	bool cacheRequestOpen;
+	//Drops the copy of the body and ends the cache request, the response can't be stored
+	void abandonCacheRequest();
+	HTTPCache::Entry cacheEntry;
+	HTTPCache::LOOKUP_RESULT cacheResult;
+	bool serveFromCache(const HTTPCache::Entry& entry);
+	//Runs the transfer if not NULL, otherwise execute blocks until it completes
+	CurlTransferLoop* transferLoop;
+	DownloadManager::PRIORITY priority;
+	//CURL handle and curl_slist of the request headers
+	void* curl;
+	void* headerList;
+	uint64_t lastProgressTime;
+	bool createHandle();
+	void releaseHandle();
+	//Called with the result of the transfer, as the last use of the downloader
+	void finishTransfer(int result);
 public:
-	CurlDownloader(const tiny_string& _url, _R<StreamCache> cache, ILoadable* o);
+	CurlDownloader(const tiny_string& _url, _R<StreamCache> cache, ILoadable* o, HTTPCache* _httpCache=NULL,
+		       CurlTransferLoop* _transferLoop=NULL,
+		       DownloadManager::PRIORITY _priority=DownloadManager::PRIORITY_NORMAL);
 	CurlDownloader(const tiny_string& _url, _R<StreamCache> cache, const std::vector<uint8_t>& data,
-		       const std::list<tiny_string>& headers, ILoadable* o);
+		       const std::list<tiny_string>& headers, ILoadable* o,
+		       CurlTransferLoop* _transferLoop=NULL,
+		       DownloadManager::PRIORITY _priority=DownloadManager::PRIORITY_NORMAL);
+	~CurlDownloader();
 };
 
 //LocalDownloader can be used as a thread job, standalone or as a streambuf
@@ -246,7 +347,8 @@ protected:
 	bool createDownloader(_R<StreamCache> cache,
 			      _NR<EventDispatcher> dispatcher=NullRef,
 			      ILoadable* owner=NULL,
-			      bool checkPolicyFile=true);
+			      bool checkPolicyFile=true,
+			      DownloadManager::PRIORITY priority=DownloadManager::PRIORITY_NORMAL);
 	void jobFence();
 public:
 	DownloaderThreadBase(_NR<URLRequest> request, IDownloaderThreadListener* listener);
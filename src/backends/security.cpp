@@ -25,6 +25,8 @@
 #include "scripting/class.h"
 #include "scripting/toplevel/Error.h"
 #include "scripting/flash/net/XMLSocket.h"
+#include "backends/config.h"
+#include <glib.h>
 #include <sstream>
 #include <string>
 #include <algorithm>
@@ -38,12 +40,65 @@ using namespace std;
 const unsigned int SocketPolicyFile::MASTER_PORT = 843;
 const char *SocketPolicyFile::MASTER_PORT_URL = ":843";
 
+//Seconds a retrieved policy file is kept in the PolicyFileCache
+#define POLICY_FILE_LIFETIME 3600
+//Seconds a failed retrieval is kept, the server may only be down for a moment
+#define POLICY_FILE_FAILURE_LIFETIME 300
+
+/*
+ * Adds the time spent in a policy file check to the statistics
+ */
+class SecurityManager::EvaluationTimer
+{
+private:
+	SecurityManager* manager;
+	int64_t start;
+public:
+	EvaluationTimer(SecurityManager* _manager):manager(_manager),start(g_get_monotonic_time()) {}
+	~EvaluationTimer()
+	{
+		Mutex::Lock l(manager->statsMutex);
+		manager->evaluationCount++;
+		manager->evaluationTime+=g_get_monotonic_time()-start;
+	}
+};
+
+/*
+ * Loads a socket policy file before it is needed, runs in the download thread pool.
+ * URL policy files don't need a job, their download is started right away
+ * and it must not wait in the pool that runs the download itself
+ */
+class SecurityManager::PolicyPrefetchJob : public IThreadJob
+{
+private:
+	SocketPolicyFile* file;
+public:
+	PolicyPrefetchJob(SocketPolicyFile* _file):file(_file) {}
+	void execute()
+	{
+		if(!threadAborting)
+			getSys()->securityManager->loadSocketPolicyFile(file);
+	}
+	void jobFence()
+	{
+		SecurityManager* manager = getSys()->securityManager;
+		{
+			Mutex::Lock l(manager->statsMutex);
+			manager->socketPrefetchJobs--;
+		}
+		delete this;
+	}
+};
+
 /**
  * \brief SecurityManager constructor
  */
 SecurityManager::SecurityManager():
+	evaluationCount(0),evaluationTime(0),prefetchCount(0),socketPrefetchJobs(0),
 	sandboxType(REMOTE),exactSettings(true),exactSettingsLocked(false)
 {
+	policyFileCache = new PolicyFileCache(Config::getConfig()->getCacheDirectory() + G_DIR_SEPARATOR_S + "policies");
+
 	sandboxNames[0] = "remote";
 	sandboxNames[1] = "localWithFile";
 	sandboxNames[2] = "localWithNetwork";
@@ -73,6 +128,29 @@ SecurityManager::~SecurityManager()
 	i = loadedURLPFiles.begin();
 	for(;i != loadedURLPFiles.end(); ++i)
 		delete (*i).second;
+
+	SocketPFileMap::iterator j = pendingSocketPFiles.begin();
+	for(; j != pendingSocketPFiles.end(); ++j)
+		delete (*j).second;
+
+	j = loadedSocketPFiles.begin();
+	for(; j != loadedSocketPFiles.end(); ++j)
+		delete (*j).second;
+
+	logStats();
+	delete policyFileCache;
+}
+
+void SecurityManager::logStats()
+{
+	Mutex::Lock l(statsMutex);
+	if(evaluationCount == 0)
+		return;
+	uint64_t hits, misses;
+	policyFileCache->getStats(hits, misses);
+	LOG(LOG_INFO, "SECURITY: " << evaluationCount << " policy checks took " << evaluationTime/1000 << " ms, "
+	    << prefetchCount << " policy files prefetched, policy file cache: "
+	    << hits << " hits, " << misses << " misses");
 }
 
 /**
@@ -86,11 +164,16 @@ SecurityManager::~SecurityManager()
  */
 PolicyFile* SecurityManager::addPolicyFile(const URLInfo& url)
 {
+	PolicyFile* file = NULL;
 	if(url.getProtocol() == "http" || url.getProtocol() == "https" || url.getProtocol() == "ftp")
-		return addURLPolicyFile(url);
+		file = addURLPolicyFile(url);
 	else if(url.getProtocol() == "xmlsocket")
-		return addSocketPolicyFile(url);
-	return NULL;
+		file = addSocketPolicyFile(url);
+
+	//The file will most likely be checked soon, load it (and its master) right away
+	if(file != NULL && file->isValid())
+		prefetchPolicyFile(file);
+	return file;
 }
 
 /**
@@ -260,6 +343,73 @@ void SecurityManager::loadSocketPolicyFile(SocketPolicyFile* file)
 	loadPolicyFile<SocketPolicyFile>(pendingSocketPFiles, loadedSocketPFiles, file);
 }
 
+void SecurityManager::prefetchPolicyFile(PolicyFile* file)
+{
+	if(file->isLoaded())
+		return;
+	if(file->getType() == PolicyFile::URL)
+	{
+		if(!static_cast<URLPolicyFile*>(file)->startPrefetch())
+			return;
+		Mutex::Lock l(statsMutex);
+		prefetchCount++;
+		return;
+	}
+	{
+		//Beyond the limit the file is simply loaded when it is first checked
+		Mutex::Lock l(statsMutex);
+		if(socketPrefetchJobs >= maxSocketPrefetchJobs)
+			return;
+		socketPrefetchJobs++;
+		prefetchCount++;
+	}
+	getSys()->addDownloadJob(new PolicyPrefetchJob(static_cast<SocketPolicyFile*>(file)));
+}
+
+/**
+ * \brief Start loading the master policy file of a host in the background
+ *
+ * Only does something the first time a host is seen, so that the master
+ * policy file is usually loaded when the first check of the host needs it.
+ * Same-host URLs and local files don't need policy files.
+ * \param url An URL the movie is about to access
+ */
+void SecurityManager::prefetchMasterPolicyFile(const URLInfo& url)
+{
+	if(!url.isValid() || url.isRTMP() || getSys()->mainClip == NULL)
+		return;
+	const URLInfo& origin = getSys()->mainClip->getOrigin();
+	bool socket = (url.getProtocol() == "xmlsocket");
+	if(!socket && url.getProtocol() != "http" && url.getProtocol() != "https" && url.getProtocol() != "ftp")
+		return;
+	if(!socket && url.getProtocol() == origin.getProtocol() && url.getHostname() == origin.getHostname())
+		return;
+
+	{
+		RecMutex::Lock l(mutex);
+		if(!seenHosts.insert(url.getProtocol() + "://" + url.getHostname()).second)
+			return;
+	}
+
+	PolicyFile* master;
+	if(socket)
+	{
+		URLInfo masterURL = url.goToURL(SocketPolicyFile::MASTER_PORT_URL);
+		master = getSocketPolicyFileByURL(masterURL);
+		if(master == NULL)
+			master = addSocketPolicyFile(masterURL);
+	}
+	else
+	{
+		URLInfo masterURL = url.goToURL("/crossdomain.xml");
+		master = getURLPolicyFileByURL(masterURL);
+		if(master == NULL)
+			master = addURLPolicyFile(masterURL);
+	}
+	if(master->isValid())
+		prefetchPolicyFile(master);
+}
+
 template<class T>
 std::list<T*> *SecurityManager::searchPolicyFiles(const URLInfo& url,
 						  T *master,
@@ -466,6 +616,9 @@ SecurityManager::EVALUATIONRESULT SecurityManager::evaluateURLStatic(const URLIn
 			return restrictLocalDirResult;
 	}
 
+	//The policy files of the host will probably be checked next
+	prefetchMasterPolicyFile(url);
+
 	//All checks passed, so we allow the URL connection
 	return ALLOWED;
 }
@@ -575,6 +728,8 @@ SecurityManager::EVALUATIONRESULT SecurityManager::evaluatePortURL(const URLInfo
 SecurityManager::EVALUATIONRESULT SecurityManager::evaluatePoliciesURL(const URLInfo& url,
 		bool loadPendingPolicies)
 {
+	EvaluationTimer timer(this);
+
 	//This check doesn't apply to data generation mode
 	if(url.isEmpty())
 		return ALLOWED;
@@ -629,6 +784,8 @@ SecurityManager::EVALUATIONRESULT SecurityManager::evaluatePoliciesURL(const URL
 SecurityManager::EVALUATIONRESULT SecurityManager::evaluateSocketConnection(const URLInfo& url,
 									    bool loadPendingPolicies)
 {
+	EvaluationTimer timer(this);
+
 	if(url.getProtocol() != "xmlsocket")
 		return NA_CROSSDOMAIN_POLICY;
 
@@ -675,6 +832,8 @@ SecurityManager::EVALUATIONRESULT SecurityManager::evaluateSocketConnection(cons
 SecurityManager::EVALUATIONRESULT SecurityManager::evaluateHeader(const URLInfo& url,
 		const tiny_string& header, bool loadPendingPolicies)
 {
+	EvaluationTimer timer(this);
+
 	//This check doesn't apply to data generation mode
 	if (url.isEmpty())
 		return ALLOWED;
@@ -882,8 +1041,10 @@ void PolicyFile::handlePolicyElement(CrossDomainPolicy::ELEMENT& elementType,
 	}
 	else if(elementType == CrossDomainPolicy::ALLOW_ACCESS_FROM)
 	{
-		allowAccessFrom.push_back(new PolicyAllowAccessFrom(this, 
-			parser.getDomain(), parser.getToPorts(), parser.getSecure(), parser.getSecureSpecified()));
+		PolicyAllowAccessFrom* entry = new PolicyAllowAccessFrom(this,
+			parser.getDomain(), parser.getToPorts(), parser.getSecure(), parser.getSecureSpecified());
+		allowAccessFrom.push_back(entry);
+		allowAccessFromIndex.insert(entry->getDomain(), entry);
 	}
 }
 
@@ -919,7 +1080,7 @@ PolicyFile::METAPOLICY PolicyFile::getMetaPolicy()
  * \see SecurityManager::addURLPolicyFile()
  */
 URLPolicyFile::URLPolicyFile(const URLInfo& _url):
-	PolicyFile(_url, URL)
+	PolicyFile(_url, URL),prefetchDownloader(NULL)
 {
 	if(url.isValid())
 		valid = true;
@@ -942,6 +1103,9 @@ URLPolicyFile::URLPolicyFile(const URLInfo& _url):
 URLPolicyFile::~URLPolicyFile()
 {
 	Mutex::Lock l(mutex);
+	//An unused prefetch, the DownloadManager already destroyed it if it is gone
+	if(prefetchDownloader && getSys()->downloadManager)
+		getSys()->downloadManager->destroy(prefetchDownloader);
 	for(list<PolicyAllowHTTPRequestHeadersFrom*>::iterator i = allowHTTPRequestHeadersFrom.begin();
 			i != allowHTTPRequestHeadersFrom.end(); ++i)
 		delete (*i);
@@ -1003,22 +1167,77 @@ bool URLPolicyFile::isIgnoredByMaster()
 	return false;
 }
 
-bool URLPolicyFile::retrievePolicyFile(vector<unsigned char>& outData)
+/**
+ * \brief Starts downloading the policy file without waiting for it
+ *
+ * Called by SecurityManager::prefetchPolicyFile(), the download is taken
+ * over by the first load of the file.
+ * Waits for mutex at start and releases mutex when finished
+ * \return false if the file is already loaded, being downloaded or cached
+ */
+bool URLPolicyFile::startPrefetch()
 {
-	bool ok = true;
+	Mutex::Lock l(mutex);
+	if(!isValid() || isLoaded() || prefetchDownloader != NULL)
+		return false;
+	PolicyFileCache::Entry entry;
+	if(getSys()->securityManager->getPolicyFileCache()->lookup(getOriginalURL().getParsedURL(), entry))
+		return false;
+	prefetchDownloader=getSys()->downloadManager->download(url, _MR(new MemoryStreamCache(getSys())), NULL,
+								 DownloadManager::PRIORITY_HIGH);
+	return true;
+}
 
+void URLPolicyFile::downloadPolicyFile(PolicyFileCache::Entry& entry)
+{
 	//No caching needed for this download, we don't expect very big files
-	Downloader* downloader=getSys()->downloadManager->download(url, _MR(new MemoryStreamCache(getSys())), NULL);
+	//Other downloads wait for the policy, fetch it first
+	Downloader* downloader=prefetchDownloader;
+	prefetchDownloader=NULL;
+	if(downloader == NULL)
+		downloader=getSys()->downloadManager->download(url, _MR(new MemoryStreamCache(getSys())), NULL,
+							       DownloadManager::PRIORITY_HIGH);
 
 	//Wait until the file is fetched
 	downloader->waitForTermination();
-	if(downloader->hasFailed())
-		ok = false;
+	entry.ok = !downloader->hasFailed();
+
+	if(entry.ok && downloader->isRedirected())
+		entry.redirectURL = downloader->getURL();
+
+	std::list<tiny_string> contenttypelist = downloader->getHeader("content-type").split(';');
+	entry.contentType = contenttypelist.size() == 0 ? "" : contenttypelist.front();
+
+	if (entry.ok)
+	{
+		std::streambuf *sbuf = downloader->getCache()->createReader();
+		istream s(sbuf);
+		size_t bufLength = downloader->getLength();
+		entry.data.resize(bufLength);
+		if (bufLength > 0)
+			s.read((char*)&entry.data[0], bufLength);
+		delete sbuf;
+	}
+
+	getSys()->downloadManager->destroy(downloader);
+}
+
+bool URLPolicyFile::retrievePolicyFile(vector<unsigned char>& outData)
+{
+	//Use the outcome of an earlier download if it is still fresh
+	PolicyFileCache::Entry entry;
+	PolicyFileCache* cache = getSys()->securityManager->getPolicyFileCache();
+	if(!cache->lookup(getOriginalURL().getParsedURL(), entry))
+	{
+		downloadPolicyFile(entry);
+		cache->store(getOriginalURL().getParsedURL(), entry);
+	}
+	bool ok = entry.ok;
 
 	//If files are redirected, we use the new URL as the file's URL
-	if(ok && downloader->isRedirected())
+	if(ok && !entry.redirectURL.empty())
 	{
-		URLInfo newURL(downloader->getURL());
+		URLInfo newURL(entry.redirectURL);
 		if(url.getHostname() != newURL.getHostname())
 		{
 			LOG(LOG_INFO, _("SECURITY: Policy file was redirected to other domain, marking invalid"));
@@ -1030,8 +1249,7 @@ bool URLPolicyFile::retrievePolicyFile(vector<unsigned char>& outData)
 
 	//Policy files must have on of the following content-types to be valid:
 	//text/*, application/xml or application/xhtml+xml
-	std::list<tiny_string> contenttypelist = downloader->getHeader("content-type").split(';');
-	tiny_string contentType = contenttypelist.size() == 0 ? "" : contenttypelist.front();
+	const tiny_string& contentType = entry.contentType;
 	if(ok && (subtype == HTTP || subtype == HTTPS) && 
 	   contentType.substr(0, 5) != "text/" &&
 	   contentType != "application/xml" &&
@@ -1047,6 +1265,7 @@ bool URLPolicyFile::retrievePolicyFile(vector<unsigned char>& outData)
 	{
 		//If the site-control policy of the master policy file is by-content-type, only policy files with
 		//content-type = text/x-cross-domain-policy are allowed.
+		//The master is owned by the SecurityManager, it must not be deleted here
 		URLPolicyFile* master = getMasterPolicyFile();
 		if(master->isValid() &&
 				(subtype == HTTP || subtype == HTTPS) &&
@@ -1056,21 +1275,10 @@ bool URLPolicyFile::retrievePolicyFile(vector<unsigned char>& outData)
 			LOG(LOG_INFO, _("SECURITY: Policy file content-type isn't strict, marking invalid"));
 			ignore = true;
 		}
-		delete master;
 	}
 
 	if (ok)
-	{
-		std::streambuf *sbuf = downloader->getCache()->createReader();
-		istream s(sbuf);
-		size_t bufLength = downloader->getLength();
-		size_t offset = outData.size();
-		outData.resize(offset+bufLength);
-		s.read((char*)&outData[offset], bufLength);
-		delete sbuf;
-	}
-
-	getSys()->downloadManager->destroy(downloader);
+		outData.insert(outData.end(), entry.data.begin(), entry.data.end());
 
 	return ok;
 }
@@ -1123,8 +1331,11 @@ bool URLPolicyFile::allowsAccessFrom(const URLInfo& requestingUrl, const URLInfo
 	if(!isValid() || isIgnored())
 		return false;
 
-	list<PolicyAllowAccessFrom*>::const_iterator i = allowAccessFrom.begin();
-	for(; i != allowAccessFrom.end(); ++i)
+	//Only the entries for the domain of requestingUrl need to be checked
+	vector<PolicyAllowAccessFrom*> entries;
+	allowAccessFromIndex.find(requestingUrl.getHostname(), entries);
+	vector<PolicyAllowAccessFrom*>::const_iterator i = entries.begin();
+	for(; i != entries.end(); ++i)
 	{
 		//This allow-access-from entry applies to our domain AND it allows our domain
 		// we allow access to https urls even if the main url is not https
@@ -1160,8 +1371,10 @@ bool URLPolicyFile::allowsHTTPRequestHeaderFrom(const URLInfo& url, const URLInf
 	if(!isValid() || isIgnored())
 		return false;
 
-	list<PolicyAllowHTTPRequestHeadersFrom*>::const_iterator i = allowHTTPRequestHeadersFrom.begin();
-	for(; i != allowHTTPRequestHeadersFrom.end(); ++i)
+	vector<PolicyAllowHTTPRequestHeadersFrom*> entries;
+	allowHTTPRequestHeadersFromIndex.find(url.getHostname(), entries);
+	vector<PolicyAllowHTTPRequestHeadersFrom*>::const_iterator i = entries.begin();
+	for(; i != entries.end(); ++i)
 	{
 		if((*i)->allowsHTTPRequestHeaderFrom(url, header))
 			return true;
@@ -1176,10 +1389,11 @@ void URLPolicyFile::handlePolicyElement(CrossDomainPolicy::ELEMENT& elementType,
 
 	if (elementType == CrossDomainPolicy::ALLOW_HTTP_REQUEST_HEADERS_FROM)
 	{
-		allowHTTPRequestHeadersFrom.push_back(
-			new PolicyAllowHTTPRequestHeadersFrom(this, 
-				parser.getDomain(), parser.getHeaders(),
-				parser.getSecure(), parser.getSecureSpecified()));
+		PolicyAllowHTTPRequestHeadersFrom* entry = new PolicyAllowHTTPRequestHeadersFrom(this,
+			parser.getDomain(), parser.getHeaders(),
+			parser.getSecure(), parser.getSecureSpecified());
+		allowHTTPRequestHeadersFrom.push_back(entry);
+		allowHTTPRequestHeadersFromIndex.insert(entry->getDomain(), entry);
 	}
 }
 
@@ -1213,8 +1427,10 @@ bool SocketPolicyFile::allowsAccessFrom(const URLInfo& requestingUrl, const URLI
 	if(!isValid() || isIgnored())
 		return false;
 
-	list<PolicyAllowAccessFrom*>::const_iterator i = allowAccessFrom.begin();
-	for(; i != allowAccessFrom.end(); ++i)
+	vector<PolicyAllowAccessFrom*> entries;
+	allowAccessFromIndex.find(requestingUrl.getHostname(), entries);
+	vector<PolicyAllowAccessFrom*>::const_iterator i = entries.begin();
+	for(; i != entries.end(); ++i)
 	{
 		//This allow-access-from entry applies to our domain AND it allows our domain
 		if((*i)->allowsAccessFrom(requestingUrl, to.getPort()))
@@ -1275,6 +1491,26 @@ bool SocketPolicyFile::isIgnoredByMaster()
  * \return \c true if policy file was downloaded without errors, otherwise \c false (content of outData will be undefined)
  */
 bool SocketPolicyFile::retrievePolicyFile(vector<unsigned char>& outData)
+{
+	//Use the outcome of an earlier request if it is still fresh
+	PolicyFileCache::Entry entry;
+	PolicyFileCache* cache = getSys()->securityManager->getPolicyFileCache();
+	if(!cache->lookup(getOriginalURL().getParsedURL(), entry))
+	{
+		entry.ok = requestPolicyFile(entry.data);
+		cache->store(getOriginalURL().getParsedURL(), entry);
+	}
+	if(entry.ok)
+		outData.insert(outData.end(), entry.data.begin(), entry.data.end());
+	return entry.ok;
+}
+
+/**
+ * \brief Request the policy file from the server
+ *
+ * \see SocketPolicyFile::retrievePolicyFile()
+ */
+bool SocketPolicyFile::requestPolicyFile(vector<unsigned char>& outData)
 {
 	tiny_string hostname = url.getHostname();
 	uint16_t port = url.getPort();
@@ -1400,54 +1636,51 @@ PolicyAllowAccessFrom::PolicyAllowAccessFrom(PolicyFile* _file, const string _do
 
 	//Set the default value
 	if(_toPorts.length() == 0 || _toPorts == "*")
-		toPorts.push_back(new PortRange(0, 0, false, true));
+		toPorts.push_back(PortRange(0, 65535));
 	else
 	{
+		//A comma separated list of ports and ranges, like "507,516-523"
 		string ports = _toPorts;
 		size_t cursor = 0;
-		size_t commaPos;
-		size_t dashPos;
-		string startPortStr;
-		string endPortStr;
-		uint16_t startPort;
-		uint16_t endPort;
-		do
+		while(cursor <= ports.length())
 		{
-			commaPos = ports.find(",", cursor);
-			dashPos = ports.find("-", commaPos);
+			size_t commaPos = ports.find(",", cursor);
+			if(commaPos == string::npos)
+				commaPos = ports.length();
+			string item = ports.substr(cursor, commaPos-cursor);
+			cursor = commaPos+1;
 
-			if(dashPos != string::npos)
+			if(item == "*")
 			{
-				startPortStr = ports.substr(cursor, dashPos-cursor);
-				if(startPortStr == "*")
-				{
-					toPorts.push_back(new PortRange(0, 0, false, true));
-					break;
-				}
-				startPort = atoi(startPortStr.c_str());
-				if(ports.length() < dashPos+1)
-				{
-					endPortStr = ports.substr(dashPos+1, commaPos-(dashPos+1));
-					endPort = atoi(endPortStr.c_str());
-					toPorts.push_back(new PortRange(startPort, endPort, true));
-				}
-				else
-					toPorts.push_back(new PortRange(startPort));
+				toPorts.clear();
+				toPorts.push_back(PortRange(0, 65535));
+				break;
 			}
-			else
+			size_t dashPos = item.find("-");
+			int startPort = atoi(item.substr(0, dashPos).c_str());
+			int endPort = (dashPos == string::npos) ? startPort : atoi(item.substr(dashPos+1).c_str());
+			if(startPort <= 0 || endPort < startPort || endPort > 65535)
 			{
-				startPortStr = ports.substr(cursor, commaPos-cursor);
-				if(startPortStr == "*")
-				{
-					toPorts.push_back(new PortRange(0, 0, false, true));
-					break;
-				}
-				startPort = atoi(startPortStr.c_str());
-				toPorts.push_back(new PortRange(startPort));
+				LOG(LOG_INFO, _("SECURITY: Ignoring invalid port range in policy file: ") << item);
+				continue;
 			}
-			cursor = commaPos+1;
+			toPorts.push_back(PortRange(startPort, endPort));
 		}
-		while(commaPos != string::npos);
+
+		//Sort and merge the ranges, so that a port is found with a binary search
+		sort(toPorts.begin(), toPorts.end());
+		vector<PortRange> merged;
+		for(vector<PortRange>::const_iterator it = toPorts.begin(); it != toPorts.end(); ++it)
+		{
+			if(!merged.empty() && it->getStartPort() <= merged.back().getEndPort()+1)
+			{
+				if(it->getEndPort() > merged.back().getEndPort())
+					merged.back() = PortRange(merged.back().getStartPort(), it->getEndPort());
+			}
+			else
+				merged.push_back(*it);
+		}
+		toPorts.swap(merged);
 	}
 }
 
@@ -1459,9 +1692,22 @@ PolicyAllowAccessFrom::PolicyAllowAccessFrom(PolicyFile* _file, const string _do
  */
 PolicyAllowAccessFrom::~PolicyAllowAccessFrom()
 {
-	for(list<PortRange*>::iterator i = toPorts.begin(); i != toPorts.end(); ++i)
-		delete (*i);
-	toPorts.clear();
+}
+
+/**
+ * \brief Checks if the entry allows connections to the given port
+ *
+ * \param port The port to look for in the to-ports ranges
+ * \return \c true if one of the ranges contains the port, otherwise \c false
+ */
+bool PolicyAllowAccessFrom::allowsPort(uint16_t port) const
+{
+	//The last range starting at or before port
+	vector<PortRange>::const_iterator it = upper_bound(toPorts.begin(), toPorts.end(), PortRange(port, port));
+	if(it == toPorts.begin())
+		return false;
+	--it;
+	return it->matches(port);
 }
 
 /**
@@ -1497,18 +1743,7 @@ bool PolicyAllowAccessFrom::allowsAccessFrom(const URLInfo& url, uint16_t toPort
 		if (toPort == 0)
 			return false;
 
-		bool match = false;
-		std::list<PortRange*>::const_iterator it;
-		for (it=toPorts.begin(); it!=toPorts.end(); ++it)
-		{
-			if ((*it)->matches(toPort))
-			{
-				match = true;
-				break;
-			}
-		}
-
-		if (!match)
+		if (!allowsPort(toPort))
 			return false;
 	}
 
@@ -1611,3 +1846,143 @@ bool PolicyAllowHTTPRequestHeadersFrom::allowsHTTPRequestHeaderFrom(const URLInf
 
 	return true;
 }
+
+/**
+ * \brief Constructor for the PolicyFileCache class
+ *
+ * \param _directory The directory where the index of the cache is saved
+ */
+PolicyFileCache::PolicyFileCache(const string& _directory):
+	directory(_directory),modified(false),hits(0),misses(0)
+{
+	if(g_mkdir_with_parents(directory.c_str(), 0700) != 0)
+		LOG(LOG_ERROR, "SECURITY: could not create the policy file cache directory " << directory);
+	readIndex(entries);
+}
+
+PolicyFileCache::~PolicyFileCache()
+{
+	if(modified)
+		saveIndex();
+}
+
+string PolicyFileCache::indexPath() const
+{
+	return directory + G_DIR_SEPARATOR_S + "index";
+}
+
+bool PolicyFileCache::lookup(const tiny_string& url, Entry& entry)
+{
+	Mutex::Lock l(mutex);
+	map<tiny_string, Entry>::const_iterator it = entries.find(url);
+	if(it == entries.end() || it->second.expires <= g_get_real_time()/1000000)
+	{
+		misses++;
+		return false;
+	}
+	LOG(LOG_INFO, _("SECURITY: Policy file found in the cache (") << url << ")");
+	hits++;
+	entry = it->second;
+	return true;
+}
+
+void PolicyFileCache::store(const tiny_string& url, Entry& entry)
+{
+	Mutex::Lock l(mutex);
+	entry.expires = g_get_real_time()/1000000 + (entry.ok ? POLICY_FILE_LIFETIME : POLICY_FILE_FAILURE_LIFETIME);
+	entries[url] = entry;
+	modified = true;
+}
+
+void PolicyFileCache::getStats(uint64_t& _hits, uint64_t& _misses)
+{
+	Mutex::Lock l(mutex);
+	_hits = hits;
+	_misses = misses;
+}
+
+/**
+ * \brief Reads the fresh entries of the index file
+ *
+ * \param result The entries are added here, unless result already has an entry for the URL
+ */
+void PolicyFileCache::readIndex(map<tiny_string, Entry>& result)
+{
+	int64_t now = g_get_real_time()/1000000;
+	GKeyFile* index = g_key_file_new();
+	if(g_key_file_load_from_file(index, indexPath().c_str(), G_KEY_FILE_NONE, NULL))
+	{
+		gsize count = 0;
+		gchar** groups = g_key_file_get_groups(index, &count);
+		for(gsize i = 0; i < count; i++)
+		{
+			gchar* url = g_key_file_get_string(index, groups[i], "url", NULL);
+			Entry e;
+			e.expires = g_key_file_get_int64(index, groups[i], "expires", NULL);
+			if(url == NULL || e.expires <= now || result.find(tiny_string(url)) != result.end())
+			{
+				g_free(url);
+				continue;
+			}
+			e.ok = g_key_file_get_boolean(index, groups[i], "ok", NULL);
+			gchar* redirect = g_key_file_get_string(index, groups[i], "redirect", NULL);
+			if(redirect)
+				e.redirectURL = tiny_string(redirect, true);
+			gchar* contentType = g_key_file_get_string(index, groups[i], "contenttype", NULL);
+			if(contentType)
+				e.contentType = tiny_string(contentType, true);
+			//The policy file is stored in base64, it may contain zero bytes
+			gchar* data = g_key_file_get_string(index, groups[i], "data", NULL);
+			if(data)
+			{
+				gsize len = 0;
+				guchar* decoded = g_base64_decode(data, &len);
+				e.data.assign(decoded, decoded+len);
+				g_free(decoded);
+			}
+			result[tiny_string(url, true)] = e;
+			g_free(data);
+			g_free(contentType);
+			g_free(redirect);
+			g_free(url);
+		}
+		g_strfreev(groups);
+	}
+	g_key_file_free(index);
+}
+
+/**
+ * \brief Saves the fresh entries to the index file
+ *
+ * The entries saved meanwhile by other processes are kept.
+ */
+void PolicyFileCache::saveIndex()
+{
+	Mutex::Lock l(mutex);
+	readIndex(entries);
+
+	int64_t now = g_get_real_time()/1000000;
+	GKeyFile* index = g_key_file_new();
+	for(map<tiny_string, Entry>::const_iterator it = entries.begin(); it != entries.end(); ++it)
+	{
+		const Entry& e = it->second;
+		if(e.expires <= now)
+			continue;
+		gchar* group = g_compute_checksum_for_string(G_CHECKSUM_SHA256, it->first.raw_buf(), -1);
+		g_key_file_set_string(index, group, "url", it->first.raw_buf());
+		g_key_file_set_boolean(index, group, "ok", e.ok);
+		g_key_file_set_string(index, group, "redirect", e.redirectURL.raw_buf());
+		g_key_file_set_string(index, group, "contenttype", e.contentType.raw_buf());
+		g_key_file_set_int64(index, group, "expires", e.expires);
+		gchar* data = g_base64_encode(e.data.empty() ? NULL : &e.data[0], e.data.size());
+		g_key_file_set_string(index, group, "data", data);
+		g_free(data);
+		g_free(group);
+	}
+	gsize len = 0;
+	gchar* data = g_key_file_to_data(index, &len, NULL);
+	if(!g_file_set_contents(indexPath().c_str(), data, len, NULL))
+		LOG(LOG_ERROR, "SECURITY: could not write the policy file cache index");
+	g_free(data);
+	g_key_file_free(index);
+}
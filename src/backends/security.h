@@ -25,6 +25,10 @@
 #include <string>
 #include <list>
 #include <map>
+#include <set>
+#include <vector>
+#include <algorithm>
+#include <cctype>
 #include <cinttypes>
 #include "swftypes.h"
 #include "threading.h"
@@ -35,6 +39,7 @@ namespace lightspark
 {
 
 class PolicyFile;
+class Downloader;
 class URLPolicyFile;
 class SocketPolicyFile;
 typedef std::list<URLPolicyFile*> URLPFileList;
@@ -52,6 +57,137 @@ typedef std::list<SocketPolicyFile*>::const_iterator SocketPFileListConstIt;
 typedef std::pair<tiny_string, SocketPolicyFile*> SocketPFilePair;
 typedef std::multimap<tiny_string, SocketPolicyFile*> SocketPFileMap;
 
+/*
+ * Persistent cache of retrieved policy files.
+ *
+ * Keeps the outcome of the retrieval of every policy file by its original
+ * URL, so that later SecurityManagers, in this process or in a later run,
+ * don't retrieve it again until the entry expires. Failures are kept too,
+ * but for a shorter time. The entries are saved in an index file in the
+ * cache directory.
+ */
+class PolicyFileCache
+{
+public:
+	class Entry
+	{
+	public:
+		//False if the retrieval failed
+		bool ok;
+		//Final URL of the file if it was redirected, empty otherwise
+		tiny_string redirectURL;
+		tiny_string contentType;
+		std::vector<unsigned char> data;
+		//Seconds since the epoch after which the file must be retrieved again
+		int64_t expires;
+		Entry():ok(false),expires(0){}
+	};
+private:
+	Mutex mutex;
+	std::map<tiny_string, Entry> entries;
+	std::string directory;
+	bool modified;
+	uint64_t hits;
+	uint64_t misses;
+	std::string indexPath() const;
+	void readIndex(std::map<tiny_string, Entry>& result);
+	void saveIndex();
+public:
+	PolicyFileCache(const std::string& _directory);
+	~PolicyFileCache();
+	//Returns false if there is no fresh entry for url
+	bool lookup(const tiny_string& url, Entry& entry);
+	//Stores the outcome of the retrieval of url, setting its expiry
+	void store(const tiny_string& url, Entry& entry);
+	void getStats(uint64_t& _hits, uint64_t& _misses);
+};
+
+/*
+ * Entries of policy files indexed by the domain they apply to.
+ *
+ * Domains are kept in a trie of their labels, starting from the top level
+ * domain, so finding the entries for a hostname takes a step per label
+ * instead of a comparison with every entry. The rules are the ones of
+ * URLInfo::matchesDomain: "*" matches every host and "*.example.com"
+ * matches example.com and all its subdomains.
+ */
+template<class T>
+class PolicyDomainIndex
+{
+private:
+	class Node
+	{
+	public:
+		std::map<std::string, Node*> children;
+		//Entries for exactly this domain
+		std::list<T*> exact;
+		//Entries for this domain and all its subdomains
+		std::list<T*> subdomains;
+		~Node()
+		{
+			for(auto it=children.begin(); it!=children.end(); ++it)
+				delete it->second;
+		}
+	};
+	Node root;
+	//Splits a domain in lowercase labels, from the top level domain down
+	static void splitLabels(std::string domain, std::vector<std::string>& labels)
+	{
+		std::transform(domain.begin(), domain.end(), domain.begin(), ::tolower);
+		size_t start=0;
+		while(true)
+		{
+			size_t dot=domain.find('.', start);
+			labels.push_back(domain.substr(start, dot == std::string::npos ? std::string::npos : dot-start));
+			if(dot == std::string::npos)
+				break;
+			start=dot+1;
+		}
+		std::reverse(labels.begin(), labels.end());
+	}
+public:
+	void insert(const std::string& domain, T* entry)
+	{
+		if(domain == "*")
+		{
+			root.subdomains.push_back(entry);
+			return;
+		}
+		bool wildcard=(domain.compare(0, 2, "*.") == 0);
+		std::vector<std::string> labels;
+		splitLabels(wildcard ? domain.substr(2) : domain, labels);
+		Node* node=&root;
+		for(size_t i=0; i<labels.size(); i++)
+		{
+			Node*& child=node->children[labels[i]];
+			if(child == NULL)
+				child=new Node();
+			node=child;
+		}
+		if(wildcard)
+			node->subdomains.push_back(entry);
+		else
+			node->exact.push_back(entry);
+	}
+	//Appends the entries applying to hostname to result
+	void find(const tiny_string& hostname, std::vector<T*>& result) const
+	{
+		std::vector<std::string> labels;
+		splitLabels(hostname.raw_buf(), labels);
+		const Node* node=&root;
+		result.insert(result.end(), root.subdomains.begin(), root.subdomains.end());
+		for(size_t i=0; i<labels.size(); i++)
+		{
+			auto it=node->children.find(labels[i]);
+			if(it == node->children.end())
+				return;
+			node=it->second;
+			result.insert(result.end(), node->subdomains.begin(), node->subdomains.end());
+		}
+		result.insert(result.end(), node->exact.begin(), node->exact.end());
+	}
+};
+
 class SecurityManager
 {
 public:
@@ -59,6 +195,26 @@ public:
 private:
 	RecMutex mutex;
 
+	//Policy files retrieved earlier, shared with the later runs
+	PolicyFileCache* policyFileCache;
+	//Protocol and hostname of the hosts whose master policy file has been looked for
+	std::set<tiny_string> seenHosts;
+	//Statistics of the policy file checks, protected by statsMutex
+	Mutex statsMutex;
+	uint64_t evaluationCount;
+	//Microseconds spent in the checks
+	uint64_t evaluationTime;
+	uint64_t prefetchCount;
+	class EvaluationTimer;
+	void logStats();
+	//Socket policy files being loaded by a PolicyPrefetchJob, protected by statsMutex
+	uint32_t socketPrefetchJobs;
+	//Each job holds a thread of the download pool while waiting for the server
+	static const uint32_t maxSocketPrefetchJobs=4;
+	class PolicyPrefetchJob;
+	//Loads file in the background
+	void prefetchPolicyFile(PolicyFile* file);
+
 	const char* sandboxNames[4];
 	const char* sandboxTitles[4];
 
@@ -114,6 +270,9 @@ public:
 
 	void loadURLPolicyFile(URLPolicyFile* file);
 	void loadSocketPolicyFile(SocketPolicyFile* file);
+	//Starts loading the master policy file of the host of url, the first time the host is seen
+	void prefetchMasterPolicyFile(const URLInfo& url);
+	PolicyFileCache* getPolicyFileCache() { return policyFileCache; }
 	
 	//Set the sandbox type
 	void setSandboxType(SANDBOXTYPE type) { sandboxType = type; }
@@ -239,6 +398,7 @@ protected:
 
 	PolicySiteControl* siteControl;
 	std::list<PolicyAllowAccessFrom*> allowAccessFrom;
+	PolicyDomainIndex<PolicyAllowAccessFrom> allowAccessFromIndex;
 public:
 
 	const URLInfo& getURL() const { return url; }
@@ -268,6 +428,14 @@ private:
 	SUBTYPE subtype;
 
 	std::list<PolicyAllowHTTPRequestHeadersFrom*> allowHTTPRequestHeadersFrom;
+	PolicyDomainIndex<PolicyAllowHTTPRequestHeadersFrom> allowHTTPRequestHeadersFromIndex;
+	//Download started by SecurityManager::prefetchPolicyFile, taken over by the first load.
+	//Destroyed with the file if it is never used
+	Downloader* prefetchDownloader;
+	//Start downloading the policy file without waiting, returns false if nothing was started
+	bool startPrefetch();
+	//Download the policy file, bypassing the PolicyFileCache
+	void downloadPolicyFile(PolicyFileCache::Entry& entry);
 protected:
 	URLPolicyFile(const URLInfo& _url);
 	~URLPolicyFile();
@@ -298,6 +466,8 @@ protected:
 	SocketPolicyFile(const URLInfo& _url);
 	bool isIgnoredByMaster();
 	bool retrievePolicyFile(std::vector<unsigned char>& outData);
+	//Request the policy file from the server, bypassing the PolicyFileCache
+	bool requestPolicyFile(std::vector<unsigned char>& outData);
 	void getParserType(CrossDomainPolicy::POLICYFILETYPE&, CrossDomainPolicy::POLICYFILESUBTYPE&);
 public:
 	static const unsigned int MASTER_PORT;
@@ -330,22 +500,16 @@ class PortRange
 private:
 	uint16_t startPort;
 	uint16_t endPort;
-	bool isRange;
-	bool matchAll;
 public:
-	PortRange(uint16_t _startPort, uint16_t _endPort=0, bool _isRange=false, bool _matchAll=false):
-		startPort(_startPort),endPort(_endPort),isRange(_isRange),matchAll(_matchAll){};
-	bool matches(uint16_t port)
+	PortRange(uint16_t _startPort, uint16_t _endPort):
+		startPort(_startPort),endPort(_endPort){};
+	uint16_t getStartPort() const { return startPort; }
+	uint16_t getEndPort() const { return endPort; }
+	bool matches(uint16_t port) const
 	{
-		if(matchAll)
-			return true;
-		if(isRange)
-		{
-			return startPort >= port && endPort <= port;
-		}
-		else
-			return startPort == port;
+		return port >= startPort && port <= endPort;
 	}
+	bool operator<(const PortRange& r) const { return startPort < r.startPort; }
 };
 
 //Permit access by documents from specified domains
@@ -357,7 +521,7 @@ class PolicyAllowAccessFrom
 private:
 	PolicyFile* file;
 	std::string domain; //Required
-	std::list<PortRange*> toPorts; //Only used for SOCKET policy files, required
+	std::vector<PortRange> toPorts; //Only used for SOCKET policy files, required, sorted and not overlapping
 	bool secure; //Only used for SOCKET & HTTPS, optional, default: SOCKET=false, HTTPS=true
 protected:
 	PolicyAllowAccessFrom(PolicyFile* _file, const std::string _domain, const std::string _toPorts, bool _secure, bool secureSpecified);
@@ -365,8 +529,9 @@ protected:
 public:
 	const std::string& getDomain() const { return domain; }
 	size_t getToPortsLength() const { return toPorts.size(); }
-	std::list<PortRange*>::const_iterator getToPortsBegin() const { return toPorts.begin(); }
-	std::list<PortRange*>::const_iterator getToPortsEnd() const { return toPorts.end(); }
+	std::vector<PortRange>::const_iterator getToPortsBegin() const { return toPorts.begin(); }
+	std::vector<PortRange>::const_iterator getToPortsEnd() const { return toPorts.end(); }
+	bool allowsPort(uint16_t port) const;
 	bool getSecure() const { return secure; }
 
 	//Does this entry allow a given URL?
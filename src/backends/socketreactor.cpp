@@ -0,0 +1,321 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2011-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#ifdef _WIN32
+#ifndef _WIN32_WINNT
+#	define _WIN32_WINNT 0x0501
+#endif
+#	include <winsock2.h>
+#else
+#	include <sys/select.h>
+#	include <fcntl.h>
+#endif
+#ifdef __linux__
+#	include <sys/epoll.h>
+#endif
+#include "backends/socketreactor.h"
+#include "logger.h"
+
+using namespace std;
+using namespace lightspark;
+
+// Flags of the ready handlers
+#define READY_READ 1
+#define READY_WRITE 2
+#define READY_NOTIFY 4
+
+SocketReactor::SocketReactor():thread(NULL),stopping(false),wakeUpPending(false),
+	pollfd(-1),wakeListener(-1),wakeEmitter(-1)
+{
+#ifndef _WIN32
+	int pipefd[2];
+	if (pipe(pipefd) == 0)
+	{
+		wakeListener = pipefd[0];
+		wakeEmitter = pipefd[1];
+		fcntl(wakeListener, F_SETFL, fcntl(wakeListener, F_GETFL) | O_NONBLOCK);
+	}
+	else
+		LOG(LOG_ERROR, "SocketReactor: cannot create the wake up pipe, polling instead");
+#endif
+#ifdef __linux__
+	pollfd = epoll_create1(EPOLL_CLOEXEC);
+	if (pollfd != -1 && wakeListener != -1)
+	{
+		struct epoll_event ev;
+		memset(&ev, 0, sizeof(ev));
+		ev.events = EPOLLIN;
+		ev.data.ptr = NULL;
+		epoll_ctl(pollfd, EPOLL_CTL_ADD, wakeListener, &ev);
+	}
+#endif
+#ifdef HAVE_NEW_GLIBMM_THREAD_API
+	thread = Thread::create(sigc::mem_fun(this,&SocketReactor::worker));
+#else
+	thread = Thread::create(sigc::mem_fun(this,&SocketReactor::worker),true);
+#endif
+}
+
+/**
+ * \brief Destructor for the SocketReactor class.
+ *
+ * Stops the reactor thread and releases the handlers still registered,
+ * closing their connections.
+ */
+SocketReactor::~SocketReactor()
+{
+	{
+		Locker l(mutex);
+		stopping = true;
+		wakeUp();
+	}
+	if (thread)
+		thread->join();
+
+	for (auto it=added.begin(); it!=added.end(); ++it)
+		(*it)->release();
+	for (auto it=handlers.begin(); it!=handlers.end(); ++it)
+		it->first->release();
+
+	if (pollfd != -1)
+		::close(pollfd);
+	if (wakeListener != -1)
+		::close(wakeListener);
+	if (wakeEmitter != -1)
+		::close(wakeEmitter);
+}
+
+void SocketReactor::add(Handler* h)
+{
+	Locker l(mutex);
+	added.push_back(h);
+	known.insert(h);
+	// Handle the requests made while connecting
+	notified.insert(h);
+	wakeUp();
+}
+
+void SocketReactor::notify(Handler* h)
+{
+	Locker l(mutex);
+	if (known.find(h) == known.end())
+		return;
+	notified.insert(h);
+	wakeUp();
+}
+
+/**
+ * \brief Interrupts the wait of the reactor thread
+ *
+ * Must be called with the mutex held. Only one byte is written to the
+ * pipe until the reactor thread wakes up.
+ */
+void SocketReactor::wakeUp()
+{
+	if (wakeUpPending || wakeEmitter == -1)
+		return;
+	wakeUpPending = true;
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wunused-result"
+	write(wakeEmitter, "*", 1);
+#pragma GCC diagnostic pop
+}
+
+void SocketReactor::drainWakeUp()
+{
+	if (wakeListener == -1)
+		return;
+	char buf[16];
+	while (read(wakeListener, buf, sizeof(buf)) > 0);
+}
+
+void SocketReactor::registerHandler(Handler* h)
+{
+	bool write = h->wantsWrite();
+	handlers[h] = write;
+#ifdef __linux__
+	if (pollfd != -1)
+	{
+		struct epoll_event ev;
+		memset(&ev, 0, sizeof(ev));
+		ev.events = write ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+		ev.data.ptr = h;
+		if (epoll_ctl(pollfd, EPOLL_CTL_ADD, h->fileDescriptor(), &ev) == -1)
+			LOG(LOG_ERROR, "SocketReactor: cannot watch socket " << h->fileDescriptor() << ": " << strerror(errno));
+	}
+#endif
+}
+
+void SocketReactor::updateInterest(Handler* h)
+{
+	bool write = h->wantsWrite();
+	auto it = handlers.find(h);
+	if (it->second == write)
+		return;
+	it->second = write;
+#ifdef __linux__
+	if (pollfd != -1)
+	{
+		struct epoll_event ev;
+		memset(&ev, 0, sizeof(ev));
+		ev.events = write ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+		ev.data.ptr = h;
+		epoll_ctl(pollfd, EPOLL_CTL_MOD, h->fileDescriptor(), &ev);
+	}
+#endif
+}
+
+/**
+ * \brief Unregisters and releases a handler
+ *
+ * The socket is removed from the epoll set before the handler closes it,
+ * so its descriptor can be reused safely.
+ */
+void SocketReactor::removeHandler(Handler* h)
+{
+#ifdef __linux__
+	if (pollfd != -1)
+	{
+		struct epoll_event ev;
+		memset(&ev, 0, sizeof(ev));
+		epoll_ctl(pollfd, EPOLL_CTL_DEL, h->fileDescriptor(), &ev);
+	}
+#endif
+	handlers.erase(h);
+	{
+		Locker l(mutex);
+		known.erase(h);
+		notified.erase(h);
+	}
+	h->release();
+}
+
+void SocketReactor::wait(map<Handler*, int>& ready)
+{
+#ifdef __linux__
+	if (pollfd != -1)
+	{
+		struct epoll_event events[64];
+		int n = epoll_wait(pollfd, events, 64, wakeListener != -1 ? -1 : pollInterval);
+		for (int i=0; i<n; i++)
+		{
+			Handler* h = (Handler*)events[i].data.ptr;
+			// The wake up pipe
+			if (h == NULL)
+				continue;
+			int flags = 0;
+			// Errors and hang ups are reported by the next read
+			if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+				flags |= READY_READ;
+			if (events[i].events & EPOLLOUT)
+				flags |= READY_WRITE;
+			ready[h] |= flags;
+		}
+		return;
+	}
+#endif
+	fd_set readfds;
+	fd_set writefds;
+	FD_ZERO(&readfds);
+	FD_ZERO(&writefds);
+	int maxfd = -1;
+	if (wakeListener != -1)
+	{
+		FD_SET(wakeListener, &readfds);
+		maxfd = wakeListener;
+	}
+	for (auto it=handlers.begin(); it!=handlers.end(); ++it)
+	{
+		int fd = it->first->fileDescriptor();
+		FD_SET(fd, &readfds);
+		if (it->second)
+			FD_SET(fd, &writefds);
+		maxfd = max(maxfd, fd);
+	}
+	if (maxfd == -1)
+	{
+		compat_msleep(pollInterval);
+		return;
+	}
+
+	struct timeval timeout;
+	timeout.tv_sec = 0;
+	timeout.tv_usec = pollInterval*1000;
+	int n = select(maxfd+1, &readfds, &writefds, NULL, wakeListener != -1 ? NULL : &timeout);
+	if (n <= 0)
+		return;
+	for (auto it=handlers.begin(); it!=handlers.end(); ++it)
+	{
+		int fd = it->first->fileDescriptor();
+		int flags = 0;
+		if (FD_ISSET(fd, &readfds))
+			flags |= READY_READ;
+		if (FD_ISSET(fd, &writefds))
+			flags |= READY_WRITE;
+		if (flags)
+			ready[it->first] |= flags;
+	}
+}
+
+void SocketReactor::worker()
+{
+	map<Handler*, int> ready;
+	vector<Handler*> newHandlers;
+	set<Handler*> toNotify;
+	while (true)
+	{
+		// Drain before collecting the requests, a later wake up
+		// stays in the pipe for the next wait
+		drainWakeUp();
+		{
+			Locker l(mutex);
+			if (stopping)
+				break;
+			newHandlers.swap(added);
+			toNotify.swap(notified);
+			wakeUpPending = false;
+		}
+
+		for (auto it=newHandlers.begin(); it!=newHandlers.end(); ++it)
+			registerHandler(*it);
+		for (auto it=toNotify.begin(); it!=toNotify.end(); ++it)
+		{
+			if (handlers.find(*it) != handlers.end())
+				ready[*it] |= READY_NOTIFY;
+		}
+
+		// Every handler runs once, with all its events merged
+		for (auto it=ready.begin(); it!=ready.end(); ++it)
+		{
+			Handler* h = it->first;
+			if (h->process(it->second & READY_READ, it->second & READY_WRITE, it->second & READY_NOTIFY))
+				updateInterest(h);
+			else
+				removeHandler(h);
+		}
+		ready.clear();
+		newHandlers.clear();
+		toNotify.clear();
+
+		wait(ready);
+	}
+}
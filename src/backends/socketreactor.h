@@ -0,0 +1,100 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2011-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef BACKENDS_SOCKETREACTOR_H
+#define BACKENDS_SOCKETREACTOR_H 1
+
+#include <map>
+#include <set>
+#include <vector>
+#include "compat.h"
+#include "threading.h"
+
+namespace lightspark
+{
+
+/*
+ * Thread servicing all the connected sockets of a SystemState.
+ *
+ * The sockets are non-blocking and waited on together, with epoll on
+ * Linux and select elsewhere. Other threads ask for a handler to be
+ * run by calling notify(), notifications arriving before the reactor
+ * wakes up are merged, so a handler runs at most once per wake up.
+ */
+class SocketReactor
+{
+public:
+	class Handler
+	{
+	public:
+		virtual ~Handler() {}
+		virtual int fileDescriptor() const=0;
+		/*
+		   Called by the reactor thread when the socket is readable
+		   or writable, or when notify() has been called since the last
+		   run. Returns false when the handler is done, it is then
+		   unregistered and release() is called.
+		*/
+		virtual bool process(bool readable, bool writable, bool notified)=0;
+		// True if the handler has data waiting for the socket to be writable
+		virtual bool wantsWrite() const=0;
+		// Last call on the handler, it must delete itself
+		virtual void release()=0;
+	};
+private:
+	Mutex mutex;
+	Thread* thread;
+	bool stopping;
+	// Handlers added since the last wake up, protected by the mutex
+	std::vector<Handler*> added;
+	// Handlers added and not released yet, protected by the mutex
+	std::set<Handler*> known;
+	// Registered handlers with their current interest in writability,
+	// only used by the reactor thread
+	std::map<Handler*, bool> handlers;
+	// Handlers to run at the next wake up, protected by the mutex
+	std::set<Handler*> notified;
+	bool wakeUpPending;
+	// epoll instance, -1 if not used
+	int pollfd;
+	// Pipe waking up the reactor thread, -1 if not available
+	int wakeListener;
+	int wakeEmitter;
+	void worker();
+	void wakeUp();
+	void drainWakeUp();
+	void registerHandler(Handler* h);
+	void updateInterest(Handler* h);
+	void removeHandler(Handler* h);
+	// Waits for the sockets, collects the ready handlers with their flags
+	void wait(std::map<Handler*, int>& ready);
+	// Interval of the periodic wake up when there is no wake up pipe
+	static const int pollInterval=50;
+public:
+	SocketReactor();
+	~SocketReactor();
+	// Starts servicing the connected socket of h, the reactor takes ownership of h
+	void add(Handler* h);
+	// Runs h on the reactor thread, ignored if h is not registered
+	void notify(Handler* h);
+};
+
+};
+
+#endif /* BACKENDS_SOCKETREACTOR_H */
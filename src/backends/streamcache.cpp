@@ -19,13 +19,20 @@
 
 #include <string.h>
 #include <unistd.h>
+#include <algorithm>
 #include <glib.h>
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#endif
 #include "backends/streamcache.h"
 #include "backends/config.h"
 #include "exceptions.h"
 #include "logger.h"
 #include "netutils.h"
 #include "swf.h"
+#include "parsing/streams.h"
 
 using namespace std;
 using namespace lightspark;
@@ -43,7 +50,8 @@ size_t StreamCache::markFinished(bool _failed)
 
 	failed = _failed;
 	terminated = true;
-	sys->sendMainSignal();
+	if (sys)
+		sys->sendMainSignal();
 	return receivedLength;
 }
 
@@ -90,13 +98,19 @@ class lightspark::MemoryChunk {
 public:
 	MemoryChunk(size_t len);
 	~MemoryChunk();
-	unsigned char * const buffer;
+	// NULL when the chunk has been spilled
+	unsigned char * buffer;
 	const size_t capacity;
 	ACQUIRE_RELEASE_VARIABLE(size_t, used);
+	// Readers using the buffer, protected by the chunk list mutex
+	uint32_t pins;
+	// Position of the data in the spill file
+	size_t fileOffset;
+	bool isSpilled() const { return buffer == NULL; }
 };
 
 MemoryChunk::MemoryChunk(size_t len) :
-	buffer(new unsigned char[len]), capacity(len), used(0)
+	buffer(new unsigned char[len]), capacity(len), used(0), pins(0), fileOffset(0)
 {
 }
 
@@ -105,15 +119,78 @@ MemoryChunk::~MemoryChunk()
 	delete[] buffer;
 }
 
+StreamCacheBudget::StreamCacheBudget(size_t _limit):limit(_limit),used(0)
+{
+}
+
+void StreamCacheBudget::addCache(MemoryStreamCache* cache)
+{
+	Locker locker(mutex);
+	caches.push_back(cache);
+}
+
+void StreamCacheBudget::removeCache(MemoryStreamCache* cache, size_t length)
+{
+	Locker locker(mutex);
+	caches.remove(cache);
+	used -= length;
+}
+
+void StreamCacheBudget::allocated(size_t length)
+{
+	Locker locker(mutex);
+	used += length;
+	if (limit == 0)
+		return;
+
+	// Caches that have nothing left to spill
+	std::list<MemoryStreamCache*> exhausted;
+	while (used > limit)
+	{
+		MemoryStreamCache* victim = NULL;
+		size_t victimLength = 0;
+		for (auto it=caches.begin(); it!=caches.end(); ++it)
+		{
+			if (find(exhausted.begin(), exhausted.end(), *it) != exhausted.end())
+				continue;
+			size_t spillable = (*it)->getSpillableLength();
+			if (spillable > victimLength)
+			{
+				victim = *it;
+				victimLength = spillable;
+			}
+		}
+		if (victim == NULL)
+			break;
+
+		size_t freed = victim->spillChunk();
+		if (freed == 0)
+			exhausted.push_back(victim);
+		used -= freed;
+	}
+}
+
 MemoryStreamCache::MemoryStreamCache(SystemState* _sys):StreamCache(_sys),
-	writeChunk(NULL), nextChunkSize(0)
+	writeChunk(NULL), nextChunkSize(0), residentLength(0), spillFileLength(0), spillFailed(false)
 {
+	if (sys && sys->streamCacheBudget)
+	{
+		sys->streamCacheBudget->incRef();
+		budget = _MR(sys->streamCacheBudget);
+		budget->addCache(this);
+	}
 }
 
 MemoryStreamCache::~MemoryStreamCache()
 {
+	if (!budget.isNull())
+		budget->removeCache(this, residentLength);
 	for (auto it=chunks.begin(); it!=chunks.end(); ++it)
 		delete *it;
+	if (spillFile.is_open())
+		spillFile.close();
+	if (!spillFilename.empty())
+		unlink(spillFilename.raw_buf());
 }
 
 // Rounds val up to the next multiple of pow(2, s).
@@ -125,15 +202,99 @@ static size_t nextMultipleOf2Pow(size_t val, size_t s)
 void MemoryStreamCache::allocateChunk(size_t minLength)
 {
 	size_t len = imax(imax(minLength, minChunkSize), nextChunkSize);
+	// handleAppend spreads the data over several chunks if needed
+	bool spillable = !budget.isNull() && budget->getLimit() != 0;
+	if (spillable && len > maxSpillableChunkSize)
+		len = maxSpillableChunkSize;
 	len = nextMultipleOf2Pow(len, 12);
-	assert(len >= minLength);
+	assert(spillable || len >= minLength);
 	nextChunkSize = len;
 
 	{
 		Locker locker(chunkListMutex);
 		writeChunk = new MemoryChunk(len);
 		chunks.push_back(writeChunk);
+		residentLength += len;
+	}
+
+	if (!budget.isNull())
+		budget->allocated(len);
+}
+
+/**
+ * \brief Creates the temporary file receiving the spilled chunks
+ *
+ * Must be called with the chunk list mutex held.
+ */
+bool MemoryStreamCache::openSpillFile()
+{
+	std::string spillFilenameS = Config::getConfig()->getCacheDirectory() + "/" + Config::getConfig()->getCachePrefix() + "XXXXXX";
+	char* spillFilenameC = g_newa(char,spillFilenameS.length()+1);
+	strncpy(spillFilenameC, spillFilenameS.c_str(), spillFilenameS.length());
+	spillFilenameC[spillFilenameS.length()] = '\0';
+	int fd = g_mkstemp(spillFilenameC);
+	if (fd == -1)
+	{
+		LOG(LOG_ERROR, _("MemoryStreamCache: cannot create spill file, keeping the stream in memory"));
+		return false;
+	}
+	//We are using fstream to read/write the file, so we don't need this FD
+	close(fd);
+
+	spillFilename = tiny_string(spillFilenameC, true);
+	spillFile.open(spillFilename.raw_buf(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
+	if (!spillFile.is_open())
+	{
+		LOG(LOG_ERROR, _("MemoryStreamCache: cannot open spill file ") << spillFilename);
+		return false;
 	}
+	LOG(LOG_INFO, _("NET: Spilling stream to cache file: ") << spillFilename);
+	return true;
+}
+
+size_t MemoryStreamCache::getSpillableLength()
+{
+	Locker locker(chunkListMutex);
+	if (spillFailed)
+		return 0;
+	size_t writeLength = writeChunk && !writeChunk->isSpilled() ? writeChunk->capacity : 0;
+	return residentLength - writeLength;
+}
+
+size_t MemoryStreamCache::spillChunk()
+{
+	Locker locker(chunkListMutex);
+	if (spillFailed)
+		return 0;
+	for (auto it=chunks.begin(); it!=chunks.end(); ++it)
+	{
+		MemoryChunk* chunk = *it;
+		if (chunk->isSpilled() || chunk == writeChunk || chunk->pins > 0)
+			continue;
+
+		if (!spillFile.is_open() && !openSpillFile())
+		{
+			spillFailed = true;
+			return 0;
+		}
+		size_t used = ACQUIRE_READ(chunk->used);
+		spillFile.seekp(spillFileLength);
+		spillFile.write((const char*)chunk->buffer, used);
+		spillFile.flush();
+		if (spillFile.fail())
+		{
+			LOG(LOG_ERROR, _("MemoryStreamCache: cannot write spill file, keeping the stream in memory"));
+			spillFailed = true;
+			return 0;
+		}
+		chunk->fileOffset = spillFileLength;
+		spillFileLength += used;
+		delete[] chunk->buffer;
+		chunk->buffer = NULL;
+		residentLength -= chunk->capacity;
+		return chunk->capacity;
+	}
+	return 0;
 }
 
 void MemoryStreamCache::handleAppend(const unsigned char* data, size_t length)
@@ -193,11 +354,55 @@ void MemoryStreamCache::openForWriting()
 }
 
 MemoryStreamCache::Reader::Reader(_R<MemoryStreamCache> b) :
-	buffer(b), chunkIndex(0), chunkStartOffset(0)
+	buffer(b), chunkIndex(0), chunkStartOffset(0), currentChunk(NULL)
 {
 	setg(NULL, NULL, NULL);
 }
 
+MemoryStreamCache::Reader::~Reader()
+{
+	Locker locker(buffer->chunkListMutex);
+	if (currentChunk && !currentChunk->isSpilled())
+		currentChunk->pins--;
+}
+
+/**
+ * Set the get area to the data of chunk, starting at offset pos.
+ * A chunk in memory is pinned until the reader moves to another one,
+ * a spilled chunk is read back into spillBuffer.
+ */
+bool MemoryStreamCache::Reader::useChunk(MemoryChunk* chunk, size_t pos)
+{
+	if (chunk != currentChunk)
+	{
+		if (currentChunk && !currentChunk->isSpilled())
+			currentChunk->pins--;
+		currentChunk = NULL;
+		if (chunk->isSpilled())
+		{
+			size_t used = ACQUIRE_READ(chunk->used);
+			spillBuffer.resize(used);
+			buffer->spillFile.seekg(chunk->fileOffset);
+			buffer->spillFile.read((char*)&spillBuffer.front(), used);
+			if (buffer->spillFile.fail())
+			{
+				buffer->spillFile.clear();
+				LOG(LOG_ERROR, _("MemoryStreamCache: cannot read spill file ") << buffer->spillFilename);
+				setg(NULL, NULL, NULL);
+				return false;
+			}
+		}
+		else
+			chunk->pins++;
+		currentChunk = chunk;
+	}
+
+	unsigned char* data = chunk->isSpilled() ? &spillBuffer.front() : chunk->buffer;
+	size_t used = ACQUIRE_READ(chunk->used);
+	setg((char *)data, (char *)(data + pos), (char *)(data + used));
+	return true;
+}
+
 /**
  * \brief Called by the streambuf API
  *
@@ -229,19 +434,19 @@ int MemoryStreamCache::Reader::underflow()
 
 	MemoryChunk *chunk = buffer->chunks[chunkIndex];
 	size_t used = ACQUIRE_READ(chunk->used);
-	unsigned char *cursor;
-	unsigned char *end = chunk->buffer + used;
+	// Offset of the cursor in the chunk
+	size_t pos;
 
 	if (gptr() == NULL)
 	{
 		// On the first call gptr() is NULL (as set in the
 		// constructor). Nothing has been read yet.
-		cursor = chunk->buffer;
+		pos = 0;
 	}
-	else if ((unsigned char*)gptr() < end)
+	else if ((size_t)(gptr() - eback()) < used)
 	{
 		// Data left in this chunk
-		cursor = (unsigned char*)gptr();
+		pos = gptr() - eback();
 	}
 	else if (chunkIndex == buffer->chunks.size()-1)
 	{
@@ -261,14 +466,14 @@ int MemoryStreamCache::Reader::underflow()
 		assert_and_throw(chunkIndex < buffer->chunks.size());
 
 		chunk = buffer->chunks[chunkIndex];
-		cursor = chunk->buffer;
-		end = chunk->buffer + ACQUIRE_READ(chunk->used);
+		pos = 0;
 	}
 
-	setg((char *)chunk->buffer, (char *)cursor, (char *)end);
+	if (!useChunk(chunk, pos))
+		return EOF;
 
-	assert(cursor != end); // there is at least one byte to return
-	return (int)cursor[0];
+	assert(gptr() != egptr()); // there is at least one byte to return
+	return (int)(unsigned char)*gptr();
 }
 
 /**
@@ -321,18 +526,20 @@ streampos MemoryStreamCache::Reader::seekpos(streampos pos, std::ios_base::openm
 
 	Locker locker(buffer->chunkListMutex);
 	streampos offset = 0;
-	for (auto it=buffer->chunks.begin(); it!=buffer->chunks.end(); ++it)
+	for (unsigned int i=0; i<buffer->chunks.size(); i++)
 	{
-		streampos used = (streampos)ACQUIRE_READ((*it)->used);
+		MemoryChunk *chunk = buffer->chunks[i];
+		streampos used = (streampos)ACQUIRE_READ(chunk->used);
 		if (pos >= offset + used)
 		{
 			offset += used;
 		}
 		else
 		{
-			setg((char *)(*it)->buffer,
-			     (char *)((*it)->buffer + (pos - offset)),
-			     (char *)((*it)->buffer + used));
+			chunkIndex = i;
+			chunkStartOffset = offset;
+			if (!useChunk(chunk, pos - offset))
+				return -1;
 			return pos;
 		}
 	}
@@ -525,3 +732,123 @@ streamsize FileStreamCache::Reader::xsgetn(char* s, streamsize n)
 
 	return read;
 }
+
+class MappedFileStreamCache::Reader : public bytes_buf {
+private:
+	_R<MappedFileStreamCache> buffer;
+public:
+	Reader(_R<MappedFileStreamCache> b);
+	_NR<RefCountable> getOwner() const;
+};
+
+MappedFileStreamCache::Reader::Reader(_R<MappedFileStreamCache> b) :
+	bytes_buf(b->data, b->dataLength), buffer(b)
+{
+}
+
+_NR<RefCountable> MappedFileStreamCache::Reader::getOwner() const
+{
+	buffer->incRef();
+	return _MNR(buffer.getPtr());
+}
+
+MappedFileStreamCache::MappedFileStreamCache(SystemState* _sys):StreamCache(_sys),
+	data(NULL), dataLength(0), dataAllocated(false)
+{
+}
+
+MappedFileStreamCache::~MappedFileStreamCache()
+{
+	if (!data)
+		return;
+	if (dataAllocated)
+		delete[] data;
+#ifndef _WIN32
+	else
+		munmap((void*)data, dataLength);
+#endif
+}
+
+bool MappedFileStreamCache::mapFile(const tiny_string& filename)
+{
+	assert(!data && !terminated);
+	size_t length = 0;
+#ifndef _WIN32
+	int fd = open(filename.raw_buf(), O_RDONLY);
+	struct stat st;
+	if (fd != -1 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0 &&
+	    (uint64_t)st.st_size <= INT32_MAX)
+	{
+		length = st.st_size;
+		void* mapped = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (mapped != MAP_FAILED)
+		{
+			// The data is consumed mostly sequentially by the parser
+			madvise(mapped, length, MADV_SEQUENTIAL);
+			data = (const uint8_t*)mapped;
+		}
+	}
+	if (fd != -1)
+		close(fd);
+#endif
+	if (!data)
+	{
+		// Mapping is not available, read the whole file instead
+		std::ifstream file(filename.raw_buf(), std::ios::in|std::ios::binary);
+		if (!file.is_open())
+		{
+			LOG(LOG_ERROR, _("MappedFileStreamCache: cannot open file: ") << filename);
+			markFinished(true);
+			return false;
+		}
+		file.seekg(0, std::ios::end);
+		length = file.tellg();
+		file.seekg(0, std::ios::beg);
+		if (length > INT32_MAX)
+		{
+			LOG(LOG_ERROR, _("MappedFileStreamCache: file too large: ") << filename);
+			markFinished(true);
+			return false;
+		}
+		uint8_t* buf = new uint8_t[length];
+		file.read((char*)buf, length);
+		if ((size_t)file.gcount() != length)
+		{
+			delete[] buf;
+			LOG(LOG_ERROR, _("MappedFileStreamCache: reading file failed: ") << filename);
+			markFinished(true);
+			return false;
+		}
+		data = buf;
+		dataAllocated = true;
+	}
+	dataLength = length;
+
+	{
+		Locker locker(stateMutex);
+		receivedLength = length;
+	}
+	// We already have the whole file
+	markFinished();
+	return true;
+}
+
+void MappedFileStreamCache::handleAppend(const unsigned char* buffer, size_t length)
+{
+	LOG(LOG_ERROR,"MappedFileStreamCache is read only");
+}
+
+void MappedFileStreamCache::openForWriting()
+{
+	LOG(LOG_ERROR,"openForWriting not implemented in MappedFileStreamCache");
+}
+
+std::streambuf *MappedFileStreamCache::createReader()
+{
+	// The data is available only after mapFile() has been called,
+	// possibly by a downloader thread
+	waitForTermination();
+
+	incRef();
+	return new MappedFileStreamCache::Reader(_MR(this));
+}
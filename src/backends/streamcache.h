@@ -21,6 +21,7 @@
 #define BACKENDS_STREAMCACHE_H 1
 
 #include <list>
+#include <vector>
 #include <istream>
 #include <fstream>
 #include <cstdint>
@@ -100,11 +101,45 @@ public:
 };
 
 class MemoryChunk;
+class MemoryStreamCache;
+
+/*
+ * Bounds the memory used by all the MemoryStreamCaches of a
+ * SystemState. When the limit is exceeded the oldest chunks of the
+ * caches holding the most memory are moved to disk.
+ *
+ * Caches keep a reference to the budget, it can outlive the
+ * SystemState.
+ */
+class DLL_PUBLIC StreamCacheBudget : public RefCountable {
+private:
+	Mutex mutex;
+	std::list<MemoryStreamCache*> caches;
+	// Bytes allowed in memory, 0 means unlimited
+	const size_t limit;
+	size_t used;
+public:
+	StreamCacheBudget(size_t _limit);
+	size_t getLimit() const { return limit; }
+	void addCache(MemoryStreamCache* cache);
+	// Forgets cache and the length bytes it still holds in memory
+	void removeCache(MemoryStreamCache* cache, size_t length);
+	// Accounts for a new allocation of a cache, spilling
+	// chunks to disk if the limit is exceeded. Must be called
+	// without holding any lock of the caches.
+	void allocated(size_t length);
+};
 
 /*
  * MemoryStreamCache buffers the stream in memory.
+ *
+ * If the SystemState limits the memory used by the caches, the
+ * older chunks can be moved to a temporary file (spilled) and
+ * are read back from there by the readers. The chunks that are
+ * being read stay in memory.
  */
 class DLL_PUBLIC MemoryStreamCache : public StreamCache {
+friend class StreamCacheBudget;
 private:
 	class DLL_LOCAL Reader : public std::streambuf {
 	private:
@@ -113,7 +148,15 @@ private:
 		unsigned int chunkIndex;
 		// Offset at the start of current chunk
 		size_t chunkStartOffset;
-
+		// The chunk the get area points to, pinned in memory
+		// unless it was already spilled
+		MemoryChunk* currentChunk;
+		// Copy of currentChunk when it is read back from disk
+		std::vector<unsigned char> spillBuffer;
+
+		// Points the get area at offset pos of chunk, the chunk
+		// list mutex must be held
+		bool useChunk(MemoryChunk* chunk, size_t pos);
 		// Handles streambuf out-of-data events
 		virtual int underflow();
 		// Seeks to absolute position
@@ -124,12 +167,14 @@ private:
 		std::streampos getOffset() const;
 	public:
 		Reader(_R<MemoryStreamCache> b);
+		~Reader();
 	};
 
 	// Stream is stored into a sequence of memory chunks. The
 	// chunks can grow, but they are never moved, so both readers
 	// and writer can safely use them. However, the mutex must be
-	// held when the container is accessed.
+	// held when the container is accessed. A chunk is only
+	// spilled when it is not written nor read.
 	Mutex chunkListMutex;
 	std::vector<MemoryChunk *> chunks;
 
@@ -139,9 +184,27 @@ private:
 	// Variables controlling the memory allocation
 	size_t nextChunkSize;
 	static const size_t minChunkSize = 4*4096;
+	// Chunks are kept small when they can be spilled
+	static const size_t maxSpillableChunkSize = 1024*1024;
+
+	// NULL if the memory used is not limited
+	_NR<StreamCacheBudget> budget;
+	// Bytes of chunks held in memory, protected by chunkListMutex
+	size_t residentLength;
+	// Temporary file holding the spilled chunks, protected by chunkListMutex
+	std::fstream spillFile;
+	tiny_string spillFilename;
+	size_t spillFileLength;
+	bool spillFailed:1;
 
 	// Allocate a new chunk, append it to chunks, update writeChunk
 	void allocateChunk(size_t minLength) DLL_LOCAL;
+	bool openSpillFile() DLL_LOCAL;
+	// Bytes that spillChunk could free
+	size_t getSpillableLength() DLL_LOCAL;
+	// Moves the oldest chunk that is not in use to disk,
+	// returns the bytes freed
+	size_t spillChunk() DLL_LOCAL;
 
 	virtual void handleAppend(const unsigned char* buffer, size_t length) DLL_LOCAL;
 
@@ -200,6 +263,46 @@ public:
 	void openForWriting();
 };
 
+/*
+ * MappedFileStreamCache maps an existing local file into memory.
+ *
+ * Readers created by createReader() read directly from the mapped
+ * region, nothing is copied into the cache. The region stays valid as
+ * long as a reference to the cache is held, so parsers can keep
+ * pointers into it (see bytes_buf::getOwner()).
+ *
+ * The whole file is available as soon as mapFile() returns, so readers
+ * never wait for data. Because of that the cache can also be used
+ * before a SystemState exists, in which case _sys may be NULL.
+ */
+class DLL_PUBLIC MappedFileStreamCache : public StreamCache {
+private:
+	class DLL_LOCAL Reader;
+
+	const uint8_t* data;
+	size_t dataLength;
+	// True when the file could not be mapped and data was read into
+	// memory allocated with new[] instead
+	bool dataAllocated:1;
+
+	virtual void handleAppend(const unsigned char* buffer, size_t length) DLL_LOCAL;
+
+public:
+	MappedFileStreamCache(SystemState* _sys);
+	virtual ~MappedFileStreamCache();
+
+	// Map an existing file as the whole content of the stream.
+	// Must be called only once. Returns false and marks the
+	// stream as failed if the file could not be opened.
+	bool mapFile(const tiny_string& filename);
+	const uint8_t* getData() const { return data; }
+
+	// The returned streambuf is a bytes_buf over the mapped region
+	virtual std::streambuf *createReader();
+
+	void openForWriting();
+};
+
 }
 
 #endif // BACKENDS_STREAMCACHE_H
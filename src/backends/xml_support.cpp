@@ -22,11 +22,88 @@
 #include "scripting/abc.h"
 #include "scripting/toplevel/Error.h"
 #include "scripting/class.h"
+#include <algorithm>
+#include <limits>
 
 using namespace lightspark;
 using namespace std;
 
-const pugi::xml_node XMLBase::buildFromString(const tiny_string& str,
+static tiny_string localName(const char* name)
+{
+	const char* sep = strchr(name,':');
+	return tiny_string(sep ? sep+1 : name,true);
+}
+
+void XMLSharedDocument::buildIndex()
+{
+	indexBuilt = true;
+	indexUsable = false;
+	// walk the tree in document order without recursion, deep documents are common
+	pugi::xml_node node = doc.first_child();
+	while (node)
+	{
+		if (node.type() == pugi::node_element)
+		{
+			ptrdiff_t offset = node.offset_debug();
+			if (offset < 0)
+			{
+				// the tree doesn't match the parsed buffer, subtreeMayContain will always answer true
+				elementIndex.clear();
+				attributeIndex.clear();
+				return;
+			}
+			elementIndex[localName(node.name())].push_back(offset);
+			for (pugi::xml_attribute attr = node.first_attribute(); attr; attr = attr.next_attribute())
+			{
+				if (strcmp(attr.name(),"xmlns") == 0 || strncmp(attr.name(),"xmlns:",6) == 0)
+					continue;
+				attributeIndex[localName(attr.name())].push_back(offset);
+			}
+		}
+		if (node.first_child())
+		{
+			node = node.first_child();
+			continue;
+		}
+		while (node && !node.next_sibling())
+			node = node.parent();
+		if (node)
+			node = node.next_sibling();
+	}
+	indexUsable = true;
+}
+
+bool XMLSharedDocument::containsOffset(const std::vector<ptrdiff_t>& offsets, ptrdiff_t start, ptrdiff_t end)
+{
+	auto it = std::upper_bound(offsets.begin(),offsets.end(),start);
+	return it != offsets.end() && *it < end;
+}
+
+bool XMLSharedDocument::subtreeMayContain(const pugi::xml_node& node, const tiny_string& localname, bool isAttribute)
+{
+	if (!indexBuilt)
+		buildIndex();
+	if (!indexUsable)
+		return true;
+	ptrdiff_t start = node.offset_debug();
+	if (start < 0)
+		return true;
+	// the subtree ends where the next node in document order begins
+	pugi::xml_node next = node;
+	while (next && !next.next_sibling())
+		next = next.parent();
+	ptrdiff_t end = next ? next.next_sibling().offset_debug() : numeric_limits<ptrdiff_t>::max();
+	if (end < 0)
+		return true;
+	auto& index = isAttribute ? attributeIndex : elementIndex;
+	auto it = index.find(localname);
+	if (it == index.end())
+		return false;
+	return containsOffset(it->second,start,end);
+}
+
+const pugi::xml_node XMLBase::buildFromString(pugi::xml_document& xmldoc,
+										const tiny_string& str,
 										unsigned int xmlparsemode,
 										const tiny_string& default_ns)
 {
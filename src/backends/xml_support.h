@@ -21,10 +21,43 @@
 #define BACKENDS_XML_SUPPORT_H 1
 
 #include "tiny_string.h"
+#include "smartrefs.h"
 #include <3rdparty/pugixml/src/pugixml.hpp>
+#include <unordered_map>
+#include <vector>
 namespace lightspark
 {
 
+/*
+ * A parsed document shared by all the toplevel XML objects created from it.
+ * The XML objects for the children of an element are only created when they
+ * are first accessed, until then the nodes exist only in this tree.
+ */
+class XMLSharedDocument: public RefCountable
+{
+private:
+	// Local element and attribute names mapped to the source offsets of the
+	// elements using them, in document order
+	std::unordered_map<tiny_string, std::vector<ptrdiff_t>> elementIndex;
+	std::unordered_map<tiny_string, std::vector<ptrdiff_t>> attributeIndex;
+	bool indexBuilt;
+	bool indexUsable;
+	void buildIndex();
+	static bool containsOffset(const std::vector<ptrdiff_t>& offsets, ptrdiff_t start, ptrdiff_t end);
+public:
+	pugi::xml_document doc;
+	// settings in effect when the document was parsed, used when its nodes are created later
+	uint32_t defaultNamespace;
+	bool ignoreWhitespace;
+	XMLSharedDocument(uint32_t defaultns, bool ignorews):indexBuilt(false),indexUsable(false),defaultNamespace(defaultns),ignoreWhitespace(ignorews){}
+	/*
+	 * Returns false if no element (or attribute, if isAttribute is set)
+	 * with the given local name exists below node.
+	 * May return true even if there is none.
+	 */
+	bool subtreeMayContain(const pugi::xml_node& node, const tiny_string& localname, bool isAttribute);
+};
+
 
 /*
  * Base class for both XML and XMLNode
@@ -32,9 +65,8 @@ namespace lightspark
 class XMLBase
 {
 protected:
-	//The parser will destroy the document and all the childs on destruction
-	pugi::xml_document xmldoc;
-	const pugi::xml_node buildFromString(const tiny_string& str,
+	static const pugi::xml_node buildFromString(pugi::xml_document& xmldoc,
+										const tiny_string& str,
 										unsigned int xmlparsemode,
 										const tiny_string& default_ns=tiny_string());
 
@@ -173,6 +173,25 @@ uint64_t compat_msectiming();
 void compat_msleep(unsigned int time);
 uint64_t compat_get_thread_cputime_us();
 
+/* threads */
+
+/* Returns a value that identifies the calling thread and is never NULL.
+ * Values of terminated threads may be reused */
+#if defined(__has_builtin)
+#	if __has_builtin(__builtin_thread_pointer) && (defined(__x86_64__) || defined(__i386__) || defined(__aarch64__))
+#		define HAVE_BUILTIN_THREAD_POINTER 1
+#	endif
+#endif
+inline const void* compat_thread_token()
+{
+#ifdef HAVE_BUILTIN_THREAD_POINTER
+	return __builtin_thread_pointer();
+#else
+	static thread_local char token;
+	return &token;
+#endif
+}
+
 /* byte order */
 #if G_BYTE_ORDER == G_BIG_ENDIAN
 
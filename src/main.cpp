@@ -20,6 +20,7 @@
 #include "version.h"
 #include "backends/security.h"
 #include "backends/config.h"
+#include "backends/streamcache.h"
 #include "swf.h"
 #include "logger.h"
 #include "platforms/engineutils.h"
@@ -357,15 +358,17 @@ int main(int argc, char* argv[])
 	}
 
 	Log::setLogLevel(log_level);
-	ifstream f(fileName, ios::in|ios::binary);
-	f.seekg(0, ios::end);
-	uint32_t fileSize=f.tellg();
-	f.seekg(0, ios::beg);
-	if(!f)
+	//The file is mapped and parsed in place. Tags keeping references
+	//into the mapping hold the cache alive, so it may outlive the reader
+	_R<MappedFileStreamCache> swfCache=_MR(new MappedFileStreamCache(NULL));
+	if(!swfCache->mapFile(fileName))
 	{
 		LOG(LOG_ERROR, argv[0] << ": " << fileName << ": No such file or directory");
 		exit(2);
 	}
+	uint32_t fileSize=swfCache->getReceivedLength();
+	streambuf* swfBuf=swfCache->createReader();
+	istream f(swfBuf);
 	f.exceptions ( istream::eofbit | istream::failbit | istream::badbit );
 	cout.exceptions( ios::failbit | ios::badbit);
 	cerr.exceptions( ios::failbit | ios::badbit);
@@ -460,6 +463,7 @@ int main(int argc, char* argv[])
 	EngineData::mainLoopThread->join();
 
 	delete pt;
+	delete swfBuf;
 	delete sys;
 
 	SystemState::staticDeinit();
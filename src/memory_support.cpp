@@ -17,10 +17,160 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 **************************************************************************/
 
+#include <cstring>
+#include <new>
 #include "memory_support.h"
 #include "swf.h"
 
+//Size classes are multiples of SLAB_GRANULARITY up to SLAB_MAX_SIZE
+#define SLAB_GRANULARITY 16
+#define SLAB_MAX_SIZE 1024
+#define SLAB_CLASSES (SLAB_MAX_SIZE/SLAB_GRANULARITY)
+#define SLAB_CHUNK_SIZE (64*1024)
+//Blocks moved between a thread cache and the global lists at once
+#define SLAB_BATCH 64
+//A thread cache keeping more blocks of a size class gives a batch back
+#define SLAB_CACHE_LIMIT (4*SLAB_BATCH)
+
 using namespace lightspark;
+
+namespace
+{
+struct slabBlock
+{
+	slabBlock* next;
+};
+
+StaticMutex slabMutex;
+slabBlock* globalSlabs[SLAB_CLASSES];
+
+//Blocks freed by static destructors after the thread cache is gone go to the global lists.
+//The flag is trivially destructible, so it can still be read after threadSlabs is destroyed
+thread_local bool threadSlabsDestroyed=false;
+
+struct slabCache
+{
+	slabBlock* blocks[SLAB_CLASSES];
+	uint32_t count[SLAB_CLASSES];
+	slabCache()
+	{
+		memset(blocks,0,sizeof(blocks));
+		memset(count,0,sizeof(count));
+	}
+	~slabCache()
+	{
+		Locker l(slabMutex);
+		for(uint32_t c=0;c<SLAB_CLASSES;c++)
+		{
+			while(blocks[c])
+			{
+				slabBlock* b=blocks[c];
+				blocks[c]=b->next;
+				b->next=globalSlabs[c];
+				globalSlabs[c]=b;
+			}
+			count[c]=0;
+		}
+		threadSlabsDestroyed=true;
+	}
+};
+
+thread_local slabCache threadSlabs;
+
+//Fills the thread cache from the global list, or with a new chunk
+void refillSlabCache(slabCache& cache, uint32_t c)
+{
+	{
+		Locker l(slabMutex);
+		for(uint32_t i=0;i<SLAB_BATCH && globalSlabs[c];i++)
+		{
+			slabBlock* b=globalSlabs[c];
+			globalSlabs[c]=b->next;
+			b->next=cache.blocks[c];
+			cache.blocks[c]=b;
+			cache.count[c]++;
+		}
+	}
+	if(cache.blocks[c])
+		return;
+	uint32_t blocksize=(c+1)*SLAB_GRANULARITY;
+	char* chunk=reinterpret_cast<char*>(malloc(SLAB_CHUNK_SIZE));
+	if(chunk==NULL)
+		throw std::bad_alloc();
+	for(uint32_t offset=0;offset+blocksize<=SLAB_CHUNK_SIZE;offset+=blocksize)
+	{
+		slabBlock* b=reinterpret_cast<slabBlock*>(chunk+offset);
+		b->next=cache.blocks[c];
+		cache.blocks[c]=b;
+		cache.count[c]++;
+	}
+}
+}
+
+void* slab_allocator::allocate(size_t size)
+{
+	if(size>SLAB_MAX_SIZE)
+	{
+		void* ret=malloc(size);
+		if(ret==NULL)
+			throw std::bad_alloc();
+		return ret;
+	}
+	uint32_t c=size ? (size-1)/SLAB_GRANULARITY : 0;
+	if(threadSlabsDestroyed)
+	{
+		Locker l(slabMutex);
+		slabBlock* b=globalSlabs[c];
+		if(b)
+		{
+			globalSlabs[c]=b->next;
+			return b;
+		}
+		//Late allocations are rare, they don't need to be recycled
+		return malloc((c+1)*SLAB_GRANULARITY);
+	}
+	slabCache& cache=threadSlabs;
+	if(cache.blocks[c]==NULL)
+		refillSlabCache(cache,c);
+	slabBlock* b=cache.blocks[c];
+	cache.blocks[c]=b->next;
+	cache.count[c]--;
+	return b;
+}
+
+void slab_allocator::deallocate(void* p, size_t size)
+{
+	if(size>SLAB_MAX_SIZE)
+	{
+		free(p);
+		return;
+	}
+	uint32_t c=size ? (size-1)/SLAB_GRANULARITY : 0;
+	slabBlock* b=reinterpret_cast<slabBlock*>(p);
+	if(threadSlabsDestroyed)
+	{
+		Locker l(slabMutex);
+		b->next=globalSlabs[c];
+		globalSlabs[c]=b;
+		return;
+	}
+	slabCache& cache=threadSlabs;
+	b->next=cache.blocks[c];
+	cache.blocks[c]=b;
+	cache.count[c]++;
+	if(cache.count[c]>SLAB_CACHE_LIMIT)
+	{
+		Locker l(slabMutex);
+		for(uint32_t i=0;i<SLAB_BATCH;i++)
+		{
+			b=cache.blocks[c];
+			cache.blocks[c]=b->next;
+			b->next=globalSlabs[c];
+			globalSlabs[c]=b;
+		}
+		cache.count[c]-=SLAB_BATCH;
+	}
+}
 #ifdef MEMORY_USAGE_PROFILING
 MemoryAccount* lightspark::getUnaccountedMemoryAccount()
 {
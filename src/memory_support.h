@@ -27,6 +27,21 @@
 namespace lightspark
 {
 
+/*
+ * Allocator for the objects deriving from memory_reporter.
+ * Small sizes are rounded up to size classes of 16 bytes and carved from
+ * 64KB chunks. Freed blocks are cached per thread, caches exceeding their
+ * limit give blocks back to a global list in batches. Chunks are never
+ * returned to the system. Bigger objects use malloc.
+ */
+class slab_allocator
+{
+public:
+	static DLL_PUBLIC void* allocate(size_t size);
+	// size must be the size passed to allocate
+	static DLL_PUBLIC void deallocate(void* p, size_t size);
+};
+
 #ifdef MEMORY_USAGE_PROFILING
 class MemoryAccount;
 DLL_PUBLIC MemoryAccount* getUnaccountedMemoryAccount();
@@ -75,7 +90,7 @@ public:
 		//Prepend some internal data.
 		//Adding the data to the object itself would not work
 		//since it can be reset by the constructors
-		objData* ret=reinterpret_cast<objData*>(malloc(size+sizeof(objData)));
+		objData* ret=reinterpret_cast<objData*>(slab_allocator::allocate(size+sizeof(objData)));
 		if(!m)
 			m = getUnaccountedMemoryAccount();
 		m->addBytes(size);
@@ -88,7 +103,7 @@ public:
 		//Get back the metadata
 		objData* th=reinterpret_cast<objData*>(obj)-1;
 		th->memoryAccount->removeBytes(th->objSize);
-		free(th);
+		slab_allocator::deallocate(th,th->objSize+sizeof(objData));
 	}
 };
 
@@ -183,11 +198,13 @@ public:
 	//Regular allocator
 	inline void* operator new( size_t size, MemoryAccount* m)
 	{
-		return malloc(size);
+		return slab_allocator::allocate(size);
 	}
-	inline void operator delete( void* obj )
+	//The size of the dynamic type is passed as the destructors are virtual,
+	//so no header is needed to find the size class
+	inline void operator delete( void* obj, size_t size )
 	{
-		free(obj);
+		slab_allocator::deallocate(obj,size);
 	}
 };
 
@@ -58,13 +58,10 @@ asAtom Amf3Deserializer::parseDouble() const
 		uint64_t dummy;
 		double val;
 	} tmp;
-	uint8_t* tmpPtr=reinterpret_cast<uint8_t*>(&tmp.dummy);
-
-	for(uint32_t i=0;i<8;i++)
-	{
-		if(!input->readByte(tmpPtr[i]))
-			throw ParseException("Not enough data to parse double");
-	}
+	const uint8_t* data=input->consumeBytes(8);
+	if(!data)
+		throw ParseException("Not enough data to parse double");
+	memcpy(&tmp.dummy,data,8);
 	tmp.dummy=GINT64_FROM_BE(tmp.dummy);
 	
 	return asAtomHandler::fromNumber(input->getSystemState(),tmp.val,false);
@@ -77,13 +74,10 @@ asAtom Amf3Deserializer::parseDate() const
 		uint64_t dummy;
 		double val;
 	} tmp;
-	uint8_t* tmpPtr=reinterpret_cast<uint8_t*>(&tmp.dummy);
-
-	for(uint32_t i=0;i<8;i++)
-	{
-		if(!input->readByte(tmpPtr[i]))
-			throw ParseException("Not enough data to parse date");
-	}
+	const uint8_t* data=input->consumeBytes(8);
+	if(!data)
+		throw ParseException("Not enough data to parse date");
+	memcpy(&tmp.dummy,data,8);
 	tmp.dummy=GINT64_FROM_BE(tmp.dummy);
 	Date* dt = Class<Date>::getInstanceS(input->getSystemState());
 	dt->MakeDateFromMilliseconds((int64_t)tmp.val);
@@ -105,14 +99,10 @@ tiny_string Amf3Deserializer::parseStringVR(std::vector<tiny_string>& stringMap)
 	}
 
 	uint32_t strLen=strRef>>1;
-	string retStr;
-	for(uint32_t i=0;i<strLen;i++)
-	{
-		uint8_t c;
-		if(!input->readByte(c))
-			throw ParseException("Not enough data to parse string");
-		retStr.push_back(c);
-	}
+	const uint8_t* strData=input->consumeBytes(strLen);
+	if(!strData)
+		throw ParseException("Not enough data to parse string");
+	string retStr((const char*)strData,strLen);
 	//Add string to the map, if it's not the empty one
 	if(retStr.size())
 		stringMap.emplace_back(retStr);
@@ -227,43 +217,50 @@ asAtom Amf3Deserializer::parseVector(uint8_t marker, std::vector<tiny_string>& s
 	
 	int32_t count = vectorRef >> 1;
 
-	for(int32_t i=0;i<count;i++)
+	if (marker != vector_object_marker)
 	{
-		switch (marker)
+		//Numeric vectors are read in one go from the input buffer
+		const uint32_t elemSize = (marker == vector_double_marker) ? 8 : 4;
+		if ((uint64_t)count*elemSize > UINT32_MAX)
+			throw ParseException("Not enough data to parse AMF3 vector");
+		const uint8_t* data=input->consumeBytes(count*elemSize);
+		if (!data)
+			throw ParseException("Not enough data to parse AMF3 vector");
+		ret->reserve(count);
+		for(int32_t i=0;i<count;i++,data+=elemSize)
 		{
-			case vector_int_marker:
+			if (marker == vector_double_marker)
 			{
-				uint32_t value = 0;
-				if (!input->readUnsignedInt(value))
-					throw ParseException("Not enough data to parse AMF3 vector");
-				asAtom v=asAtomHandler::fromInt((int32_t)value);
-				ret->append(v);
-				break;
+				union
+				{
+					uint64_t dummy;
+					double val;
+				} tmp;
+				memcpy(&tmp.dummy,data,8);
+				tmp.dummy=GINT64_FROM_BE(tmp.dummy);
+				ret->appendNumber(tmp.val);
 			}
-			case vector_uint_marker:
+			else
 			{
-				uint32_t value = 0;
-				if (!input->readUnsignedInt(value))
-					throw ParseException("Not enough data to parse AMF3 vector");
-				asAtom v=asAtomHandler::fromUInt(value);
-				ret->append(v);
-				break;
-			}
-			case vector_double_marker:
-			{
-				asAtom v = parseDouble();
-				ret->append(v);
-				break;
-			}
-			case vector_object_marker:
-			{
-				asAtom value=parseValue(stringMap, objMap, traitsMap);
-				ASATOM_INCREF(value);
-				ret->append(value);
-				break;
+				uint32_t value;
+				memcpy(&value,data,4);
+				value=input->endianOut(value);
+				if (marker == vector_int_marker)
+					ret->appendInt((int32_t)value);
+				else
+					ret->appendUInt(value);
 			}
 		}
 	}
+	else
+	{
+		for(int32_t i=0;i<count;i++)
+		{
+			asAtom value=parseValue(stringMap, objMap, traitsMap);
+			ASATOM_INCREF(value);
+			ret->append(value);
+		}
+	}
 	// set fixed at last to avoid rangeError
 	ret->setFixed(b == 0x01);
 	return asAtomHandler::fromObject(ret);
@@ -340,13 +337,11 @@ asAtom Amf3Deserializer::parseByteArray(std::vector<tiny_string>& stringMap,
 	
 	int32_t count = bytearrayRef >> 1;
 
-	for(int32_t i=0;i<count;i++)
-	{
-		uint8_t b;
-		if (!input->readByte(b))
-			throw ParseException("Not enough data to parse AMF3 bytearray");
-		ret->writeByte(b);
-	}
+	const uint8_t* data=input->consumeBytes(count);
+	if (!data)
+		throw ParseException("Not enough data to parse AMF3 bytearray");
+	if (count)
+		memcpy(ret->reserveBytes(count),data,count);
 	return asAtomHandler::fromObject(ret);
 }
 
@@ -396,53 +391,84 @@ asAtom Amf3Deserializer::parseObject(std::vector<tiny_string>& stringMap,
 		return ret;
 	}
 
-	TraitsRef traits(NULL);
+	//traitsMap may grow while the values are parsed, so the traits
+	//are accessed by index
+	uint32_t traitsIndex;
 	if((objRef&0x02)==0)
 	{
-		uint32_t traitsRef=objRef>>2;
-		if(traitsMap.size() <= traitsRef)
+		traitsIndex=objRef>>2;
+		if(traitsMap.size() <= traitsIndex)
 			throw ParseException("Invalid traits reference in AMF3 data");
-		traits=traitsMap[traitsRef];
 	}
 	else
 	{
+		TraitsRef traits(NULL);
 		traits.dynamic = objRef&0x08;
 		uint32_t traitsCount=objRef>>4;
 		const tiny_string& className=parseStringVR(stringMap);
 		//Add the type to the traitsMap
 		for(uint32_t i=0;i<traitsCount;i++)
-			traits.traitsNames.emplace_back(parseStringVR(stringMap));
+			traits.traitsNames.push_back(input->getSystemState()->getUniqueStringId(parseStringVR(stringMap)));
 
 		const auto it=input->getSystemState()->aliasMap.find(className);
 		if(it!=input->getSystemState()->aliasMap.end())
 			traits.type=it->second.getPtr();
-		traitsMap.emplace_back(traits);
+		traitsIndex=traitsMap.size();
+		traitsMap.push_back(std::move(traits));
 	}
 
+	Class_base* type=traitsMap[traitsIndex].type;
+	const bool dynamic=traitsMap[traitsIndex].dynamic;
+	const uint32_t traitsCount=traitsMap[traitsIndex].traitsNames.size();
 	asAtom ret=asAtomHandler::invalidAtom;
-	if (traits.type)
-		traits.type->getInstance(ret,true, NULL, 0);
+	if (type)
+		type->getInstance(ret,true, NULL, 0);
 	else
 		ret =asAtomHandler::fromObject(Class<ASObject>::getInstanceS(input->getSystemState()));
 	//Add object to the map
 	objMap.push_back(ret);
+	ASObject* obj=asAtomHandler::getObject(ret);
+
+	multiname name(NULL);
+	name.name_type=multiname::NAME_STRING;
+	name.ns.push_back(nsNameAndKind(input->getSystemState(),"",NAMESPACE));
+	name.isAttribute=false;
+	if (type && !traitsMap[traitsIndex].slotsResolved)
+	{
+		//Plain variables of the class are written directly into their slots
+		TraitsRef& traits=traitsMap[traitsIndex];
+		for(uint32_t i=0;i<traitsCount;i++)
+		{
+			name.name_s_id=traits.traitsNames[i];
+			bool isborrowed=false;
+			variable* v=obj->findVariableByMultiname(name,type,nullptr,&isborrowed);
+			if (v && !isborrowed && v->kind==DECLARED_TRAIT && v->slotid && asAtomHandler::isInvalid(v->setter))
+				traits.traitsSlots.push_back(v->slotid);
+			else
+				traits.traitsSlots.push_back(0);
+		}
+		traits.slotsResolved=true;
+	}
 
-	for(uint32_t i=0;i<traits.traitsNames.size();i++)
+	for(uint32_t i=0;i<traitsCount;i++)
 	{
 		asAtom value=parseValue(stringMap, objMap, traitsMap);
 		ASATOM_INCREF(value);
 
-		multiname name(NULL);
-		name.name_type=multiname::NAME_STRING;
-		name.name_s_id=input->getSystemState()->getUniqueStringId(traits.traitsNames[i]);
-		name.ns.push_back(nsNameAndKind(input->getSystemState(),"",NAMESPACE));
-		name.isAttribute=false;
-			
-		asAtomHandler::getObject(ret)->setVariableByMultiname_intern(name,value,ASObject::CONST_ALLOWED,traits.type,nullptr);
+		const TraitsRef& traits=traitsMap[traitsIndex];
+		uint32_t slot=type ? traits.traitsSlots[i] : 0;
+		if (slot)
+		{
+			if (!obj->setSlot(slot,value))
+				ASATOM_DECREF(value);
+			continue;
+		}
+		name.name_s_id=traits.traitsNames[i];
+		obj->setVariableByMultiname_intern(name,value,ASObject::CONST_ALLOWED,type,nullptr);
 	}
 
 	//Read dynamic name, value pairs
-	while(traits.dynamic)
+	while(dynamic)
 	{
 		const tiny_string& varName=parseStringVR(stringMap);
 		if(varName=="")
@@ -471,14 +497,10 @@ asAtom Amf3Deserializer::parseXML(std::vector<asAtom>& objMap, bool legacyXML) c
 	}
 
 	uint32_t strLen=xmlRef>>1;
-	string xmlStr;
-	for(uint32_t i=0;i<strLen;i++)
-	{
-		uint8_t c;
-		if(!input->readByte(c))
-			throw ParseException("Not enough data to parse string");
-		xmlStr.push_back(c);
-	}
+	const uint8_t* strData=input->consumeBytes(strLen);
+	if(!strData)
+		throw ParseException("Not enough data to parse string");
+	string xmlStr((const char*)strData,strLen);
 
 	ASObject *xmlObj;
 	if(legacyXML)
@@ -590,15 +612,10 @@ tiny_string Amf3Deserializer::parseStringAMF0() const
 	if(!input->readShort(strLen))
 		throw ParseException("Not enough data to parse integer");
 	
-	string retStr;
-	for(uint32_t i=0;i<strLen;i++)
-	{
-		uint8_t c;
-		if(!input->readByte(c))
-			throw ParseException("Not enough data to parse string");
-		retStr.push_back(c);
-	}
-	return retStr;
+	const uint8_t* strData=input->consumeBytes(strLen);
+	if(!strData)
+		throw ParseException("Not enough data to parse string");
+	return string((const char*)strData,strLen);
 }
 asAtom Amf3Deserializer::parseECMAArrayAMF0(std::vector<tiny_string>& stringMap,
 			std::vector<asAtom>& objMap,
@@ -82,9 +82,14 @@ class TraitsRef
 {
 public:
 	Class_base* type;
-	std::vector<tiny_string> traitsNames;
+	// Unique string ids of the sealed trait names
+	std::vector<uint32_t> traitsNames;
+	// Slot of each sealed trait in instances of type, 0 if the
+	// trait has to be set by name. Resolved on the first instance
+	std::vector<uint32_t> traitsSlots;
 	bool dynamic;
-	TraitsRef(Class_base* t):type(t),dynamic(false){}
+	bool slotsResolved;
+	TraitsRef(Class_base* t):type(t),dynamic(false),slotsResolved(false){}
 };
 
 class Amf3Deserializer
@@ -255,3 +255,66 @@ AudioDataTag::~AudioDataTag()
 	if (packetData)
 		aligned_free(packetData);
 }
+
+void FLVKeyframeIndex::addKeyframe(uint32_t time, uint64_t offset)
+{
+	//Keyframes from onMetaData may already cover this part of the stream
+	if(!keyframes.empty() && keyframes.back().offset>=offset)
+		return;
+	Keyframe k;
+	k.time=time;
+	k.offset=offset;
+	keyframes.push_back(k);
+}
+
+void FLVKeyframeIndex::setIndexedOffset(uint64_t offset)
+{
+	if(offset>indexedOffset)
+		indexedOffset=offset;
+}
+
+void FLVKeyframeIndex::scan(istream& s, uint64_t limit, uint32_t stopTime)
+{
+	//PreviousTagSize, the tag header and the first byte of the payload,
+	//which holds the frame type of video tags
+	uint8_t header[16];
+	s.clear();
+	while(indexedOffset+sizeof(header)<=limit)
+	{
+		s.seekg(indexedOffset);
+		s.read((char*)header,sizeof(header));
+		if(s.gcount()!=sizeof(header))
+			break;
+		uint32_t dataSize=(header[5]<<16)|(header[6]<<8)|header[7];
+		uint32_t time=(header[8]<<16)|(header[9]<<8)|header[10]|(header[11]<<24);
+		uint64_t next=indexedOffset+15+dataSize;
+		//Only complete tags are indexed
+		if(next>limit)
+			break;
+		bool keyframe=(header[4]==9 && dataSize>0 && (header[15]>>4)==1);
+		if(keyframe)
+			addKeyframe(time,indexedOffset);
+		indexedOffset=next;
+		if(keyframe && time>stopTime)
+			break;
+	}
+	s.clear();
+}
+
+bool FLVKeyframeIndex::find(uint32_t time, uint64_t limit, uint32_t& keyframeTime, uint64_t& offset) const
+{
+	//Keyframes are stored in stream order, so they are sorted by time
+	auto it=upper_bound(keyframes.begin(),keyframes.end(),time,
+			[](uint32_t t, const Keyframe& k) { return t<k.time; });
+	while(it!=keyframes.begin())
+	{
+		--it;
+		if(it->offset<limit)
+		{
+			keyframeTime=it->time;
+			offset=it->offset;
+			return true;
+		}
+	}
+	return false;
+}
@@ -23,6 +23,7 @@
 #include "compat.h"
 #include <istream>
 #include <map>
+#include <vector>
 #include "swftypes.h"
 #include "backends/decoder.h"
 
@@ -57,6 +58,7 @@ public:
 	VideoTag(std::istream& s);
 	uint32_t getDataSize() const { return dataSize; }
 	uint32_t getTotalLen() const { return totalLen; }
+	uint32_t getTimestamp() const { return timestamp; }
 };
 
 class ScriptDataTag: public VideoTag
@@ -108,6 +110,45 @@ public:
 	bool isHeader() const { return _isHeader; }
 };
 
+/*
+ * Maps the times of the video keyframes to their position in the stream.
+ * Positions are the offset of the PreviousTagSize field that precedes the
+ * tag, so parsing can be resumed there. Entries come from the onMetaData
+ * keyframes object or are collected while tags are read, in stream order.
+ */
+class FLVKeyframeIndex
+{
+private:
+	struct Keyframe
+	{
+		uint32_t time;
+		uint64_t offset;
+	};
+	std::vector<Keyframe> keyframes;
+	//Offset of the first tag that has not been looked at yet
+	uint64_t indexedOffset;
+public:
+	FLVKeyframeIndex():indexedOffset(0){}
+	void addKeyframe(uint32_t time, uint64_t offset);
+	/*
+	   Marks the tags before offset as indexed
+	*/
+	void setIndexedOffset(uint64_t offset);
+	uint64_t getIndexedOffset() const { return indexedOffset; }
+	/*
+	   Reads the tag headers following the indexed part of the stream,
+	   without decoding them, until limit bytes or the first keyframe
+	   after stopTime. The stream position is not restored.
+	*/
+	void scan(std::istream& s, uint64_t limit, uint32_t stopTime);
+	/*
+	   Finds the last keyframe at or before time whose tag starts within
+	   the first limit bytes of the stream
+	*/
+	bool find(uint32_t time, uint64_t limit, uint32_t& keyframeTime, uint64_t& offset) const;
+	bool isEmpty() const { return keyframes.empty(); }
+};
+
 }
 
 #endif /* PARSING_FLV_H */
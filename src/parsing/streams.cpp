@@ -122,10 +122,30 @@ bytes_buf::bytes_buf(const uint8_t* b, int l):buf(b),len(l)
 
 bytes_buf::pos_type bytes_buf::seekoff(off_type off, ios_base::seekdir dir,ios_base::openmode mode)
 {
-	assert(off==0);
 	//The current offset is the amount used in the buffer
-	int ret=(gptr()-eback());
-	return ret;
+	off_type cur=(gptr()-eback());
+	switch(dir)
+	{
+		case ios_base::beg:
+			return seekpos(off, mode);
+		case ios_base::cur:
+			if(off==0)
+				return cur;
+			return seekpos(cur+off, mode);
+		case ios_base::end:
+			return seekpos(len+off, mode);
+		default:
+			return -1;
+	}
+}
+
+bytes_buf::pos_type bytes_buf::seekpos(pos_type pos, ios_base::openmode mode)
+{
+	off_type off=pos;
+	if((mode & ios_base::in)==0 || off<0 || off>len)
+		return -1;
+	setg((char*)buf,(char*)buf+off,(char*)buf+len);
+	return pos;
 }
 
 liblzma_filter::liblzma_filter(streambuf* b):uncompressing_filter(b)
@@ -88,6 +88,13 @@ private:
 public:
 	bytes_buf(const uint8_t* b, int l);
 	virtual pos_type seekoff(off_type, std::ios_base::seekdir, std::ios_base::openmode);
+	virtual pos_type seekpos(pos_type, std::ios_base::openmode);
+	// Pointer to the data at the current read position
+	const uint8_t* getCurrentData() const { return (const uint8_t*)gptr(); }
+	// Object keeping the buffer alive. When this is not null the
+	// buffer may be referenced after the streambuf is destroyed, as
+	// long as a reference to the owner is held
+	virtual lightspark::NullableRef<lightspark::RefCountable> getOwner() const { return lightspark::NullRef; }
 };
 
 // A lightweight, istream-like interface for reading from a memory
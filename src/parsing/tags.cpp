@@ -1036,32 +1036,75 @@ ASObject* DefineFont4Tag::instance(Class_base* c)
 	return ret;
 }
 
-BitmapTag::BitmapTag(RECORDHEADER h,RootMovieClip* root):DictionaryTag(h,root),bitmap(_MR(new BitmapContainer(root->getSystemState()->tagsMemory)))
+BitmapTag::BitmapTag(RECORDHEADER h,RootMovieClip* root):DictionaryTag(h,root),
+	compressedData(reporter_allocator<uint8_t>(root->getSystemState()->tagsMemory))
 {
 }
 
-_R<BitmapContainer> BitmapTag::getBitmap() const {
-	return bitmap;
+void BitmapTag::readCompressedData(istream& in, uint32_t len)
+{
+	compressedData.resize(len);
+	if(len)
+		in.read((char*)compressedData.data(),len);
+}
+
+/* called in vm's and render thread's context */
+_R<BitmapContainer> BitmapTag::getBitmap()
+{
+	uint32_t decodedSize=0;
+	_NR<BitmapContainer> ret;
+	{
+		Locker l(bitmapMutex);
+		if(bitmap.isNull())
+		{
+			bitmap=_MNR(new BitmapContainer(loadedFrom->getSystemState()->tagsMemory));
+			decodeBitmap(bitmap.getPtr());
+			decodedSize=bitmap->getWidth()*bitmap->getHeight()*4;
+		}
+		ret=bitmap;
+	}
+	//Register outside of the lock, the root may purge other bitmap tags
+	if(decodedSize)
+		loadedFrom->registerDecodedTag(this,decodedSize);
+	return _MR(ret);
+}
+
+uint32_t BitmapTag::purgeDecodedData()
+{
+	//A busy tag is in use, this also avoids lock order issues with
+	//the root movie which calls this with its own lock held
+	if(!bitmapMutex.trylock())
+		return 0;
+	uint32_t ret=0;
+	//The container is still used by a BitmapData or a shape otherwise
+	if(!bitmap.isNull() && bitmap->isLastRef())
+	{
+		ret=bitmap->getWidth()*bitmap->getHeight()*4;
+		bitmap.reset();
+	}
+	bitmapMutex.unlock();
+	return ret;
 }
-void BitmapTag::loadBitmap(uint8_t* inData, int datasize, const uint8_t *tablesData, int tablesLen)
+
+void BitmapTag::loadBitmap(BitmapContainer* b, const uint8_t* inData, int datasize, const uint8_t *tablesData, int tablesLen)
 {
 	if (datasize < 4)
 		return;
 	else if((inData[0]&0x80) && inData[1]=='P' && inData[2]=='N' && inData[3]=='G')
-		bitmap->fromPNG(inData,datasize);
+		b->fromPNG(const_cast<uint8_t*>(inData),datasize);
 	else if(inData[0]==0xff && inData[1]==0xd8 && inData[2]==0xff)
-		bitmap->fromJPEG(inData,datasize,tablesData,tablesLen);
+		b->fromJPEG(const_cast<uint8_t*>(inData),datasize,tablesData,tablesLen);
 	else if(inData[0]=='G' && inData[1]=='I' && inData[2]=='F' && inData[3]=='8')
 		LOG(LOG_ERROR,"GIF image found, not yet supported, ID :"<<getId());
 	else if(inData[0]==0xff && inData[1]==0xd9)
 		// I've found swf files with broken jpegs that start with the jpeg "end of file" magic bytes and two times the "begin of file" magic bytes
 		// so we just ignore the first 4 bytes
 		// TODO check if libjpeg has a better common way to deal with invalid headers
-		loadBitmap(inData+4, datasize-4, tablesData, tablesLen);
+		loadBitmap(b, inData+4, datasize-4, tablesData, tablesLen);
 	else
 		LOG(LOG_ERROR,"unknown image format for ID "<<getId());
 }
-DefineBitsLosslessTag::DefineBitsLosslessTag(RECORDHEADER h, istream& in, int version, RootMovieClip* root):BitmapTag(h,root),BitmapColorTableSize(0)
+DefineBitsLosslessTag::DefineBitsLosslessTag(RECORDHEADER h, istream& in, int v, RootMovieClip* root):BitmapTag(h,root),BitmapColorTableSize(0),version(v)
 {
 	int dest=in.tellg();
 	dest+=h.getLength();
@@ -1070,12 +1113,14 @@ DefineBitsLosslessTag::DefineBitsLosslessTag(RECORDHEADER h, istream& in, int ve
 	if(BitmapFormat==LOSSLESS_BITMAP_PALETTE)
 		in >> BitmapColorTableSize;
 
-	string cData;
-	size_t cSize = dest-in.tellg(); //rest of this tag
-	cData.resize(cSize);
-	in.read(&cData[0], cSize);
-	istringstream cDataStream(cData);
-	zlib_filter zf(cDataStream.rdbuf());
+	//rest of this tag, it is only uncompressed on first use
+	readCompressedData(in, dest-in.tellg());
+}
+
+void DefineBitsLosslessTag::decodeBitmap(BitmapContainer* b)
+{
+	bytes_buf cDataBuf(compressedData.data(), compressedData.size());
+	zlib_filter zf(&cDataBuf);
 	istream zfstream(&zf);
 
 	if (BitmapFormat == LOSSLESS_BITMAP_RGB15 ||
@@ -1094,7 +1139,7 @@ DefineBitsLosslessTag::DefineBitsLosslessTag(RECORDHEADER h, istream& in, int ve
 		else
 			format = BitmapContainer::ARGB32;
 
-		bitmap->fromRGB(inData, BitmapWidth, BitmapHeight, format);
+		b->fromRGB(inData, BitmapWidth, BitmapHeight, format);
 	}
 	else if (BitmapFormat == LOSSLESS_BITMAP_PALETTE)
 	{
@@ -1118,7 +1163,7 @@ DefineBitsLosslessTag::DefineBitsLosslessTag(RECORDHEADER h, istream& in, int ve
 
 		uint8_t *palette = inData;
 		uint8_t *pixelData = inData + paletteBPP*numColors;
-		bitmap->fromPalette(pixelData, BitmapWidth, BitmapHeight, stride, palette, numColors, paletteBPP);
+		b->fromPalette(pixelData, BitmapWidth, BitmapHeight, stride, palette, numColors, paletteBPP);
 		delete[] inData;
 	}
 	else
@@ -1136,11 +1181,11 @@ ASObject* BitmapTag::instance(Class_base* c)
 	Class_base* classRet = Class<BitmapData>::getClass(loadedFrom->getSystemState());
 
 	if(!realClass)
-		return new (classRet->memoryAccount) BitmapData(classRet, bitmap);
+		return new (classRet->memoryAccount) BitmapData(classRet, getBitmap());
 
 	if(realClass->isSubClass(Class<Bitmap>::getClass(realClass->getSystemState())))
 	{
-		BitmapData* ret=new (classRet->memoryAccount) BitmapData(classRet, bitmap);
+		BitmapData* ret=new (classRet->memoryAccount) BitmapData(classRet, getBitmap());
 		Bitmap* bitmapRet=new (realClass->memoryAccount) Bitmap(realClass,_MR(ret));
 		return bitmapRet;
 	}
@@ -1150,7 +1195,7 @@ ASObject* BitmapTag::instance(Class_base* c)
 		classRet = realClass;
 	}
 
-	return new (classRet->memoryAccount) BitmapData(classRet, bitmap);
+	return new (classRet->memoryAccount) BitmapData(classRet, getBitmap());
 }
 
 DefineTextTag::DefineTextTag(RECORDHEADER h, istream& in, RootMovieClip* root,int v):DictionaryTag(h,root),
@@ -1263,14 +1308,74 @@ void DefineTextTag::computeCached() const
 	}
 }
 
-DefineShapeTag::DefineShapeTag(RECORDHEADER h,int v,RootMovieClip* root):DictionaryTag(h,root),Shapes(v)
+DefineShapeTag::DefineShapeTag(RECORDHEADER h,int v,RootMovieClip* root):DictionaryTag(h,root),shapeVersion(v),
+	shapeData(reporter_allocator<uint8_t>(root->getSystemState()->tagsMemory)),
+	tokens(reporter_allocator<_NR<GeomToken>>(root->getSystemState()->tagsMemory)),tokensValid(false)
 {
 }
 
-DefineShapeTag::DefineShapeTag(RECORDHEADER h, std::istream& in,RootMovieClip* root):DictionaryTag(h,root),Shapes(1)
+DefineShapeTag::DefineShapeTag(RECORDHEADER h, std::istream& in,RootMovieClip* root):DefineShapeTag(h,1,root)
 {
 	LOG(LOG_TRACE,_("DefineShapeTag"));
-	in >> ShapeId >> ShapeBounds >> Shapes;
+	streampos end=in.tellg()+(streamoff)h.getLength();
+	in >> ShapeId >> ShapeBounds;
+	readShapeData(in,end);
+}
+
+void DefineShapeTag::readShapeData(std::istream& in, streampos end)
+{
+	shapeData.resize(end-in.tellg());
+	if(!shapeData.empty())
+		in.read((char*)shapeData.data(),shapeData.size());
+}
+
+/* called with tokensMutex held */
+void DefineShapeTag::buildTokens()
+{
+	SHAPEWITHSTYLE shapes(shapeVersion);
+	bytes_buf shapeBuf(shapeData.data(),shapeData.size());
+	istream in(&shapeBuf);
+	try
+	{
+		in >> shapes;
+	}
+	catch(LightsparkException& e)
+	{
+		LOG(LOG_ERROR,"Invalid data for shape " << ShapeId << ": " << e.cause);
+		return;
+	}
+
+	//Bitmap fills only store the dictionary id, the bitmaps are decoded now
+	std::vector<FILLSTYLE*> bitmapFills;
+	for(auto it=shapes.FillStyles.FillStyles.begin();it!=shapes.FillStyles.FillStyles.end();++it)
+		bitmapFills.push_back(&(*it));
+	for(auto it=shapes.LineStyles.LineStyles2.begin();it!=shapes.LineStyles.LineStyles2.end();++it)
+	{
+		if(it->HasFillFlag)
+			bitmapFills.push_back(&it->FillType);
+	}
+	for(auto it=bitmapFills.begin();it!=bitmapFills.end();++it)
+	{
+		FILLSTYLE* style=*it;
+		if(style->bitmapId==65535)
+			continue;
+		try
+		{
+			BitmapTag* b=dynamic_cast<BitmapTag*>(loadedFrom->dictionaryLookup(style->bitmapId));
+			if(b)
+				style->bitmap=b->getBitmap();
+			else
+				LOG(LOG_ERROR,"Invalid bitmap ID " << style->bitmapId);
+		}
+		catch(RunTimeException& e)
+		{
+			//Thrown if the bitmapId does not exists in dictionary
+			LOG(LOG_ERROR,"Exception in FillStyle parsing: " << e.what());
+		}
+	}
+
+	TokenContainer::FromShaperecordListToShapeVector(shapes.ShapeRecords,tokens,shapes.FillStyles.FillStyles,MATRIX(),shapes.LineStyles.LineStyles2);
+	tokensValid=true;
 }
 
 ASObject *DefineShapeTag::instance(Class_base *c)
@@ -1282,36 +1387,85 @@ ASObject *DefineShapeTag::instance(Class_base *c)
 		else
 			c=Class<Shape>::getClass(loadedFrom->getSystemState());
 	}
-	tokensVector tokens(reporter_allocator<GeomToken>(loadedFrom->getSystemState()->tagsMemory));
-	TokenContainer::FromShaperecordListToShapeVector(Shapes.ShapeRecords,tokens,Shapes.FillStyles.FillStyles,MATRIX(),Shapes.LineStyles.LineStyles2);
+	tokensVector shapeTokens(reporter_allocator<_NR<GeomToken>>(loadedFrom->getSystemState()->tagsMemory));
+	uint32_t decodedSize=0;
+	{
+		Locker l(tokensMutex);
+		if(!tokensValid)
+		{
+			buildTokens();
+			decodedSize=tokens.size()*sizeof(GeomToken);
+		}
+		//The tokens are reference counted, so this does not copy the geometry
+		shapeTokens.filltokens.assign(tokens.filltokens.begin(),tokens.filltokens.end());
+		shapeTokens.stroketokens.assign(tokens.stroketokens.begin(),tokens.stroketokens.end());
+	}
+	if(decodedSize)
+		loadedFrom->registerDecodedTag(this,decodedSize);
 	Shape* ret= loadedFrom->version >= 9 ?
-				new (c->memoryAccount) Shape(c, tokens, 1.0f/20.0f):
-				new (c->memoryAccount) AVM1Shape(c, tokens, 1.0f/20.0f);
+				new (c->memoryAccount) Shape(c, shapeTokens, 1.0f/20.0f):
+				new (c->memoryAccount) AVM1Shape(c, shapeTokens, 1.0f/20.0f);
+	return ret;
+}
+
+template<class T>
+static bool tokensShared(const T& tokens)
+{
+	for(auto it=tokens.begin();it!=tokens.end();++it)
+	{
+		if(!it->isNull() && !(*it)->isLastRef())
+			return true;
+	}
+	return false;
+}
+
+uint32_t DefineShapeTag::purgeDecodedData()
+{
+	//See BitmapTag::purgeDecodedData
+	if(!tokensMutex.trylock())
+		return 0;
+	uint32_t ret=0;
+	//Instances hold their own references to the tokens, which are
+	//only freed here when no instance is alive anymore
+	if(tokensValid && !tokensShared(tokens.filltokens) && !tokensShared(tokens.stroketokens))
+	{
+		ret=tokens.size()*sizeof(GeomToken);
+		tokens.clear();
+		tokens.filltokens.shrink_to_fit();
+		tokens.stroketokens.shrink_to_fit();
+		tokensValid=false;
+	}
+	tokensMutex.unlock();
 	return ret;
 }
 
 DefineShape2Tag::DefineShape2Tag(RECORDHEADER h, std::istream& in,RootMovieClip* root):DefineShapeTag(h,2,root)
 {
 	LOG(LOG_TRACE,_("DefineShape2Tag"));
-	in >> ShapeId >> ShapeBounds >> Shapes;
+	streampos end=in.tellg()+(streamoff)h.getLength();
+	in >> ShapeId >> ShapeBounds;
+	readShapeData(in,end);
 }
 
 DefineShape3Tag::DefineShape3Tag(RECORDHEADER h, std::istream& in,RootMovieClip* root):DefineShape2Tag(h,3,root)
 {
 	LOG(LOG_TRACE,"DefineShape3Tag");
-	in >> ShapeId >> ShapeBounds >> Shapes;
+	streampos end=in.tellg()+(streamoff)h.getLength();
+	in >> ShapeId >> ShapeBounds;
+	readShapeData(in,end);
 }
 
 DefineShape4Tag::DefineShape4Tag(RECORDHEADER h, std::istream& in, RootMovieClip* root):DefineShape3Tag(h,4,root)
 {
 	LOG(LOG_TRACE,"DefineShape4Tag");
+	streampos end=in.tellg()+(streamoff)h.getLength();
 	in >> ShapeId >> ShapeBounds >> EdgeBounds;
 	BitStream bs(in);
 	UB(5,bs);
 	UsesFillWindingRule=UB(1,bs);
 	UsesNonScalingStrokes=UB(1,bs);
 	UsesScalingStrokes=UB(1,bs);
-	in >> Shapes;
+	readShapeData(in,end);
 }
 
 DefineMorphShapeTag::DefineMorphShapeTag(RECORDHEADER h, std::istream& in, RootMovieClip* root):DictionaryTag(h, root),
@@ -1966,22 +2120,42 @@ ASObject* DefineVideoStreamTag::instance(Class_base* c)
 	return ret;
 }
 
-DefineBinaryDataTag::DefineBinaryDataTag(RECORDHEADER h,std::istream& s,RootMovieClip* root):DictionaryTag(h,root)
+// Private copy of a DefineBinaryData payload, shared with the
+// ByteArrays instantiated from the tag
+class BinaryDataBuffer: public RefCountable
+{
+public:
+	std::vector<uint8_t, reporter_allocator<uint8_t>> data;
+	BinaryDataBuffer(MemoryAccount* m, uint32_t size):data(size, 0, reporter_allocator<uint8_t>(m)) {}
+};
+
+DefineBinaryDataTag::DefineBinaryDataTag(RECORDHEADER h,std::istream& s,RootMovieClip* root):DictionaryTag(h,root),bytes(NULL)
 {
 	LOG(LOG_TRACE,_("DefineBinaryDataTag"));
 	int size=h.getLength();
 	s >> Tag >> Reserved;
 	size -= sizeof(Tag)+sizeof(Reserved);
-	bytes=new uint8_t[size];
 	len=size;
-	s.read((char*)bytes,size);
+	//Reference the data in place if the stream memory can outlive the stream
+	bytes_buf* buf=dynamic_cast<bytes_buf*>(s.rdbuf());
+	if(buf && buf->in_avail()>=size)
+	{
+		bytesOwner=buf->getOwner();
+		if(!bytesOwner.isNull())
+		{
+			bytes=buf->getCurrentData();
+			s.ignore(size);
+			return;
+		}
+	}
+	BinaryDataBuffer* copy=new BinaryDataBuffer(root->getSystemState()->tagsMemory,size);
+	bytesOwner=_MNR(copy);
+	bytes=copy->data.data();
+	s.read((char*)copy->data.data(),size);
 }
 
 ASObject* DefineBinaryDataTag::instance(Class_base* c)
 {
-	uint8_t* b = new uint8_t[len];
-	memcpy(b,bytes,len);
-
 	Class_base* classRet = NULL;
 	if(c)
 		classRet=c;
@@ -1990,7 +2164,9 @@ ASObject* DefineBinaryDataTag::instance(Class_base* c)
 	else
 		classRet=Class<ByteArray>::getClass(loadedFrom->getSystemState());
 
-	ByteArray* ret=new (classRet->memoryAccount) ByteArray(classRet, b, len);
+	//The data is copied only when the ByteArray is written
+	ByteArray* ret=new (classRet->memoryAccount) ByteArray(classRet);
+	ret->acquireSharedBuffer(bytes,len,bytesOwner);
 	return ret;
 }
 
@@ -2262,11 +2438,12 @@ DefineBitsTag::DefineBitsTag(RECORDHEADER h, std::istream& in,RootMovieClip* roo
 
 	in >> CharacterId;
 	//Read image data
-	int dataSize=Header.getLength()-2;
-	uint8_t *inData=new(nothrow) uint8_t[dataSize];
-	in.read((char*)inData,dataSize);
-	loadBitmap(inData,dataSize,JPEGTablesTag::getJPEGTables(),JPEGTablesTag::getJPEGTableSize());
-	delete[] inData;
+	readCompressedData(in,Header.getLength()-2);
+}
+
+void DefineBitsTag::decodeBitmap(BitmapContainer* b)
+{
+	loadBitmap(b,compressedData.data(),compressedData.size(),JPEGTablesTag::getJPEGTables(),JPEGTablesTag::getJPEGTableSize());
 }
 
 DefineBitsJPEG2Tag::DefineBitsJPEG2Tag(RECORDHEADER h, std::istream& in, RootMovieClip* root):BitmapTag(h,root)
@@ -2274,58 +2451,58 @@ DefineBitsJPEG2Tag::DefineBitsJPEG2Tag(RECORDHEADER h, std::istream& in, RootMov
 	LOG(LOG_TRACE,_("DefineBitsJPEG2Tag Tag"));
 	in >> CharacterId;
 	//Read image data
-	int dataSize=Header.getLength()-2;
-	uint8_t* inData=new(nothrow) uint8_t[dataSize];
-	in.read((char*)inData,dataSize);
-	loadBitmap(inData,dataSize);
-	delete[] inData;
+	readCompressedData(in,Header.getLength()-2);
 }
 
-DefineBitsJPEG3Tag::DefineBitsJPEG3Tag(RECORDHEADER h, std::istream& in, RootMovieClip* root):BitmapTag(h,root),alphaData(NULL)
+void DefineBitsJPEG2Tag::decodeBitmap(BitmapContainer* b)
+{
+	loadBitmap(b,compressedData.data(),compressedData.size());
+}
+
+DefineBitsJPEG3Tag::DefineBitsJPEG3Tag(RECORDHEADER h, std::istream& in, RootMovieClip* root):BitmapTag(h,root),
+	alphaData(reporter_allocator<uint8_t>(root->getSystemState()->tagsMemory))
 {
 	LOG(LOG_TRACE,_("DefineBitsJPEG3Tag Tag"));
 	UI32_SWF dataSize;
 	in >> CharacterId >> dataSize;
 	//Read image data
-	uint8_t* inData=new(nothrow) uint8_t[dataSize];
-	in.read((char*)inData,dataSize);
-
-	loadBitmap(inData,dataSize);
-	delete[] inData;
+	readCompressedData(in,dataSize);
 
 	//Read alpha data (if any)
 	int alphaSize=Header.getLength()-dataSize-6;
 	if(alphaSize>0) //If less that 0 the consistency check on tag size will stop later
 	{
-		//Create a zlib filter
-		string alphaData;
 		alphaData.resize(alphaSize);
-		in.read(&alphaData[0], alphaSize);
-		istringstream alphaStream(alphaData);
-		zlib_filter zf(alphaStream.rdbuf());
-		istream zfstream(&zf);
-		zfstream.exceptions ( istream::eofbit | istream::failbit | istream::badbit );
-
-		//Catch the exception if the stream ends
-		try
-		{
-			//Set alpha
-			for(int32_t i=0;i<bitmap->getHeight();i++)
-			{
-				for(int32_t j=0;j<bitmap->getWidth();j++)
-					bitmap->setAlpha(j, i, zfstream.get());
-			}
-		}
-		catch(std::exception& e)
-		{
-			LOG(LOG_ERROR, "Exception while parsing Alpha data in DefineBitsJPEG3");
-		}
+		in.read((char*)alphaData.data(), alphaSize);
 	}
 }
 
-DefineBitsJPEG3Tag::~DefineBitsJPEG3Tag()
+void DefineBitsJPEG3Tag::decodeBitmap(BitmapContainer* b)
 {
-	delete[] alphaData;
+	loadBitmap(b,compressedData.data(),compressedData.size());
+	if(alphaData.empty())
+		return;
+
+	//Create a zlib filter
+	bytes_buf alphaBuf(alphaData.data(),alphaData.size());
+	zlib_filter zf(&alphaBuf);
+	istream zfstream(&zf);
+	zfstream.exceptions ( istream::eofbit | istream::failbit | istream::badbit );
+
+	//Catch the exception if the stream ends
+	try
+	{
+		//Set alpha
+		for(int32_t i=0;i<b->getHeight();i++)
+		{
+			for(int32_t j=0;j<b->getWidth();j++)
+				b->setAlpha(j, i, zfstream.get());
+		}
+	}
+	catch(std::exception& e)
+	{
+		LOG(LOG_ERROR, "Exception while parsing Alpha data in DefineBitsJPEG3");
+	}
 }
 
 DefineSceneAndFrameLabelDataTag::DefineSceneAndFrameLabelDataTag(RECORDHEADER h, std::istream& in):ControlTag(h)
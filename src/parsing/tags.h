@@ -87,6 +87,12 @@ public:
 	virtual int getId() const=0;
 	virtual ASObject* instance(Class_base* c=NULL) { return NULL; }
 	virtual MATRIX MapToBounds(const MATRIX& mat) { return mat; }
+	/*
+	 * Tags which decode their payload on first use can drop the
+	 * decoded data again if nobody else holds a reference to it.
+	 * Returns the number of bytes released.
+	 */
+	virtual uint32_t purgeDecodedData() { return 0; }
 };
 
 /*
@@ -136,15 +142,28 @@ public:
 
 class DefineShapeTag: public DictionaryTag
 {
+private:
+	/*
+	 * The SHAPEWITHSTYLE records are kept in their compressed on-disk
+	 * form and are only parsed and converted to tokens when the shape
+	 * is instantiated for the first time.
+	 */
+	uint8_t shapeVersion;
+	std::vector<uint8_t, reporter_allocator<uint8_t>> shapeData;
+	Mutex tokensMutex;
+	tokensVector tokens;
+	bool tokensValid;
+	void buildTokens();
 protected:
 	UI16_SWF ShapeId;
 	RECT ShapeBounds;
-	SHAPEWITHSTYLE Shapes;
 	DefineShapeTag(RECORDHEADER h,int v,RootMovieClip* root);
+	void readShapeData(std::istream& in, std::streampos end);
 public:
 	DefineShapeTag(RECORDHEADER h,std::istream& in, RootMovieClip* root);
 	virtual int getId() const{ return ShapeId; }
 	ASObject* instance(Class_base* c=NULL);
+	uint32_t purgeDecodedData();
 };
 
 class DefineShape2Tag: public DefineShapeTag
@@ -419,11 +438,14 @@ class DefineBinaryDataTag: public DictionaryTag
 private:
 	UI16_SWF Tag;
 	UI32_SWF Reserved;
-	uint8_t* bytes;
+	// Keeps bytes alive. This is the mapped file when the tag is
+	// parsed in place, otherwise a private copy of the payload.
+	// ByteArrays created by instance() share the data until written
+	_NR<RefCountable> bytesOwner;
+	const uint8_t* bytes;
 	uint32_t len;
 public:
 	DefineBinaryDataTag(RECORDHEADER h,std::istream& s,RootMovieClip* root);
-	~DefineBinaryDataTag() { delete[] bytes; }
 	virtual int getId() const {return Tag;}
 	ASObject* instance(Class_base* c=NULL);
 };
@@ -583,15 +605,27 @@ public:
 
 class BitmapContainer;
 
+/*
+ * Bitmap tags only keep the compressed image data resident. The pixels
+ * are decoded into a BitmapContainer on the first call to getBitmap()
+ * and can be purged again when the container is not shared anymore.
+ */
 class BitmapTag: public DictionaryTag
 {
+private:
+	Mutex bitmapMutex;
+	_NR<BitmapContainer> bitmap;
 protected:
-        _R<BitmapContainer> bitmap;
-    void loadBitmap(uint8_t* inData, int datasize, const uint8_t *tablesData=NULL, int tablesLen=0);
+	std::vector<uint8_t, reporter_allocator<uint8_t>> compressedData;
+	void readCompressedData(std::istream& in, uint32_t len);
+	void loadBitmap(BitmapContainer* b, const uint8_t* inData, int datasize, const uint8_t *tablesData=NULL, int tablesLen=0);
+	// Decode compressedData into the (empty) container
+	virtual void decodeBitmap(BitmapContainer* b) = 0;
 public:
 	BitmapTag(RECORDHEADER h,RootMovieClip* root);
 	ASObject* instance(Class_base* c=NULL);
-        _R<BitmapContainer> getBitmap() const;
+	_R<BitmapContainer> getBitmap();
+	uint32_t purgeDecodedData();
 };
 
 class JPEGTablesTag: public Tag
@@ -613,7 +647,10 @@ private:
 	UI16_SWF BitmapWidth;
 	UI16_SWF BitmapHeight;
 	UI8 BitmapColorTableSize;
-	//ZlibBitmapData;
+	int version;
+	//compressedData holds the ZlibBitmapData
+protected:
+	void decodeBitmap(BitmapContainer* b);
 public:
 	DefineBitsLosslessTag(RECORDHEADER h, std::istream& in, int version, RootMovieClip* root);
 	int getId() const{ return CharacterId; }
@@ -623,6 +660,8 @@ class DefineBitsTag: public BitmapTag
 {
 private:
 	UI16_SWF CharacterId;
+protected:
+	void decodeBitmap(BitmapContainer* b);
 public:
 	DefineBitsTag(RECORDHEADER h, std::istream& in, RootMovieClip* root);
 	int getId() const{ return CharacterId; }
@@ -632,6 +671,8 @@ class DefineBitsJPEG2Tag: public BitmapTag
 {
 private:
 	UI16_SWF CharacterId;
+protected:
+	void decodeBitmap(BitmapContainer* b);
 public:
 	DefineBitsJPEG2Tag(RECORDHEADER h, std::istream& in, RootMovieClip* root);
 	int getId() const{ return CharacterId; }
@@ -641,10 +682,12 @@ class DefineBitsJPEG3Tag: public BitmapTag
 {
 private:
 	UI16_SWF CharacterId;
-	uint8_t* alphaData;
+	//zlib compressed alpha channel, the image data is in compressedData
+	std::vector<uint8_t, reporter_allocator<uint8_t>> alphaData;
+protected:
+	void decodeBitmap(BitmapContainer* b);
 public:
 	DefineBitsJPEG3Tag(RECORDHEADER h, std::istream& in, RootMovieClip* root);
-	~DefineBitsJPEG3Tag();
 	int getId() const{ return CharacterId; }
 };
 
@@ -24,6 +24,7 @@
 #include <SDL2/SDL_mouse.h>
 #include <SDL2/SDL_mixer.h>
 #include "backends/input.h"
+#include "backends/audio.h"
 #include "backends/rendering.h"
 #include "backends/lsopengl.h"
 #include "platforms/engineutils.h"
@@ -921,63 +922,12 @@ void EngineData::exec_glGenerateMipmap_GL_TEXTURE_2D()
 	glGenerateMipmap(GL_TEXTURE_2D);
 }
 
-void mixer_effect_ffmpeg_cb(int chan, void * stream, int len, void * udata)
+void mixer_hook_cb(void* udata, Uint8* stream, int len)
 {
-	AudioStream *s = (AudioStream*)udata;
-	if (!s)
+	AudioManager* manager = (AudioManager*)udata;
+	if (!manager)
 		return;
-	memset(stream,0,len);
-	uint32_t readcount = 0;
-	while (readcount < ((uint32_t)len))
-	{
-		uint32_t ret = s->getDecoder()->copyFrame((int16_t *)(((unsigned char*)stream)+readcount), ((uint32_t)len)-readcount);
-		if (!ret)
-			break;
-		readcount += ret;
-	}
-}
-
-
-
-int EngineData::audio_StreamInit(AudioStream* s)
-{
-	int mixer_channel = -1;
-
-	uint32_t len = LIGHTSPARK_AUDIO_BUFFERSIZE;
-
-	uint8_t *buf = new uint8_t[len];
-	memset(buf,0,len);
-	Mix_Chunk* chunk = Mix_QuickLoad_RAW(buf, len);
-	delete[] buf;
-
-
-	mixer_channel = Mix_PlayChannel(-1, chunk, -1);
-	Mix_RegisterEffect(mixer_channel, mixer_effect_ffmpeg_cb, NULL, s);
-	Mix_Resume(mixer_channel);
-	return mixer_channel;
-}
-
-void EngineData::audio_StreamPause(int channel, bool dopause)
-{
-	if (channel == -1)
-		return;
-	if(dopause)
-		Mix_Pause(channel);
-	else
-		Mix_Resume(channel);
-}
-
-void EngineData::audio_StreamSetVolume(int channel, double volume)
-{
-	int curvolume = SDL_MIX_MAXVOLUME * volume;
-	if (channel != -1)
-		Mix_Volume(channel, curvolume);
-}
-
-void EngineData::audio_StreamDeinit(int channel)
-{
-	if (channel != -1)
-		Mix_HaltChannel(channel);
+	manager->mixStreams((int16_t*)stream, (uint32_t)len);
 }
 
 bool EngineData::audio_ManagerInit()
@@ -992,12 +942,18 @@ bool EngineData::audio_ManagerInit()
 
 void EngineData::audio_ManagerCloseMixer()
 {
+	Mix_HookMusic(NULL, NULL);
 	Mix_CloseAudio();
 }
 
-bool EngineData::audio_ManagerOpenMixer()
+bool EngineData::audio_ManagerOpenMixer(AudioManager* manager)
 {
-	return Mix_OpenAudio (audio_getSampleRate(), AUDIO_S16, 2, LIGHTSPARK_AUDIO_BUFFERSIZE) >= 0;
+	//All streams are mixed by the AudioManager into the single
+	//music hook, so the number of SDL_mixer channels is no limit
+	if (Mix_OpenAudio (audio_getSampleRate(), AUDIO_S16, 2, LIGHTSPARK_AUDIO_BUFFERSIZE) < 0)
+		return false;
+	Mix_HookMusic(mixer_hook_cb, manager);
+	return true;
 }
 
 void EngineData::audio_ManagerDeinit()
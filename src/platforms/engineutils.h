@@ -39,7 +39,7 @@ namespace lightspark
 #define LS_USEREVENT_QUIT EngineData::userevent+2
 class SystemState;
 class StreamCache;
-class AudioStream;
+class AudioManager;
 
 enum DEPTH_FUNCTION { ALWAYS, EQUAL, GREATER, GREATER_EQUAL, LESS, LESS_EQUAL, NEVER, NOT_EQUAL };
 enum TRIANGLE_FACE { FACE_BACK, FACE_FRONT, FACE_FRONT_AND_BACK, FACE_NONE };
@@ -232,13 +232,10 @@ public:
 	virtual void exec_glGenerateMipmap_GL_TEXTURE_2D();
 
 	// Audio handling
-	virtual int audio_StreamInit(AudioStream* s);
-	virtual void audio_StreamPause(int channel, bool dopause);
-	virtual void audio_StreamSetVolume(int channel, double volume);
-	virtual void audio_StreamDeinit(int channel);
+	// The output calls AudioManager::mixStreams to get the mixed samples of all streams
 	virtual bool audio_ManagerInit();
 	virtual void audio_ManagerCloseMixer();
-	virtual bool audio_ManagerOpenMixer();
+	virtual bool audio_ManagerOpenMixer(AudioManager* manager);
 	virtual void audio_ManagerDeinit();
 	virtual int audio_getSampleRate();
 	
@@ -0,0 +1,58 @@
+/**************************************************************************
+  Lightspark, a free flash player implementation
+
+  Copyright (C) 2010-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU Lesser General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ **************************************************************************/
+
+#include "platforms/fastpaths.h"
+#include <cinttypes>
+#include <arm_neon.h>
+
+using namespace lightspark;
+
+void lightspark::fastYUV420ChannelsToYUV0Buffer(uint8_t* y, uint8_t* u, uint8_t* v, uint8_t* out, uint32_t width, uint32_t height)
+{
+	const uint32_t texw=(width+15)&0xfffffff0;
+	const uint32_t chromaw=width/2;
+	uint8x16x4_t pixels;
+	pixels.val[3]=vdupq_n_u8(0xff);
+	for(uint32_t i=0;i<height;i++)
+	{
+		const uint8_t* yrow=y+i*width;
+		const uint8_t* urow=u+(i/2)*chromaw;
+		const uint8_t* vrow=v+(i/2)*chromaw;
+		uint8_t* outrow=out+i*texw*4;
+		uint32_t j=0;
+		//16 pixels per iteration, each chroma sample covers two of them
+		for(;j+16<=width;j+=16)
+		{
+			uint8x8x2_t uu=vzip_u8(vld1_u8(urow+j/2),vld1_u8(urow+j/2));
+			uint8x8x2_t vv=vzip_u8(vld1_u8(vrow+j/2),vld1_u8(vrow+j/2));
+			pixels.val[0]=vld1q_u8(yrow+j);
+			pixels.val[1]=vcombine_u8(uu.val[0],uu.val[1]);
+			pixels.val[2]=vcombine_u8(vv.val[0],vv.val[1]);
+			vst4q_u8(outrow+j*4,pixels);
+		}
+		for(;j<width;j++)
+		{
+			uint32_t c=(j/2<chromaw) ? j/2 : chromaw-1;
+			outrow[j*4+0]=yrow[j];
+			outrow[j*4+1]=urow[c];
+			outrow[j*4+2]=vrow[c];
+			outrow[j*4+3]=0xff;
+		}
+	}
+}
@@ -19,22 +19,47 @@
 
 #include "platforms/fastpaths.h"
 #include <cinttypes>
-
-extern "C"
-{
-	void fastYUV420ChannelsToYUV0Buffer_SSE2Aligned(uint8_t* y, uint8_t* u, 
-			uint8_t* v, uint8_t* out, uint32_t width, uint32_t height);
-	void fastYUV420ChannelsToYUV0Buffer_SSE2Unaligned(uint8_t* y, uint8_t* u, 
-			uint8_t* v, uint8_t* out, uint32_t width, uint32_t height);
-}
+#include <emmintrin.h>
 
 using namespace lightspark;
 
 void lightspark::fastYUV420ChannelsToYUV0Buffer(uint8_t* y, uint8_t* u, uint8_t* v, uint8_t* out, uint32_t width, uint32_t height)
 {
-	//If the width is compatible with full aligned accesses use the aligned version of the packer
-	if(width%32==0)
-		fastYUV420ChannelsToYUV0Buffer_SSE2Aligned(y,u,v,out,width,height);
-	else
-		fastYUV420ChannelsToYUV0Buffer_SSE2Unaligned(y,u,v,out,width,height);
+	const uint32_t texw=(width+15)&0xfffffff0;
+	const uint32_t chromaw=width/2;
+	const __m128i alpha=_mm_set1_epi8((char)0xff);
+	for(uint32_t i=0;i<height;i++)
+	{
+		const uint8_t* yrow=y+i*width;
+		const uint8_t* urow=u+(i/2)*chromaw;
+		const uint8_t* vrow=v+(i/2)*chromaw;
+		uint8_t* outrow=out+i*texw*4;
+		uint32_t j=0;
+		//16 pixels per iteration, each chroma sample covers two of them
+		for(;j+16<=width;j+=16)
+		{
+			__m128i yv=_mm_loadu_si128((const __m128i*)(yrow+j));
+			__m128i uv=_mm_loadl_epi64((const __m128i*)(urow+j/2));
+			__m128i vv=_mm_loadl_epi64((const __m128i*)(vrow+j/2));
+			uv=_mm_unpacklo_epi8(uv,uv);
+			vv=_mm_unpacklo_epi8(vv,vv);
+			__m128i yuLow=_mm_unpacklo_epi8(yv,uv);
+			__m128i yuHigh=_mm_unpackhi_epi8(yv,uv);
+			__m128i vaLow=_mm_unpacklo_epi8(vv,alpha);
+			__m128i vaHigh=_mm_unpackhi_epi8(vv,alpha);
+			__m128i* dest=(__m128i*)(outrow+j*4);
+			_mm_storeu_si128(dest,_mm_unpacklo_epi16(yuLow,vaLow));
+			_mm_storeu_si128(dest+1,_mm_unpackhi_epi16(yuLow,vaLow));
+			_mm_storeu_si128(dest+2,_mm_unpacklo_epi16(yuHigh,vaHigh));
+			_mm_storeu_si128(dest+3,_mm_unpackhi_epi16(yuHigh,vaHigh));
+		}
+		for(;j<width;j++)
+		{
+			uint32_t c=(j/2<chromaw) ? j/2 : chromaw-1;
+			outrow[j*4+0]=yrow[j];
+			outrow[j*4+1]=urow[c];
+			outrow[j*4+2]=vrow[c];
+			outrow[j*4+3]=0xff;
+		}
+	}
 }
@@ -66,17 +66,18 @@ NPDownloadManager::NPDownloadManager(NPP _instance):instance(_instance)
  * \return A pointer to a newly created \c Downloader for the given URL.
  * \see DownloadManager::destroy()
  */
-lightspark::Downloader* NPDownloadManager::download(const lightspark::URLInfo& url, _R<StreamCache> cache, lightspark::ILoadable* owner)
+lightspark::Downloader* NPDownloadManager::download(const lightspark::URLInfo& url, _R<StreamCache> cache, lightspark::ILoadable* owner,
+		PRIORITY priority)
 {
 	// empty URL means data is generated from calls to NetStream::appendBytes
 	if(!url.isValid() && url.getInvalidReason() == URLInfo::IS_EMPTY)
 	{
-		return StandaloneDownloadManager::download(url, cache, owner);
+		return StandaloneDownloadManager::download(url, cache, owner, priority);
 	}
 	// Handle RTMP requests internally, not through NPAPI
 	if(url.isRTMP())
 	{
-		return StandaloneDownloadManager::download(url, cache, owner);
+		return StandaloneDownloadManager::download(url, cache, owner, priority);
 	}
 
 	// FIXME: dynamic_cast fails because the linker doesn't find
@@ -102,12 +103,12 @@ lightspark::Downloader* NPDownloadManager::download(const lightspark::URLInfo& u
  */
 lightspark::Downloader* NPDownloadManager::downloadWithData(const lightspark::URLInfo& url,
 		_R<StreamCache> cache, const std::vector<uint8_t>& data,
-		const std::list<tiny_string>& headers, lightspark::ILoadable* owner)
+		const std::list<tiny_string>& headers, lightspark::ILoadable* owner, PRIORITY priority)
 {
 	// Handle RTMP requests internally, not through NPAPI
 	if(url.isRTMP())
 	{
-		return StandaloneDownloadManager::downloadWithData(url, cache, data, headers, owner);
+		return StandaloneDownloadManager::downloadWithData(url, cache, data, headers, owner, priority);
 	}
 
 	LOG(LOG_INFO, _("NET: PLUGIN: DownloadManager::downloadWithData '") << url.getParsedURL());
@@ -47,10 +47,12 @@ public:
 	NPDownloadManager(NPP i);
 	lightspark::Downloader* download(const lightspark::URLInfo& url,
 					 _R<StreamCache> cache,
-					 lightspark::ILoadable* owner);
+					 lightspark::ILoadable* owner,
+					 PRIORITY priority=PRIORITY_NORMAL);
 	lightspark::Downloader* downloadWithData(const lightspark::URLInfo& url,
 			_R<StreamCache> cache, const std::vector<uint8_t>& data,
-			const std::list<tiny_string>& headers, lightspark::ILoadable* owner);
+			const std::list<tiny_string>& headers, lightspark::ILoadable* owner,
+			PRIORITY priority=PRIORITY_NORMAL);
 	void destroy(lightspark::Downloader* downloader);
 };
 
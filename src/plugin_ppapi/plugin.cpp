@@ -28,6 +28,7 @@
 #include "abc.h"
 #include "backends/security.h"
 #include "backends/rendering.h"
+#include "backends/audio.h"
 #include <string>
 #include <algorithm>
 #include <SDL2/SDL.h>
@@ -574,17 +575,18 @@ ppDownloadManager::ppDownloadManager(ppPluginInstance *_instance, SystemState *s
 	type = NPAPI;
 }
 
-lightspark::Downloader* ppDownloadManager::download(const lightspark::URLInfo& url, _R<StreamCache> cache, lightspark::ILoadable* owner)
+lightspark::Downloader* ppDownloadManager::download(const lightspark::URLInfo& url, _R<StreamCache> cache, lightspark::ILoadable* owner,
+		PRIORITY priority)
 {
 	// empty URL means data is generated from calls to NetStream::appendBytes
 	if(!url.isValid() && url.getInvalidReason() == URLInfo::IS_EMPTY)
 	{
-		return StandaloneDownloadManager::download(url, cache, owner);
+		return StandaloneDownloadManager::download(url, cache, owner, priority);
 	}
 	// Handle RTMP requests internally, not through PPAPI
 	if(url.isRTMP())
 	{
-		return StandaloneDownloadManager::download(url, cache, owner);
+		return StandaloneDownloadManager::download(url, cache, owner, priority);
 	}
 
 	bool cached = false;
@@ -597,12 +599,12 @@ lightspark::Downloader* ppDownloadManager::download(const lightspark::URLInfo& u
 }
 lightspark::Downloader* ppDownloadManager::downloadWithData(const lightspark::URLInfo& url,
 		_R<StreamCache> cache, const std::vector<uint8_t>& data,
-		const std::list<tiny_string>& headers, lightspark::ILoadable* owner)
+		const std::list<tiny_string>& headers, lightspark::ILoadable* owner, PRIORITY priority)
 {
 	// Handle RTMP requests internally, not through PPAPI
 	if(url.isRTMP())
 	{
-		return StandaloneDownloadManager::downloadWithData(url, cache, data, headers, owner);
+		return StandaloneDownloadManager::downloadWithData(url, cache, data, headers, owner, priority);
 	}
 
 	LOG(LOG_INFO, _("NET: PLUGIN: DownloadManager::downloadWithData '") << url.getParsedURL());
@@ -2374,54 +2376,10 @@ void ppPluginEngineData::exec_glGenerateMipmap_GL_TEXTURE_2D()
 
 void audio_callback(void* sample_buffer,uint32_t buffer_size_in_bytes,PP_TimeDelta latency,void* user_data)
 {
-	AudioStream *s = (AudioStream*)user_data;
-	if (!s)
+	AudioManager* manager = (AudioManager*)user_data;
+	if (!manager)
 		return;
-
-	uint32_t readcount = 0;
-	while (readcount < buffer_size_in_bytes)
-	{
-		uint32_t ret = s->getDecoder()->copyFrame((int16_t *)(((unsigned char*)sample_buffer)+readcount), buffer_size_in_bytes-readcount);
-		if (!ret)
-			break;
-		readcount += ret;
-	}
-	if (s->getVolume() != 1.0)
-	{
-		int16_t *p = (int16_t *)sample_buffer;
-		for (uint32_t i = 0; i < readcount/2; i++)
-		{
-			*p = (*p)*s->getVolume();
-			p++;
-		}
-	}
-}
-
-int ppPluginEngineData::audio_StreamInit(AudioStream *s)
-{
-	PP_Resource res = g_audio_interface->Create(instance->m_ppinstance,audioconfig,audio_callback,s);
-	if (res != 0)
-		g_audio_interface->StartPlayback(res);
-	else
-		LOG(LOG_ERROR,"creating audio interface failed");
-	return res;
-}
-
-void ppPluginEngineData::audio_StreamPause(int channel, bool dopause)
-{
-	if (dopause)
-		g_audio_interface->StopPlayback(channel);
-	else
-		g_audio_interface->StartPlayback(channel);
-}
-
-void ppPluginEngineData::audio_StreamSetVolume(int channel, double volume)
-{
-}
-
-void ppPluginEngineData::audio_StreamDeinit(int channel)
-{
-	g_audio_interface->StopPlayback(channel);
+	manager->mixStreams((int16_t*)sample_buffer,buffer_size_in_bytes);
 }
 
 bool ppPluginEngineData::audio_ManagerInit()
@@ -2433,11 +2391,23 @@ bool ppPluginEngineData::audio_ManagerInit()
 
 void ppPluginEngineData::audio_ManagerCloseMixer()
 {
+	if (audioresource)
+	{
+		g_audio_interface->StopPlayback(audioresource);
+		g_core_interface->ReleaseResource(audioresource);
+		audioresource = 0;
+	}
 }
 
-bool ppPluginEngineData::audio_ManagerOpenMixer()
+bool ppPluginEngineData::audio_ManagerOpenMixer(AudioManager* manager)
 {
-	return true;
+	audioresource = g_audio_interface->Create(instance->m_ppinstance,audioconfig,audio_callback,manager);
+	if (audioresource == 0)
+	{
+		LOG(LOG_ERROR,"creating audio interface failed");
+		return false;
+	}
+	return g_audio_interface->StartPlayback(audioresource);
 }
 
 void ppPluginEngineData::audio_ManagerDeinit()
@@ -77,10 +77,12 @@ public:
 	ppDownloadManager(ppPluginInstance* _instance,SystemState* sys);
 	Downloader* download(const URLInfo& url,
 					 _R<StreamCache> cache,
-					 ILoadable* owner);
+					 ILoadable* owner,
+					 PRIORITY priority=PRIORITY_NORMAL);
 	Downloader* downloadWithData(const URLInfo& url,
 			_R<StreamCache> cache, const std::vector<uint8_t>& data,
-			const std::list<tiny_string>& headers, ILoadable* owner);
+			const std::list<tiny_string>& headers, ILoadable* owner,
+			PRIORITY priority=PRIORITY_NORMAL);
 	void destroy(Downloader* downloader);
 };
 
@@ -178,7 +180,8 @@ private:
 public:
 	SystemState* sys;
 	PP_Resource audioconfig;
-	ppPluginEngineData(ppPluginInstance* i, uint32_t w, uint32_t h,SystemState* _sys) : EngineData(), instance(i),buffersswapped(false),sys(_sys),audioconfig(0)
+	PP_Resource audioresource;
+	ppPluginEngineData(ppPluginInstance* i, uint32_t w, uint32_t h,SystemState* _sys) : EngineData(), instance(i),buffersswapped(false),sys(_sys),audioconfig(0),audioresource(0)
 	{
 		hasExternalFontRenderer=true;
 		width = w;
@@ -299,13 +302,9 @@ public:
 	void exec_glGenerateMipmap_GL_TEXTURE_2D();
 
 	// Audio handling
-	virtual int audio_StreamInit(AudioStream* s);
-	virtual void audio_StreamPause(int channel, bool dopause);
-	virtual void audio_StreamSetVolume(int channel, double volume);
-	virtual void audio_StreamDeinit(int channel);
 	virtual bool audio_ManagerInit();
 	virtual void audio_ManagerCloseMixer();
-	virtual bool audio_ManagerOpenMixer();
+	virtual bool audio_ManagerOpenMixer(AudioManager* manager);
 	virtual void audio_ManagerDeinit();
 	virtual int audio_getSampleRate();
 
@@ -72,6 +72,7 @@
 #include <limits>
 #include <cmath>
 #include "swf.h"
+#include "scripting/cyclecollector.h"
 #include "scripting/toplevel/ASString.h"
 #include "scripting/toplevel/Date.h"
 #include "scripting/toplevel/JSON.h"
@@ -649,6 +650,8 @@ void ABCVm::registerClasses()
 	builtin->registerBuiltin("ApplicationDomain","flash.system",Class<ApplicationDomain>::getRef(m_sys));
 	builtin->registerBuiltin("SecurityDomain","flash.system",Class<SecurityDomain>::getRef(m_sys));
 	builtin->registerBuiltin("LoaderContext","flash.system",Class<LoaderContext>::getRef(m_sys));
+	builtin->registerBuiltin("MessageChannel","flash.system",Class<MessageChannel>::getRef(m_sys));
+	builtin->registerBuiltin("MessageChannelState","flash.system",Class<MessageChannelState>::getRef(m_sys));
 	builtin->registerBuiltin("System","flash.system",Class<System>::getRef(m_sys));
 	builtin->registerBuiltin("Worker","flash.system",Class<ASWorker>::getRef(m_sys));
 	builtin->registerBuiltin("WorkerDomain","flash.system",Class<WorkerDomain>::getRef(m_sys));
@@ -2159,6 +2162,8 @@ void ABCVm::Run(ABCVm* th)
 
 	/* set TLS variable for isVmThread() */
         tls_set(&is_vm_thread, GINT_TO_POINTER(1));
+	//Objects created by the VM are reference counted without atomic operations
+	RefCountable::registerOwnerThread();
 #ifndef NDEBUG
 	inStartupOrClose= false;
 #endif
@@ -2274,6 +2279,16 @@ void ABCVm::Run(ABCVm* th)
 		pair<_NR<EventDispatcher>,_R<Event>> e=th->events_queue.front();
 		th->handleFrontEvent();
 		profile->accountTime(chronometer.checkpoint());
+		//Destroy the objects released by other threads
+		RefCountable::processForeignReleases();
+		//No code is running between events, look for garbage cycles
+		if(!th->shuttingdown)
+		{
+			th->event_queue_mutex.lock();
+			bool idle=th->events_queue.empty();
+			th->event_queue_mutex.unlock();
+			th->m_sys->cycleCollector->collectIfNeeded(idle);
+		}
 #ifdef MEMORY_USAGE_PROFILING
 		if((snapshotCount%100)==0)
 			th->m_sys->saveMemoryUsageInformation(memoryProfile, snapshotCount);
@@ -2287,6 +2302,9 @@ void ABCVm::Run(ABCVm* th)
 		delete th->module;
 	}
 #endif
+	//Other threads may destroy the objects of the VM from now on
+	th->m_sys->cycleCollector->stopBuffering();
+	RefCountable::unregisterOwnerThread();
 #ifndef NDEBUG
 	inStartupOrClose= true;
 #endif
@@ -24,6 +24,7 @@
 #include "scripting/class.h"
 #include "scripting/toplevel/ASString.h"
 #include "scripting/toplevel/RegExp.h"
+#include "scripting/toplevel/Vector.h"
 #include "parsing/streams.h"
 #include <string>
 #include <sstream>
@@ -3865,6 +3866,17 @@ void ABCVm::abc_getProperty_local_constant_localresult(call_context* context)
 		LOG_CALL( _("getProperty_lcl ") << asAtomHandler::getInt(*instrptr->arg2_constant) << ' ' << asAtomHandler::toDebugString(context->locals[instrptr->local_pos1]));
 		asAtomHandler::as<Array>(context->locals[instrptr->local_pos1])->at_nocheck(prop,asAtomHandler::getInt(*instrptr->arg2_constant));
 	}
+	else if (asAtomHandler::isInteger(*instrptr->arg2_constant)
+			&& asAtomHandler::is<Vector>(context->locals[instrptr->local_pos1])
+			&& asAtomHandler::getInt(*instrptr->arg2_constant) >= 0
+			&& (uint32_t)asAtomHandler::getInt(*instrptr->arg2_constant) < asAtomHandler::as<Vector>(context->locals[instrptr->local_pos1])->size())
+	{
+		LOG_CALL( _("getProperty_lcl vector ") << asAtomHandler::getInt(*instrptr->arg2_constant) << ' ' << asAtomHandler::toDebugString(context->locals[instrptr->local_pos1]));
+		//The element replaces the result directly, reusing the Number stored there if possible
+		asAtomHandler::as<Vector>(context->locals[instrptr->local_pos1])->replaceWithElement(context->locals[instrptr->local_pos3-1],asAtomHandler::getInt(*instrptr->arg2_constant));
+		++(context->exec_pos);
+		return;
+	}
 	else
 	{
 		multiname* name=context->mi->context->getMultinameImpl(*instrptr->arg2_constant,NULL,t,false);
@@ -3914,6 +3926,17 @@ void ABCVm::abc_getProperty_local_local_localresult(call_context* context)
 		LOG_CALL( _("getProperty_lll int ") << asAtomHandler::getInt(context->locals[instrptr->local_pos2]) << ' ' << asAtomHandler::toDebugString(context->locals[instrptr->local_pos1]));
 		asAtomHandler::as<Array>(context->locals[instrptr->local_pos1])->at_nocheck(prop,asAtomHandler::getInt(context->locals[instrptr->local_pos2]));
 	}
+	else if (asAtomHandler::isInteger(context->locals[instrptr->local_pos2])
+			&& asAtomHandler::is<Vector>(context->locals[instrptr->local_pos1])
+			&& asAtomHandler::getInt(context->locals[instrptr->local_pos2]) >= 0
+			&& (uint32_t)asAtomHandler::getInt(context->locals[instrptr->local_pos2]) < asAtomHandler::as<Vector>(context->locals[instrptr->local_pos1])->size())
+	{
+		LOG_CALL( _("getProperty_lll vector ") << asAtomHandler::getInt(context->locals[instrptr->local_pos2]) << ' ' << asAtomHandler::toDebugString(context->locals[instrptr->local_pos1]));
+		//The element replaces the result directly, reusing the Number stored there if possible
+		asAtomHandler::as<Vector>(context->locals[instrptr->local_pos1])->replaceWithElement(context->locals[instrptr->local_pos3-1],asAtomHandler::getInt(context->locals[instrptr->local_pos2]));
+		++(context->exec_pos);
+		return;
+	}
 	else
 	{
 		multiname* name=context->mi->context->getMultinameImpl(context->locals[instrptr->local_pos2],NULL,t,false);
@@ -0,0 +1,305 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include <sstream>
+#include <unordered_map>
+#include "scripting/abc.h"
+#include "scripting/cyclecollector.h"
+#include "swf.h"
+#include "scripting/flash/display/DisplayObject.h"
+#include "logger.h"
+#include "timer.h"
+
+//Number of buffered candidates that triggers a collection after the current event
+#define COLLECT_THRESHOLD 100000
+//Number of buffered candidates that triggers a collection while the VM is idle
+#define IDLE_COLLECT_THRESHOLD 1000
+//Minimum time between two collections triggered by idleness, in milliseconds
+#define IDLE_COLLECT_INTERVAL 1000
+
+using namespace std;
+using namespace lightspark;
+
+void RefCountable::addCycleCandidate()
+{
+	//Only ASObjects are traceable
+	ASObject* o=static_cast<ASObject*>(this);
+	SystemState* sys=o->getSystemState();
+	if(sys==NULL)
+		cycleTraceable=false;
+	else if(sys->cycleCollector)
+		sys->cycleCollector->addCandidate(o);
+}
+
+void RefCountable::removeCycleCandidate()
+{
+	ASObject* o=static_cast<ASObject*>(this);
+	SystemState* sys=o->getSystemState();
+	if(sys && sys->cycleCollector)
+		sys->cycleCollector->removeCandidate(o);
+	else
+		cycleBuffered=false;
+}
+
+CycleCollector::CycleCollector(SystemState* s):sys(s),emptySlots(0),buffering(true),collectionRequested(false),profile(NULL),lastCollection(0),collections(0),
+	totalPauseTime(0),totalReclaimedObjects(0),totalReclaimedBytes(0)
+{
+}
+
+CycleCollector::~CycleCollector()
+{
+	stopBuffering();
+}
+
+void CycleCollector::stopBuffering()
+{
+	buffering=false;
+	for(auto it=candidates.begin();it!=candidates.end();++it)
+	{
+		if(*it)
+			(*it)->setCycleBuffered(false);
+	}
+	candidates.clear();
+	emptySlots=0;
+}
+
+bool CycleCollector::isCollectable(ASObject* o)
+{
+	//Classes, globals and activation objects are referenced from the VM
+	//without references being counted. Primitives can't be part of a cycle
+	switch(o->getObjectType())
+	{
+		case T_CLASS:
+		case T_TEMPLATE:
+		case T_INTEGER:
+		case T_UINTEGER:
+		case T_NUMBER:
+		case T_STRING:
+		case T_BOOLEAN:
+		case T_NULL:
+		case T_UNDEFINED:
+		case T_NAMESPACE:
+		case T_QNAME:
+			return false;
+		default:
+			break;
+	}
+	return !o->is<Global>() && !o->is<Activation_object>();
+}
+
+void CycleCollector::addCandidate(ASObject* o)
+{
+	//Objects may be shared between concurrently running workers
+	if(!sys->singleworker || !buffering)
+		return;
+	if(!isCollectable(o))
+	{
+		o->setCycleTraceable(false);
+		return;
+	}
+	o->setCycleBuffered(true);
+	o->setCycleIndex(candidates.size());
+	candidates.push_back(o);
+}
+
+void CycleCollector::removeCandidate(ASObject* o)
+{
+	o->setCycleBuffered(false);
+	candidates[o->getCycleIndex()]=NULL;
+	emptySlots++;
+}
+
+void CycleCollector::compactCandidates()
+{
+	uint32_t count=0;
+	for(auto it=candidates.begin();it!=candidates.end();++it)
+	{
+		if(*it==NULL)
+			continue;
+		(*it)->setCycleIndex(count);
+		candidates[count++]=*it;
+	}
+	candidates.resize(count);
+	emptySlots=0;
+}
+
+void CycleCollector::collectIfNeeded(bool idle)
+{
+	//Short lived objects leave many empty slots behind
+	if(emptySlots>candidates.size()/2)
+		compactCandidates();
+	uint32_t count=candidates.size()-emptySlots;
+	if(collectionRequested || count>=COLLECT_THRESHOLD ||
+		(idle && count>=IDLE_COLLECT_THRESHOLD && compat_msectiming()-lastCollection>=IDLE_COLLECT_INTERVAL))
+		collect();
+}
+
+uint32_t CycleCollector::collect()
+{
+	Chronometer chronometer;
+	vector<ASObject*> roots;
+	roots.reserve(candidates.size()-emptySlots);
+	for(auto it=candidates.begin();it!=candidates.end();++it)
+	{
+		if(*it==NULL)
+			continue;
+		(*it)->setCycleBuffered(false);
+		roots.push_back(*it);
+	}
+	candidates.clear();
+	emptySlots=0;
+	collectionRequested=false;
+	lastCollection=compat_msectiming();
+
+	struct node
+	{
+		ASObject* obj;
+		//references from outside of the subgraph
+		int32_t refs;
+		//range of the outgoing references in edges
+		uint32_t firstEdge;
+		uint32_t lastEdge;
+		uint32_t tracedRefs;
+		bool alive;
+	};
+	vector<node> nodes;
+	vector<uint32_t> edges;
+	//UINT32_MAX marks objects that are not collected in this run
+	unordered_map<ASObject*,uint32_t> index;
+	auto getNode=[&](ASObject* o) -> uint32_t
+	{
+		auto it=index.find(o);
+		if(it!=index.end())
+			return it->second;
+		uint32_t ret=UINT32_MAX;
+		//Objects referenced by the display list or by code currently running
+		//are treated as externally referenced and not traced further
+		if(o->getCycleTraceable() && !o->getConstant() && !o->getCached() && !o->getInDestruction()
+			&& o->getActivationCount()==1 && o->getSystemState()==sys && isCollectable(o)
+			&& (!o->is<DisplayObject>() || (o->as<DisplayObject>()->getParent()==NULL && !o->as<DisplayObject>()->isOnStage())))
+		{
+			ret=nodes.size();
+			node n;
+			n.obj=o;
+			n.refs=o->getRefCount();
+			n.firstEdge=0;
+			n.lastEdge=0;
+			n.tracedRefs=0;
+			n.alive=false;
+			nodes.push_back(n);
+		}
+		index[o]=ret;
+		return ret;
+	};
+
+	//Build the subgraph reachable from the candidates
+	for(auto it=roots.begin();it!=roots.end();++it)
+		getNode(*it);
+	vector<ASObject*> refs;
+	for(uint32_t i=0;i<nodes.size();i++)
+	{
+		refs.clear();
+		nodes[i].obj->traceReferences(refs);
+		nodes[i].firstEdge=edges.size();
+		nodes[i].tracedRefs=refs.size();
+		for(auto it=refs.begin();it!=refs.end();++it)
+		{
+			uint32_t n=getNode(*it);
+			if(n!=UINT32_MAX)
+				edges.push_back(n);
+		}
+		nodes[i].lastEdge=edges.size();
+	}
+
+	//Trial deletion: remove the references coming from inside the subgraph
+	for(uint32_t i=0;i<nodes.size();i++)
+	{
+		for(uint32_t e=nodes[i].firstEdge;e<nodes[i].lastEdge;e++)
+			nodes[edges[e]].refs--;
+	}
+	vector<uint32_t> stack;
+	for(uint32_t i=0;i<nodes.size();i++)
+	{
+		if(nodes[i].refs<0)
+		{
+			//More references have been traced than the object has
+			LOG(LOG_ERROR,"cycle collector: inconsistent reference count for " << nodes[i].obj->toDebugString());
+			return 0;
+		}
+		if(nodes[i].refs>0)
+		{
+			nodes[i].alive=true;
+			stack.push_back(i);
+		}
+	}
+	//Everything reachable from an externally referenced object is alive
+	while(!stack.empty())
+	{
+		uint32_t i=stack.back();
+		stack.pop_back();
+		for(uint32_t e=nodes[i].firstEdge;e<nodes[i].lastEdge;e++)
+		{
+			node& n=nodes[edges[e]];
+			if(!n.alive)
+			{
+				n.alive=true;
+				stack.push_back(edges[e]);
+			}
+		}
+	}
+
+	vector<ASObject*> garbage;
+	uint64_t bytes=0;
+	for(uint32_t i=0;i<nodes.size();i++)
+	{
+		if(nodes[i].alive)
+			continue;
+		garbage.push_back(nodes[i].obj);
+		bytes+=sizeof(ASObject)+nodes[i].tracedRefs*sizeof(asAtom);
+	}
+	//Keep all the garbage alive while the cycles are broken, then release it
+	for(auto it=garbage.begin();it!=garbage.end();++it)
+		(*it)->incRef();
+	for(auto it=garbage.begin();it!=garbage.end();++it)
+		(*it)->clearReferences();
+	for(auto it=garbage.begin();it!=garbage.end();++it)
+		(*it)->decRef();
+
+	uint32_t pause=chronometer.checkpoint();
+	collections++;
+	totalPauseTime+=pause;
+	totalReclaimedObjects+=garbage.size();
+	totalReclaimedBytes+=bytes;
+	if(profile==NULL)
+	{
+		profile=sys->allocateProfiler(RGB(200,0,200));
+		profile->setTag("GC");
+	}
+	profile->accountTime(pause);
+	if(!garbage.empty())
+	{
+		ostringstream tag;
+		tag << "GC " << garbage.size() << " objects, " << bytes/1024 << "KB";
+		profile->setTag(tag.str());
+		LOG(LOG_INFO,"cycle collector: reclaimed " << garbage.size() << " objects (" << bytes << " bytes) out of "
+			<< nodes.size() << " traced in " << pause << "us, total " << totalReclaimedObjects << " objects ("
+			<< totalReclaimedBytes << " bytes) in " << collections << " collections");
+	}
+	return garbage.size();
+}
@@ -0,0 +1,90 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#ifndef SCRIPTING_CYCLECOLLECTOR_H
+#define SCRIPTING_CYCLECOLLECTOR_H 1
+
+#include "compat.h"
+#include <vector>
+
+namespace lightspark
+{
+
+class ASObject;
+class SystemState;
+class ThreadProfile;
+
+/*
+ * Synchronous trial deletion collector for reference cycles between ASObjects.
+ * Objects that survive a decRef are buffered as possible cycle roots. A collection
+ * computes, for the subgraph reachable from the roots, how many references each
+ * object gets from outside of the subgraph. Objects that are not reachable from
+ * any externally referenced object are garbage, their references are released
+ * to break the cycles.
+ * Only references reported by ASObject::traceReferences are subtracted, so a
+ * missing reference only keeps objects alive.
+ * Collections run in the VM thread between events, when no AS code is running.
+ * Only the VM thread buffers candidates, objects it owns are only destroyed by it, so
+ * the buffer is used without locking. Destroyed candidates leave an empty slot behind.
+ */
+class CycleCollector
+{
+private:
+	SystemState* sys;
+	//Buffered possible roots, NULL for candidates destroyed since
+	std::vector<ASObject*> candidates;
+	uint32_t emptySlots;
+	//Cleared when the VM thread stops, its objects may be destroyed by any thread afterwards
+	bool buffering;
+	//Set by System.gc, the next check between events collects regardless of the thresholds
+	bool collectionRequested;
+	ThreadProfile* profile;
+	uint64_t lastCollection;
+	uint32_t collections;
+	uint64_t totalPauseTime;
+	uint64_t totalReclaimedObjects;
+	uint64_t totalReclaimedBytes;
+	static bool isCollectable(ASObject* o);
+	void compactCandidates();
+public:
+	CycleCollector(SystemState* s);
+	~CycleCollector();
+	void addCandidate(ASObject* o);
+	void removeCandidate(ASObject* o);
+	// Drops all candidates and stops buffering new ones, called by the VM thread before it terminates
+	void stopBuffering();
+	/* Runs a collection if enough candidates are buffered,
+	 * idle means that there are no pending events in the VM
+	 */
+	void collectIfNeeded(bool idle);
+	// Makes the next collectIfNeeded run a collection, called by the VM thread
+	void requestCollection() { collectionRequested=true; }
+	// returns the number of objects reclaimed
+	uint32_t collect();
+	uint32_t getCollections() const { return collections; }
+	// pause time in microseconds
+	uint64_t getTotalPauseTime() const { return totalPauseTime; }
+	uint64_t getTotalReclaimedObjects() const { return totalReclaimedObjects; }
+	// the size of the objects and of their references, the memory of other
+	// contents (e.g. strings and bitmaps) is not accounted
+	uint64_t getTotalReclaimedBytes() const { return totalReclaimedBytes; }
+};
+
+}
+#endif /* SCRIPTING_CYCLECOLLECTOR_H */
@@ -23,13 +23,14 @@
 using namespace std;
 using namespace lightspark;
 
-ASCondition::ASCondition(Class_base* c):ASObject(c)
+ASCondition::ASCondition(Class_base* c):ASObject(c,T_OBJECT,SUBTYPE_CONDITION)
 {
 	
 }
 void ASCondition::sinit(Class_base* c)
 {
 	CLASS_SETUP(c, ASObject, _constructor, CLASS_FINAL);
+	//Workers don't run on their own threads yet
 	c->setVariableByQName("isSupported","",abstract_b(c->getSystemState(),false),CONSTANT_TRAIT);
 	c->setDeclaredMethodByQName("notify","",Class<IFunction>::getFunction(c->getSystemState(),_notify),NORMAL_METHOD,true);
 	c->setDeclaredMethodByQName("notifyAll","",Class<IFunction>::getFunction(c->getSystemState(),_notifyAll),NORMAL_METHOD,true);
@@ -51,29 +52,40 @@ ASFUNCTIONBODY_ATOM(ASCondition,_constructor)
 		throwError<ArgumentError>(kInvalidArgumentError) ;
 	arg->incRef();
 	th->mutex = _NR<ASMutex>(arg->as<ASMutex>());
+	LOG(LOG_NOT_IMPLEMENTED,"Condition can't block workers, they all run on the VM thread");
 }
 ASFUNCTIONBODY_ATOM(ASCondition,_notify)
 {
-	LOG(LOG_NOT_IMPLEMENTED,"condition notify not implemented");
 	ASCondition* th=asAtomHandler::as<ASCondition>(obj);
-	if (!th->mutex->getLockCount())
-		throwError<ASError>(kConditionCannotNotify);
+	ASMutex* m=th->mutex.getPtr();
+	Locker l(m->mutex);
+	if (m->owner!=compat_thread_token())
+		throwError<IllegalOperationError>(kConditionCannotNotify);
+	//Nobody can be waiting, see wait
 	asAtomHandler::setNull(ret);
 }
 ASFUNCTIONBODY_ATOM(ASCondition,_notifyAll)
 {
-	LOG(LOG_NOT_IMPLEMENTED,"condition notifyAll not implemented");
 	ASCondition* th=asAtomHandler::as<ASCondition>(obj);
-	if (!th->mutex->getLockCount())
-		throwError<ASError>(kConditionCannotNotifyAll) ;
+	ASMutex* m=th->mutex.getPtr();
+	Locker l(m->mutex);
+	if (m->owner!=compat_thread_token())
+		throwError<IllegalOperationError>(kConditionCannotNotifyAll);
 	asAtomHandler::setNull(ret);
 }
 ASFUNCTIONBODY_ATOM(ASCondition,_wait)
 {
-	LOG(LOG_NOT_IMPLEMENTED,"condition wait not implemented");
 	ASCondition* th=asAtomHandler::as<ASCondition>(obj);
-	if (!th->mutex->getLockCount())
-		throwError<ASError>(kConditionCannotWait) ;
-	asAtomHandler::setBool(ret,true);
+	number_t timeout;
+	ARG_UNPACK_ATOM(timeout,-1);
+	if (std::isnan(timeout) || (timeout<0 && timeout!=-1))
+		throwError<ArgumentError>(kConditionInvalidTimeout);
+	ASMutex* m=th->mutex.getPtr();
+	Locker l(m->mutex);
+	if (m->owner!=compat_thread_token())
+		throwError<IllegalOperationError>(kConditionCannotWait);
+	//All workers run their code on the VM thread, nobody could notify us
+	//and waiting for the timeout would only block the player
+	LOG(LOG_NOT_IMPLEMENTED,"Condition.wait can't wait for other workers, they all run on the VM thread");
+	asAtomHandler::setBool(ret,false);
 }
-
@@ -16,42 +16,64 @@
 **************************************************************************/
 
 #include "scripting/flash/concurrent/Mutex.h"
+#include "scripting/flash/errors/flasherrors.h"
 #include "scripting/class.h"
 #include "scripting/argconv.h"
 
 using namespace std;
 using namespace lightspark;
 
-ASMutex::ASMutex(Class_base* c):ASObject(c,T_OBJECT,SUBTYPE_MUTEX),lockcount(0)
+ASMutex::ASMutex(Class_base* c):ASObject(c,T_OBJECT,SUBTYPE_MUTEX),owner(NULL),lockcount(0)
 {
 	
 }
 void ASMutex::sinit(Class_base* c)
 {
 	CLASS_SETUP(c, ASObject, _constructor, CLASS_FINAL);
+	//Workers don't run on their own threads yet
+	c->setVariableByQName("isSupported","",abstract_b(c->getSystemState(),false),CONSTANT_TRAIT);
 	c->setDeclaredMethodByQName("lock","",Class<IFunction>::getFunction(c->getSystemState(),_lock),NORMAL_METHOD,true);
 	c->setDeclaredMethodByQName("unlock","",Class<IFunction>::getFunction(c->getSystemState(),_unlock),NORMAL_METHOD,true);
 	c->setDeclaredMethodByQName("tryLock","",Class<IFunction>::getFunction(c->getSystemState(),_trylock),NORMAL_METHOD,true);
 }
 
+bool ASMutex::isLockedByCurrentThread()
+{
+	Locker l(mutex);
+	return owner==compat_thread_token();
+}
+
 ASFUNCTIONBODY_ATOM(ASMutex,_constructor)
 {
+	LOG(LOG_NOT_IMPLEMENTED,"Mutex doesn't exclude workers from each other, they all run on the VM thread");
 }
 ASFUNCTIONBODY_ATOM(ASMutex,_lock)
 {
 	ASMutex* th=asAtomHandler::as<ASMutex>(obj);
-	th->mutex.lock();
+	Locker l(th->mutex);
+	th->owner=compat_thread_token();
 	th->lockcount++;
 }
 ASFUNCTIONBODY_ATOM(ASMutex,_unlock)
 {
 	ASMutex* th=asAtomHandler::as<ASMutex>(obj);
-	th->mutex.unlock();
-	th->lockcount--;
+	Locker l(th->mutex);
+	if(th->owner!=compat_thread_token())
+		throwError<IllegalOperationError>(kMutextNotLocked);
+	if(--th->lockcount==0)
+		th->owner=NULL;
 }
 ASFUNCTIONBODY_ATOM(ASMutex,_trylock)
 {
 	ASMutex* th=asAtomHandler::as<ASMutex>(obj);
-	asAtomHandler::setBool(ret,th->mutex.trylock());
+	const void* current=compat_thread_token();
+	Locker l(th->mutex);
+	if(th->owner && th->owner!=current)
+	{
+		asAtomHandler::setBool(ret,false);
+		return;
+	}
+	th->owner=current;
+	th->lockcount++;
+	asAtomHandler::setBool(ret,true);
 }
-
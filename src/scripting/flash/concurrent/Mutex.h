@@ -26,8 +26,13 @@ namespace lightspark
 
 class ASMutex: public ASObject
 {
+friend class ASCondition;
 private:
-	RecMutex mutex;
+	//Protects owner and lockcount
+	Mutex mutex;
+	//The thread holding the lock, NULL if the mutex is not locked. Workers
+	//all run on the VM thread, so another thread never holds it
+	const void* owner;
 	int lockcount;
 
 public:
@@ -37,7 +42,7 @@ public:
 	ASFUNCTION_ATOM(_lock);
 	ASFUNCTION_ATOM(_unlock);
 	ASFUNCTION_ATOM(_trylock);
-	int getLockCount() { return lockcount; }
+	bool isLockedByCurrentThread();
 };
 
 }
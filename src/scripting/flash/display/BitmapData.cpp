@@ -635,11 +635,9 @@ ASFUNCTIONBODY_ATOM(BitmapData,histogram)
 	{
 		Template<Vector>::getInstanceS(v,sys,Class<Number>::getClass(sys),NullRef);
 		Vector *histogram = asAtomHandler::as<Vector>(v);
+		histogram->reserve(256);
 		for (int level=0; level<256; level++)
-		{
-			asAtom v = asAtomHandler::fromUInt(counts[channelOrder[j]][level]);
-			histogram->append(v);
-		}
+			histogram->appendNumber(counts[channelOrder[j]][level]);
 		asAtom v = asAtomHandler::fromObject(histogram);
 		result->append(v);
 	}
@@ -729,12 +727,10 @@ ASFUNCTIONBODY_ATOM(BitmapData,getVector)
 	Template<Vector>::getInstanceS(v,sys,Class<UInteger>::getClass(sys),NullRef);
 	Vector *result = asAtomHandler::as<Vector>(v);
 	vector<uint32_t> pixelvec = th->pixels->getPixelVector(rect->getRect());
+	result->reserve(pixelvec.size());
 	vector<uint32_t>::const_iterator it;
 	for (it=pixelvec.begin(); it!=pixelvec.end(); ++it)
-	{
-		asAtom v = asAtomHandler::fromUInt(*it);
-		result->append(v);
-	}
+		result->appendUInt(*it);
 	ret = asAtomHandler::fromObject(result);
 }
 
@@ -794,8 +790,7 @@ ASFUNCTIONBODY_ATOM(BitmapData,setVector)
 			if (i >= inputVector->size())
 				throwError<RangeError>(kParamRangeError);
 
-			asAtom v = inputVector->at(i);
-			uint32_t pixel = asAtomHandler::toUInt(v);
+			uint32_t pixel = inputVector->uintAt(i);
 			th->pixels->setPixel(x, y, pixel, th->transparent);
 			i++;
 		}
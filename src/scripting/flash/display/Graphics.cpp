@@ -543,44 +543,33 @@ void Graphics::pathToTokens(_NR<Vector> commands, _NR<Vector> data,
 	if (winding != "evenOdd")
 		LOG(LOG_NOT_IMPLEMENTED, "Only event-odd winding implemented in Graphics.drawPath");
 
-	asAtom zero = asAtomHandler::fromInt(0);
-
 	int k = 0;
 	for (unsigned int i=0; i<commands->size(); i++)
 	{
-		asAtom c = commands->at(i);
-		switch (asAtomHandler::toInt(c))
+		switch ((int)commands->numberAt(i))
 		{
 			case GraphicsPathCommand::MOVE_TO:
 			{
-				asAtom ax = data->at(k++, zero);
-				asAtom ay = data->at(k++, zero);
-				number_t x = asAtomHandler::toNumber(ax);
-				number_t y = asAtomHandler::toNumber(ay);
+				number_t x = data->numberAt(k++);
+				number_t y = data->numberAt(k++);
 				tokens.emplace_back(_MR(new GeomToken(MOVE, Vector2(x, y))));
 				break;
 			}
 
 			case GraphicsPathCommand::LINE_TO:
 			{
-				asAtom ax = data->at(k++, zero);
-				asAtom ay = data->at(k++, zero);
-				number_t x = asAtomHandler::toNumber(ax);
-				number_t y = asAtomHandler::toNumber(ay);
+				number_t x = data->numberAt(k++);
+				number_t y = data->numberAt(k++);
 				tokens.emplace_back(_MR(new GeomToken(STRAIGHT, Vector2(x, y))));
 				break;
 			}
 
 			case GraphicsPathCommand::CURVE_TO:
 			{
-				asAtom acx = data->at(k++, zero);
-				asAtom acy = data->at(k++, zero);
-				number_t cx = asAtomHandler::toNumber(acx);
-				number_t cy = asAtomHandler::toNumber(acy);
-				asAtom ax = data->at(k++, zero);
-				asAtom ay = data->at(k++, zero);
-				number_t x = asAtomHandler::toNumber(ax);
-				number_t y = asAtomHandler::toNumber(ay);
+				number_t cx = data->numberAt(k++);
+				number_t cy = data->numberAt(k++);
+				number_t x = data->numberAt(k++);
+				number_t y = data->numberAt(k++);
 				tokens.emplace_back(_MR(new GeomToken(CURVE_QUADRATIC,
 							      Vector2(cx, cy),
 							      Vector2(x, y))));
@@ -590,10 +579,8 @@ void Graphics::pathToTokens(_NR<Vector> commands, _NR<Vector> data,
 			case GraphicsPathCommand::WIDE_MOVE_TO:
 			{
 				k+=2;
-				asAtom ax = data->at(k++, zero);
-				asAtom ay = data->at(k++, zero);
-				number_t x = asAtomHandler::toNumber(ax);
-				number_t y = asAtomHandler::toNumber(ay);
+				number_t x = data->numberAt(k++);
+				number_t y = data->numberAt(k++);
 				tokens.emplace_back(_MR(new GeomToken(MOVE, Vector2(x, y))));
 				break;
 			}
@@ -601,28 +588,20 @@ void Graphics::pathToTokens(_NR<Vector> commands, _NR<Vector> data,
 			case GraphicsPathCommand::WIDE_LINE_TO:
 			{
 				k+=2;
-				asAtom ax = data->at(k++, zero);
-				asAtom ay = data->at(k++, zero);
-				number_t x = asAtomHandler::toNumber(ax);
-				number_t y = asAtomHandler::toNumber(ay);
+				number_t x = data->numberAt(k++);
+				number_t y = data->numberAt(k++);
 				tokens.emplace_back(_MR(new GeomToken(STRAIGHT, Vector2(x, y))));
 				break;
 			}
 
 			case GraphicsPathCommand::CUBIC_CURVE_TO:
 			{
-				asAtom ac1x = data->at(k++, zero);
-				asAtom ac1y = data->at(k++, zero);
-				asAtom ac2x = data->at(k++, zero);
-				asAtom ac2y = data->at(k++, zero);
-				number_t c1x = asAtomHandler::toNumber(ac1x);
-				number_t c1y = asAtomHandler::toNumber(ac1y);
-				number_t c2x = asAtomHandler::toNumber(ac2x);
-				number_t c2y = asAtomHandler::toNumber(ac2y);
-				asAtom ax = data->at(k++, zero);
-				asAtom ay = data->at(k++, zero);
-				number_t x = asAtomHandler::toNumber(ax);
-				number_t y = asAtomHandler::toNumber(ay);
+				number_t c1x = data->numberAt(k++);
+				number_t c1y = data->numberAt(k++);
+				number_t c2x = data->numberAt(k++);
+				number_t c2y = data->numberAt(k++);
+				number_t x = data->numberAt(k++);
+				number_t y = data->numberAt(k++);
 				tokens.emplace_back(_MR(new GeomToken(CURVE_CUBIC,
 							      Vector2(c1x, c1y),
 							      Vector2(c2x, c2y),
@@ -776,21 +755,16 @@ void Graphics::drawTrianglesToTokens(_NR<Vector> vertices, _NR<Vector> indices,
 				vertex=3*i+j;
 			else
 			{
-				asAtom a =indices->at(3*i+j);
-				vertex=asAtomHandler::toInt(a);
+				vertex=(int)indices->numberAt(3*i+j);
 			}
 
-			asAtom ax = vertices->at(2*vertex);
-			x[j]=asAtomHandler::toNumber(ax);
-			asAtom ay = vertices->at(2*vertex+1);
-			y[j]=asAtomHandler::toNumber(ay);;
+			x[j]=vertices->numberAt(2*vertex);
+			y[j]=vertices->numberAt(2*vertex+1);
 
 			if (has_uvt)
 			{
-				asAtom au = uvtData->at(vertex*uvtElemSize);
-				u[j]=asAtomHandler::toNumber(au)*texturewidth;
-				asAtom av = uvtData->at(vertex*uvtElemSize+1);
-				v[j]=asAtomHandler::toNumber(av)*textureheight;
+				u[j]=uvtData->numberAt(vertex*uvtElemSize)*texturewidth;
+				v[j]=uvtData->numberAt(vertex*uvtElemSize+1)*textureheight;
 			}
 		}
 		
@@ -236,7 +236,7 @@ _NR<DisplayObject> TokenContainer::hitTestImpl(_NR<DisplayObject> last, number_t
 {
 	//Masks have been already checked along the way
 
-	if(CairoTokenRenderer::hitTest(tokens, scaling, x, y))
+	if(outlineCache.hitTest(tokens, scaling, x, y))
 		return last;
 	return NullRef;
 }
@@ -58,6 +58,8 @@ public:
 	static void getTextureSize(std::vector<_NR<GeomToken>, reporter_allocator<_NR<GeomToken>>> &tokens, int *width, int *height);
 	uint16_t getCurrentLineWidth() const;
 	float scaling;
+private:
+	mutable OutlineCache outlineCache;
 protected:
 	TokenContainer(DisplayObject* _o, MemoryAccount* _m);
 	TokenContainer(DisplayObject* _o, MemoryAccount* _m, const tokensVector& _tokens, float _scaling);
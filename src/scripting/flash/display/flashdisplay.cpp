@@ -386,8 +386,16 @@ void LoaderThread::execute()
 	streambuf *sbuf = 0;
 	if(source==URL)
 	{
-		_R<MemoryStreamCache> cache(_MR(new MemoryStreamCache(loader->getSystemState())));
-		if(!createDownloader(cache, loaderInfo, loaderInfo.getPtr(), false))
+		StreamCache* c;
+		//Local files are mapped and parsed in place. The plugins
+		//fetch them through the browser, so they need a regular cache
+		if(loader->getSystemState()->standalone && url.getProtocol() == "file")
+			c = new MappedFileStreamCache(loader->getSystemState());
+		else
+			c = new MemoryStreamCache(loader->getSystemState());
+		_R<StreamCache> cache(_MR(c));
+		//Movies are started before the assets they will load
+		if(!createDownloader(cache, loaderInfo, loaderInfo.getPtr(), false, DownloadManager::PRIORITY_HIGH))
 			return;
 
 		sbuf = cache->createReader();
@@ -974,11 +982,12 @@ _NR<DisplayObject> DisplayObjectContainer::hitTestImpl(_NR<DisplayObject> last,
 		if((*j)->isMask())
 			continue;
 
-		if(!(*j)->getMatrix().isInvertible())
+		const MATRIX childMatrix=(*j)->getMatrix();
+		if(!childMatrix.isInvertible())
 			continue; /* The object is shrunk to zero size */
 
 		number_t localX, localY;
-		(*j)->getMatrix().getInverted().multiply2D(x,y,localX,localY);
+		childMatrix.getInverted().multiply2D(x,y,localX,localY);
 		this->incRef();
 		ret=(*j)->hitTest(_MR(this), localX,localY, type,interactiveObjectsOnly);
 		if(!ret.isNull())
@@ -1003,8 +1003,7 @@ ASFUNCTIONBODY_ATOM(Context3D,setProgramConstantsFromVector)
 		action.fdata= new float[action.udata3*4];
 		for (uint32_t i = 0; i < action.udata3*4; i++)
 		{
-			asAtom a = data->at(i);
-			action.fdata[i] = asAtomHandler::toNumber(a);
+			action.fdata[i] = data->numberAt(i);
 		}
 		th->addAction(action);
 	}
@@ -1348,8 +1347,7 @@ ASFUNCTIONBODY_ATOM(IndexBuffer3D,uploadFromVector)
 		th->data.resize(count+startOffset);
 	for (uint32_t i = 0; i< count; i++)
 	{
-		asAtom a = data->at(i);
-		th->data[startOffset+i] = asAtomHandler::toUInt(a);
+		th->data[startOffset+i] = data->uintAt(i);
 	}
 }
 
@@ -1455,8 +1453,7 @@ ASFUNCTIONBODY_ATOM(VertexBuffer3D,uploadFromVector)
 		th->data.resize((numVertices+startVertex)* th->data32PerVertex);
 	for (uint32_t i = 0; i< numVertices* th->data32PerVertex; i++)
 	{
-		asAtom a = data->at(i);
-		th->data[startVertex*th->data32PerVertex+i] = asAtomHandler::toNumber(a);
+		th->data[startVertex*th->data32PerVertex+i] = data->numberAt(i);
 	}
 }
 
@@ -545,6 +545,35 @@ void EventDispatcher::finalize()
 	handlers.clear();
 }
 
+void EventDispatcher::traceReferences(std::vector<ASObject*>& refs)
+{
+	ASObject::traceReferences(refs);
+	Locker l(handlersMutex);
+	for (auto it = handlers.begin(); it != handlers.end(); ++it)
+	{
+		for (auto itl = it->second.begin(); itl != it->second.end(); ++itl)
+		{
+			if (asAtomHandler::isObject(itl->f))
+				refs.push_back(asAtomHandler::getObjectNoCheck(itl->f));
+		}
+	}
+}
+
+void EventDispatcher::clearReferences()
+{
+	std::map<tiny_string,std::list<listener> > tmp;
+	{
+		Locker l(handlersMutex);
+		tmp.swap(handlers);
+	}
+	for (auto it = tmp.begin(); it != tmp.end(); ++it)
+	{
+		for (auto itl = it->second.begin(); itl != it->second.end(); ++itl)
+			ASATOM_DECREF(itl->f);
+	}
+	ASObject::clearReferences();
+}
+
 void EventDispatcher::sinit(Class_base* c)
 {
 	CLASS_SETUP(c, ASObject, _constructor, CLASS_SEALED);
@@ -366,6 +366,8 @@ protected:
 public:
 	EventDispatcher(Class_base* c);
 	void finalize();
+	void traceReferences(std::vector<ASObject*>& refs);
+	void clearReferences();
 	// is called when a new event is added to the event queue
 	virtual void onNewEvent(){}
 	// is called after an event was handled by the event queue
@@ -1980,8 +1980,7 @@ ASFUNCTIONBODY_ATOM(Matrix3D,_constructor)
 	{
 		for (uint32_t i = 0; i < v->size() && i < 4*4; i++)
 		{
-			asAtom a = v->at(i);
-			th->data[i] = asAtomHandler::toNumber(a);
+			th->data[i] = v->numberAt(i);
 		}
 	}
 }
@@ -2160,8 +2159,7 @@ ASFUNCTIONBODY_ATOM(Matrix3D,copyRawDataFrom)
 		LOG(LOG_NOT_IMPLEMENTED, "Matrix3D.copyRawDataFrom ignores parameter 'transpose'");
 	for (uint32_t i = 0; i < vector->size()-index && i < 16; i++)
 	{
-		asAtom a = vector->at(index+i);
-		th->data[i] = asAtomHandler::toNumber(a);
+		th->data[i] = vector->numberAt(index+i);
 	}
 }
 
@@ -2275,11 +2273,9 @@ ASFUNCTIONBODY_ATOM(Matrix3D,_get_rawData)
 	asAtom v=asAtomHandler::invalidAtom;
 	Template<Vector>::getInstanceS(v,sys,Class<Number>::getClass(sys),NullRef);
 	Vector *result = asAtomHandler::as<Vector>(v);
+	result->reserve(4*4);
 	for (uint32_t i = 0; i < 4*4; i++)
-	{
-		asAtom o = asAtomHandler::fromNumber(sys,th->data[i],false);
-		result->append(o);
-	}
+		result->appendNumber(th->data[i]);
 	ret =asAtomHandler::fromObject(result);
 }
 ASFUNCTIONBODY_ATOM(Matrix3D,_set_rawData)
@@ -2290,8 +2286,7 @@ ASFUNCTIONBODY_ATOM(Matrix3D,_set_rawData)
 	// TODO handle not invertible argument
 	for (uint32_t i = 0; i < data->size(); i++)
 	{
-		asAtom a = data->at(i);
-		th->data[i] = asAtomHandler::toNumber(a);
+		th->data[i] = data->numberAt(i);
 	}
 }
 ASFUNCTIONBODY_ATOM(Matrix3D,_get_position)
@@ -23,6 +23,7 @@
 #include "compat.h"
 #include <iostream>
 #include "backends/audio.h"
+#include "backends/config.h"
 #include "backends/rendering.h"
 #include "backends/streamcache.h"
 #include "scripting/argconv.h"
@@ -327,16 +328,17 @@ ASFUNCTIONBODY_ATOM(Sound,play)
 	if(startTime!=0)
 		LOG(LOG_NOT_IMPLEMENTED,"startTime not supported in Sound::play");
 
-	th->incRef();
-	if (th->container)
+	if (th->container && !th->downloader && th->soundData->getReceivedLength()==0)
 	{
-		_NR<ByteArray> data = _MR(Class<ByteArray>::getInstanceS(th->getSystemState()));
+		//Nothing loaded, the samples are generated by sampleData listeners
+		th->soundChannel = _MR(Class<SoundChannel>::getInstanceS(sys,NullRef,AudioFormat(CODEC_NONE,0,0),false));
 		th->incRef();
-		getVm(th->getSystemState())->addEvent(_MR(th),_MR(Class<SampleDataEvent>::getInstanceS(th->getSystemState(),data,0)));
-		th->soundChannel = _MR(Class<SoundChannel>::getInstanceS(sys,th->soundData, AudioFormat(CODEC_NONE,0,0),false));
+		th->soundChannel->playSampleData(_MR(th));
 		th->soundChannel->incRef();
 		ret = asAtomHandler::fromObject(th->soundChannel.getPtr());
 	}
+	else if (th->container)
+		ret = asAtomHandler::fromObject(Class<SoundChannel>::getInstanceS(sys,th->soundData, AudioFormat(CODEC_NONE,0,0)));
 	else
 		ret = asAtomHandler::fromObject(Class<SoundChannel>::getInstanceS(sys,th->soundData, th->format));
 }
@@ -370,33 +372,12 @@ ASFUNCTIONBODY_ATOM(Sound,loadCompressedDataFromByteArray)
 		}
 		delete[] buf;
 	}
+	th->soundData->markFinished();
 }
 void Sound::afterExecution(_R<Event> e)
 {
-	if (e->type == "sampleData")
-	{
-		_NR<ByteArray> data = e->as<SampleDataEvent>()->data;
-		if (data.isNull())
-		{
-			this->soundData->markFinished(false);
-			return;
-		}
-		uint32_t len = data->getLength();
-		this->soundData->append(data->getBuffer(len,false),len);
-		soundChannel->play();
-		if (len < 2048*sizeof(float))
-		{
-			// less than 2048 samples, stop requesting data
-			this->soundData->markFinished(true);
-		}
-		else
-		{
-			// request more data
-			_NR<ByteArray> data = _MR(Class<ByteArray>::getInstanceS(getSystemState()));
-			incRef();
-			getVm(getSystemState())->addEvent(_MR(this),_MR(Class<SampleDataEvent>::getInstanceS(getSystemState(),data,0)));
-		}
-	}
+	if (e->type == "sampleData" && soundChannel)
+		soundChannel->appendSampleData(e->as<SampleDataEvent>()->data);
 }
 
 void Sound::setBytesTotal(uint32_t b)
@@ -474,7 +455,8 @@ ASFUNCTIONBODY_GETTER_SETTER(SoundLoaderContext,checkPolicyFile);
 
 SoundChannel::SoundChannel(Class_base* c, _NR<StreamCache> _stream, AudioFormat _format, bool autoplay)
 	: EventDispatcher(c),stream(_stream),stopped(true),audioDecoder(NULL),audioStream(NULL),
-	format(_format),oldVolume(-1.0),soundTransform(_MR(Class<SoundTransform>::getInstanceS(c->getSystemState()))),
+	format(_format),oldVolume(-1.0),oldPan(0.0),sampleDataDecoder(NULL),sampleDataPending(false),sampleDataFinished(false),sampleDataPosition(0),
+	soundTransform(_MR(Class<SoundTransform>::getInstanceS(c->getSystemState()))),
 	leftPeak(1),position(0),rightPeak(1)
 {
 	subtype=SUBTYPE_SOUNDCHANNEL;
@@ -494,7 +476,7 @@ void SoundChannel::appendStreamBlock(unsigned char *buf, int len)
 
 void SoundChannel::play()
 {
-	if (!stream.isNull() && stopped)
+	if ((!stream.isNull() || !sampleDataSource.isNull()) && stopped)
 	{
 		// Start playback
 		incRef();
@@ -503,6 +485,31 @@ void SoundChannel::play()
 	}
 }
 
+void SoundChannel::playSampleData(_R<Sound> source)
+{
+	sampleDataSource=source;
+	play();
+}
+
+void SoundChannel::appendSampleData(_NR<ByteArray> data)
+{
+	Locker l(mutex);
+	sampleDataPending=false;
+	if (!sampleDataDecoder || sampleDataFinished)
+		return;
+	uint32_t count=data.isNull() ? 0 : data->getLength()/(2*sizeof(float));
+	if (count)
+		sampleDataDecoder->decodeFloatSamples(data->getBuffer(count*2*sizeof(float),false),count,data->getLittleEndian());
+	sampleDataPosition+=count;
+	//Less than 2048 samples mean the sound is over once they have been played
+	if (count < 2048)
+	{
+		sampleDataFinished=true;
+		sampleDataDecoder->setFlushing();
+	}
+	sampleDataCond.signal();
+}
+
 void SoundChannel::markFinished()
 {
 	if (stream)
@@ -558,7 +565,24 @@ ASFUNCTIONBODY_ATOM(SoundChannel, stop)
 
 void SoundChannel::execute()
 {
-	playStream();
+	if (sampleDataSource.isNull())
+		playStream();
+	else
+		playSampleDataStream();
+}
+
+void SoundChannel::updateStreamTransform()
+{
+	if(soundTransform && soundTransform->volume != oldVolume)
+	{
+		audioStream->setVolume(soundTransform->volume);
+		oldVolume = soundTransform->volume;
+	}
+	if(soundTransform && soundTransform->pan != oldPan)
+	{
+		audioStream->setPan(soundTransform->pan);
+		oldPan = soundTransform->pan;
+	}
 }
 
 void SoundChannel::playStream()
@@ -597,14 +621,7 @@ void SoundChannel::playStream()
 				position=audioStream->getPlayedTime();
 
 			if(audioStream)
-			{
-				//TODO: use soundTransform->pan
-				if(soundTransform && soundTransform->volume != oldVolume)
-				{
-					audioStream->setVolume(soundTransform->volume);
-					oldVolume = soundTransform->volume;
-				}
-			}
+				updateStreamTransform();
 			
 			if(threadAborting)
 				throw JobTerminationException();
@@ -651,6 +668,65 @@ void SoundChannel::playStream()
 	}
 }
 
+void SoundChannel::requestSampleData()
+{
+	sampleDataPending=true;
+	_NR<ByteArray> data = _MR(Class<ByteArray>::getInstanceS(getSystemState()));
+	sampleDataSource->incRef();
+	getVm(getSystemState())->addEvent(sampleDataSource,_MR(Class<SampleDataEvent>::getInstanceS(getSystemState(),data,sampleDataPosition)));
+}
+
+void SoundChannel::playSampleDataStream()
+{
+	// ensure audio manager is initialized
+	getSystemState()->waitInitialized();
+	SampleDataAudioDecoder* decoder=new SampleDataAudioDecoder(getSystemState()->getEngineData()->audio_getSampleRate(),
+								   Config::getConfig()->getSampleDataBufferSize());
+	//Wake up four times per chunk to keep the next one queued in time
+	const uint32_t pollTime=max(1U,decoder->getChunkSize()*250/44100);
+	AudioStream* stream=getSystemState()->audioManager->createStream(decoder,false);
+	uint32_t underruns=0;
+	{
+		Locker l(mutex);
+		audioDecoder=decoder;
+		sampleDataDecoder=decoder;
+		audioStream=stream;
+		//Keep one chunk queued behind the one being played, so the
+		//listener has a whole chunk of time to generate the next one
+		while(audioStream && !ACQUIRE_READ(stopped) && !threadAborting)
+		{
+			if(sampleDataFinished)
+			{
+				if(decoder->queuedChunks()==0)
+					break;
+			}
+			else if(!sampleDataPending && decoder->queuedChunks()<=1)
+				requestSampleData();
+			position=audioStream->getPlayedTime();
+			updateStreamTransform();
+			CondTime(pollTime).wait(mutex,sampleDataCond);
+		}
+		if(audioStream)
+			underruns=audioStream->getUnderrunCount();
+		audioDecoder=NULL;
+		sampleDataDecoder=NULL;
+		audioStream=NULL;
+		sampleDataFinished=false;
+		sampleDataPending=false;
+		//Break the reference cycle with the Sound
+		sampleDataSource.reset();
+	}
+	delete stream;
+	delete decoder;
+	if(underruns)
+		LOG(LOG_INFO,"SoundChannel: "<<underruns<<" buffer underruns while playing sampleData sound");
+
+	if (!ACQUIRE_READ(stopped))
+	{
+		incRef();
+		getVm(getSystemState())->addEvent(_MR(this),_MR(Class<Event>::getInstanceS(getSystemState(),"soundComplete")));
+	}
+}
 
 void SoundChannel::jobFence()
 {
@@ -667,6 +743,7 @@ void SoundChannel::threadAbort()
 		audioDecoder->setFlushing();
 		audioDecoder->skipAll();
 	}
+	sampleDataCond.signal();
 }
 
 void StageVideo::sinit(Class_base *c)
@@ -34,6 +34,7 @@ namespace lightspark
 {
 
 class AudioDecoder;
+class SampleDataAudioDecoder;
 class NetStream;
 class StreamCache;
 class SoundChannel;
@@ -94,12 +95,33 @@ private:
 	AudioStream* audioStream;
 	AudioFormat format;
 	number_t oldVolume;
+	number_t oldPan;
+	//Dynamic sound state, the samples come from sampleData events
+	//dispatched to sampleDataSource. Protected by mutex
+	_NR<Sound> sampleDataSource;
+	SampleDataAudioDecoder* sampleDataDecoder;
+	Cond sampleDataCond;
+	bool sampleDataPending;
+	bool sampleDataFinished;
+	uint32_t sampleDataPosition;
 	void validateSoundTransform(_NR<SoundTransform>);
+	void updateStreamTransform();
 	void playStream();
+	void playSampleDataStream();
+	void requestSampleData();
 public:
 	SoundChannel(Class_base* c, _NR<StreamCache> stream=NullRef, AudioFormat format=AudioFormat(CODEC_NONE,0,0), bool autoplay=true);
 	~SoundChannel();
 	void appendStreamBlock(unsigned char* buf, int len);
+	/*
+	 * Plays the samples provided by the sampleData listeners of source
+	 */
+	void playSampleData(_R<Sound> source);
+	/*
+	 * Queues the samples written to a sampleData event and
+	 * stops requesting more if less than 2048 samples were given
+	 */
+	void appendSampleData(_NR<ByteArray> data);
 	void play();
 	void markFinished(); // indicates that all sound data is available
 	static void sinit(Class_base* c);
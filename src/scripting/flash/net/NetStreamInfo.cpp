@@ -97,7 +97,7 @@ ASFUNCTIONBODY_GETTER(NetStreamInfo,playbackBytesPerSecond);
 ASFUNCTIONBODY_GETTER_NOT_IMPLEMENTED(NetStreamInfo,resourceName);
 ASFUNCTIONBODY_GETTER_NOT_IMPLEMENTED(NetStreamInfo,SRTT);
 ASFUNCTIONBODY_GETTER_NOT_IMPLEMENTED(NetStreamInfo,uri);
-ASFUNCTIONBODY_GETTER_NOT_IMPLEMENTED(NetStreamInfo,videoBufferByteLength);
+ASFUNCTIONBODY_GETTER(NetStreamInfo,videoBufferByteLength);
 ASFUNCTIONBODY_GETTER(NetStreamInfo,videoBufferLength);
 ASFUNCTIONBODY_GETTER_NOT_IMPLEMENTED(NetStreamInfo,videoByteCount);
 ASFUNCTIONBODY_GETTER(NetStreamInfo,videoBytesPerSecond);
@@ -35,15 +35,16 @@
 #	include <fcntl.h>
 #else
 #	include <sys/socket.h>
+#	include <sys/ioctl.h>
 #	include <netdb.h>
-#	include <sys/select.h>
+#	include <fcntl.h>
 #endif
 #include <string.h>
 #include <unistd.h>
 #include <errno.h>
 
-const char SOCKET_COMMAND_SEND = '*';
-const char SOCKET_COMMAND_CLOSE = '-';
+// Bytes read from a socket before giving the other sockets a turn
+const uint32_t SOCKET_MAX_READ = 1024*1024;
 
 using namespace std;
 using namespace lightspark;
@@ -141,6 +142,49 @@ ssize_t SocketIO::receive(void *buf, size_t count) const
 	return n;
 }
 
+bool SocketIO::setNonBlocking()
+{
+#ifdef _WIN32
+	u_long mode = 1;
+	return ioctlsocket(fd, FIONBIO, &mode) == 0;
+#else
+	int flags = fcntl(fd, F_GETFL);
+	return flags != -1 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+#endif
+}
+
+ssize_t SocketIO::send(const void *buf, size_t count) const
+{
+	ssize_t n;
+
+	do
+	{
+#ifdef MSG_NOSIGNAL
+		// A connection closed by the peer must not raise SIGPIPE
+		n = ::send(fd, buf, count, MSG_NOSIGNAL);
+#else
+		n = write(fd, buf, count);
+#endif
+	}
+	while (n < 0 && errno == EINTR);
+
+	return n;
+}
+
+int SocketIO::availableBytes() const
+{
+#ifdef _WIN32
+	u_long n = 0;
+	if (ioctlsocket(fd, FIONREAD, &n) != 0)
+		return -1;
+#else
+	int n = 0;
+	if (ioctl(fd, FIONREAD, &n) == -1)
+		return -1;
+#endif
+	return n;
+}
+
 ssize_t SocketIO::sendAll(const void *buf, size_t count) const
 {
 	ssize_t n;
@@ -295,9 +339,9 @@ void ASSocket::connect(tiny_string host, int port)
 	}
 
 	incRef();
-	ASSocketThread *thread = new ASSocketThread(_MR(this), host, port, timeout);
-	getSys()->addJob(thread);
-	job = thread;
+	ASSocketConnection *connection = new ASSocketConnection(_MR(this), host, port, timeout);
+	getSys()->addJob(connection);
+	job = connection;
 }
 
 ASFUNCTIONBODY_ATOM(ASSocket, _connect)
@@ -374,16 +418,23 @@ ASFUNCTIONBODY_ATOM(ASSocket,readBytes)
 	SpinlockLocker l(th->joblock);
 	if (th->job)
 	{
-		th->job->datareceive->lock();
+		_R<ByteArray> datareceive = th->job->datareceive;
+		datareceive->lock();
+		uint32_t available = datareceive->getLength();
 		if (length == 0)
-			length = th->job->datareceive->getLength();
-		uint8_t buf[length];
-		th->job->datareceive->readBytes(0,length,buf);
-		th->job->datareceive->unlock();
+			length = available;
+		if (length > available)
+		{
+			datareceive->unlock();
+			throwError<EOFError>(kEOFError);
+		}
+		// The received data is consumed by the read
 		uint32_t pos = data->getPosition();
 		data->setPosition(offset);
-		data->writeBytes(buf,length);
+		data->writeBytes(datareceive->getBufferNoCheck(),length);
 		data->setPosition(pos);
+		datareceive->removeFrontBytes(length);
+		datareceive->unlock();
 	}
 	else
 	{
@@ -448,6 +499,11 @@ ASFUNCTIONBODY_ATOM(ASSocket,readUTFBytes)
 	if (th->job)
 	{
 		th->job->datareceive->lock();
+		if (length > th->job->datareceive->getLength())
+		{
+			th->job->datareceive->unlock();
+			throwError<EOFError>(kEOFError);
+		}
 		th->job->datareceive->readUTFBytes(length,data);
 		th->job->datareceive->removeFrontBytes(length);
 		th->job->datareceive->unlock();
@@ -464,7 +520,7 @@ ASFUNCTIONBODY_ATOM(ASSocket,_flush)
 	SpinlockLocker l(th->joblock);
 	if (th->job)
 	{
-		th->job->flushData();
+		th->job->requestSend();
 	}
 	else
 	{
@@ -490,211 +546,239 @@ void ASSocket::threadFinished()
 	job = NULL;
 }
 
-ASSocketThread::ASSocketThread(_R<ASSocket> _owner, const tiny_string& _hostname, int _port, int _timeout)
-: owner(_owner), hostname(_hostname), port(_port), timeout(_timeout)
+SocketConnection::SocketConnection(_R<EventDispatcher> _owner, const tiny_string& _hostname, int _port, int _timeout)
+: systemState(_owner->getSystemState()), hostname(_hostname), port(_port), timeout(_timeout),
+  sendRequested(false), closeRequested(false), closing(false), open(false), sendOffset(0), owner(_owner)
 {
-	sendQueue = g_async_queue_new();
-	datasend = _MR(Class<ByteArray>::getInstanceS(owner->getSystemState()));
-	datareceive = _MR(Class<ByteArray>::getInstanceS(owner->getSystemState()));
-#ifdef _WIN32
-	HANDLE readPipe, writePipe;
-	if (!CreatePipe(&readPipe,&writePipe,NULL,0))
-	{
-		signalListener = -1;
-		signalEmitter = -1;
-		return;
-	}
-	signalListener = _open_osfhandle((intptr_t)readPipe, _O_RDONLY);
-	signalEmitter = _open_osfhandle((intptr_t)writePipe, _O_WRONLY);
-#else
-	int pipefd[2];
-	if (pipe(pipefd) == -1)
-	{
-		signalListener = -1;
-		signalEmitter = -1;
-		return;
-	}
-	signalListener = pipefd[0];
-	signalEmitter = pipefd[1];
-#endif
 }
 
-ASSocketThread::~ASSocketThread()
+void SocketConnection::sendEvent(_R<Event> e)
 {
-	if (signalListener != -1)
-		::close(signalListener);
-	if (signalEmitter != -1)
-		::close(signalEmitter);
+	owner->incRef();
+	getVm(systemState)->addEvent(owner, e);
+}
 
-	void *data;
-	while ((data = g_async_queue_try_pop(sendQueue)) != NULL)
+void SocketConnection::execute()
+{
+	if (!sock.connect(hostname, port) || !sock.setNonBlocking())
 	{
-		tiny_string *s = (tiny_string *)data;
-		delete s;
+		sock.close();
+		sendEvent(_MR(Class<IOErrorEvent>::getInstanceS(systemState)));
+		return;
 	}
-	g_async_queue_unref(sendQueue);
+	open = true;
+	connected();
 }
 
-void ASSocketThread::execute()
+void SocketConnection::jobFence()
 {
-	if (!sock.connect(hostname, port))
+	if (open && !threadAborting)
 	{
-		owner->incRef();
-		getVm(owner->getSystemState())->addEvent(owner, _MR(Class<IOErrorEvent>::getInstanceS(owner->getSystemState())));
+		// The reactor services the connection from now on
+		systemState->getSocketReactor()->add(this);
 		return;
 	}
+	open = false;
+	ownerFinished();
+	delete this;
+}
 
-	bool first=true;
-	struct timeval timeout;
-	int maxfd;
-	fd_set readfds;
-	       
-	while (!threadAborting)
+bool SocketConnection::process(bool readable, bool writable, bool notified)
+{
+	if (notified && !closing)
 	{
-		FD_ZERO(&readfds);
-		FD_SET(signalListener, &readfds);
-		FD_SET(sock.fileDescriptor(), &readfds);
-		maxfd = max(signalListener, sock.fileDescriptor());
-
-		// Check threadAborting periodically
-		timeout.tv_sec = 10;
-		timeout.tv_usec = 0;
-
-		int status = select(maxfd+1, &readfds, NULL, NULL, &timeout);
-		if (status  < 0)
-		{
-			owner->incRef();
-			getVm(owner->getSystemState())->addEvent(owner, _MR(Class<IOErrorEvent>::getInstanceS(owner->getSystemState())));
-			return;
-		}
-
-		if (FD_ISSET(signalListener, &readfds))
+		bool sendData;
 		{
-			char cmd;
-
-			ssize_t nbytes = read(signalListener, &cmd, 1);
-			if (nbytes < 0)
-			{
-				owner->incRef();
-				getVm(owner->getSystemState())->addEvent(owner, _MR(Class<IOErrorEvent>::getInstanceS(owner->getSystemState())));
-				return;
-			}
-			else if (nbytes == 0)
-			{
-				//The pipe has been closed. This
-				//shouldn't happen, the pipe will be
-				//closed only in the desctructor.
-				return;
-			}
-			else
-			{
-				executeCommand(cmd, sock);
-			}
-			if (first && !threadAborting)
+			Locker l(requestMutex);
+			if (closeRequested && threadAborting)
 			{
-				// send connect event only after first succesful communication
-				first = false;
-				owner->incRef();
-				getVm(owner->getSystemState())->addEvent(owner, _MR(Class<Event>::getInstanceS(owner->getSystemState(),"connect")));
+				// The owner is gone, nobody waits for the data
+				open = false;
+				closed();
+				return false;
 			}
+			closing = closeRequested;
+			sendData = sendRequested || closeRequested;
+			sendRequested = false;
 		}
-		else if (FD_ISSET(sock.fileDescriptor(), &readfds))
-		{
-			readSocket(sock);
-		}
+		// Everything flushed since the last run goes out together,
+		// on close also the data written after the last flush
+		if (sendData)
+			collectSendData(sendBuffer);
+		if (closing)
+			open = false;
 	}
-}
-
-void ASSocketThread::readSocket(const SocketIO& sock)
-{
-	uint8_t buf[1024];
-	size_t nbytes = sock.receive(buf, sizeof buf - 1);
-
-	if (nbytes > 0)
+	if (wantsWrite() && !writeSocket())
 	{
-		buf[nbytes] = '\0';
-		datareceive->writeBytes(buf,nbytes);
-		owner->incRef();
-		getVm(owner->getSystemState())->addEvent(owner, _MR(Class<ProgressEvent>::getInstanceS(owner->getSystemState(),nbytes,0,"socketData")));
+		open = false;
+		if (closing)
+			closed();
+		else
+			sendEvent(_MR(Class<IOErrorEvent>::getInstanceS(systemState)));
+		return false;
 	}
-	else if (nbytes == 0)
+	if (closing)
 	{
-		// The server has closed the socket
-		owner->incRef();
-		getVm(owner->getSystemState())->addEvent(owner, _MR(Class<Event>::getInstanceS(owner->getSystemState(),"close")));
-		threadAborting = true;
+		// Keep the handler until the reactor has drained the pending data
+		if (wantsWrite() && (!readable || discardReceived()))
+			return true;
+		closed();
+		return false;
 	}
-	else
+	if (readable && !readSocket())
 	{
-		// Error
-		owner->incRef();
-		getVm(owner->getSystemState())->addEvent(owner, _MR(Class<IOErrorEvent>::getInstanceS(owner->getSystemState())));
-		threadAborting = true;
+		open = false;
+		return false;
 	}
+	return true;
 }
 
-void ASSocketThread::executeCommand(char cmd, SocketIO& sock)
+/**
+ * \brief Writes as much of the pending data as the socket accepts
+ *
+ * The remaining data is written when the reactor reports the socket as
+ * writable. Returns false on errors.
+ */
+bool SocketConnection::writeSocket()
 {
-	switch (cmd)
+	while (sendOffset < sendBuffer.size())
 	{
-		case SOCKET_COMMAND_SEND:
-		{
-			datasend->lock();
-			sock.sendAll(datasend->getBuffer(datasend->getLength(),false),datasend->getLength());
-			datasend->setLength(0);
-			datasend->unlock();
-			void *data;
-			while ((data = g_async_queue_try_pop(sendQueue)) != NULL)
-			{
-				tiny_string *s = (tiny_string *)data;
-				delete s;
-			}
-			break;
-		}
-		case SOCKET_COMMAND_CLOSE:
-		{
-			sock.close();
-			owner->incRef();
-			getVm(owner->getSystemState())->addEvent(owner, _MR(Class<Event>::getInstanceS(owner->getSystemState(),"close")));
-			threadAborting = true;
-			break;
-		}
-		default:
-		{
-			assert_and_throw(false && "Unexpected command");
-			break;
-		}
+		ssize_t n = sock.send(&sendBuffer[sendOffset], sendBuffer.size()-sendOffset);
+		if (n < 0)
+			return errno == EAGAIN || errno == EWOULDBLOCK;
+		sendOffset += n;
 	}
+	sendBuffer.clear();
+	sendOffset = 0;
+	return true;
 }
 
-bool ASSocketThread::isConnected()
+/**
+ * \brief Drops the data received while closing
+ *
+ * The owner has closed the connection and gets no more events. Returns
+ * false when the connection is over.
+ */
+bool SocketConnection::discardReceived()
 {
-	return sock.connected();
+	while (true)
+	{
+		char buf[4096];
+		ssize_t n = sock.receive(buf, sizeof buf);
+		if (n > 0)
+			continue;
+		return n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK);
+	}
 }
 
-void ASSocketThread::jobFence()
+void SocketConnection::release()
 {
-	owner->threadFinished();
+	open = false;
+	ownerFinished();
 	delete this;
 }
 
-void ASSocketThread::flushData()
+void SocketConnection::requestSend()
 {
 	if (threadAborting)
 		return;
+	{
+		Locker l(requestMutex);
+		sendRequested = true;
+	}
+	// Before the connection is made the request is handled by SocketReactor::add
+	if (open)
+		systemState->getSocketReactor()->notify(this);
+}
+
+void SocketConnection::requestClose()
+{
+	{
+		Locker l(requestMutex);
+		closeRequested = true;
+	}
+	if (open)
+		systemState->getSocketReactor()->notify(this);
+}
+
+ASSocketConnection::ASSocketConnection(_R<ASSocket> _owner, const tiny_string& _hostname, int _port, int _timeout)
+: SocketConnection(_owner, _hostname, _port, _timeout)
+{
+	datasend = _MR(Class<ByteArray>::getInstanceS(owner->getSystemState()));
+	datareceive = _MR(Class<ByteArray>::getInstanceS(owner->getSystemState()));
+}
 
-	tiny_string *packet = new tiny_string("");
-	g_async_queue_push(sendQueue, packet);
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wunused-result"
-	write(signalEmitter, &SOCKET_COMMAND_SEND, 1);
-#pragma GCC diagnostic pop
+void ASSocketConnection::connected()
+{
+	sendEvent(_MR(Class<Event>::getInstanceS(owner->getSystemState(),"connect")));
+}
+
+void ASSocketConnection::closed()
+{
+	sendEvent(_MR(Class<Event>::getInstanceS(owner->getSystemState(),"close")));
+}
+
+void ASSocketConnection::collectSendData(std::vector<uint8_t>& buffer)
+{
+	datasend->lock();
+	uint32_t len = datasend->getLength();
+	if (len > 0)
+	{
+		const uint8_t* data = datasend->getBufferNoCheck();
+		buffer.insert(buffer.end(), data, data+len);
+		datasend->setLength(0);
+	}
+	datasend->unlock();
+}
+
+/**
+ * \brief Reads the available data into datareceive
+ *
+ * The data is received directly in the buffer of the ByteArray. A single
+ * socketData event is sent for everything read in one run.
+ */
+bool ASSocketConnection::readSocket()
+{
+	uint32_t total = 0;
+	while (total < SOCKET_MAX_READ)
+	{
+		// With no data pending, the read reports the end of the stream or the error
+		int avail = sock.availableBytes();
+		if (avail <= 0)
+			avail = 1024;
+		datareceive->lock();
+		uint32_t oldlen = datareceive->getLength();
+		uint8_t* buf = datareceive->getBuffer(oldlen+avail,true);
+		ssize_t n = sock.receive(buf+oldlen, avail);
+		int error = errno;
+		datareceive->setLength(oldlen + (n > 0 ? n : 0));
+		datareceive->unlock();
+
+		if (n > 0)
+		{
+			total += n;
+			continue;
+		}
+		if (n < 0 && (error == EAGAIN || error == EWOULDBLOCK))
+			break;
+
+		if (total > 0)
+			sendEvent(_MR(Class<ProgressEvent>::getInstanceS(owner->getSystemState(),total,0,"socketData")));
+		if (n == 0)
+		{
+			// The server has closed the socket
+			sendEvent(_MR(Class<Event>::getInstanceS(owner->getSystemState(),"close")));
+		}
+		else
+			sendEvent(_MR(Class<IOErrorEvent>::getInstanceS(owner->getSystemState())));
+		return false;
+	}
+	if (total > 0)
+		sendEvent(_MR(Class<ProgressEvent>::getInstanceS(owner->getSystemState(),total,0,"socketData")));
+	return true;
 }
 
-void ASSocketThread::requestClose()
+void ASSocketConnection::ownerFinished()
 {
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wunused-result"
-	write(signalEmitter, &SOCKET_COMMAND_CLOSE, 1);
-#pragma GCC diagnostic pop
+	static_cast<ASSocket*>(owner.getPtr())->threadFinished();
 }
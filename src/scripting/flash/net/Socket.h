@@ -25,7 +25,9 @@
 #include "tiny_string.h"
 #include "asobject.h"
 #include "threading.h"
+#include "backends/socketreactor.h"
 #include <glib.h>
+#include <vector>
 
 namespace lightspark
 {
@@ -41,17 +43,75 @@ public:
 	bool connect(const tiny_string& hostname, int port);
 	bool connected() const;
 	void close();
+	bool setNonBlocking();
 	ssize_t receive(void *buf, size_t count) const;
+	// Single write, fails with EAGAIN when a non-blocking socket is full
+	ssize_t send(const void *buf, size_t count) const;
 	ssize_t sendAll(const void *buf, size_t count) const;
+	// Number of bytes that can be read without blocking, -1 on error
+	int availableBytes() const;
 	int fileDescriptor() const { return fd; }
 };
 
-class ASSocketThread;
+/*
+ * Base class of the connections of Socket and XMLSocket.
+ *
+ * The connection is opened by a job of the thread pool, since name
+ * resolution blocks. The connected socket is then made non-blocking and
+ * handed to the SocketReactor of the SystemState, which owns the object
+ * from then on.
+ */
+class SocketConnection : public IThreadJob, public SocketReactor::Handler
+{
+private:
+	SystemState* systemState;
+	tiny_string hostname;
+	int port;
+	int timeout;
+	Mutex requestMutex;
+	bool sendRequested;
+	bool closeRequested;
+	// Set once a close has been requested, the pending data is written before closing
+	bool closing;
+	volatile bool open;
+	// Data not accepted by the socket yet
+	std::vector<uint8_t> sendBuffer;
+	size_t sendOffset;
+	bool writeSocket();
+	bool discardReceived();
+protected:
+	SocketIO sock;
+	_R<EventDispatcher> owner;
+	void sendEvent(_R<Event> e);
+	// Called by the connecting job once the socket is connected
+	virtual void connected() {}
+	// Called when a close requested by the owner has been done
+	virtual void closed() {}
+	// Appends the data queued by the owner to buffer
+	virtual void collectSendData(std::vector<uint8_t>& buffer)=0;
+	// Reads the available data, returns false when the connection is over
+	virtual bool readSocket()=0;
+	// Detaches the connection from the owner, it is deleted afterwards
+	virtual void ownerFinished()=0;
+public:
+	SocketConnection(_R<EventDispatcher> owner, const tiny_string& hostname, int port, int timeout);
+	virtual void execute();
+	virtual void jobFence();
+	int fileDescriptor() const { return sock.fileDescriptor(); }
+	bool process(bool readable, bool writable, bool notified);
+	bool wantsWrite() const { return sendOffset < sendBuffer.size(); }
+	void release();
+	void requestSend();
+	void requestClose();
+	bool isConnected() const { return open; }
+};
+
+class ASSocketConnection;
 
 class ASSocket : public EventDispatcher, IDataInput, IDataOutput
 {
 protected:
-	ASSocketThread *job;
+	ASSocketConnection *job;
 	Spinlock joblock; // protect access to job
 
 	ASPROPERTY_GETTER_SETTER(int,timeout);
@@ -100,33 +160,19 @@ public:
 	void threadFinished();
 };
 
-class ASSocketThread : public IThreadJob
+class ASSocketConnection : public SocketConnection
 {
 friend class ASSocket;
-private:
-	SocketIO sock;
-	_R<ASSocket> owner;
-	tiny_string hostname;
-	int port;
-	int timeout;
-	GAsyncQueue *sendQueue;
-	int signalEmitter;
-	int signalListener;
-
-	int connectSocket();
-	void readSocket(const SocketIO& sock);
-	void executeCommand(char cmd, SocketIO& sock);
 protected:
 	_NR<ByteArray> datasend;
 	_NR<ByteArray> datareceive;
+	void connected();
+	void closed();
+	void collectSendData(std::vector<uint8_t>& buffer);
+	bool readSocket();
+	void ownerFinished();
 public:
-	ASSocketThread(_R<ASSocket> owner, const tiny_string& hostname, int port, int timeout);
-	~ASSocketThread();
-	virtual void execute();
-	virtual void jobFence();
-	void flushData();
-	void requestClose();
-	bool isConnected();
+	ASSocketConnection(_R<ASSocket> owner, const tiny_string& hostname, int port, int timeout);
 };
 
 }
@@ -34,9 +34,10 @@
 #	include <ws2tcpip.h>
 #	include <fcntl.h>
 #endif
+#include <errno.h>
 
-const char SOCKET_COMMAND_SEND = '*';
-const char SOCKET_COMMAND_CLOSE = '-';
+// Bytes read from a socket before giving the other sockets a turn
+const uint32_t XMLSOCKET_MAX_READ = 1024*1024;
 
 using namespace std;
 using namespace lightspark;
@@ -143,9 +144,9 @@ void XMLSocket::connect(tiny_string host, int port)
 	}
 
 	incRef();
-	XMLSocketThread *thread = new XMLSocketThread(_MR(this), host, port, timeout);
-	getSys()->addJob(thread);
-	job = thread;
+	XMLSocketConnection *connection = new XMLSocketConnection(_MR(this), host, port, timeout);
+	getSys()->addJob(connection);
+	job = connection;
 }
 
 ASFUNCTIONBODY_ATOM(XMLSocket, _connect)
@@ -198,200 +199,101 @@ void XMLSocket::threadFinished()
 	job = NULL;
 }
 
-XMLSocketThread::XMLSocketThread(_R<XMLSocket> _owner, const tiny_string& _hostname, int _port, int _timeout)
-: owner(_owner), hostname(_hostname), port(_port), timeout(_timeout)
+XMLSocketConnection::XMLSocketConnection(_R<XMLSocket> _owner, const tiny_string& _hostname, int _port, int _timeout)
+: SocketConnection(_owner, _hostname, _port, _timeout)
 {
-	sendQueue = g_async_queue_new();
-
-#ifdef _WIN32
-	HANDLE readPipe, writePipe;
-	if (!CreatePipe(&readPipe,&writePipe,NULL,0))
-	{
-		signalListener = -1;
-		signalEmitter = -1;
-		return;
-	}
-	signalListener = _open_osfhandle((intptr_t)readPipe, _O_RDONLY);
-	signalEmitter = _open_osfhandle((intptr_t)writePipe, _O_WRONLY);
-#else
-	int pipefd[2];
-	if (pipe(pipefd) == -1)
-	{
-		signalListener = -1;
-		signalEmitter = -1;
-		return;
-	}
-	signalListener = pipefd[0];
-	signalEmitter = pipefd[1];
-#endif
 }
 
-XMLSocketThread::~XMLSocketThread()
+void XMLSocketConnection::connected()
 {
-	if (signalListener != -1)
-		::close(signalListener);
-	if (signalEmitter != -1)
-		::close(signalEmitter);
-
-	void *data;
-	while ((data = g_async_queue_try_pop(sendQueue)) != NULL)
-	{
-		tiny_string *s = (tiny_string *)data;
-		delete s;
-	}
-	g_async_queue_unref(sendQueue);
+	sendEvent(_MR(Class<Event>::getInstanceS(owner->getSystemState(),"connect")));
 }
 
-void XMLSocketThread::execute()
+void XMLSocketConnection::collectSendData(std::vector<uint8_t>& buffer)
 {
-	if (!sock.connect(hostname, port))
+	Locker l(queueMutex);
+	while (!sendQueue.empty())
 	{
-		owner->incRef();
-		getVm(owner->getSystemState())->addEvent(owner, _MR(Class<IOErrorEvent>::getInstanceS(owner->getSystemState())));
-		return;
+		const tiny_string& s = sendQueue.front();
+		buffer.insert(buffer.end(), s.raw_buf(), s.raw_buf()+s.numBytes());
+		sendQueue.pop_front();
 	}
+}
 
-	owner->incRef();
-	getVm(owner->getSystemState())->addEvent(owner, _MR(Class<Event>::getInstanceS(owner->getSystemState(),"connect")));
-
-	struct timeval timeout;
-	int maxfd;
-	fd_set readfds;
-	       
-	while (!threadAborting)
+/**
+ * \brief Reads the available data and sends it as DataEvents
+ *
+ * Every message terminated by a zero byte becomes a DataEvent, data
+ * without a terminator is kept until the rest of the message arrives.
+ */
+bool XMLSocketConnection::readSocket()
+{
+	std::vector<char> data;
+	data.swap(partialMessage);
+	// 0 while the connection is open, otherwise the result of the last read
+	ssize_t result = 1;
+	size_t readBytes = 0;
+	while (readBytes < XMLSOCKET_MAX_READ)
 	{
-		FD_ZERO(&readfds);
-		FD_SET(signalListener, &readfds);
-		FD_SET(sock.fileDescriptor(), &readfds);
-		maxfd = max(signalListener, sock.fileDescriptor());
-
-		// Check threadAborting periodically
-		timeout.tv_sec = 10;
-		timeout.tv_usec = 0;
-
-		int status = select(maxfd+1, &readfds, NULL, NULL, &timeout);
-		if (status  < 0)
+		char buf[4096];
+		ssize_t n = sock.receive(buf, sizeof buf);
+		if (n > 0)
 		{
-			owner->incRef();
-			getVm(owner->getSystemState())->addEvent(owner, _MR(Class<IOErrorEvent>::getInstanceS(owner->getSystemState())));
-			return;
+			data.insert(data.end(), buf, buf+n);
+			readBytes += n;
+			continue;
 		}
+		if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+		result = n;
+		break;
+	}
 
-		if (FD_ISSET(signalListener, &readfds))
+	size_t start = 0;
+	while (start < data.size())
+	{
+		size_t end = start;
+		while (end < data.size() && data[end] != '\0')
+			end++;
+		if (end == data.size())
 		{
-			char cmd;
-
-			ssize_t nbytes = read(signalListener, &cmd, 1);
-			if (nbytes < 0)
-			{
-				owner->incRef();
-				getVm(owner->getSystemState())->addEvent(owner, _MR(Class<IOErrorEvent>::getInstanceS(owner->getSystemState())));
-				return;
-			}
-			else if (nbytes == 0)
-			{
-				//The pipe has been closed. This
-				//shouldn't happen, the pipe will be
-				//closed only in the desctructor.
-				return;
-			}
-			else
-			{
-				executeCommand(cmd, sock);
-			}
+			partialMessage.assign(data.begin()+start, data.end());
+			break;
 		}
-		else if (FD_ISSET(sock.fileDescriptor(), &readfds))
+		if (end > start)
 		{
-			readSocket(sock);
+			tiny_string message(std::string(&data[start], end-start));
+			sendEvent(_MR(Class<DataEvent>::getInstanceS(owner->getSystemState(),message)));
 		}
+		start = end+1;
 	}
-}
 
-void XMLSocketThread::readSocket(const SocketIO& sock)
-{
-	char buf[1024];
-	size_t nbytes = sock.receive(buf, sizeof buf - 1);
-
-	if (nbytes > 0)
-	{
-		buf[nbytes] = '\0';
-		tiny_string data(buf, true);
-		owner->incRef();
-		getVm(owner->getSystemState())->addEvent(owner, _MR(Class<DataEvent>::getInstanceS(owner->getSystemState(),data)));
-	}
-	else if (nbytes == 0)
+	if (result == 0)
 	{
 		// The server has closed the socket
-		owner->incRef();
-		getVm(owner->getSystemState())->addEvent(owner, _MR(Class<Event>::getInstanceS(owner->getSystemState(),"close")));
-		threadAborting = true;
+		sendEvent(_MR(Class<Event>::getInstanceS(owner->getSystemState(),"close")));
+		return false;
 	}
-	else
+	else if (result < 0)
 	{
-		// Error
-		owner->incRef();
-		getVm(owner->getSystemState())->addEvent(owner, _MR(Class<IOErrorEvent>::getInstanceS(owner->getSystemState())));
-		threadAborting = true;
+		sendEvent(_MR(Class<IOErrorEvent>::getInstanceS(owner->getSystemState())));
+		return false;
 	}
+	return true;
 }
 
-void XMLSocketThread::executeCommand(char cmd, SocketIO& sock)
+void XMLSocketConnection::ownerFinished()
 {
-	switch (cmd)
-	{
-		case SOCKET_COMMAND_SEND:
-		{
-			void *data;
-			while ((data = g_async_queue_try_pop(sendQueue)) != NULL)
-			{
-				tiny_string *s = (tiny_string *)data;
-				sock.sendAll(s->raw_buf(), s->numBytes());
-				delete s;
-			}
-			break;
-		}
-		case SOCKET_COMMAND_CLOSE:
-		{
-			sock.close();
-			threadAborting = true;
-			break;
-		}
-		default:
-		{
-			assert_and_throw(false && "Unexpected command");
-			break;
-		}
-	}
+	static_cast<XMLSocket*>(owner.getPtr())->threadFinished();
 }
 
-bool XMLSocketThread::isConnected()
-{
-	return sock.connected();
-}
-
-void XMLSocketThread::jobFence()
-{
-	owner->threadFinished();
-	delete this;
-}
-
-void XMLSocketThread::sendData(const tiny_string& data)
+void XMLSocketConnection::sendData(const tiny_string& data)
 {
 	if (threadAborting)
 		return;
-
-	tiny_string *packet = new tiny_string(data);
-	g_async_queue_push(sendQueue, packet);
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wunused-result"
-	write(signalEmitter, &SOCKET_COMMAND_SEND, 1);
-#pragma GCC diagnostic pop
-}
-
-void XMLSocketThread::requestClose()
-{
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wunused-result"
-	write(signalEmitter, &SOCKET_COMMAND_CLOSE, 1);
-#pragma GCC diagnostic pop
+	{
+		Locker l(queueMutex);
+		sendQueue.push_back(data);
+	}
+	requestSend();
 }
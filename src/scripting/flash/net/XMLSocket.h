@@ -25,16 +25,18 @@
 #include "asobject.h"
 #include "threading.h"
 #include <glib.h>
+#include <deque>
+#include <vector>
 #include "Socket.h"
 
 namespace lightspark
 {
-class XMLSocketThread;
+class XMLSocketConnection;
 
 class XMLSocket : public EventDispatcher
 {
 protected:
-	XMLSocketThread *job;
+	XMLSocketConnection *job;
 	Spinlock joblock; // protect access to job
 
 	ASPROPERTY_GETTER_SETTER(int,timeout);
@@ -55,29 +57,21 @@ public:
 	void threadFinished();
 };
 
-class XMLSocketThread : public IThreadJob
+class XMLSocketConnection : public SocketConnection
 {
 private:
-	SocketIO sock;
-	_R<XMLSocket> owner;
-	tiny_string hostname;
-	int port;
-	int timeout;
-	GAsyncQueue *sendQueue;
-	int signalEmitter;
-	int signalListener;
-
-	int connectSocket();
-	void readSocket(const SocketIO& sock);
-	void executeCommand(char cmd, SocketIO& sock);
+	Mutex queueMutex;
+	std::deque<tiny_string> sendQueue;
+	// Received data of a message whose terminator has not arrived yet
+	std::vector<char> partialMessage;
+protected:
+	void connected();
+	void collectSendData(std::vector<uint8_t>& buffer);
+	bool readSocket();
+	void ownerFinished();
 public:
-	XMLSocketThread(_R<XMLSocket> owner, const tiny_string& hostname, int port, int timeout);
-	~XMLSocketThread();
-	virtual void execute();
-	virtual void jobFence();
+	XMLSocketConnection(_R<XMLSocket> owner, const tiny_string& hostname, int port, int timeout);
 	void sendData(const tiny_string& data);
-	void requestClose();
-	bool isConnected();
 };
 
 }
@@ -34,6 +34,9 @@
 #include "backends/streamcache.h"
 #include "scripting/argconv.h"
 
+//Seconds decoded ahead of the playback when bufferTime is smaller
+#define NETSTREAM_MIN_READAHEAD 1.0
+
 using namespace std;
 using namespace lightspark;
 
@@ -1181,7 +1184,7 @@ void NetStreamAppendBytesAction::sinit(Class_base* c)
 NetStream::NetStream(Class_base* c):EventDispatcher(c),tickStarted(false),paused(false),closed(true),
 	streamTime(0),frameRate(0),connection(),downloader(NULL),videoDecoder(NULL),
 	audioDecoder(NULL),audioStream(NULL),datagenerationfile(NULL),datagenerationthreadstarted(false),client(NullRef),
-	oldVolume(-1.0),checkPolicyFile(false),rawAccessAllowed(false),framesdecoded(0),playbackBytesPerSecond(0),maxBytesPerSecond(0),datagenerationexpecttype(DATAGENERATION_HEADER),datagenerationbuffer(Class<ByteArray>::getInstanceS(c->getSystemState())),
+	oldVolume(-1.0),oldPan(0.0),checkPolicyFile(false),rawAccessAllowed(false),framesdecoded(0),prevstreamtime(0),pendingSeek(-1),buffering(true),decodingDone(false),endReached(false),restartedBySeek(false),playbackBytesPerSecond(0),maxBytesPerSecond(0),datagenerationexpecttype(DATAGENERATION_HEADER),datagenerationbuffer(Class<ByteArray>::getInstanceS(c->getSystemState())),
 	backBufferLength(0),backBufferTime(30),bufferLength(0),bufferTime(0.1),bufferTimeMax(0),
 	maxPauseBufferTime(0)
 {
@@ -1200,6 +1203,9 @@ NetStream::~NetStream()
 {
 	if(tickStarted)
 		getSys()->removeJob(this);
+	//Kept for seek() after the end of the stream
+	if(downloader && getSys()->downloadManager)
+		getSys()->downloadManager->destroy(downloader);
 	delete videoDecoder;
 	delete audioDecoder;
 	if (datagenerationfile)
@@ -1221,6 +1227,7 @@ void NetStream::sinit(Class_base* c)
 	c->setDeclaredMethodByQName("bytesLoaded","",Class<IFunction>::getFunction(c->getSystemState(),_getBytesLoaded),GETTER_METHOD,true);
 	c->setDeclaredMethodByQName("bytesTotal","",Class<IFunction>::getFunction(c->getSystemState(),_getBytesTotal),GETTER_METHOD,true);
 	c->setDeclaredMethodByQName("time","",Class<IFunction>::getFunction(c->getSystemState(),_getTime),GETTER_METHOD,true);
+	c->setDeclaredMethodByQName("decodedFrames","",Class<IFunction>::getFunction(c->getSystemState(),_getDecodedFrames),GETTER_METHOD,true);
 	c->setDeclaredMethodByQName("currentFPS","",Class<IFunction>::getFunction(c->getSystemState(),_getCurrentFPS),GETTER_METHOD,true);
 	c->setDeclaredMethodByQName("client","",Class<IFunction>::getFunction(c->getSystemState(),_getClient),GETTER_METHOD,true);
 	c->setDeclaredMethodByQName("client","",Class<IFunction>::getFunction(c->getSystemState(),_setClient),SETTER_METHOD,true);
@@ -1294,7 +1301,11 @@ ASFUNCTIONBODY_ATOM(NetStream,_getInfo)
 	else
 		LOG(LOG_NOT_IMPLEMENTED,"NetStreamInfo.currentBytesPerSecond/maxBytesPerSecond/dataBytesPerSecond is only implemented for data generation mode");
 	if (th->videoDecoder)
+	{
 		res->droppedFrames = th->videoDecoder->framesdropped;
+		//Decoded frames are queued as 8 bit YUV 4:2:0
+		res->videoBufferByteLength = th->videoDecoder->getQueuedFrames()*th->videoDecoder->getWidth()*th->videoDecoder->getHeight()*3/2;
+	}
 	res->playbackBytesPerSecond = th->playbackBytesPerSecond;
 	res->audioBufferLength = th->bufferLength;
 	res->videoBufferLength = th->bufferLength;
@@ -1444,7 +1455,8 @@ ASFUNCTIONBODY_ATOM(NetStream,play)
 	else //The URL is valid so we can start the download and add ourself as a job
 	{
 		StreamCache *cache = sys->getEngineData()->createFileStreamCache(th->getSystemState());
-		th->downloader=getSys()->downloadManager->download(th->url, _MR(cache), NULL);
+		//Streams are buffered progressively, they can wait for the other downloads
+		th->downloader=getSys()->downloadManager->download(th->url, _MR(cache), NULL, DownloadManager::PRIORITY_LOW);
 		th->streamTime=0;
 		//To be decreffed in jobFence
 		th->incRef();
@@ -1519,10 +1531,29 @@ ASFUNCTIONBODY_ATOM(NetStream,play2)
 }
 ASFUNCTIONBODY_ATOM(NetStream,seek)
 {
-	//NetStream* th=asAtomHandler::as<NetStream>(obj);
-	int pos;
-	ARG_UNPACK_ATOM(pos);
-	LOG(LOG_NOT_IMPLEMENTED,"NetStream.seek is not implemented yet:"<<pos);
+	NetStream* th=asAtomHandler::as<NetStream>(obj);
+	number_t offset;
+	ARG_UNPACK_ATOM(offset);
+	if(th->closed)
+	{
+		th->incRef();
+		getVm(sys)->addEvent(_MR(th),_MR(Class<NetStatusEvent>::getInstanceS(sys,"error","NetStream.Seek.Failed")));
+		return;
+	}
+	//The decoding thread moves the stream at its next iteration
+	th->countermutex.lock();
+	th->pendingSeek=(offset>0) ? dmin(offset*1000,INT32_MAX) : 0;
+	th->countermutex.unlock();
+	//The decoding job ended at the end of the stream, run it again from the seek target
+	Mutex::Lock l(th->mutex);
+	if(th->endReached)
+	{
+		th->endReached=false;
+		th->restartedBySeek=true;
+		//To be decreffed in jobFence
+		th->incRef();
+		sys->addJob(th);
+	}
 }
 
 ASFUNCTIONBODY_ATOM(NetStream,attach)
@@ -1724,12 +1755,16 @@ void NetStream::tick()
 	//Check if the stream is paused
 	if(audioStream)
 	{
-		//TODO: use soundTransform->pan
 		if(soundTransform && soundTransform->volume != oldVolume)
 		{
 			audioStream->setVolume(soundTransform->volume);
 			oldVolume = soundTransform->volume;
 		}
+		if(soundTransform && soundTransform->pan != oldPan)
+		{
+			audioStream->setPan(soundTransform->pan);
+			oldPan = soundTransform->pan;
+		}
 	}
 	if(paused)
 		return;
@@ -1745,12 +1780,12 @@ void NetStream::tick()
 		assert(audioDecoder);
 		if (streamTime == 0)
 			streamTime=audioStream->getPlayedTime()+audioDecoder->initialTime;
-		else if (this->bufferLength > 0)
+		else if (this->bufferLength > 0 && !buffering)
 			streamTime+=1000/frameRate;
 	}
 	else
 	{
-		if (this->bufferLength > 0)
+		if (this->bufferLength > 0 && !buffering)
 			streamTime+=1000/frameRate;
 		if (audioDecoder)
 			audioDecoder->skipAll();
@@ -1758,10 +1793,24 @@ void NetStream::tick()
 	this->bufferLength = (framesdecoded / frameRate) - (streamTime-prevstreamtime)/1000.0;
 	if (this->bufferLength < 0)
 		this->bufferLength = 0;
+	//Playback caught up with decoding before the end of the stream,
+	//wait for bufferTime seconds to be available again
+	bool emptied=false;
+	if (this->bufferLength == 0 && !buffering && !decodingDone)
+	{
+		buffering=true;
+		emptied=true;
+	}
 	//LOG(LOG_INFO,"tick:"<< " "<<bufferLength << " "<<streamTime<<" "<<frameRate<<" "<<framesdecoded<<" "<<bufferTime<<" "<<this->playbackBytesPerSecond<<" "<<this->getReceivedLength());
 	countermutex.unlock();
+	if (emptied)
+	{
+		this->incRef();
+		getVm(getSystemState())->addEvent(_MR(this),_MR(Class<NetStatusEvent>::getInstanceS(getSystemState(),"status", "NetStream.Buffer.Empty")));
+	}
 	if (videoDecoder)
 	{
+		videoDecoder->setPresentationTime(streamTime);
 		videoDecoder->skipUntil(streamTime);
 		//The next line ensures that the downloader will not be destroyed before the upload jobs are fenced
 		videoDecoder->waitForFencing();
@@ -1773,6 +1822,88 @@ void NetStream::tickFence()
 {
 }
 
+void NetStream::checkBufferFull(bool endOfStream)
+{
+	countermutex.lock();
+	bool filled=buffering && frameRate && (endOfStream || this->bufferLength >= this->bufferTime) &&
+			(tickStarted || isReady());
+	if(filled)
+		buffering=false;
+	countermutex.unlock();
+	if(!filled)
+		return;
+	this->incRef();
+	getVm(getSystemState())->addEvent(_MR(this),
+					  _MR(Class<NetStatusEvent>::getInstanceS(getSystemState(),"status", "NetStream.Buffer.Full")));
+	if(!tickStarted)
+	{
+		tickStarted=true;
+		getSystemState()->addTick(1000/frameRate,this);
+		//Also ask for a render rate equal to the video one (capped at 24)
+		float localRenderRate=dmin(frameRate,24);
+		getSystemState()->setRenderRate(localRenderRate);
+	}
+}
+
+bool NetStream::seekStream(StreamDecoder* streamDecoder, uint32_t time)
+{
+	uint64_t available=datagenerationfile ? datagenerationfile->getReceivedLength() : downloader->getReceivedLength();
+	uint32_t keyframeTime;
+	if(!streamDecoder->seek(time,available,keyframeTime))
+	{
+		LOG(LOG_INFO,"NetStream: no keyframe available for seeking to "<<time);
+		this->incRef();
+		getVm(getSystemState())->addEvent(_MR(this),
+						  _MR(Class<NetStatusEvent>::getInstanceS(getSystemState(),"error", "NetStream.Seek.InvalidTime")));
+		return false;
+	}
+	countermutex.lock();
+	streamTime=keyframeTime;
+	prevstreamtime=keyframeTime;
+	framesdecoded=0;
+	this->bufferLength=0;
+	buffering=true;
+	countermutex.unlock();
+	if(videoDecoder)
+		videoDecoder->setPresentationTime(keyframeTime);
+	if(audioStream && audioDecoder)
+		audioStream->setPlayedTime(keyframeTime>audioDecoder->initialTime ? keyframeTime-audioDecoder->initialTime : 0);
+	this->incRef();
+	getVm(getSystemState())->addEvent(_MR(this),
+					  _MR(Class<NetStatusEvent>::getInstanceS(getSystemState(),"status", "NetStream.Seek.Notify")));
+	return true;
+}
+
+/**
+ * \brief Lets the decoders output everything left and waits for its playback
+ *
+ * Sends NetStream.Play.Stop once the decoded frames have been consumed.
+ */
+void NetStream::endOfStream()
+{
+	countermutex.lock();
+	decodingDone=true;
+	countermutex.unlock();
+	//Put the decoders in the flushing state and wait for the complete consumption of contents
+	if(audioDecoder)
+		audioDecoder->setFlushing();
+	if(videoDecoder)
+	{
+		videoDecoder->drain();
+		videoDecoder->setFlushing();
+	}
+
+	if(audioDecoder)
+		audioDecoder->waitFlushed();
+	if(videoDecoder)
+		videoDecoder->waitFlushed();
+
+	this->incRef();
+	getVm(getSystemState())->addEvent(_MR(this), _MR(Class<NetStatusEvent>::getInstanceS(getSystemState(),"status", "NetStream.Play.Stop")));
+	this->incRef();
+	getVm(getSystemState())->addEvent(_MR(this), _MR(Class<NetStatusEvent>::getInstanceS(getSystemState(),"status", "NetStream.Buffer.Flush")));
+}
+
 bool NetStream::isReady() const
 {
 	//Must have videoDecoder, but audioDecoder is optional (in
@@ -1831,14 +1962,25 @@ void NetStream::execute()
 	istream s(sbuf);
 	s.exceptions(istream::goodbit);
 
+	bool resumed;
+	{
+		Mutex::Lock l(mutex);
+		resumed=restartedBySeek;
+		restartedBySeek=false;
+	}
+
 	ThreadProfile* profile=getSystemState()->allocateProfiler(RGB(0,0,200));
 	profile->setTag("NetStream");
 	bool waitForFlush=true;
+	//Set when the stream has been played to the end, it then stays available for seek()
+	bool atEnd=false;
 	//We need to catch possible EOF and other error condition in the non reliable stream
 	try
 	{
 #ifdef ENABLE_LIBAVCODEC
 		Chronometer chronometer;
+		//A job run again by seek() stays at the end if the seek fails
+		bool seekingFromEnd=resumed;
 		if (!sbuf)
 		{
 			threadAbort();
@@ -1862,9 +2004,10 @@ void NetStream::execute()
 		videoDecoder = NULL;
 		this->prevstreamtime = streamTime;
 		this->bufferLength = 0;
+		buffering = true;
+		decodingDone = false;
 		countermutex.unlock();
 		bool done=false;
-		bool bufferfull = true;
 		while(!done)
 		{
 			//Check if threadAbort has been called, if so, stop this loop
@@ -1873,17 +2016,43 @@ void NetStream::execute()
 				done = true;
 				continue;
 			}
-			bool decodingSuccess= bufferfull && streamDecoder->decodeNextFrame();
-			if(!decodingSuccess && bufferfull)
+			countermutex.lock();
+			int32_t seekTarget=pendingSeek;
+			pendingSeek=-1;
+			countermutex.unlock();
+			if(seekTarget>=0 && !seekStream(streamDecoder,seekTarget) && seekingFromEnd)
+			{
+				//Nothing is decoded again, the stream stays at its end
+				atEnd=true;
+				waitForFlush=false;
+				done=true;
+				continue;
+			}
+			seekingFromEnd=false;
+
+			//Decode ahead of the playback only up to the buffer time, the
+			//rest stays in the download cache where seeking can reach it
+			countermutex.lock();
+			number_t readAhead=dmax(dmax(this->bufferTime,this->bufferTimeMax),NETSTREAM_MIN_READAHEAD);
+			bool prefetched=tickStarted && !buffering && frameRate && this->bufferLength >= readAhead;
+			countermutex.unlock();
+			if(prefetched)
+			{
+				compat_msleep(1000/frameRate);
+				continue;
+			}
+
+			bool decodingSuccess=streamDecoder->decodeNextFrame();
+			if(!decodingSuccess)
 			{
 				if (s.tellg() == -1)
 				{
+					atEnd=true;
 					done = true;
 					continue;
 				}
 
 				LOG(LOG_INFO,"decoding failed:"<<s.tellg()<<" "<<this->getReceivedLength());
-				bufferfull = false;
 			}
 			else
 			{
@@ -1903,15 +2072,10 @@ void NetStream::execute()
 						{
 							this->playbackBytesPerSecond = s.tellg() / (framesdecoded / frameRate);
 							this->bufferLength = (framesdecoded / frameRate) - (streamTime-prevstreamtime)/1000.0;
+							if (this->bufferLength < 0)
+								this->bufferLength = 0;
 						}
 						countermutex.unlock();
-						if (bufferfull && this->bufferLength < 0)
-						{
-							bufferfull = false;
-							this->bufferLength=0;
-							this->incRef();
-							getVm(getSystemState())->addEvent(_MR(this),_MR(Class<NetStatusEvent>::getInstanceS(getSystemState(),"status", "NetStream.Buffer.Empty")));
-						}
 					}
 				}
 			}
@@ -1919,37 +2083,26 @@ void NetStream::execute()
 			if(videoDecoder==NULL && streamDecoder->videoDecoder)
 			{
 				videoDecoder=streamDecoder->videoDecoder;
-				this->incRef();
-				getVm(getSystemState())->addEvent(_MR(this),
-								  _MR(Class<NetStatusEvent>::getInstanceS(getSystemState(),"status", "NetStream.Play.Start")));
+				if(!resumed)
+				{
+					this->incRef();
+					getVm(getSystemState())->addEvent(_MR(this),
+									  _MR(Class<NetStatusEvent>::getInstanceS(getSystemState(),"status", "NetStream.Play.Start")));
+				}
 			}
 			if(audioDecoder==NULL && streamDecoder->audioDecoder)
 				audioDecoder=streamDecoder->audioDecoder;
 			
 			if(audioStream==NULL && audioDecoder && audioDecoder->isValid())
 				audioStream=getSys()->audioManager->createStream(audioDecoder,streamDecoder->hasVideo());
-			if(!tickStarted && isReady() && frameRate && ((framesdecoded / frameRate) >= this->bufferTime))
-			{
-				tickStarted=true;
-				this->incRef();
-				getVm(getSystemState())->addEvent(_MR(this),
-								  _MR(Class<NetStatusEvent>::getInstanceS(getSystemState(),"status", "NetStream.Buffer.Full")));
-				getSystemState()->addTick(1000/frameRate,this);
-				//Also ask for a render rate equal to the video one (capped at 24)
-				float localRenderRate=dmin(frameRate,24);
-				getSystemState()->setRenderRate(localRenderRate);
-			}
-			if (!bufferfull && frameRate && ((framesdecoded / frameRate) >= this->bufferTime))
-			{
-				bufferfull = true;
-				this->incRef();
-				getVm(getSystemState())->addEvent(_MR(this),
-								  _MR(Class<NetStatusEvent>::getInstanceS(getSystemState(),"status", "NetStream.Buffer.Full")));
-			}
+			checkBufferFull(false);
 			profile->accountTime(chronometer.checkpoint());
 			if(threadAborting)
 				throw JobTerminationException();
 		}
+		//Streams shorter than the buffer time start playing once fully decoded
+		if(!closed && waitForFlush)
+			checkBufferFull(true);
 #endif //ENABLE_LIBAVCODEC
 	}
 	catch(LightsparkException& e)
@@ -1968,22 +2121,12 @@ void NetStream::execute()
 		LOG(LOG_ERROR, _("Exception in reading: ")<<e.what());
 	}
 	if(waitForFlush)
+		endOfStream();
+	else
 	{
-		//Put the decoders in the flushing state and wait for the complete consumption of contents
-		if(audioDecoder)
-			audioDecoder->setFlushing();
-		if(videoDecoder)
-			videoDecoder->setFlushing();
-		
-		if(audioDecoder)
-			audioDecoder->waitFlushed();
-		if(videoDecoder)
-			videoDecoder->waitFlushed();
-
-		this->incRef();
-		getVm(getSystemState())->addEvent(_MR(this), _MR(Class<NetStatusEvent>::getInstanceS(getSystemState(),"status", "NetStream.Play.Stop")));
-		this->incRef();
-		getVm(getSystemState())->addEvent(_MR(this), _MR(Class<NetStatusEvent>::getInstanceS(getSystemState(),"status", "NetStream.Buffer.Flush")));
+		countermutex.lock();
+		decodingDone=true;
+		countermutex.unlock();
 	}
 	//Before deleting stops ticking, removeJobs also spin waits for termination
 	getSystemState()->removeJob(this);
@@ -1994,11 +2137,17 @@ void NetStream::execute()
 		//Change the state to invalid to avoid locking
 		videoDecoder=NULL;
 		audioDecoder=NULL;
-		//Clean up everything for a possible re-run
-		if (downloader)
-			getSys()->downloadManager->destroy(downloader);
-		//This transition is critical, so the mutex is needed
-		downloader=NULL;
+		//Clean up everything for a possible re-run, the data played to
+		//the end is kept until close() in case seek() is called
+		if(atEnd && !closed)
+			endReached=true;
+		else
+		{
+			if (downloader)
+				getSys()->downloadManager->destroy(downloader);
+			//This transition is critical, so the mutex is needed
+			downloader=NULL;
+		}
 		if (audioStream)
 			delete audioStream;
 		audioStream=NULL;
@@ -2017,6 +2166,14 @@ void NetStream::threadAbort()
 
 	if(downloader)
 		downloader->stop();
+	//No decoding job is running, release the data kept for seek()
+	if(endReached)
+	{
+		endReached=false;
+		if(downloader)
+			getSys()->downloadManager->destroy(downloader);
+		downloader=NULL;
+	}
 
 	//Clear everything we have in buffers, discard all frames
 	if(videoDecoder)
@@ -2089,6 +2246,12 @@ ASFUNCTIONBODY_ATOM(NetStream,_getTime)
 		asAtomHandler::setUInt(ret,sys,0);
 }
 
+ASFUNCTIONBODY_ATOM(NetStream,_getDecodedFrames)
+{
+	NetStream* th=asAtomHandler::as<NetStream>(obj);
+	asAtomHandler::setUInt(ret,sys,th->framesdecoded);
+}
+
 ASFUNCTIONBODY_ATOM(NetStream,_getCurrentFPS)
 {
 	//TODO: provide real FPS (what really is displayed)
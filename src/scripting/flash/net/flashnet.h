@@ -304,6 +304,7 @@ private:
 
 	ASPROPERTY_GETTER_SETTER(NullableRef<SoundTransform>,soundTransform);
 	number_t oldVolume;
+	number_t oldPan;
 
 	enum CONNECTION_TYPE { CONNECT_TO_FMS=0, DIRECT_CONNECTIONS };
 	CONNECTION_TYPE peerID;
@@ -313,6 +314,20 @@ private:
 
 	uint32_t framesdecoded;
 	uint32_t prevstreamtime;
+	//Time in ms requested by seek(), -1 if none is pending. Protected by countermutex
+	int32_t pendingSeek;
+	//Set while waiting for bufferTime seconds to be decoded ahead of the playback
+	bool buffering;
+	//Set when the decoding thread reached the end of the stream
+	bool decodingDone;
+	//Set when the decoding job ended at the end of the stream and the data is kept
+	//for seek(), which runs the job again. Protected by mutex
+	bool endReached;
+	//Set by seek() for the job it runs again, Play.Start has already been sent
+	bool restartedBySeek;
+	void checkBufferFull(bool endOfStream);
+	bool seekStream(StreamDecoder* streamDecoder, uint32_t time);
+	void endOfStream();
 	number_t playbackBytesPerSecond;
 	number_t maxBytesPerSecond;
 
@@ -341,6 +356,7 @@ public:
 	ASFUNCTION_ATOM(_getBytesLoaded);
 	ASFUNCTION_ATOM(_getBytesTotal);
 	ASFUNCTION_ATOM(_getTime);
+	ASFUNCTION_ATOM(_getDecodedFrames);
 	ASFUNCTION_ATOM(_getCurrentFPS);
 	ASFUNCTION_ATOM(_getClient);
 	ASFUNCTION_ATOM(_setClient);
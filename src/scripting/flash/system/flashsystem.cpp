@@ -20,6 +20,7 @@
 #include "version.h"
 #include "scripting/flash/system/flashsystem.h"
 #include "scripting/abc.h"
+#include "scripting/cyclecollector.h"
 #include "scripting/argconv.h"
 #include "compat.h"
 #include "backends/security.h"
@@ -27,6 +28,8 @@
 #include "scripting/toplevel/XMLList.h"
 #include "scripting/toplevel/Vector.h"
 #include "parsing/streams.h"
+#include "parsing/amf3_generator.h"
+#include "scripting/flash/concurrent/Condition.h"
 
 #include <istream>
 
@@ -644,8 +647,10 @@ void System::sinit(Class_base* c)
 
 ASFUNCTIONBODY_ATOM(System,totalMemory)
 {
-	LOG(LOG_NOT_IMPLEMENTED, "System.totalMemory not implemented");
-	asAtomHandler::setUInt(ret,sys,1024);
+	//The decoded bitmaps and shapes are the only memory accounted in all builds
+	LOG(LOG_NOT_IMPLEMENTED, "System.totalMemory only reports decoded bitmaps and shapes");
+	uint64_t used=sys->mainClip ? sys->mainClip->getDecodedTagsSize() : 0;
+	asAtomHandler::setUInt(ret,sys,min<uint64_t>(used,UINT32_MAX));
 }
 ASFUNCTIONBODY_ATOM(System,disposeXML)
 {
@@ -669,7 +674,15 @@ ASFUNCTIONBODY_ATOM(System,pauseForGCIfCollectionImminent)
 }
 ASFUNCTIONBODY_ATOM(System,gc)
 {
-	LOG(LOG_NOT_IMPLEMENTED, "System.gc not implemented");
+	//Decoded bitmaps and shapes can be recreated from their tags
+	uint64_t released=0;
+	if(sys->mainClip)
+		released=sys->mainClip->purgeDecodedTags();
+	LOG(LOG_CALLS, "System.gc released " << released << " bytes of decoded bitmaps and shapes");
+	//AS code is running and may hold unaccounted references, so reference cycles
+	//are collected as soon as the current event is handled
+	if(sys->cycleCollector)
+		sys->cycleCollector->requestCollection();
 	asAtomHandler::setUndefined(ret);
 }
 
@@ -765,8 +778,16 @@ ASFUNCTIONBODY_ATOM(ASWorker,_addEventListener)
 }
 ASFUNCTIONBODY_ATOM(ASWorker,createMessageChannel)
 {
-	LOG(LOG_NOT_IMPLEMENTED, "Worker.createMessageChannel not implemented");
-	asAtomHandler::setUndefined(ret);
+	ASWorker* th = asAtomHandler::as<ASWorker>(obj);
+	_NR<ASWorker> receiver;
+	ARG_UNPACK_ATOM(receiver);
+	if (receiver.isNull())
+		throwError<ArgumentError>(kNullPointerError, "receiver");
+	MessageChannel* channel = Class<MessageChannel>::getInstanceS(sys);
+	th->incRef();
+	channel->sender = _MR(th);
+	channel->receiver = receiver;
+	ret = asAtomHandler::fromObject(channel);
 }
 ASFUNCTIONBODY_ATOM(ASWorker,_removeEventListener)
 {
@@ -778,6 +799,8 @@ ASFUNCTIONBODY_ATOM(ASWorker,setSharedProperty)
 	asAtom value=asAtomHandler::invalidAtom;
 	ARG_UNPACK_ATOM(key)(value);
 	Locker l(sys->workerDomain->workersharedobjectmutex);
+	if (asAtomHandler::isObject(value))
+		asAtomHandler::getObjectNoCheck(value)->setShared();
 	ASATOM_INCREF(value);
 	multiname m(NULL);
 	m.name_type=multiname::NAME_STRING;
@@ -889,6 +912,160 @@ ASFUNCTIONBODY_ATOM(WorkerDomain,listWorkers)
 	th->workerlist->incRef();
 	ret = asAtomHandler::fromObject(th->workerlist.getPtr());
 }
+MessageChannel::MessageChannel(Class_base* c):
+	EventDispatcher(c),state("open")
+{
+	subtype = SUBTYPE_MESSAGECHANNEL;
+}
+
+void MessageChannel::sinit(Class_base* c)
+{
+	CLASS_SETUP(c, EventDispatcher, _constructorNotInstantiatable, CLASS_SEALED | CLASS_FINAL);
+	c->setDeclaredMethodByQName("messageAvailable","",Class<IFunction>::getFunction(c->getSystemState(),_getMessageAvailable),GETTER_METHOD,true);
+	c->setDeclaredMethodByQName("state","",Class<IFunction>::getFunction(c->getSystemState(),_getState),GETTER_METHOD,true);
+	c->setDeclaredMethodByQName("close","",Class<IFunction>::getFunction(c->getSystemState(),close),NORMAL_METHOD,true);
+	c->setDeclaredMethodByQName("receive","",Class<IFunction>::getFunction(c->getSystemState(),receive),NORMAL_METHOD,true);
+	c->setDeclaredMethodByQName("send","",Class<IFunction>::getFunction(c->getSystemState(),send),NORMAL_METHOD,true);
+}
+
+void MessageChannel::finalize()
+{
+	EventDispatcher::finalize();
+	Locker l(messagemutex);
+	messages.clear();
+	state = "open";
+	sender.reset();
+	receiver.reset();
+}
+
+bool MessageChannel::isShareable(ASObject* o)
+{
+	return (o->is<ByteArray>() && o->as<ByteArray>()->shareable) || o->is<ASMutex>() || o->is<ASCondition>()
+		|| o->is<ASWorker>() || o->is<MessageChannel>();
+}
+
+void MessageChannel::dispatchChannelEvent(const char* type)
+{
+	this->incRef();
+	getVm(getSystemState())->addEvent(_MR(this),_MR(Class<Event>::getInstanceS(getSystemState(),type)));
+}
+
+ASFUNCTIONBODY_ATOM(MessageChannel,_getMessageAvailable)
+{
+	MessageChannel* th = asAtomHandler::as<MessageChannel>(obj);
+	Locker l(th->messagemutex);
+	asAtomHandler::setBool(ret,!th->messages.empty());
+}
+ASFUNCTIONBODY_ATOM(MessageChannel,_getState)
+{
+	MessageChannel* th = asAtomHandler::as<MessageChannel>(obj);
+	Locker l(th->messagemutex);
+	ret = asAtomHandler::fromString(sys,th->state);
+}
+ASFUNCTIONBODY_ATOM(MessageChannel,close)
+{
+	MessageChannel* th = asAtomHandler::as<MessageChannel>(obj);
+	{
+		Locker l(th->messagemutex);
+		if (th->state != "open")
+			return;
+		//The channel is closed once the queued messages have been received
+		th->state = th->messages.empty() ? "closed" : "closing";
+	}
+	th->dispatchChannelEvent("channelState");
+}
+ASFUNCTIONBODY_ATOM(MessageChannel,send)
+{
+	MessageChannel* th = asAtomHandler::as<MessageChannel>(obj);
+	asAtom arg=asAtomHandler::invalidAtom;
+	int32_t queueLimit;
+	ARG_UNPACK_ATOM(arg)(queueLimit,-1);
+	message m;
+	ASObject* o = asAtomHandler::getObject(arg);
+	if (o && isShareable(o))
+	{
+		o->incRef();
+		o->setShared();
+		m.shared = _MNR(o);
+	}
+	else
+	{
+		ByteArray* data = Class<ByteArray>::getInstanceS(sys);
+		data->writeObject(asAtomHandler::toObject(arg,sys));
+		data->setPosition(0);
+		data->setShared();
+		m.data = _MNR(data);
+	}
+	{
+		Locker l(th->messagemutex);
+		//Messages sent to a closed channel are dropped
+		if (th->state != "open")
+			return;
+		//The VM thread runs the code of all workers, so it can't wait for a receiver
+		if (queueLimit >= 0 && th->messages.size() >= (uint32_t)queueLimit)
+			LOG(LOG_NOT_IMPLEMENTED,"MessageChannel.send: queueLimit can't block, all workers run on the VM thread");
+		th->messages.push_back(m);
+	}
+	th->dispatchChannelEvent("channelMessage");
+}
+ASFUNCTIONBODY_ATOM(MessageChannel,receive)
+{
+	MessageChannel* th = asAtomHandler::as<MessageChannel>(obj);
+	bool blockUntilReceived;
+	ARG_UNPACK_ATOM(blockUntilReceived,false);
+	message m;
+	bool closed = false;
+	{
+		Locker l(th->messagemutex);
+		//The VM thread runs the code of all workers, nobody could send while blocking
+		if (blockUntilReceived && th->messages.empty())
+			LOG(LOG_NOT_IMPLEMENTED,"MessageChannel.receive: blocking, all workers run on the VM thread");
+		if (th->messages.empty())
+		{
+			asAtomHandler::setNull(ret);
+			return;
+		}
+		m = th->messages.front();
+		th->messages.pop_front();
+		if (th->state == "closing" && th->messages.empty())
+		{
+			th->state = "closed";
+			closed = true;
+		}
+	}
+	if (closed)
+		th->dispatchChannelEvent("channelState");
+	if (!m.shared.isNull())
+	{
+		m.shared->incRef();
+		ret = asAtomHandler::fromObject(m.shared.getPtr());
+		return;
+	}
+	Amf3Deserializer d(m.data.getPtr());
+	try
+	{
+		ret=d.readObject();
+	}
+	catch(LightsparkException& e)
+	{
+		LOG(LOG_ERROR,"Exception caught while parsing AMF3: " << e.cause);
+	}
+	if(asAtomHandler::isInvalid(ret))
+	{
+		asAtomHandler::setUndefined(ret);
+		return;
+	}
+	ASATOM_INCREF(ret);
+}
+
+void MessageChannelState::sinit(Class_base* c)
+{
+	CLASS_SETUP(c, ASObject, _constructorNotInstantiatable, CLASS_SEALED | CLASS_FINAL);
+	c->setVariableAtomByQName("OPEN",nsNameAndKind(),asAtomHandler::fromString(c->getSystemState(),"open"),CONSTANT_TRAIT);
+	c->setVariableAtomByQName("CLOSING",nsNameAndKind(),asAtomHandler::fromString(c->getSystemState(),"closing"),CONSTANT_TRAIT);
+	c->setVariableAtomByQName("CLOSED",nsNameAndKind(),asAtomHandler::fromString(c->getSystemState(),"closed"),CONSTANT_TRAIT);
+}
+
 void WorkerState::sinit(Class_base* c)
 {
 	CLASS_SETUP(c, ASObject, _constructorNotInstantiatable, CLASS_SEALED | CLASS_FINAL);
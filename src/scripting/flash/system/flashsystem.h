@@ -25,6 +25,7 @@
 #include "scripting/flash/utils/ByteArray.h"
 #include "scripting/toplevel/Error.h"
 #include "scripting/flash/events/flashevents.h"
+#include <deque>
 
 #define MIN_DOMAIN_MEMORY_LIMIT 1024
 namespace lightspark
@@ -105,7 +106,7 @@ public:
 		uint32_t bufLen=domainMemory->getLength();
 		if(bufLen < (addr+sizeof(T)))
 			throwError<RangeError>(kInvalidRangeError);
-		uint8_t* buf=domainMemory->getBufferNoCheck();
+		uint8_t* buf=domainMemory->getBuffer(bufLen,true);
 		*reinterpret_cast<T*>(buf+addr)=val;
 	}
 	void checkDomainMemory();
@@ -214,6 +215,46 @@ public:
 	ASFUNCTION_ATOM(listWorkers);
 };
 
+/*
+ * Messages are serialized to AMF3 when they are sent, so that sender and receiver never
+ * share objects. Shareable objects (shareable ByteArrays, Mutexes, Conditions, Workers and
+ * MessageChannels) are passed by reference instead and are not copied.
+ */
+class MessageChannel: public EventDispatcher
+{
+friend class ASWorker;
+private:
+	struct message
+	{
+		_NR<ByteArray> data;
+		_NR<ASObject> shared;
+	};
+	//Protects messages and state
+	Mutex messagemutex;
+	std::deque<message> messages;
+	tiny_string state;
+	_NR<ASWorker> sender;
+	_NR<ASWorker> receiver;
+	static bool isShareable(ASObject* o);
+	void dispatchChannelEvent(const char* type);
+public:
+	MessageChannel(Class_base* c);
+	static void sinit(Class_base*);
+	void finalize();
+	ASFUNCTION_ATOM(_getMessageAvailable);
+	ASFUNCTION_ATOM(_getState);
+	ASFUNCTION_ATOM(close);
+	ASFUNCTION_ATOM(receive);
+	ASFUNCTION_ATOM(send);
+};
+
+class MessageChannelState: public ASObject
+{
+public:
+	MessageChannelState(Class_base* c):ASObject(c){}
+	static void sinit(Class_base* c);
+};
+
 class WorkerState: public ASObject
 {
 public:
@@ -48,13 +48,7 @@ ByteArray::ByteArray(Class_base* c, uint8_t* b, uint32_t l):ASObject(c,T_OBJECT,
 
 ByteArray::~ByteArray()
 {
-	if(bytes)
-	{
-#ifdef MEMORY_USAGE_PROFILING
-		getClass()->memoryAccount->removeBytes(real_len);
-#endif
-		free(bytes);
-	}
+	releaseBuffer();
 }
 
 void ByteArray::sinit(Class_base* c)
@@ -124,6 +118,8 @@ uint8_t* ByteArray::getBufferIntern(unsigned int size, bool enableResize)
 {
 	if (size > BA_MAX_SIZE) 
 		throwError<ASError>(kOutOfMemoryError);
+	if(enableResize && !sharedOwner.isNull())
+		unshareBuffer();
 	// The first allocation is exactly the size we need,
 	// the subsequent reallocations happen in increments of BA_CHUNK_SIZE bytes
 	uint32_t prevLen = len;
@@ -309,14 +305,7 @@ void ByteArray::setLength(uint32_t newLen)
 	}
 	else
 	{
-		if (bytes)
-		{
-#ifdef MEMORY_USAGE_PROFILING
-			getClass()->memoryAccount->removeBytes(real_len);
-#endif
-			free(bytes);
-		}
-		bytes = NULL;
+		releaseBuffer();
 		real_len = newLen;
 	}
 	len = newLen;
@@ -531,9 +520,9 @@ uint32_t ByteArray::writeObject(ASObject* obj)
 	//Return the length of the serialized object
 
 	//TODO: support custom serialization
-	map<tiny_string, uint32_t> stringMap;
-	map<const ASObject*, uint32_t> objMap;
-	map<const Class_base*, uint32_t> traitsMap;
+	unordered_map<tiny_string, uint32_t> stringMap;
+	unordered_map<const ASObject*, uint32_t> objMap;
+	unordered_map<const Class_base*, uint32_t> traitsMap;
 	uint32_t oldPosition=position;
 	obj->serialize(this, stringMap, objMap,traitsMap);
 	return position-oldPosition;
@@ -1118,6 +1107,8 @@ multiname *ByteArray::setVariableByMultiname(const multiname& name, asAtom& o, C
 		// Fill the gap between the end of the current data and the index with zeros
 		memset(bytes+prevLen, 0, index-prevLen);
 	}
+	else if(!sharedOwner.isNull())
+		unshareBuffer();
 
 	// Fill the byte pointed to by index with the truncated uint value of the object.
 	uint8_t value = static_cast<uint8_t>(asAtomHandler::toUInt(o) & 0xff);
@@ -1135,13 +1126,7 @@ void ByteArray::setVariableByMultiname_i(const multiname& name, int32_t value)
 
 void ByteArray::acquireBuffer(uint8_t* buf, int bufLen)
 {
-	if(bytes)
-	{
-#ifdef MEMORY_USAGE_PROFILING
-		getClass()->memoryAccount->removeBytes(real_len);
-#endif
-		free(bytes);
-	}
+	releaseBuffer();
 	bytes=buf;
 	real_len=bufLen;
 	len=bufLen;
@@ -1151,6 +1136,47 @@ void ByteArray::acquireBuffer(uint8_t* buf, int bufLen)
 	position=0;
 }
 
+void ByteArray::acquireSharedBuffer(const uint8_t* buf, uint32_t bufLen, _R<RefCountable> owner)
+{
+	releaseBuffer();
+	bytes=const_cast<uint8_t*>(buf);
+	real_len=bufLen;
+	len=bufLen;
+	sharedOwner=owner;
+	position=0;
+}
+
+void ByteArray::unshareBuffer()
+{
+	uint8_t* copy=NULL;
+	if(len)
+	{
+		copy=(uint8_t*) malloc(len);
+		assert_and_throw(copy);
+		memcpy(copy,bytes,len);
+#ifdef MEMORY_USAGE_PROFILING
+		getClass()->memoryAccount->addBytes(len);
+#endif
+	}
+	sharedOwner.reset();
+	bytes=copy;
+	real_len=len;
+}
+
+void ByteArray::releaseBuffer()
+{
+	if(!sharedOwner.isNull())
+		sharedOwner.reset();
+	else if(bytes)
+	{
+#ifdef MEMORY_USAGE_PROFILING
+		getClass()->memoryAccount->removeBytes(real_len);
+#endif
+		free(bytes);
+	}
+	bytes=NULL;
+}
+
 void ByteArray::writeU29(uint32_t val)
 {
 	for(uint32_t i=0;i<4;i++)
@@ -1183,7 +1209,7 @@ void ByteArray::serializeDouble(number_t val)
 	
 }
 
-void ByteArray::writeStringVR(map<tiny_string, uint32_t>& stringMap, const tiny_string& s)
+void ByteArray::writeStringVR(unordered_map<tiny_string, uint32_t>& stringMap, const tiny_string& s)
 {
 	const uint32_t len=s.numBytes();
 	if(len >= 1<<28)
@@ -1231,7 +1257,7 @@ void ByteArray::writeStringAMF0(const tiny_string& s)
 	}
 }
 
-void ByteArray::writeXMLString(std::map<const ASObject*, uint32_t>& objMap,
+void ByteArray::writeXMLString(std::unordered_map<const ASObject*, uint32_t>& objMap,
 			       ASObject *xml,
 			       const tiny_string& xmlstr)
 {
@@ -1270,8 +1296,10 @@ void ByteArray::append(streambuf *data, int length)
 }
 void ByteArray::removeFrontBytes(int count)
 {
-	memmove(bytes,bytes+count,count);
-	position -= count;
+	if(!sharedOwner.isNull())
+		unshareBuffer();
+	memmove(bytes,bytes+count,len-count);
+	position = position > (uint32_t)count ? position-count : 0;
 	len -= count;
 }
 
@@ -1335,6 +1363,12 @@ void ByteArray::uncompress_zlib()
 
 	inflateEnd(&strm);
 
+	if(!sharedOwner.isNull())
+	{
+		// The compressed data is not needed anymore, don't copy it
+		releaseBuffer();
+		real_len=0;
+	}
 	len=strm.total_out;
 #ifdef MEMORY_USAGE_PROFILING
 	getClass()->memoryAccount->addBytes(len-real_len);
@@ -1389,14 +1423,7 @@ ASFUNCTIONBODY_ATOM(ByteArray,clear)
 {
 	ByteArray* th=asAtomHandler::as<ByteArray>(obj);
 	th->lock();
-	if(th->bytes)
-	{
-#ifdef MEMORY_USAGE_PROFILING
-		th->getClass()->memoryAccount->removeBytes(th->real_len);
-#endif
-		free(th->bytes);
-	}
-	th->bytes = NULL;
+	th->releaseBuffer();
 	th->len=0;
 	th->real_len=0;
 	th->position=0;
@@ -1411,6 +1438,8 @@ ASFUNCTIONBODY_ATOM(ByteArray,pop)
 	th->lock();
 	if (th->readByte(res))
 	{
+		if(!th->sharedOwner.isNull())
+			th->unshareBuffer();
 		memmove(th->bytes,(th->bytes+1),th->getLength()-1);
 		th->len--;
 	}
@@ -1442,6 +1471,8 @@ ASFUNCTIONBODY_ATOM(ByteArray,shift)
 	th->lock();
 	if (th->readByte(res))
 	{
+		if(!th->sharedOwner.isNull())
+			th->unshareBuffer();
 		memmove(th->bytes,(th->bytes+1),th->getLength()-1);
 		th->len--;
 	}
@@ -1495,6 +1526,8 @@ ASFUNCTIONBODY_ATOM(ByteArray,atomicCompareAndSwapIntAt)
 
 	if (res == expectedValue)
 	{
+		if(!th->sharedOwner.isNull())
+			th->unshareBuffer();
 		memcpy(th->bytes+byteindex,&newvalue,4);
 	}
 	th->unlock();
@@ -1521,9 +1554,9 @@ ASFUNCTIONBODY_ATOM(ByteArray,_toJSON)
 	ret = asAtomHandler::fromString(sys,"ByteArray");
 }
 
-void ByteArray::serialize(ByteArray* out, std::map<tiny_string, uint32_t>& stringMap,
-				std::map<const ASObject*, uint32_t>& objMap,
-				std::map<const Class_base*, uint32_t>& traitsMap)
+void ByteArray::serialize(ByteArray* out, std::unordered_map<tiny_string, uint32_t>& stringMap,
+				std::unordered_map<const ASObject*, uint32_t>& objMap,
+				std::unordered_map<const Class_base*, uint32_t>& traitsMap)
 {
 	if (out->getObjectEncoding() == ObjectEncoding::AMF0)
 	{
@@ -1547,8 +1580,13 @@ void ByteArray::serialize(ByteArray* out, std::map<tiny_string, uint32_t>& strin
 		assert_and_throw(len<0x20000000);
 		uint32_t value = (len << 1) | 1;
 		out->writeU29(value);
-		// TODO faster implementation
-		for (unsigned int i = 0; i < len; i++)
-			out->writeByte(this->bytes[i]);
+		if (out == this)
+		{
+			//Writing may reallocate the source buffer
+			std::vector<uint8_t> tmp(bytes, bytes+len);
+			out->writeBytes(tmp.data(), tmp.size());
+		}
+		else if (len)
+			out->writeBytes(bytes, len);
 	}
 }
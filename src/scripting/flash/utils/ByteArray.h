@@ -42,10 +42,16 @@ protected:
 	uint8_t* bytes;
 	uint32_t real_len;
 	uint32_t len;
+	// Set when bytes points into read only memory kept alive by
+	// sharedOwner (e.g. a mapped SWF file). The data is copied before
+	// the first write
+	_NR<RefCountable> sharedOwner;
 	void compress_zlib();
 	void uncompress_zlib();
 	Mutex mutex;
 	uint8_t* getBufferIntern(unsigned int size, bool enableResize);
+	void unshareBuffer();
+	void releaseBuffer();
 	
 public:
 	FORCE_INLINE void lock()
@@ -78,13 +84,33 @@ public:
 		memcpy(bytes+position,data,length);
 		position+=length;
 	}
+	// Bulk helpers for the (de)serializers. They neither lock nor do any
+	// byte order conversion
+	// Makes room for length bytes at the current position, returns the
+	// start of the area and moves the position after it
+	FORCE_INLINE uint8_t* reserveBytes(uint32_t length)
+	{
+		uint8_t* ret=getBuffer(position+length,true)+position;
+		position+=length;
+		return ret;
+	}
+	// Returns the next length bytes and moves the position after them,
+	// or NULL if not enough data is available
+	FORCE_INLINE const uint8_t* consumeBytes(uint32_t length)
+	{
+		if(position > len || length > len-position)
+			return NULL;
+		const uint8_t* ret=bytes+position;
+		position+=length;
+		return ret;
+	}
 	void writeShort(uint16_t val);
 	void writeUnsignedInt(uint32_t val);
 	void writeUTF(const tiny_string& str);
 	uint32_t writeObject(ASObject* obj);
-	void writeStringVR(std::map<tiny_string, uint32_t>& stringMap, const tiny_string& s);
+	void writeStringVR(std::unordered_map<tiny_string, uint32_t>& stringMap, const tiny_string& s);
 	void writeStringAMF0(const tiny_string& s);
-	void writeXMLString(std::map<const ASObject*, uint32_t>& objMap, ASObject *xml, const tiny_string& s);
+	void writeXMLString(std::unordered_map<const ASObject*, uint32_t>& objMap, ASObject *xml, const tiny_string& s);
 	void writeU29(uint32_t val);
 
 	void serializeDouble(number_t val);
@@ -176,10 +202,19 @@ public:
 		@pre buf must be allocated using new[]
 	*/
 	void acquireBuffer(uint8_t* buf, int bufLen);
+	/**
+		Reference a read only buffer without copying it
+		@param buf The buffer
+		@param bufLen Lenght of the buffer
+		@param owner Object keeping buf alive while it is referenced
+	*/
+	void acquireSharedBuffer(const uint8_t* buf, uint32_t bufLen, _R<RefCountable> owner);
+	// Only for reading, unless the caller has called getBuffer(size,true)
 	inline uint8_t* getBufferNoCheck() const { return bytes; }
+	// enableResize also means that the buffer is going to be written
 	inline uint8_t* getBuffer(unsigned int size, bool enableResize)
 	{
-		if (size <= len && size > 0)
+		if (size <= len && size > 0 && (!enableResize || sharedOwner.isNull()))
 		{
 			return bytes;
 		}
@@ -203,9 +238,9 @@ public:
 	void setVariableByMultiname_i(const multiname& name, int32_t value);
 	bool hasPropertyByMultiname(const multiname& name, bool considerDynamic, bool considerPrototype);
 
-	void serialize(ByteArray* out, std::map<tiny_string, uint32_t>& stringMap,
-				std::map<const ASObject*, uint32_t>& objMap,
-				std::map<const Class_base*, uint32_t>& traitsMap);
+	void serialize(ByteArray* out, std::unordered_map<tiny_string, uint32_t>& stringMap,
+				std::unordered_map<const ASObject*, uint32_t>& objMap,
+				std::unordered_map<const Class_base*, uint32_t>& traitsMap);
 };
 
 }
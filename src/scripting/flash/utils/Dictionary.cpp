@@ -25,13 +25,260 @@
 #include "scripting/argconv.h"
 #include "scripting/flash/errors/flasherrors.h"
 #include "scripting/flash/utils/Dictionary.h"
+#include "scripting/toplevel/toplevel.h"
+#include <unordered_map>
 
 using namespace std;
 using namespace lightspark;
 
+#define EMPTY_SLOT UINT32_MAX
+#define DELETED_SLOT (UINT32_MAX-1)
+#define MIN_SLOTS 16
+
+// Dictionaries using an object as weak key, and the hash the key was stored with
+static StaticMutex weakKeyMutex;
+static std::unordered_multimap<ASObject*,std::pair<Dictionary*,uint32_t>> weakKeyRegistry;
+
+static inline uint32_t hashPointer(const void* p)
+{
+	uint64_t h = (uint64_t)(uintptr_t)p;
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	return (uint32_t)h;
+}
+
 Dictionary::Dictionary(Class_base* c):ASObject(c),
-	data(std::less<dictType::key_type>(), reporter_allocator<dictType::value_type>(c->memoryAccount)),weakkeys(false)
+	entries(reporter_allocator<dictEntry>(c->memoryAccount)),slots(reporter_allocator<uint32_t>(c->memoryAccount)),
+	livecount(0),weakkeys(false)
+{
+}
+
+uint32_t Dictionary::hashKey(ASObject* o)
+{
+	// keys that are strictly equal must get the same hash
+	switch (o->getObjectType())
+	{
+		case T_NULL:
+		case T_UNDEFINED:
+			return 0;
+		case T_FUNCTION:
+			// methods of the same class may compare equal (see SyntheticFunction::isEqual)
+			if (o->is<SyntheticFunction>() && o->as<SyntheticFunction>()->inClass)
+				return hashPointer(o->as<SyntheticFunction>()->inClass);
+			// native functions are equal if they wrap the same function
+			if (o->is<Function>())
+				return 1;
+			break;
+		default:
+			// these are compared by value
+			if (o->is<XML>() || o->is<XMLList>() || o->is<Date>())
+				return 2;
+			break;
+	}
+	return hashPointer(o);
+}
+
+uint32_t Dictionary::findEntry(ASObject* o, uint32_t hash) const
+{
+	if (slots.empty())
+		return EMPTY_SLOT;
+	uint32_t mask = slots.size()-1;
+	for (uint32_t i = hash & mask;; i = (i+1) & mask)
+	{
+		uint32_t index = slots[i];
+		if (index == EMPTY_SLOT)
+			return EMPTY_SLOT;
+		if (index == DELETED_SLOT)
+			continue;
+		const dictEntry& e = entries[index];
+		if (e.key == o || (e.hash == hash && e.key->isEqualStrict(o)))
+			return index;
+	}
+}
+
+uint32_t Dictionary::findSlot(uint32_t index) const
+{
+	uint32_t mask = slots.size()-1;
+	uint32_t i = entries[index].hash & mask;
+	while (slots[i] != index)
+		i = (i+1) & mask;
+	return i;
+}
+
+void Dictionary::rehash()
+{
+	uint32_t newsize = MIN_SLOTS;
+	while ((livecount+1)*2 > newsize)
+		newsize *= 2;
+	if (livecount != entries.size())
+	{
+		// drop removed entries
+		auto it = std::remove_if(entries.begin(),entries.end(),[](const dictEntry& e) { return e.key == nullptr; });
+		entries.erase(it,entries.end());
+	}
+	slots.assign(newsize,EMPTY_SLOT);
+	uint32_t mask = newsize-1;
+	for (uint32_t index = 0; index < entries.size(); index++)
+	{
+		uint32_t i = entries[index].hash & mask;
+		while (slots[i] != EMPTY_SLOT)
+			i = (i+1) & mask;
+		slots[i] = index;
+	}
+}
+
+void Dictionary::insertEntry(ASObject* o, uint32_t hash, asAtom& value)
+{
+	// keep the table at most 3/4 full, removed entries included
+	if ((entries.size()+1)*4 > slots.size()*3)
+		rehash();
+	uint32_t mask = slots.size()-1;
+	uint32_t i = hash & mask;
+	while (slots[i] != EMPTY_SLOT && slots[i] != DELETED_SLOT)
+		i = (i+1) & mask;
+	slots[i] = entries.size();
+	dictEntry e;
+	e.key = o;
+	e.value = value;
+	e.hash = hash;
+	entries.push_back(e);
+	livecount++;
+	if (weakkeys)
+	{
+		Locker l(weakKeyMutex);
+		weakKeyRegistry.insert(make_pair(o,make_pair(this,hash)));
+		o->isWeakKey = true;
+	}
+}
+
+void Dictionary::removeEntry(uint32_t index)
+{
+	dictEntry& e = entries[index];
+	slots[findSlot(index)] = DELETED_SLOT;
+	ASObject* key = e.key;
+	asAtom value = e.value;
+	e.key = nullptr;
+	e.value = asAtomHandler::invalidAtom;
+	livecount--;
+	if (weakkeys)
+	{
+		Locker l(weakKeyMutex);
+		auto range = weakKeyRegistry.equal_range(key);
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			if (it->second.first == this)
+			{
+				weakKeyRegistry.erase(it);
+				break;
+			}
+		}
+		if (weakKeyRegistry.find(key) == weakKeyRegistry.end())
+			key->isWeakKey = false;
+	}
+	else
+		key->decRef();
+	ASATOM_DECREF(value);
+}
+
+void Dictionary::removeWeakKeyEntry(ASObject* o, uint32_t hash)
 {
+	if (slots.empty())
+		return;
+	uint32_t mask = slots.size()-1;
+	for (uint32_t i = hash & mask; slots[i] != EMPTY_SLOT; i = (i+1) & mask)
+	{
+		uint32_t index = slots[i];
+		if (index == DELETED_SLOT || entries[index].key != o)
+			continue;
+		asAtom value = entries[index].value;
+		slots[i] = DELETED_SLOT;
+		entries[index].key = nullptr;
+		entries[index].value = asAtomHandler::invalidAtom;
+		livecount--;
+		ASATOM_DECREF(value);
+		return;
+	}
+}
+
+void Dictionary::clearEntries()
+{
+	// the entries are released after the Dictionary is emptied,
+	// as destroying a value may lead back here
+	std::vector<dictEntry> tmp(entries.begin(),entries.end());
+	entries.clear();
+	slots.clear();
+	livecount = 0;
+	if (weakkeys)
+	{
+		Locker l(weakKeyMutex);
+		for (auto it = tmp.begin(); it != tmp.end(); ++it)
+		{
+			if (!it->key)
+				continue;
+			auto range = weakKeyRegistry.equal_range(it->key);
+			for (auto itreg = range.first; itreg != range.second; ++itreg)
+			{
+				if (itreg->second.first == this)
+				{
+					weakKeyRegistry.erase(itreg);
+					break;
+				}
+			}
+			if (weakKeyRegistry.find(it->key) == weakKeyRegistry.end())
+				it->key->isWeakKey = false;
+		}
+	}
+	for (auto it = tmp.begin(); it != tmp.end(); ++it)
+	{
+		if (!it->key)
+			continue;
+		if (!weakkeys)
+			it->key->decRef();
+		ASATOM_DECREF(it->value);
+	}
+}
+
+void Dictionary::traceReferences(std::vector<ASObject*>& refs)
+{
+	ASObject::traceReferences(refs);
+	for (auto it = entries.begin(); it != entries.end(); ++it)
+	{
+		if (!it->key)
+			continue;
+		if (!weakkeys)
+			refs.push_back(it->key);
+		if (asAtomHandler::isObject(it->value))
+			refs.push_back(asAtomHandler::getObjectNoCheck(it->value));
+	}
+}
+
+void Dictionary::clearReferences()
+{
+	clearEntries();
+	ASObject::clearReferences();
+}
+
+void Dictionary::purgeWeakKey(ASObject* o)
+{
+	std::vector<std::pair<Dictionary*,uint32_t>> dicts;
+	{
+		Locker l(weakKeyMutex);
+		auto range = weakKeyRegistry.equal_range(o);
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			// keep the Dictionary alive in case removing a value destroys it
+			it->second.first->incRef();
+			dicts.push_back(it->second);
+		}
+		weakKeyRegistry.erase(range.first,range.second);
+		o->isWeakKey = false;
+	}
+	for (auto it = dicts.begin(); it != dicts.end(); ++it)
+	{
+		it->first->removeWeakKeyEntry(o,it->second);
+		it->first->decRef();
+	}
 }
 
 void Dictionary::sinit(Class_base* c)
@@ -55,18 +302,6 @@ ASFUNCTIONBODY_ATOM(Dictionary,_toJSON)
 	ret = asAtomHandler::fromString(sys,"Dictionary");
 }
 
-Dictionary::dictType::iterator Dictionary::findKey(ASObject *o)
-{
-	Dictionary::dictType::iterator it = data.begin();
-	for(; it!=data.end(); ++it)
-	{
-		if (it->first->isEqualStrict(o))
-			return it;
-	}
-
-	return data.end();
-}
-
 void Dictionary::setVariableByMultiname_i(const multiname& name, int32_t value)
 {
 	assert_and_throw(implEnable);
@@ -103,22 +338,25 @@ multiname *Dictionary::setVariableByMultiname(const multiname& name, asAtom& o,
 			default:
 				break;
 		}
-		name.name_o->incRef();
-		_R<ASObject> name_o(name.name_o);
-
-		Dictionary::dictType::iterator it=findKey(name_o.getPtr());
-		if(it!=data.end())
+		uint32_t hash=hashKey(name.name_o);
+		uint32_t index=findEntry(name.name_o,hash);
+		if(index!=EMPTY_SLOT)
 		{
-			if (alreadyset && it->second.uintval == o.uintval)
+			if (alreadyset && entries[index].value.uintval == o.uintval)
 				*alreadyset=true;
 			else
 			{
-				ASATOM_DECREF(it->second);
-				it->second=o;
+				asAtom oldvalue = entries[index].value;
+				entries[index].value=o;
+				ASATOM_DECREF(oldvalue);
 			}
 		}
 		else
-			data.insert(make_pair(name_o,o));
+		{
+			if (!weakkeys)
+				name.name_o->incRef();
+			insertEntry(name.name_o,hash,o);
+		}
 	}
 	else
 	{
@@ -163,14 +401,10 @@ bool Dictionary::deleteVariableByMultiname(const multiname& name)
 			default:
 				break;
 		}
-		name.name_o->incRef();
-		_R<ASObject> name_o(name.name_o);
-
-		Dictionary::dictType::iterator it=findKey(name_o.getPtr());
-		if(it != data.end())
+		uint32_t index=findEntry(name.name_o,hashKey(name.name_o));
+		if(index != EMPTY_SLOT)
 		{
-			ASATOM_DECREF(it->second);
-			data.erase(it);
+			removeEntry(index);
 			return true;
 		}
 		return false;
@@ -217,26 +451,14 @@ GET_VARIABLE_RESULT Dictionary::getVariableByMultiname(asAtom& ret, const multin
 				default:
 					break;
 			}
-			bool islastref = name.name_o->isLastRef();
-			name.name_o->incRef();
-			_R<ASObject> name_o(name.name_o);
-
-			Dictionary::dictType::iterator it=findKey(name_o.getPtr());
-			if(it != data.end())
+			uint32_t index=findEntry(name.name_o,hashKey(name.name_o));
+			if(index != EMPTY_SLOT)
 			{
-				ret = it->second;
-				if (islastref)
-				{
-					LOG(LOG_INFO,"erasing weak key from dictionary:"<< name.name_o->toDebugString());
-					name.name_o->decRef();
-					data.erase(it);
-				}
-				else
+				ret = entries[index].value;
+				if (!(opt & NO_INCREF))
 					ASATOM_INCREF(ret);
-				return GET_VARIABLE_RESULT::GETVAR_NORMAL;
 			}
-			else
-				return GET_VARIABLE_RESULT::GETVAR_NORMAL;
+			return GET_VARIABLE_RESULT::GETVAR_NORMAL;
 		}
 		else
 		{
@@ -291,11 +513,7 @@ bool Dictionary::hasPropertyByMultiname(const multiname& name, bool considerDyna
 				break;
 		}
 
-		name.name_o->incRef();
-		_R<ASObject> name_o(name.name_o);
-
-		Dictionary::dictType::iterator it=findKey(name_o.getPtr());
-		return it != data.end();
+		return findEntry(name.name_o,hashKey(name.name_o)) != EMPTY_SLOT;
 	}
 	else
 	{
@@ -312,54 +530,60 @@ bool Dictionary::hasPropertyByMultiname(const multiname& name, bool considerDyna
 uint32_t Dictionary::nextNameIndex(uint32_t cur_index)
 {
 	assert_and_throw(implEnable);
-	if(cur_index<data.size())
-		return cur_index+1;
-	else
+	uint32_t count=entries.size();
+	while(cur_index<count)
 	{
-		//Fall back on object properties
-		uint32_t ret=ASObject::nextNameIndex(cur_index-data.size());
-		if(ret==0)
-			return 0;
-		else
-			return ret+data.size();
-
+		// skip removed entries
+		if(entries[cur_index].key)
+			return cur_index+1;
+		cur_index++;
 	}
+	//Fall back on object properties
+	uint32_t ret=ASObject::nextNameIndex(cur_index-count);
+	if(ret==0)
+		return 0;
+	else
+		return ret+count;
 }
 
 void Dictionary::nextName(asAtom& ret,uint32_t index)
 {
 	assert_and_throw(implEnable);
-	if(index<=data.size())
+	if(index<=entries.size())
 	{
-		auto it=data.begin();
-		for(unsigned int i=1;i<index;i++)
-			++it;
-		it->first->incRef();
-		ret = asAtomHandler::fromObject(it->first.getPtr());
+		ASObject* key=entries[index-1].key;
+		if(key)
+		{
+			key->incRef();
+			ret = asAtomHandler::fromObject(key);
+		}
+		else
+			asAtomHandler::setUndefined(ret);
 	}
 	else
 	{
 		//Fall back on object properties
-		ASObject::nextName(ret,index-data.size());
+		ASObject::nextName(ret,index-entries.size());
 	}
 }
 
 void Dictionary::nextValue(asAtom& ret,uint32_t index)
 {
 	assert_and_throw(implEnable);
-	if(index<=data.size())
+	if(index<=entries.size())
 	{
-		auto it=data.begin();
-		for(unsigned int i=1;i<index;i++)
-			++it;
-
-		ASATOM_INCREF(it->second);
-		ret = it->second;
+		if(entries[index-1].key)
+		{
+			ret = entries[index-1].value;
+			ASATOM_INCREF(ret);
+		}
+		else
+			asAtomHandler::setUndefined(ret);
 	}
 	else
 	{
 		//Fall back on object properties
-		ASObject::nextValue(ret,index-data.size());
+		ASObject::nextValue(ret,index-entries.size());
 	}
 }
 
@@ -367,13 +591,15 @@ tiny_string Dictionary::toString()
 {
 	std::stringstream retstr;
 	retstr << "{";
-	auto it=data.begin();
-	while(it != data.end())
+	bool first=true;
+	for(auto it=entries.begin();it != entries.end();++it)
 	{
-		if(it != data.begin())
+		if(!it->key)
+			continue;
+		if(!first)
 			retstr << ", ";
-		retstr << "{" << it->first->toString() << ", " << asAtomHandler::toString(it->second,getSystemState()) << "}";
-		++it;
+		first=false;
+		retstr << "{" << it->key->toString() << ", " << asAtomHandler::toString(it->value,getSystemState()) << "}";
 	}
 	retstr << "}";
 
@@ -381,9 +607,9 @@ tiny_string Dictionary::toString()
 }
 
 
-void Dictionary::serialize(ByteArray* out, std::map<tiny_string, uint32_t>& stringMap,
-				std::map<const ASObject*, uint32_t>& objMap,
-				std::map<const Class_base*, uint32_t>& traitsMap)
+void Dictionary::serialize(ByteArray* out, std::unordered_map<tiny_string, uint32_t>& stringMap,
+				std::unordered_map<const ASObject*, uint32_t>& objMap,
+				std::unordered_map<const Class_base*, uint32_t>& traitsMap)
 {
 	if (out->getObjectEncoding() == ObjectEncoding::AMF0)
 	{
@@ -404,16 +630,16 @@ void Dictionary::serialize(ByteArray* out, std::map<tiny_string, uint32_t>& stri
 		//Add the dictionary to the map
 		objMap.insert(make_pair(this, objMap.size()));
 
+		// nextNameIndex returns slot positions, deleted slots are skipped
+		// but still advance the index, so count the live entries
 		uint32_t count = 0;
-		uint32_t tmp;
-		while ((tmp = nextNameIndex(count)) != 0)
-		{
-			count = tmp;
-		}
+		uint32_t tmp = 0;
+		while ((tmp = nextNameIndex(tmp)) != 0)
+			count++;
 		assert_and_throw(count<0x20000000);
 		uint32_t value = (count << 1) | 1;
 		out->writeU29(value);
-		out->writeByte(0x00); // TODO handle weak keys
+		out->writeByte(weakkeys ? 0x01 : 0x00);
 		
 		tmp = 0;
 		while ((tmp = nextNameIndex(tmp)) != 0)
@@ -31,24 +31,43 @@ class Dictionary: public ASObject
 {
 friend class ABCVm;
 private:
-	typedef std::map<_R<ASObject>,asAtom,std::less<_R<ASObject>>,
-	       reporter_allocator<std::pair<const _R<ASObject>, asAtom>>> dictType;
-	dictType data;
-	dictType::iterator findKey(ASObject *);
+	/* Object keys are kept in insertion order in entries, slots is an open
+	 * addressing hash table of indices into entries. Removed entries keep
+	 * their position with a NULL key until the table is rebuilt, so that
+	 * for..in iteration is stable while keys are deleted.
+	 * Keys are not referenced if weakkeys is set, they are removed when
+	 * the key object is destroyed.
+	 */
+	struct dictEntry
+	{
+		ASObject* key;
+		asAtom value;
+		uint32_t hash;
+	};
+	std::vector<dictEntry, reporter_allocator<dictEntry>> entries;
+	std::vector<uint32_t, reporter_allocator<uint32_t>> slots;
+	uint32_t livecount;
 	bool weakkeys;
+	static uint32_t hashKey(ASObject* o);
+	uint32_t findEntry(ASObject* o, uint32_t hash) const;
+	uint32_t findSlot(uint32_t index) const;
+	void insertEntry(ASObject* o, uint32_t hash, asAtom& value);
+	void removeEntry(uint32_t index);
+	void removeWeakKeyEntry(ASObject* o, uint32_t hash);
+	void rehash();
+	void clearEntries();
 public:
 	Dictionary(Class_base* c);
 	bool destruct()
 	{
-		Dictionary::dictType::iterator it = data.begin();
-		while(it!=data.end())
-		{
-			ASATOM_DECREF(it->second);
-			it++;
-		}
-		data.clear();
+		clearEntries();
+		weakkeys=false;
 		return destructIntern();
 	}
+	void traceReferences(std::vector<ASObject*>& refs);
+	void clearReferences();
+	// removes a destroyed object from all Dictionaries using it as weak key
+	static void purgeWeakKey(ASObject* o);
 	
 	static void sinit(Class_base*);
 	static void buildTraits(ASObject* o);
@@ -70,9 +89,9 @@ public:
 	void nextName(asAtom &ret, uint32_t index);
 	void nextValue(asAtom &ret, uint32_t index);
 
-	void serialize(ByteArray* out, std::map<tiny_string, uint32_t>& stringMap,
-				std::map<const ASObject*, uint32_t>& objMap,
-				std::map<const Class_base*, uint32_t>& traitsMap);
+	void serialize(ByteArray* out, std::unordered_map<tiny_string, uint32_t>& stringMap,
+				std::unordered_map<const ASObject*, uint32_t>& objMap,
+				std::unordered_map<const Class_base*, uint32_t>& traitsMap);
 };
 
 }
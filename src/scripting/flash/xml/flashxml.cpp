@@ -340,9 +340,9 @@ ASFUNCTIONBODY_ATOM(XMLDocument,_constructor)
 		th->parseXMLImpl(source);
 }
 
-void XMLDocument::serialize(ByteArray* out, std::map<tiny_string, uint32_t>& stringMap,
-				std::map<const ASObject*, uint32_t>& objMap,
-				std::map<const Class_base*, uint32_t>& traitsMap)
+void XMLDocument::serialize(ByteArray* out, std::unordered_map<tiny_string, uint32_t>& stringMap,
+				std::unordered_map<const ASObject*, uint32_t>& objMap,
+				std::unordered_map<const Class_base*, uint32_t>& traitsMap)
 {
 	if (out->getObjectEncoding() == ObjectEncoding::AMF0)
 	{
@@ -358,7 +358,7 @@ void XMLDocument::parseXMLImpl(const string& str)
 	unsigned int parsemode = pugi::parse_full |pugi::parse_fragment;
 	if (!ignoreWhite) parsemode |= pugi::parse_ws_pcdata;
 
-	rootNode=buildFromString(str, parsemode);
+	rootNode=buildFromString(xmldoc, str, parsemode);
 }
 
 ASFUNCTIONBODY_ATOM(XMLDocument,_toString)
@@ -70,6 +70,8 @@ class XMLDocument: public XMLNode, public XMLBase
 {
 friend class XMLNode;
 private:
+	//The parser will destroy the document and all the childs on destruction
+	pugi::xml_document xmldoc;
 	pugi::xml_node rootNode;
 public:
 	XMLDocument(Class_base* c, tiny_string s="");
@@ -84,9 +86,9 @@ public:
 	ASFUNCTION_ATOM(_toString);
 	ASFUNCTION_ATOM(createElement);
 	//Serialization interface
-	void serialize(ByteArray* out, std::map<tiny_string, uint32_t>& stringMap,
-				std::map<const ASObject*, uint32_t>& objMap,
-				std::map<const Class_base*, uint32_t>& traitsMap);
+	void serialize(ByteArray* out, std::unordered_map<tiny_string, uint32_t>& stringMap,
+				std::unordered_map<const ASObject*, uint32_t>& objMap,
+				std::unordered_map<const Class_base*, uint32_t>& traitsMap);
 };
 
 };
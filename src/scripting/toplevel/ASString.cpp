@@ -18,6 +18,7 @@
 **************************************************************************/
 
 #include <pcre.h>
+#include <algorithm>
 
 #include "scripting/toplevel/ASString.h"
 #include "scripting/flash/utils/ByteArray.h"
@@ -29,24 +30,24 @@
 using namespace std;
 using namespace lightspark;
 
-ASString::ASString(Class_base* c):ASObject(c,T_STRING),currentindex(0),hasId(true),datafilled(true)
+ASString::ASString(Class_base* c):ASObject(c,T_STRING),currentindex(0),ropeprefix(nullptr),ownsRopeBuffer(false),hasId(true),datafilled(true)
 {
 	stringId = BUILTIN_STRINGS::EMPTY;
 }
 
-ASString::ASString(Class_base* c,const string& s) : ASObject(c,T_STRING),data(s),currentindex(0),hasId(false),datafilled(true)
+ASString::ASString(Class_base* c,const string& s) : ASObject(c,T_STRING),data(s),currentindex(0),ropeprefix(nullptr),ownsRopeBuffer(false),hasId(false),datafilled(true)
 {
 }
 
-ASString::ASString(Class_base* c,const tiny_string& s) : ASObject(c,T_STRING),data(s),currentindex(0),hasId(false),datafilled(true)
+ASString::ASString(Class_base* c,const tiny_string& s) : ASObject(c,T_STRING),data(s),currentindex(0),ropeprefix(nullptr),ownsRopeBuffer(false),hasId(false),datafilled(true)
 {
 }
 
-ASString::ASString(Class_base* c,const Glib::ustring& s) : ASObject(c,T_STRING),data(s),currentindex(0),hasId(false),datafilled(true)
+ASString::ASString(Class_base* c,const Glib::ustring& s) : ASObject(c,T_STRING),data(s),currentindex(0),ropeprefix(nullptr),ownsRopeBuffer(false),hasId(false),datafilled(true)
 {
 }
 
-ASString::ASString(Class_base* c,const char* s) : ASObject(c,T_STRING),data(s, /*copy:*/true),currentindex(0),hasId(false),datafilled(true)
+ASString::ASString(Class_base* c,const char* s) : ASObject(c,T_STRING),data(s, /*copy:*/true),currentindex(0),ropeprefix(nullptr),ownsRopeBuffer(false),hasId(false),datafilled(true)
 {
 }
 
@@ -56,6 +57,176 @@ ASString::ASString(Class_base* c,const char* s, uint32_t len) : ASObject(c,T_STR
 	hasId = false;
 	datafilled=true;
 	currentindex=0;
+	ropeprefix=nullptr;
+	ownsRopeBuffer=false;
+}
+
+/* Strings shorter than this are copied when concatenated, ropes only pay off
+ * for longer prefixes */
+#define ROPE_MIN_BYTES 64
+
+ASObject* ASString::concatenate(SystemState* sys, asAtom& left, asAtom& right)
+{
+	ASObject* o = asAtomHandler::getObject(left);
+	if (o && o->is<ASString>())
+	{
+		ASString* prefix = o->as<ASString>();
+		if (prefix->ropeprefix || prefix->getData().numBytes() >= ROPE_MIN_BYTES)
+		{
+			ASString* ret = Class<ASString>::getInstanceSNoArgs(sys);
+			ret->data = asAtomHandler::toString(right,sys);
+			ret->stringId = UINT32_MAX;
+			ret->hasId = false;
+			ret->datafilled = false;
+			prefix->incRef();
+			ret->ropeprefix = prefix;
+			return ret;
+		}
+	}
+	tiny_string s = asAtomHandler::toString(left,sys);
+	s += asAtomHandler::toString(right,sys);
+	return abstract_s(sys,s);
+}
+
+void ASString::flatten()
+{
+	// collect the chain of prefixes, the last one is a plain string
+	std::vector<ASString*> parts;
+	uint32_t bytes = data.numBytes();
+	bool exclusive = true;
+	ASString* p = ropeprefix;
+	while (p->ropeprefix)
+	{
+		parts.push_back(p);
+		bytes += p->data.numBytes();
+		exclusive = exclusive && p->getRefCount()==1;
+		p = p->ropeprefix;
+	}
+	tiny_string& base = p->getData();
+	tiny_string res;
+	// constant and interned strings may be shared without their reference
+	// count showing it, only a buffer built by a previous flatten is private
+	if (exclusive && p->getRefCount()==1 && p->ownsRopeBuffer && !p->getConstant() && !p->hasId)
+	{
+		// nobody else can see the prefixes, so the buffer of the plain string
+		// can be reused. Appending to it grows geometrically, so building a
+		// string with repeated += is linear even if it is read in between
+		res = std::move(base);
+		p->ownsRopeBuffer = false;
+	}
+	else
+	{
+		res.reserve(bytes+base.numBytes());
+		res += base;
+	}
+	for (auto it = parts.rbegin(); it != parts.rend(); ++it)
+		res += (*it)->data;
+	res += data;
+	data = std::move(res);
+	ownsRopeBuffer = true;
+	releasePrefix();
+}
+
+void ASString::releasePrefix()
+{
+	// release the chain iteratively, decRef'ing the first prefix directly
+	// would recurse once for every concatenation
+	ASString* p = ropeprefix;
+	ropeprefix = nullptr;
+	while (p)
+	{
+		ASString* next = nullptr;
+		if (p->getRefCount()==1)
+		{
+			next = p->ropeprefix;
+			p->ropeprefix = nullptr;
+		}
+		p->decRef();
+		p = next;
+	}
+}
+
+/* Strings with at least twice as many characters get an index of byte
+ * positions, shorter strings are just scanned from the start */
+#define UTF8_INDEX_STEP 64
+
+void ASString::buildUtf8Index()
+{
+	tiny_string& d = getData();
+	utf8index.reserve(d.numChars()/UTF8_INDEX_STEP+1);
+	const char* buf = d.raw_buf();
+	const char* p = buf;
+	for (uint32_t i = 0; i < d.numChars(); i += UTF8_INDEX_STEP)
+	{
+		utf8index.push_back(p-buf);
+		if (i+UTF8_INDEX_STEP < d.numChars())
+			p = g_utf8_offset_to_pointer(p,UTF8_INDEX_STEP);
+	}
+}
+
+uint32_t ASString::charIndexToBytePos(uint32_t index)
+{
+	tiny_string& d = getData();
+	if (d.isSinglebyte())
+		return index;
+	assert(index <= d.numChars());
+	if (d.numChars() < 2*UTF8_INDEX_STEP)
+		return g_utf8_offset_to_pointer(d.raw_buf(),index)-d.raw_buf();
+	if (utf8index.empty())
+		buildUtf8Index();
+	uint32_t k = std::min(index/UTF8_INDEX_STEP,(uint32_t)utf8index.size()-1);
+	const char* p = d.raw_buf()+utf8index[k];
+	return g_utf8_offset_to_pointer(p,index-k*UTF8_INDEX_STEP)-d.raw_buf();
+}
+
+uint32_t ASString::bytePosToCharIndex(uint32_t bytepos)
+{
+	tiny_string& d = getData();
+	if (d.isSinglebyte())
+		return bytepos;
+	if (d.numChars() < 2*UTF8_INDEX_STEP)
+		return g_utf8_pointer_to_offset(d.raw_buf(),d.raw_buf()+bytepos);
+	if (utf8index.empty())
+		buildUtf8Index();
+	uint32_t k = std::upper_bound(utf8index.begin(),utf8index.end(),bytepos)-utf8index.begin()-1;
+	const char* p = d.raw_buf()+utf8index[k];
+	return k*UTF8_INDEX_STEP+g_utf8_pointer_to_offset(p,d.raw_buf()+bytepos);
+}
+
+uint32_t ASString::charAtIndex(uint32_t index)
+{
+	tiny_string& d = getData();
+	if (d.isSinglebyte())
+		return d.charAt(index);
+	return g_utf8_get_char(d.raw_buf()+charIndexToBytePos(index));
+}
+
+tiny_string ASString::substrChars(uint32_t start, uint32_t len)
+{
+	tiny_string& d = getData();
+	assert_and_throw(start <= d.numChars());
+	if (d.isSinglebyte())
+		return d.substr(start,len);
+	if (len > d.numChars()-start)
+		len = d.numChars()-start;
+	uint32_t bytestart = charIndexToBytePos(start);
+	uint32_t byteend = charIndexToBytePos(start+len);
+	return d.substr_bytes(bytestart,byteend-bytestart);
+}
+
+/* Returns obj as ASString, so that the index of the object can be used.
+ * Values that are not ASString objects are wrapped into a temporary one */
+static _R<ASString> stringObject(asAtom& obj, SystemState* sys)
+{
+	ASObject* o = asAtomHandler::getObject(obj);
+	if (o && o->is<ASString>())
+	{
+		o->incRef();
+		return _MR(o->as<ASString>());
+	}
+	if (asAtomHandler::isStringID(obj))
+		return _MR(abstract_s(sys,asAtomHandler::getStringId(obj))->as<ASString>());
+	return _MR(abstract_s(sys,asAtomHandler::toString(obj,sys))->as<ASString>());
 }
 
 ASFUNCTIONBODY_ATOM(ASString,_constructor)
@@ -64,6 +235,7 @@ ASFUNCTIONBODY_ATOM(ASString,_constructor)
 	if(args && argslen==1)
 	{
 		th->data=asAtomHandler::toString(args[0],sys);
+		th->utf8index.clear();
 		th->hasId = false;
 		th->stringId = UINT32_MAX;
 		th->datafilled = true;
@@ -167,40 +339,25 @@ ASFUNCTIONBODY_ATOM(ASString,search)
 		restr = asAtomHandler::toString(args[0],sys);
 	}
 
-	const char* error;
-	int errorOffset;
-	pcre* pcreRE=pcre_compile(restr.raw_buf(), options, &error, &errorOffset,NULL);
-	if(error)
-	{
-		asAtomHandler::setInt(ret,sys,res);
-		return;
-	}
-	int capturingGroups;
-	int infoOk=pcre_fullinfo(pcreRE, NULL, PCRE_INFO_CAPTURECOUNT, &capturingGroups);
-	if(infoOk!=0)
+	_NR<CompiledRegExp> pcreRE=RegExp::compilePattern(restr, options);
+	if(pcreRE.isNull())
 	{
-		pcre_free(pcreRE);
 		asAtomHandler::setInt(ret,sys,res);
 		return;
 	}
-	pcre_extra extra;
-	extra.match_limit_recursion=200;
-	extra.flags = PCRE_EXTRA_MATCH_LIMIT_RECURSION;
+	int capturingGroups = pcreRE->capturingGroups;
 	int ovector[(capturingGroups+1)*3];
 	int offset=0;
 	//Global is not used in search
-	int rc=pcre_exec(pcreRE, &extra, data.raw_buf(), data.numBytes(), offset, 0, ovector, (capturingGroups+1)*3);
+	int rc=pcreRE->exec(data, offset, ovector, (capturingGroups+1)*3, true);
 	if(rc<0)
 	{
 		//No matches or error
-		pcre_free(pcreRE);
 		asAtomHandler::setInt(ret,sys,res);
 		return;
 	}
-	res=ovector[0];
 	// pcre_exec returns byte position, so we have to convert it to character position 
-	tiny_string tmp = data.substr_bytes(0, res);
-	res = tmp.numChars();
+	res = data.bytePosToIndex(ovector[0]);
 	asAtomHandler::setInt(ret,sys,res);
 }
 
@@ -321,23 +478,13 @@ ASFUNCTIONBODY_ATOM(ASString,split)
 			return;
 		}
 
-		pcre* pcreRE = re->compile();
-		if (!pcreRE)
-		{
-			ret = asAtomHandler::fromObject(res);
-			return;
-		}
-		int capturingGroups;
-		int infoOk=pcre_fullinfo(pcreRE, NULL, PCRE_INFO_CAPTURECOUNT, &capturingGroups);
-		if(infoOk!=0)
+		_NR<CompiledRegExp> pcreRE = re->compile();
+		if (pcreRE.isNull())
 		{
-			pcre_free(pcreRE);
 			ret = asAtomHandler::fromObject(res);
 			return;
 		}
-		pcre_extra extra;
-		extra.match_limit_recursion=200;
-		extra.flags = PCRE_EXTRA_MATCH_LIMIT_RECURSION;
+		int capturingGroups = pcreRE->capturingGroups;
 		int ovector[(capturingGroups+1)*3];
 		int offset=0;
 		unsigned int end;
@@ -345,7 +492,7 @@ ASFUNCTIONBODY_ATOM(ASString,split)
 		do
 		{
 			//offset is a byte offset that must point to the beginning of an utf8 character
-			int rc=pcre_exec(pcreRE, &extra, data.raw_buf(), data.numBytes(), offset, 0, ovector, (capturingGroups+1)*3);
+			int rc=pcreRE->exec(data, offset, ovector, (capturingGroups+1)*3, true);
 			end=ovector[0];
 			if(rc<0)
 				break;
@@ -377,7 +524,6 @@ ASFUNCTIONBODY_ATOM(ASString,split)
 			ASObject* s=abstract_s(sys,data.substr_bytes(lastMatch,data.numBytes()-lastMatch));
 			res->push(asAtomHandler::fromObject(s));
 		}
-		pcre_free(pcreRE);
 	}
 	else
 	{
@@ -401,20 +547,18 @@ ASFUNCTIONBODY_ATOM(ASString,split)
 			ret = asAtomHandler::fromObject(res);
 			return;
 		}
-		unsigned int start=0;
-		unsigned int len = data.numChars();
+		//search and cut on byte positions, so no character indices have to be computed
+		uint32_t start=0;
+		uint32_t len = data.numBytes();
 		do
 		{
-			int match=data.find(del,start);
-			if(del.empty())
-				match++;
-			if(match==-1)
+			uint32_t match=data.findBytes(del,start);
+			if(match==tiny_string::npos)
 				match= len;
-			ASObject* s=abstract_s(sys,data.substr(start,(match-start)));
 			if (res->size() >= limit)
 				break;
-			res->push(asAtomHandler::fromObject(s));
-			start=match+del.numChars();
+			res->push(asAtomHandler::fromObject(abstract_s(sys,data.substr_bytes(start,match-start))));
+			start=match+del.numBytes();
 			if (start == len)
 				res->push(asAtomHandler::fromStringID(BUILTIN_STRINGS::EMPTY));
 		}
@@ -426,7 +570,8 @@ ASFUNCTIONBODY_ATOM(ASString,split)
 
 ASFUNCTIONBODY_ATOM(ASString,substr)
 {
-	tiny_string data = asAtomHandler::toString(obj,sys);
+	_R<ASString> th = stringObject(obj,sys);
+	const tiny_string& data = th->getData();
 	int start=0;
 	if(argslen>=1)
 	{
@@ -457,12 +602,15 @@ ASFUNCTIONBODY_ATOM(ASString,substr)
 		else
 			len=asAtomHandler::toInt(args[1]);
 	}
-	ret = asAtomHandler::fromObject(abstract_s(sys,data.substr(start,len)));
+	if (len < 0)
+		len = 0;
+	ret = asAtomHandler::fromObject(abstract_s(sys,th->substrChars(start,len)));
 }
 
 ASFUNCTIONBODY_ATOM(ASString,substring)
 {
-	tiny_string data = asAtomHandler::toString(obj,sys);
+	_R<ASString> th = stringObject(obj,sys);
+	const tiny_string& data = th->getData();
 
 	number_t start, end;
 	ARG_UNPACK_ATOM (start,0) (end,0x7fffffff);
@@ -482,7 +630,7 @@ ASFUNCTIONBODY_ATOM(ASString,substring)
 		end=tmp;
 	}
 
-	ret = asAtomHandler::fromObject(abstract_s(sys,data.substr(start,end-start)));
+	ret = asAtomHandler::fromObject(abstract_s(sys,th->substrChars(start,end-start)));
 }
 
 number_t ASString::toNumber()
@@ -641,9 +789,9 @@ TRISTATE ASString::isLessAtom(asAtom& r)
 	return (a<b)?TTRUE:TFALSE;
 }
 
-void ASString::serialize(ByteArray* out, std::map<tiny_string, uint32_t>& stringMap,
-				std::map<const ASObject*, uint32_t>& objMap,
-				std::map<const Class_base*, uint32_t>& traitsMap)
+void ASString::serialize(ByteArray* out, std::unordered_map<tiny_string, uint32_t>& stringMap,
+				std::unordered_map<const ASObject*, uint32_t>& objMap,
+				std::unordered_map<const Class_base*, uint32_t>& traitsMap)
 {
 	if (out->getObjectEncoding() == ObjectEncoding::AMF0)
 	{
@@ -659,7 +807,8 @@ void ASString::serialize(ByteArray* out, std::map<tiny_string, uint32_t>& string
 
 ASFUNCTIONBODY_ATOM(ASString,slice)
 {
-	tiny_string data = asAtomHandler::toString(obj,sys);
+	_R<ASString> th = stringObject(obj,sys);
+	const tiny_string& data = th->getData();
 	int startIndex=0;
 	if(argslen>=1)
 		startIndex=asAtomHandler::toInt(args[0]);
@@ -684,7 +833,7 @@ ASFUNCTIONBODY_ATOM(ASString,slice)
 	if(endIndex<=startIndex)
 		ret = asAtomHandler::fromStringID(BUILTIN_STRINGS::EMPTY);
 	else
-		ret = asAtomHandler::fromObject(abstract_s(sys,data.substr(startIndex,endIndex-startIndex)));
+		ret = asAtomHandler::fromObject(abstract_s(sys,th->substrChars(startIndex,endIndex-startIndex)));
 }
 ASFUNCTIONBODY_ATOM(ASString,charAt)
 {
@@ -719,7 +868,7 @@ ASFUNCTIONBODY_ATOM(ASString,charAt)
 				c = *(++th->currentpos);
 			}
 			else
-				c = th->getData().charAt(index);
+				c = th->charAtIndex(index);
 		}
 		ret = c < BUILTIN_STRINGS_CHAR_MAX ? asAtomHandler::fromStringID(c) : asAtomHandler::fromObject(abstract_s(sys, tiny_string::fromChar(c) ));
 		return;
@@ -774,7 +923,7 @@ ASFUNCTIONBODY_ATOM(ASString,charCodeAt)
 					c = *(++th->currentpos);
 				}
 				else
-					c = th->getData().charAt(index);
+					c = th->charAtIndex(index);
 			}
 			asAtomHandler::setInt(ret,sys,(int32_t)c);
 		}
@@ -799,24 +948,26 @@ ASFUNCTIONBODY_ATOM(ASString,indexOf)
 		asAtomHandler::setInt(ret,sys,-1);
 		return;
 	}
-	tiny_string data = asAtomHandler::toString(obj,sys);
+	_R<ASString> th = stringObject(obj,sys);
+	const tiny_string& data = th->getData();
 	tiny_string arg0=asAtomHandler::toString(args[0],sys);
 	int startIndex=0;
 	if(argslen>1)
 		startIndex=asAtomHandler::toInt(args[1]);
 	startIndex = imin(imax(startIndex, 0), data.numChars());
 
-	size_t pos = data.find(arg0.raw_buf(), startIndex);
+	uint32_t pos = data.findBytes(arg0, th->charIndexToBytePos(startIndex));
 	if(pos == data.npos)
 		asAtomHandler::setInt(ret,sys,-1);
 	else
-		asAtomHandler::setInt(ret,sys,(int32_t)pos);
+		asAtomHandler::setInt(ret,sys,(int32_t)th->bytePosToCharIndex(pos));
 }
 
 ASFUNCTIONBODY_ATOM(ASString,lastIndexOf)
 {
 	assert_and_throw(argslen==1 || argslen==2);
-	tiny_string data = asAtomHandler::toString(obj,sys);
+	_R<ASString> th = stringObject(obj,sys);
+	const tiny_string& data = th->getData();
 	tiny_string val=asAtomHandler::toString(args[0],sys);
 	size_t startIndex=data.npos;
 	if(argslen > 1 && !asAtomHandler::isUndefined(args[1]) && !std::isnan(asAtomHandler::toNumber(args[1])) && !(asAtomHandler::toNumber(args[1]) > 0 && std::isinf(asAtomHandler::toNumber(args[1]))))
@@ -832,11 +983,11 @@ ASFUNCTIONBODY_ATOM(ASString,lastIndexOf)
 
 	startIndex = imin(startIndex, data.numChars());
 
-	size_t pos=data.rfind(val.raw_buf(), startIndex);
+	uint32_t pos=data.rfindBytes(val, th->charIndexToBytePos(startIndex));
 	if(pos==data.npos)
 		asAtomHandler::setInt(ret,sys,-1);
 	else
-		asAtomHandler::setInt(ret,sys,(int32_t)pos);
+		asAtomHandler::setInt(ret,sys,(int32_t)th->bytePosToCharIndex(pos));
 }
 
 ASFUNCTIONBODY_ATOM(ASString,toLowerCase)
@@ -938,24 +1089,14 @@ ASFUNCTIONBODY_ATOM(ASString,replace)
 	{
 		RegExp* re=asAtomHandler::as<RegExp>(args[0]);
 
-		pcre* pcreRE = re->compile();
-		if (!pcreRE)
+		_NR<CompiledRegExp> pcreRE = re->compile();
+		if (pcreRE.isNull())
 		{
 			ret = asAtomHandler::fromObject(res);
 			return;
 		}
 
-		int capturingGroups;
-		int infoOk=pcre_fullinfo(pcreRE, NULL, PCRE_INFO_CAPTURECOUNT, &capturingGroups);
-		if(infoOk!=0)
-		{
-			pcre_free(pcreRE);
-			ret = asAtomHandler::fromObject(res);
-			return;
-		}
-		pcre_extra extra;
-		extra.match_limit_recursion=200;
-		extra.flags = PCRE_EXTRA_MATCH_LIMIT_RECURSION;
+		int capturingGroups = pcreRE->capturingGroups;
 		int ovector[(capturingGroups+1)*3];
 		int offset=0;
 		int retDiff=0;
@@ -963,11 +1104,10 @@ ASFUNCTIONBODY_ATOM(ASString,replace)
 		do
 		{
 			tiny_string replaceWithTmp = replaceWith;
-			int rc=pcre_exec(pcreRE, &extra, res->getData().raw_buf(), res->getData().numBytes(), offset, 0, ovector, (capturingGroups+1)*3);
+			int rc=pcreRE->exec(res->getData(), offset, ovector, (capturingGroups+1)*3, true);
 			if(rc<0)
 			{
 				//No matches or error
-				pcre_free(pcreRE);
 				ret = asAtomHandler::fromObject(res);
 				return;
 			}
@@ -1041,8 +1181,6 @@ ASFUNCTIONBODY_ATOM(ASString,replace)
 			retDiff+=replaceWithTmp.numBytes()-(ovector[1]-ovector[0]);
 		}
 		while(re->global);
-
-		pcre_free(pcreRE);
 	}
 	else
 	{
@@ -1067,7 +1205,7 @@ ASFUNCTIONBODY_ATOM(ASString,concat)
 	for(unsigned int i=0;i<argslen;i++)
 	{
 		res->hasId = false;
-		res->getData()+=asAtomHandler::toString(args[i],sys).raw_buf();
+		res->getData()+=asAtomHandler::toString(args[i],sys);
 	}
 
 	ret = asAtomHandler::fromObject(res);
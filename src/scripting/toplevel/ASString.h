@@ -45,6 +45,21 @@ private:
 	// speeds up iterating over all chars in the string
 	CharIterator currentpos;
 	uint32_t currentindex;
+
+	// set for strings created by concatenation that were not accessed yet:
+	// the string is ropeprefix followed by data, the parts are copied
+	// together by getData() the first time the string is used
+	ASString* ropeprefix;
+	// set when data has been built by flatten() and is not shared with any
+	// other string, only then the buffer may be taken over by a longer rope
+	bool ownsRopeBuffer;
+	void flatten();
+	void releasePrefix();
+
+	// byte positions of every UTF8_INDEX_STEP-th character, built on the
+	// first index based access to a long non-ASCII string
+	std::vector<uint32_t> utf8index;
+	void buildUtf8Index();
 public:
 	ASString(Class_base* c);
 	ASString(Class_base* c, const std::string& s);
@@ -58,18 +73,35 @@ public:
 	{
 		if (!datafilled)
 		{
-			data = getSystemState()->getStringFromUniqueId(stringId);
+			if (ropeprefix)
+				flatten();
+			else
+				data = getSystemState()->getStringFromUniqueId(stringId);
 			datafilled = true;
 		}
 		return data;
 	}
 	FORCE_INLINE bool isEmpty() const
 	{
+		// ropes are only built on non-empty prefixes
+		if (ropeprefix)
+			return false;
 		if (hasId)
 			return stringId == BUILTIN_STRINGS::EMPTY || stringId == UINT32_MAX;
 		return data.empty();
 	}
 
+	// conversions between character indices and byte positions in the data,
+	// these are fast for long non-ASCII strings, too
+	uint32_t charIndexToBytePos(uint32_t index);
+	uint32_t bytePosToCharIndex(uint32_t bytepos);
+	uint32_t charAtIndex(uint32_t index);
+	tiny_string substrChars(uint32_t start, uint32_t len);
+
+	// returns the concatenation of left and right as needed by the add opcode,
+	// long strings on the left side are not copied but referenced by a rope
+	static ASObject* concatenate(SystemState* sys, asAtom& left, asAtom& right);
+
 	static void sinit(Class_base* c);
 	static void buildTraits(ASObject* o);
 	ASFUNCTION_ATOM(_constructor);
@@ -103,14 +135,17 @@ public:
 	
 	ASFUNCTION_ATOM(generator);
 	//Serialization interface
-	void serialize(ByteArray* out, std::map<tiny_string, uint32_t>& stringMap,
-				std::map<const ASObject*, uint32_t>& objMap,
-				std::map<const Class_base*, uint32_t>& traitsMap);
+	void serialize(ByteArray* out, std::unordered_map<tiny_string, uint32_t>& stringMap,
+				std::unordered_map<const ASObject*, uint32_t>& objMap,
+				std::unordered_map<const Class_base*, uint32_t>& traitsMap);
 	std::string toDebugString() { return std::string("\"") + std::string(getData()) + "\""; }
 	static bool isEcmaSpace(uint32_t c);
 	static bool isEcmaLineTerminator(uint32_t c);
 	inline bool destruct() 
 	{ 
+		releasePrefix();
+		ownsRopeBuffer=false;
+		utf8index.clear();
 		data.clear(); 
 		hasId = false;
 		datafilled=false; 
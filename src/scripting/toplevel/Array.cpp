@@ -48,6 +48,37 @@ bool Array::destruct()
 	return destructIntern();
 }
 
+void Array::traceReferences(std::vector<ASObject*>& refs)
+{
+	ASObject::traceReferences(refs);
+	for (auto it=data_first.begin() ; it != data_first.end(); ++it)
+	{
+		if (asAtomHandler::isObject(*it))
+			refs.push_back(asAtomHandler::getObjectNoCheck(*it));
+	}
+	for (auto it=data_second.begin() ; it != data_second.end(); ++it)
+	{
+		if (asAtomHandler::isObject(it->second))
+			refs.push_back(asAtomHandler::getObjectNoCheck(it->second));
+	}
+}
+
+void Array::clearReferences()
+{
+	//The elements are released after the Array is emptied
+	std::deque<asAtom> tmp;
+	tmp.swap(data_first);
+	for (auto it=data_second.begin() ; it != data_second.end(); ++it)
+		tmp.push_back(it->second);
+	data_second.clear();
+	currentsize=0;
+	for (auto it=tmp.begin() ; it != tmp.end(); ++it)
+	{
+		ASATOM_DECREF_POINTER(it);
+	}
+	ASObject::clearReferences();
+}
+
 void Array::sinit(Class_base* c)
 {
 	CLASS_SETUP(c, ASObject, _constructor, CLASS_DYNAMIC_NOT_FINAL);
@@ -174,21 +205,20 @@ ASFUNCTIONBODY_ATOM(Array,_concat)
 		{
 			// Insert the contents of the array argument
 			uint64_t oldSize=res->currentsize;
-			uint64_t newSize=oldSize;
 			Array* otherArray=asAtomHandler::as<Array>(args[i]);
-			auto itother1=otherArray->data_first.begin();
-			for(;itother1!=otherArray->data_first.end(); ++itother1)
+			res->resize(oldSize+otherArray->size());
+			for(uint32_t j=0;j<otherArray->data_first.size();j++)
 			{
-				res->push(*itother1);
-				newSize++;
+				asAtom a = otherArray->data_first[j];
+				if (asAtomHandler::isValid(a))
+					res->set(oldSize+j, a,false);
 			}
 			auto itother2=otherArray->data_second.begin();
 			for(;itother2!=otherArray->data_second.end(); ++itother2)
 			{
 				asAtom a = itother2->second;
-				res->set(newSize+itother2->first, a,false);
+				res->set(oldSize+itother2->first, a,false);
 			}
-			res->resize(oldSize+otherArray->size());
 		}
 		else
 		{
@@ -225,9 +255,9 @@ ASFUNCTIONBODY_ATOM(Array,filter)
 	while (index < th->currentsize)
 	{
 		index++;
-		if (index <= ARRAY_SIZE_THRESHOLD)
+		if (index <= th->data_first.size())
 		{
-			asAtom& a =th->data_first.at(index-1);
+			asAtom& a =th->data_first[index-1];
 			if (asAtomHandler::isInvalid(a))
 				continue;
 			params[0] = a;
@@ -292,9 +322,9 @@ ASFUNCTIONBODY_ATOM(Array, some)
 	while (index < th->currentsize)
 	{
 		index++;
-		if (index <= ARRAY_SIZE_THRESHOLD)
+		if (index <= th->data_first.size())
 		{
-			asAtom& a =th->data_first.at(index-1);
+			asAtom& a =th->data_first[index-1];
 			if (asAtomHandler::isInvalid(a))
 				continue;
 			params[0] = a;
@@ -355,9 +385,9 @@ ASFUNCTIONBODY_ATOM(Array, every)
 	while (index < th->currentsize)
 	{
 		index++;
-		if (index <= ARRAY_SIZE_THRESHOLD)
+		if (index <= th->data_first.size())
 		{
-			asAtom& a =th->data_first.at(index-1);
+			asAtom& a =th->data_first[index-1];
 			if (asAtomHandler::isInvalid(a))
 				continue;
 			params[0] = a;
@@ -435,9 +465,9 @@ ASFUNCTIONBODY_ATOM(Array,forEach)
 	while (index < s)
 	{
 		index++;
-		if (index <= ARRAY_SIZE_THRESHOLD)
+		if (index <= th->data_first.size())
 		{
-			asAtom& a =th->data_first.at(index-1);
+			asAtom& a =th->data_first[index-1];
 			if (asAtomHandler::isInvalid(a))
 				continue;
 			else
@@ -472,7 +502,7 @@ ASFUNCTIONBODY_ATOM(Array, _reverse)
 {
 	Array* th=asAtomHandler::as<Array>(obj);
 
-	if (th->data_second.empty())
+	if (th->data_second.empty() && th->data_first.size() == th->currentsize)
 		std::reverse(th->data_first.begin(),th->data_first.end());
 	else
 	{
@@ -540,7 +570,7 @@ ASFUNCTIONBODY_ATOM(Array,lastIndexOf)
 	do
 	{
 		asAtom a=asAtomHandler::invalidAtom;
-		if ( i >= ARRAY_SIZE_THRESHOLD)
+		if ( i >= th->data_first.size())
 		{
 			auto it = th->data_second.find(i);
 			if (it == th->data_second.end())
@@ -601,27 +631,15 @@ ASFUNCTIONBODY_ATOM(Array,shift)
 		asAtomHandler::setUndefined(ret);
 		return;
 	}
+	asAtomHandler::setUndefined(ret);
+	// the first element is always stored in the dense part, so this is O(1) for dense arrays
 	if (th->data_first.size() > 0)
-		ret = th->data_first[0];
-	if (asAtomHandler::isInvalid(ret))
-		ret = asAtomHandler::undefinedAtom;
-	if (th->data_first.size() > 0)
-		th->data_first.erase(th->data_first.begin());
-
-	std::unordered_map<uint32_t,asAtom> tmp;
-	auto it=th->data_second.begin();
-	for (; it != th->data_second.end(); ++it )
 	{
-		if(it->first)
-		{
-			if (it->first == ARRAY_SIZE_THRESHOLD)
-				th->data_first[ARRAY_SIZE_THRESHOLD-1] = it->second;
-			else
-				tmp[it->first-1]=it->second;
-		}
+		if (asAtomHandler::isValid(th->data_first.front()))
+			ret = th->data_first.front();
+		th->data_first.front() = asAtomHandler::invalidAtom;
 	}
-	th->data_second.clear();
-	th->data_second.insert(tmp.begin(),tmp.end());
+	th->moveElements(1,-1);
 	th->resize(th->size()-1);
 }
 
@@ -680,6 +698,8 @@ ASFUNCTIONBODY_ATOM(Array,splice)
 
 	startIndex=th->capIndex(startIndex);
 
+	if (deleteCount < 0)
+		deleteCount = 0;
 	if((uint32_t)(startIndex+deleteCount)>totalSize)
 		deleteCount=totalSize-startIndex;
 
@@ -699,58 +719,30 @@ ASFUNCTIONBODY_ATOM(Array,splice)
 		// delete items from current array
 		for (int i = 0; i < deleteCount; i++)
 		{
-			if (i+startIndex < ARRAY_SIZE_THRESHOLD)
+			uint32_t index = startIndex+i;
+			if (index < th->data_first.size())
 			{
-				if ((uint32_t)startIndex <th->data_first.size())
-					th->data_first.erase(th->data_first.begin()+startIndex);
+				ASATOM_DECREF(th->data_first[index]);
+				th->data_first[index] = asAtomHandler::invalidAtom;
 			}
 			else
 			{
-				auto it = th->data_second.find(startIndex+i);
+				auto it = th->data_second.find(index);
 				if (it != th->data_second.end())
 				{
+					ASATOM_DECREF(it->second);
 					th->data_second.erase(it);
 				}
 			}
 		}
 	}
-	// remember items in current array that have to be moved to new position
-	vector<asAtom> tmp = vector<asAtom>(totalSize- (startIndex+deleteCount));
-	for (uint32_t i = (uint32_t)startIndex+deleteCount; i < totalSize ; i++)
-	{
-		if (i < ARRAY_SIZE_THRESHOLD)
-		{
-			if ((uint32_t)startIndex < th->data_first.size())
-			{
-				tmp[i-(startIndex+deleteCount)] = th->data_first[(uint32_t)startIndex];
-				th->data_first.erase(th->data_first.begin()+startIndex);
-			}
-		}
-		else
-		{
-			auto it = th->data_second.find(i);
-			if (it != th->data_second.end())
-			{
-				tmp[i-(startIndex+deleteCount)] = it->second;
-				th->data_second.erase(it);
-			}
-		}
-	}
-	th->resize(startIndex);
-
-	
+	// move the items behind the deleted range to their new position
+	uint32_t insertCount = (argslen > 2 ? argslen-2 : 0);
+	th->moveElements(startIndex+deleteCount,(int64_t)insertCount-deleteCount);
+	th->resize((totalSize-deleteCount)+insertCount);
 	//Insert requested values starting at startIndex
-	for(unsigned int i=2;i<argslen;i++)
-	{
-		th->push(args[i]);
-	}
-	// move remembered items to new position
-	th->resize((totalSize-deleteCount)+(argslen > 2 ? argslen-2 : 0));
-	for(uint32_t i=0;i<totalSize- (startIndex+deleteCount);i++)
-	{
-		if (asAtomHandler::isValid(tmp[i]))
-			th->set(startIndex+i+(argslen > 2 ? argslen-2 : 0),tmp[i],false);
-	}
+	for(uint32_t i=0;i<insertCount;i++)
+		th->set(startIndex+i,args[i+2],false);
 	ret =asAtomHandler::fromObject(res);
 }
 
@@ -853,15 +845,12 @@ ASFUNCTIONBODY_ATOM(Array,_pop)
 	if (size == 0)
 		return;
 	
-	if (size <= ARRAY_SIZE_THRESHOLD)
+	if (size <= th->data_first.size())
 	{
-		if (th->data_first.size() > 0)
-		{
-			ret = *th->data_first.rbegin();
-			th->data_first.pop_back();
-			if (asAtomHandler::isInvalid(ret))
-				asAtomHandler::setUndefined(ret);
-		}
+		ret = th->data_first.back();
+		th->data_first.pop_back();
+		if (asAtomHandler::isInvalid(ret))
+			asAtomHandler::setUndefined(ret);
 	}
 	else
 	{
@@ -929,47 +918,201 @@ bool Array::sortComparatorDefault::operator()(const asAtom& d1, const asAtom& d2
 		}
 	}
 }
-// std::sort expects strict weak ordering for the comparison function
-// this is not guarranteed by user defined comparison functions, so we need out own sorting method.
-// TODO this is just a simple quicksort implementation, not optimized for performance
-void simplequicksortArray(std::vector<asAtom>& v, Array::sortComparatorWrapper& comp, int32_t lo, int32_t hi)
+// Reads a u30 from the raw method code
+static bool readComparatorU30(const std::string& code, uint32_t& pos, uint32_t& ret)
 {
-	if (v.size() == 2)
+	ret=0;
+	for(uint32_t shift=0;shift<35;shift+=7)
 	{
-		if (comp.compare(v[0],v[1]) > 0)
-			std::swap(v[0],v[1]);
-		return;
+		if(pos>=code.size())
+			return false;
+		uint8_t b=code[pos++];
+		ret|=uint32_t(b&0x7f)<<shift;
+		if(!(b&0x80))
+			return true;
 	}
-	if (lo < hi)
+	return false;
+}
+
+// Skips opcodes that have no effect on the result
+static bool skipComparatorDebugCode(const std::string& code, uint32_t& pos)
+{
+	uint32_t tmp;
+	while(pos<code.size())
 	{
-		asAtom pivot = v[lo];
-		int32_t i = lo - 1;
-		int32_t j = hi + 1;
-		while (true)
+		switch((uint8_t)code[pos])
 		{
-			do
-			{
-				i++;
-			}
-			while (i < hi && (comp.compare(v[i],pivot) < 0));
-			
-			do
-			{
-				j--;
-			}
-			while (j >= 0 && (comp.compare(v[j],pivot) > 0));
-	
-			if (i >= j)
+			case 0x02://nop
+			case 0x09://label
+				pos++;
 				break;
-
-			std::swap(v[i],v[j]);
+			case 0xef://debug
+				pos+=2;
+				if(!readComparatorU30(code,pos,tmp))
+					return false;
+				pos++;
+				if(!readComparatorU30(code,pos,tmp))
+					return false;
+				break;
+			case 0xf0://debugline
+			case 0xf1://debugfile
+				pos++;
+				if(!readComparatorU30(code,pos,tmp))
+					return false;
+				break;
+			default:
+				return true;
 		}
-		if (j >= lo)
+	}
+	return false;
+}
+
+// Reads "getlocal1/getlocal2 [getproperty name]", returns the local number
+static uint32_t readComparatorOperand(const std::string& code, uint32_t& pos, uint32_t& nameIndex)
+{
+	nameIndex=0;
+	if(!skipComparatorDebugCode(code,pos))
+		return 0;
+	uint32_t local;
+	switch((uint8_t)code[pos])
+	{
+		case 0xd1://getlocal1
+			local=1;
+			break;
+		case 0xd2://getlocal2
+			local=2;
+			break;
+		default:
+			return 0;
+	}
+	pos++;
+	if(!skipComparatorDebugCode(code,pos))
+		return 0;
+	if((uint8_t)code[pos]==0x66)//getproperty
+	{
+		pos++;
+		if(!readComparatorU30(code,pos,nameIndex) || nameIndex==0)
+			return 0;
+	}
+	return local;
+}
+
+// Checks if a value will be accepted as argument without coercion
+static bool isComparatorArgument(SystemState* sys, const Type* type, const asAtom& value)
+{
+	if(type==Type::anyType)
+		return true;
+	if(type==Class<Number>::getRef(sys).getPtr() && asAtomHandler::isNumeric(value))
+		return true;
+	if(!asAtomHandler::isObject(value))
+		return false;
+	const Class_base* cls=dynamic_cast<const Class_base*>(type);
+	ASObject* obj=asAtomHandler::getObject(value);
+	return cls && obj->getClass() && obj->getClass()->isSubClass(cls);
+}
+
+bool Array::getNumericComparatorKeys(asAtom comparator, const std::vector<asAtom>& values, std::vector<number_t>& keys, bool& descending)
+{
+	if(!asAtomHandler::is<SyntheticFunction>(comparator))
+		return false;
+	method_info* mi=asAtomHandler::as<SyntheticFunction>(comparator)->getMethodInfo();
+	// optimized code is no longer in abc format
+	if(mi->body==NULL || (mi->body->codeStatus!=method_body_info::ORIGINAL &&
+			mi->body->codeStatus!=method_body_info::USED && mi->body->codeStatus!=method_body_info::PRELOADED))
+		return false;
+	if(mi->numArgs()!=2 || mi->needsArgs() || mi->needsRest() || mi->needsActivation())
+		return false;
+
+	// match [getlocal0 pushscope] operand operand subtract [convert_d|coerce_a] returnvalue
+	const std::string& code=mi->body->code;
+	uint32_t pos=0;
+	if(!skipComparatorDebugCode(code,pos))
+		return false;
+	if(pos+1<code.size() && (uint8_t)code[pos]==0xd0 && (uint8_t)code[pos+1]==0x30)
+		pos+=2;
+	uint32_t nameIndex1;
+	uint32_t nameIndex2;
+	uint32_t local1=readComparatorOperand(code,pos,nameIndex1);
+	uint32_t local2=readComparatorOperand(code,pos,nameIndex2);
+	if(local1==0 || local2==0 || local1==local2 || nameIndex1!=nameIndex2)
+		return false;
+	if(!skipComparatorDebugCode(code,pos) || (uint8_t)code[pos++]!=0xa1)//subtract
+		return false;
+	if(!skipComparatorDebugCode(code,pos))
+		return false;
+	if((uint8_t)code[pos]==0x75 || (uint8_t)code[pos]==0x82)//convert_d, coerce_a
+		pos++;
+	if(!skipComparatorDebugCode(code,pos) || (uint8_t)code[pos++]!=0x48)//returnvalue
+		return false;
+	descending=(local1==2);
+
+	const multiname* name=NULL;
+	if(nameIndex1)
+	{
+		if(nameIndex1>=mi->context->constant_pool.multinames.size())
+			return false;
+		uint8_t kind=mi->context->constant_pool.multinames[nameIndex1].kind;
+		// only static names without attributes
+		if(kind!=0x07 && kind!=0x09)
+			return false;
+		name=mi->context->getMultiname(nameIndex1,NULL);
+	}
+	SystemState* sys=asAtomHandler::getObject(comparator)->getSystemState();
+	// integer return types would truncate the difference
+	const Type* returnType=Type::getTypeFromMultiname(mi->returnTypeName(),mi->context);
+	if(returnType!=Type::anyType && returnType!=Class<Number>::getRef(sys).getPtr())
+		return false;
+	const Type* paramType1=Type::getTypeFromMultiname(mi->paramTypeName(0),mi->context);
+	const Type* paramType2=Type::getTypeFromMultiname(mi->paramTypeName(1),mi->context);
+	if(paramType1==Class<ASObject>::getRef(sys).getPtr())
+		paramType1=Type::anyType;
+	if(paramType2==Class<ASObject>::getRef(sys).getPtr())
+		paramType2=Type::anyType;
+
+	keys.resize(values.size());
+	for(uint32_t i=0;i<values.size();i++)
+	{
+		const asAtom& v=values[i];
+		if(asAtomHandler::isInvalid(v) || !isComparatorArgument(sys,paramType1,v) || !isComparatorArgument(sys,paramType2,v))
+			return false;
+		if(name==NULL)
 		{
-			simplequicksortArray(v, comp, lo, j);
-			simplequicksortArray(v, comp, j + 1, hi);
+			if(!asAtomHandler::isPrimitive(v))
+				return false;
+			keys[i]=asAtomHandler::toNumber(v);
+			continue;
 		}
+		if(asAtomHandler::isPrimitive(v) || !asAtomHandler::isObject(v))
+			return false;
+		ASObject* obj=asAtomHandler::getObject(v);
+		if(obj->is<Proxy>())
+			return false;
+		// the stored value or getter is borrowed, only the getter result is owned
+		asAtom val=asAtomHandler::invalidAtom;
+		GET_VARIABLE_RESULT res=obj->getVariableByMultiname(val,*name,(GET_VARIABLE_OPTION)(DONT_CALL_GETTER|NO_INCREF));
+		bool owned=false;
+		if(res & GETVAR_ISGETTER)
+		{
+			// getters written in ActionScript may have side effects
+			if(asAtomHandler::is<SyntheticFunction>(val))
+				return false;
+			val=asAtomHandler::invalidAtom;
+			obj->getVariableByMultiname(val,*name);
+			owned=true;
+		}
+		// missing properties may throw a ReferenceError
+		if(asAtomHandler::isInvalid(val))
+			return false;
+		bool primitive=asAtomHandler::isPrimitive(val);
+		if(primitive)
+			keys[i]=asAtomHandler::toNumber(val);
+		if(owned)
+			ASATOM_DECREF(val);
+		// objects may be converted by a valueOf method
+		if(!primitive)
+			return false;
 	}
+	return true;
 }
 
 number_t Array::sortComparatorWrapper::compare(const asAtom& d1, const asAtom& d2)
@@ -1034,12 +1177,9 @@ ASFUNCTIONBODY_ATOM(Array,_sort)
 	}
 	
 	if(asAtomHandler::isValid(comp))
-	{
-		sortComparatorWrapper c(comp);
-		simplequicksortArray(tmp,c,0,tmp.size()-1);
-	}
+		sortWithComparator<sortComparatorWrapper>(tmp,comp);
 	else
-		sort(tmp.begin(),tmp.end(),sortComparatorDefault(sys->getSwfVersion() < 11, isNumeric,isCaseInsensitive,isDescending));
+		adaptiveSort(tmp,sortComparatorDefault(sys->getSwfVersion() < 11, isNumeric,isCaseInsensitive,isDescending));
 
 	th->data_first.clear();
 	th->data_second.clear();
@@ -1057,33 +1197,27 @@ bool Array::sortOnComparator::operator()(const sorton_value& d1, const sorton_va
 {
 	std::vector<sorton_field>::iterator it=fields.begin();
 	uint32_t i = 0;
-	for(;it != fields.end();++it)
+	for(;it != fields.end();++it,++i)
 	{
-		asAtom obj1 = d1.sortvalues.at(i);
-		asAtom obj2 = d2.sortvalues.at(i);
-		i++;
 		if(it->isNumeric)
 		{
-			number_t a=numeric_limits<double>::quiet_NaN();
-			number_t b=numeric_limits<double>::quiet_NaN();
-			a=asAtomHandler::toNumber(obj1);
-			
-			b=asAtomHandler::toNumber(obj2);
-			
-			if((!asAtomHandler::isNumeric(obj1) && std::isnan(a)) || (!asAtomHandler::isNumeric(obj2) && std::isnan(b)))
+			number_t a=d1.sortnumbers[i];
+			number_t b=d2.sortnumbers[i];
+			if((std::isnan(a) && !asAtomHandler::isNumeric(d1.sortvalues[i])) || (std::isnan(b) && !asAtomHandler::isNumeric(d2.sortvalues[i])))
 				throw RunTimeException("Cannot sort non number with Array.NUMERIC option");
-			if(it->isDescending)
-				return b>a;
-			else
-				return a<b;
+			if (a != b)
+			{
+				if(it->isDescending)
+					return b>a;
+				else
+					return a<b;
+			}
 		}
 		else
 		{
 			//Comparison is always in lexicographic order
-			tiny_string s1;
-			tiny_string s2;
-			s1=asAtomHandler::toString(obj1,sys);
-			s2=asAtomHandler::toString(obj2,sys);
+			const tiny_string& s1=d1.sortstrings[i];
+			const tiny_string& s2=d2.sortstrings[i];
 			if (s1 != s2)
 			{
 				if(it->isDescending)
@@ -1106,6 +1240,23 @@ bool Array::sortOnComparator::operator()(const sorton_value& d1, const sorton_va
 	return false;
 }
 
+void Array::getSortOnKeys(sorton_value& v, std::vector<sorton_field>& sortfields)
+{
+	v.sortnumbers.resize(sortfields.size());
+	v.sortstrings.resize(sortfields.size());
+	for (uint32_t i=0;i<sortfields.size();i++)
+	{
+		asAtom tmpval=asAtomHandler::invalidAtom;
+		asAtomHandler::getObject(v.dataAtom)->getVariableByMultiname(tmpval,sortfields[i].fieldname);
+		v.sortvalues.push_back(tmpval);
+		//Convert the values only once instead of on every comparison
+		if(sortfields[i].isNumeric)
+			v.sortnumbers[i]=asAtomHandler::toNumber(tmpval);
+		else
+			v.sortstrings[i]=asAtomHandler::toString(tmpval,getSystemState());
+	}
+}
+
 ASFUNCTIONBODY_ATOM(Array,sortOn)
 {
 	if (argslen != 1 && argslen != 2)
@@ -1116,7 +1267,6 @@ ASFUNCTIONBODY_ATOM(Array,sortOn)
 	if(asAtomHandler::is<Array>(args[0]))
 	{
 		Array* obj=asAtomHandler::as<Array>(args[0]);
-		int n = 0;
 		for(uint32_t i = 0;i<obj->size();i++)
 		{
 			multiname sortfieldname(NULL);
@@ -1130,8 +1280,8 @@ ASFUNCTIONBODY_ATOM(Array,sortOn)
 		{
 			Array* opts=asAtomHandler::as<Array>(args[1]);
 			auto itopt=opts->data_first.begin();
-			int nopt = 0;
-			for(;itopt != opts->data_first.end() && nopt < n;++itopt)
+			uint32_t nopt = 0;
+			for(;itopt != opts->data_first.end() && nopt < sortfields.size();++itopt)
 			{
 				uint32_t options=0;
 				options = asAtomHandler::toInt(*itopt);
@@ -1178,14 +1328,8 @@ ASFUNCTIONBODY_ATOM(Array,sortOn)
 		// ensure ASObjects are created
 		asAtomHandler::toObject(*it1,sys);
 		
-		sorton_value v(*it1);
-		for (auto itsf=sortfields.begin();itsf != sortfields.end(); itsf++)
-		{
-			asAtom tmpval=asAtomHandler::invalidAtom;
-			asAtomHandler::getObject(*it1)->getVariableByMultiname(tmpval,itsf->fieldname);
-			v.sortvalues.push_back(tmpval);
-		}
-		tmp.push_back(v);
+		tmp.push_back(sorton_value(*it1));
+		th->getSortOnKeys(tmp.back(),sortfields);
 	}
 	auto it2=th->data_second.begin();
 	for(;it2 != th->data_second.end();++it2)
@@ -1195,17 +1339,11 @@ ASFUNCTIONBODY_ATOM(Array,sortOn)
 		// ensure ASObjects are created
 		asAtomHandler::toObject(it2->second,sys);
 		
-		sorton_value v(it2->second);
-		for (auto itsf=sortfields.begin();itsf != sortfields.end(); itsf++)
-		{
-			asAtom tmpval=asAtomHandler::invalidAtom;
-			asAtomHandler::getObject(it2->second)->getVariableByMultiname(tmpval,itsf->fieldname);
-			v.sortvalues.push_back(tmpval);
-		}
-		tmp.push_back(v);
+		tmp.push_back(sorton_value(it2->second));
+		th->getSortOnKeys(tmp.back(),sortfields);
 	}
 	
-	sort(tmp.begin(),tmp.end(),sortOnComparator(sortfields,sys));
+	adaptiveSort(tmp,sortOnComparator(sortfields,sys));
 
 	th->data_first.clear();
 	th->data_second.clear();
@@ -1257,27 +1395,10 @@ ASFUNCTIONBODY_ATOM(Array,unshift)
 	if (argslen > 0)
 	{
 		th->resize(th->size()+argslen);
-		std::map<uint32_t,asAtom> tmp;
-		for (uint32_t i = 0; i< th->data_first.size(); i++)
-		{
-			tmp[i+argslen]=th->data_first[i];
-		}
-		for (auto it=th->data_second.begin(); it != th->data_second.end(); ++it )
-		{
-			tmp[it->first+argslen]=it->second;
-		}
-		
+		// O(1) per element for dense arrays, as the new elements are added in front of the deque
+		th->moveElements(0,argslen);
 		for(uint32_t i=0;i<argslen;i++)
-		{
-			tmp[i] = args[i];
-			ASATOM_INCREF(args[i]);
-		}
-		th->data_first.clear();
-		th->data_second.clear();
-		for (auto it=tmp.begin(); it != tmp.end(); ++it )
-		{
-			th->set(it->first,it->second,false);
-		}
+			th->set(i,args[i],false);
 	}
 	asAtomHandler::setUInt(ret,sys,(int32_t)th->size());
 }
@@ -1388,9 +1509,9 @@ ASFUNCTIONBODY_ATOM(Array,_map)
 	while (index < s)
 	{
 		index++;
-		if (index <= ARRAY_SIZE_THRESHOLD)
+		if (index <= th->data_first.size())
 		{
-			asAtom& a =th->data_first.at(index-1);
+			asAtom& a =th->data_first[index-1];
 			if(asAtomHandler::isValid(a))
 				params[0] = a;
 			else
@@ -1398,8 +1519,8 @@ ASFUNCTIONBODY_ATOM(Array,_map)
 		}
 		else
 		{
-			auto it=th->data_second.find(index);
-			if(asAtomHandler::isValid(it->second))
+			auto it=th->data_second.find(index-1);
+			if(it != th->data_second.end())
 				params[0]=it->second;
 			else
 				params[0]=asAtomHandler::undefinedAtom;
@@ -1481,26 +1602,7 @@ ASFUNCTIONBODY_ATOM(Array,insertAt)
 	}
 	else
 	{
-		std::map<uint32_t,asAtom> tmp;
-		if (index < ARRAY_SIZE_THRESHOLD)
-			th->data_first.insert(th->data_first.begin()+index,o);
-		auto it=th->data_second.begin();
-		for (; it != th->data_second.end(); ++it )
-		{
-			tmp[it->first+(it->first >= (uint32_t)index ? 1 : 0)]=it->second;
-		}
-		if (th->data_first.size() > ARRAY_SIZE_THRESHOLD)
-		{
-			tmp[ARRAY_SIZE_THRESHOLD] = th->data_first[ARRAY_SIZE_THRESHOLD];
-			th->data_first.pop_back();
-		}
-		th->data_second.clear();
-		auto ittmp = tmp.begin();
-		while (ittmp != tmp.end())
-		{
-			th->set(ittmp->first,ittmp->second,false);
-			ittmp++;
-		}
+		th->moveElements(index,1);
 		th->currentsize++;
 		th->set(index,o,false);
 	}
@@ -1516,15 +1618,12 @@ ASFUNCTIONBODY_ATOM(Array,removeAt)
 	if (index < 0)
 		index = 0;
 	asAtomHandler::setUndefined(ret);
-	if (index < ARRAY_SIZE_THRESHOLD)
+	if ((uint32_t)index < th->data_first.size())
 	{
-		if ((uint32_t)index < th->data_first.size())
-		{
-			ret = th->data_first[index];
-			if (asAtomHandler::isInvalid(ret))
-				asAtomHandler::setUndefined(ret);
-			th->data_first.erase(th->data_first.begin()+index);
-		}
+		ret = th->data_first[index];
+		if (asAtomHandler::isInvalid(ret))
+			asAtomHandler::setUndefined(ret);
+		th->data_first[index] = asAtomHandler::invalidAtom;
 	}
 	else
 	{
@@ -1538,18 +1637,10 @@ ASFUNCTIONBODY_ATOM(Array,removeAt)
 		}
 	}
 	if ((uint32_t)index < th->currentsize)
-		th->currentsize--;
-	std::map<uint32_t,asAtom> tmp;
-	auto it=th->data_second.begin();
-	for (; it != th->data_second.end(); ++it )
 	{
-		if (it->first == ARRAY_SIZE_THRESHOLD)
-			th->data_first[ARRAY_SIZE_THRESHOLD-1]=it->second;
-		else
-			tmp[it->first-(it->first > (uint32_t)index ? 1 : 0)]=it->second;
+		th->moveElements(index+1,-1);
+		th->currentsize--;
 	}
-	th->data_second.clear();
-	th->data_second.insert(tmp.begin(),tmp.end());
 }
 int32_t Array::getVariableByMultiname_i(const multiname& name)
 {
@@ -1560,10 +1651,8 @@ int32_t Array::getVariableByMultiname_i(const multiname& name)
 
 	if(index<size())
 	{
-		if (index < ARRAY_SIZE_THRESHOLD)
-		{
-			return data_first.size() > index ? asAtomHandler::toInt(data_first.at(index)) : 0;
-		}
+		if (index < data_first.size())
+			return asAtomHandler::toInt(data_first[index]);
 		auto it = data_second.find(index);
 		if (it == data_second.end())
 			return 0;
@@ -1594,16 +1683,13 @@ GET_VARIABLE_RESULT Array::getVariableByMultiname(asAtom& ret, const multiname&
 	if (getClass() && getClass()->isSealed)
 		throwError<ReferenceError>(kReadSealedError,name.normalizedNameUnresolved(getSystemState()),getClass()->getQualifiedClassName());
 	
-	if (index < ARRAY_SIZE_THRESHOLD)
+	if (index < data_first.size())
 	{
-		if (data_first.size() > index)
-		{
-			ret = data_first.at(index);
-			if (!(opt & NO_INCREF))
-				ASATOM_INCREF(ret);
-			if (asAtomHandler::isValid(ret))
-				return GET_VARIABLE_RESULT::GETVAR_NORMAL;
-		}
+		ret = data_first[index];
+		if (!(opt & NO_INCREF))
+			ASATOM_INCREF(ret);
+		if (asAtomHandler::isValid(ret))
+			return GET_VARIABLE_RESULT::GETVAR_NORMAL;
 	}
 	auto it = data_second.find(index);
 	if(it != data_second.end())
@@ -1660,11 +1746,9 @@ bool Array::hasPropertyByMultiname(const multiname& name, bool considerDynamic,
 	// Derived classes may be sealed!
 	if (getClass() && getClass()->isSealed)
 		return false;
-	if (index < ARRAY_SIZE_THRESHOLD)
-	{
-		return data_first.size() > index ? (asAtomHandler::isValid(data_first.at(index))) : false;
-	}
-	
+	if (index < data_first.size())
+		return asAtomHandler::isValid(data_first[index]);
+
 	return (data_second.find(index) != data_second.end());
 }
 
@@ -1757,8 +1841,11 @@ bool Array::deleteVariableByMultiname(const multiname& name)
 		return true;
 	if (index < data_first.size())
 	{
-		ASATOM_DECREF(data_first.at(index));
+		ASATOM_DECREF(data_first[index]);
 		data_first[index]=asAtomHandler::invalidAtom;
+		// holes at the end are not kept in the dense part
+		while (!data_first.empty() && asAtomHandler::isInvalid(data_first.back()))
+			data_first.pop_back();
 		return true;
 	}
 	
@@ -1801,11 +1888,8 @@ tiny_string Array::toString_priv(bool localized)
 	for(uint32_t i=0;i<size();i++)
 	{
 		asAtom sl=asAtomHandler::invalidAtom;
-		if (i < ARRAY_SIZE_THRESHOLD)
-		{
-			if (i < data_first.size())
-				sl = data_first[i];
-		}
+		if (i < data_first.size())
+			sl = data_first[i];
 		else
 		{
 			auto it = data_second.find(i);
@@ -1831,12 +1915,12 @@ void Array::nextValue(asAtom& ret,uint32_t index)
 	if(index<=size())
 	{
 		--index;
-		if (index < ARRAY_SIZE_THRESHOLD)
-			ret = data_first.at(index);
+		if (index < data_first.size())
+			ret = data_first[index];
 		else
 		{
 			auto it = data_second.find(index);
-			if(it == data_second.end() || it->first != index)
+			if(it == data_second.end())
 				asAtomHandler::setUndefined(ret);
 			else
 				ret = it->second;
@@ -1862,7 +1946,7 @@ uint32_t Array::nextNameIndex(uint32_t cur_index)
 	if(cur_index<s)
 	{
 		uint32_t firstsize = data_first.size();
-		while (cur_index < ARRAY_SIZE_THRESHOLD && cur_index<s && cur_index < firstsize && asAtomHandler::isInvalid(data_first.at(cur_index)))
+		while (cur_index<s && cur_index < firstsize && asAtomHandler::isInvalid(data_first[cur_index]))
 		{
 			cur_index++;
 		}
@@ -1903,11 +1987,8 @@ asAtom Array::at(unsigned int index)
 		outofbounds(index);
 	
 	asAtom ret=asAtomHandler::invalidAtom;
-	if (index < ARRAY_SIZE_THRESHOLD)
-	{
-		if (index < data_first.size())
-			ret = data_first.at(index);
-	}
+	if (index < data_first.size())
+		ret = data_first[index];
 	else
 	{
 		auto it = data_second.find(index);
@@ -1930,24 +2011,18 @@ void Array::resize(uint64_t n)
 {
 	if (n < currentsize)
 	{
-		if (n < data_first.size())
+		while (n < data_first.size())
 		{
-			auto it1 = data_first.begin()+n;
-			while (it1 != data_first.end())
-			{
-				ASATOM_DECREF((*it1));
-				it1 = data_first.erase(it1);
-			}
+			ASATOM_DECREF(data_first.back());
+			data_first.pop_back();
 		}
 		auto it2=data_second.begin();
 		while (it2 != data_second.end())
 		{
 			if (it2->first >= n)
 			{
-				auto it2a = it2;
-				++it2;
-				ASATOM_DECREF(it2a->second);
-				data_second.erase(it2a);
+				ASATOM_DECREF(it2->second);
+				it2 = data_second.erase(it2);
 			}
 			else
 				++it2;
@@ -1956,9 +2031,9 @@ void Array::resize(uint64_t n)
 	currentsize = n;
 }
 
-void Array::serialize(ByteArray* out, std::map<tiny_string, uint32_t>& stringMap,
-				std::map<const ASObject*, uint32_t>& objMap,
-				std::map<const Class_base*, uint32_t>& traitsMap)
+void Array::serialize(ByteArray* out, std::unordered_map<tiny_string, uint32_t>& stringMap,
+				std::unordered_map<const ASObject*, uint32_t>& objMap,
+				std::unordered_map<const Class_base*, uint32_t>& traitsMap)
 {
 	if (out->getObjectEncoding() == ObjectEncoding::AMF0)
 	{
@@ -1986,12 +2061,12 @@ void Array::serialize(ByteArray* out, std::map<tiny_string, uint32_t>& stringMap
 		serializeDynamicProperties(out, stringMap, objMap, traitsMap);
 		for(uint32_t i=0;i<denseCount;i++)
 		{
-			if (i < ARRAY_SIZE_THRESHOLD)
+			if (i < data_first.size())
 			{
-				if (asAtomHandler::isInvalid(data_first.at(i)))
+				if (asAtomHandler::isInvalid(data_first[i]))
 					out->writeByte(null_marker);
 				else
-					asAtomHandler::toObject(data_first.at(i),getSystemState())->serialize(out, stringMap, objMap, traitsMap);
+					asAtomHandler::toObject(data_first[i],getSystemState())->serialize(out, stringMap, objMap, traitsMap);
 			}
 			else
 			{
@@ -2024,8 +2099,8 @@ tiny_string Array::toJSON(std::vector<ASObject *> &path, asAtom replacer, const
 	for (uint32_t i=0 ; i < denseCount; i++)
 	{
 		asAtom a=asAtomHandler::invalidAtom;
-		if ( i < ARRAY_SIZE_THRESHOLD)
-			a = data_first.at(i);
+		if ( i < data_first.size())
+			a = data_first[i];
 		else
 		{
 			auto it = data_second.find(i);
@@ -2079,17 +2154,15 @@ bool Array::set(unsigned int index, asAtom& o, bool checkbounds, bool addref)
 	bool ret = true;
 	if(index<currentsize)
 	{
-		if (index < ARRAY_SIZE_THRESHOLD)
+		// small gaps behind the dense part are filled with holes to keep the array dense
+		if (index >= data_first.size() && index-data_first.size() < max<size_t>(ARRAY_DENSE_MIN_GAP,data_first.size()/ARRAY_DENSE_GAP_DIVISOR))
+			growDense(index+1);
+		if (index < data_first.size())
 		{
-			if (index < data_first.size())
-			{
-				if (data_first.at(index).uintval == o.uintval)
-					ret = false;
-				else
-					ASATOM_DECREF(data_first.at(index));
-			}
+			if (data_first[index].uintval == o.uintval)
+				ret = false;
 			else
-				data_first.resize(index+1);
+				ASATOM_DECREF(data_first[index]);
 			if (addref && ret)
 				ASATOM_INCREF(o);
 			data_first[index]=o;
@@ -2133,6 +2206,77 @@ uint64_t Array::size()
 	return currentsize;
 }
 
+void Array::growDense(uint32_t n)
+{
+	uint32_t oldsize = data_first.size();
+	if (n > oldsize)
+		data_first.resize(n,asAtomHandler::invalidAtom);
+	if (data_second.empty())
+		return;
+	// move the sparse elements that are now covered by the dense part
+	if (data_second.size() < n-oldsize)
+	{
+		auto it=data_second.begin();
+		while (it != data_second.end())
+		{
+			if (it->first < n)
+			{
+				data_first[it->first]=it->second;
+				it = data_second.erase(it);
+			}
+			else
+				++it;
+		}
+	}
+	else
+	{
+		for (uint32_t i = oldsize; i < n; i++)
+		{
+			auto it = data_second.find(i);
+			if (it != data_second.end())
+			{
+				data_first[i]=it->second;
+				data_second.erase(it);
+			}
+		}
+	}
+	// absorb the sparse elements directly following the dense part
+	auto it = data_second.find(data_first.size());
+	while (it != data_second.end())
+	{
+		data_first.push_back(it->second);
+		data_second.erase(it);
+		it = data_second.find(data_first.size());
+	}
+}
+
+void Array::moveElements(uint32_t from, int64_t delta)
+{
+	if (delta == 0)
+		return;
+	if (delta > 0)
+	{
+		if (from < data_first.size())
+			data_first.insert(data_first.begin()+from,delta,asAtomHandler::invalidAtom);
+	}
+	else if ((uint64_t)(from+delta) < data_first.size())
+		data_first.erase(data_first.begin()+(from+delta),data_first.begin()+min<size_t>(from,data_first.size()));
+	if (!data_second.empty())
+	{
+		std::unordered_map<uint32_t,asAtom> tmp;
+		tmp.reserve(data_second.size());
+		for (auto it=data_second.begin(); it != data_second.end(); ++it )
+		{
+			if (it->first >= from)
+				tmp[it->first+delta]=it->second;
+			else if (delta > 0 || it->first < from+delta)
+				tmp[it->first]=it->second;
+		}
+		data_second.swap(tmp);
+	}
+	growDense(data_first.size());
+}
+
 void Array::push(asAtom o)
 {
 	if (currentsize == UINT32_MAX)
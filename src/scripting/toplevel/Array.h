@@ -22,11 +22,15 @@
 
 #include "asobject.h"
 #include <unordered_map>
+#include <deque>
+#include <algorithm>
 
 namespace lightspark
 {
-// maximum index stored in vector
-#define ARRAY_SIZE_THRESHOLD 65536
+// an index behind the dense part is stored densely if the gap to the dense part is
+// smaller than ARRAY_DENSE_MIN_GAP or than the dense size divided by ARRAY_DENSE_GAP_DIVISOR
+#define ARRAY_DENSE_MIN_GAP 16
+#define ARRAY_DENSE_GAP_DIVISOR 8
 
 
 struct sorton_field
@@ -40,6 +44,9 @@ struct sorton_field
 struct sorton_value
 {
 	std::vector<asAtom> sortvalues;
+	// sort keys of the fields, converted once before sorting
+	std::vector<number_t> sortnumbers;
+	std::vector<tiny_string> sortstrings;
 	asAtom dataAtom;
 	sorton_value(asAtom _dataAtom):dataAtom(_dataAtom) {}
 };
@@ -49,9 +56,15 @@ class Array: public ASObject
 friend class ABCVm;
 protected:
 	uint64_t currentsize;
-	// data is split into a vector for the first ARRAY_SIZE_THRESHOLD indexes, and a map for bigger indexes
-	std::vector<asAtom> data_first;
+	// data is split into a dense deque for the indexes below data_first.size(), and a map for bigger indexes.
+	// The map never contains the index data_first.size(), those elements are moved to the deque.
+	// The deque allows shift/unshift in constant time
+	std::deque<asAtom> data_first;
 	std::unordered_map<uint32_t,asAtom> data_second;
+	// extends the dense part to n elements and moves the covered and adjacent elements of the map into it
+	void growDense(uint32_t n);
+	// moves all elements at indexes >= from by delta, elements at [from+delta,from) must have been released before
+	void moveElements(uint32_t from, int64_t delta);
 	
 	void outofbounds(unsigned int index) const;
 	~Array();
@@ -76,6 +89,7 @@ private:
 		sortOnComparator(const std::vector<sorton_field>& sf,SystemState* s):fields(sf),sys(s){}
 		bool operator()(const sorton_value& d1, const sorton_value& d2);
 	};
+	void getSortOnKeys(sorton_value& v, std::vector<sorton_field>& sortfields);
 	void constructorImpl(asAtom *args, const unsigned int argslen);
 	tiny_string toString_priv(bool localized=false);
 	int capIndex(int i);
@@ -88,10 +102,23 @@ public:
 		sortComparatorWrapper(asAtom c):comparator(c){}
 		number_t compare(const asAtom& d1, const asAtom& d2);
 	};
+	/*
+	 * Recognizes comparators of the form function(a,b) { return a.field - b.field; },
+	 * (or b.field - a.field, or a - b) and computes the numeric keys of all values.
+	 * Returns false if the comparator has to be called for every comparison
+	 */
+	static bool getNumericComparatorKeys(asAtom comparator, const std::vector<asAtom>& values, std::vector<number_t>& keys, bool& descending);
+	/*
+	 * Sorts values with a comparator function, using the precomputed keys if possible
+	 */
+	template<class COMPARATOR>
+	static void sortWithComparator(std::vector<asAtom>& values, asAtom comparator);
 	static bool isIntegerWithoutLeadingZeros(const tiny_string& value);
 	enum SORTTYPE { CASEINSENSITIVE=1, DESCENDING=2, UNIQUESORT=4, RETURNINDEXEDARRAY=8, NUMERIC=16 };
 	Array(Class_base* c);
 	bool destruct();
+	void traceReferences(std::vector<ASObject*>& refs);
+	void clearReferences();
 	
 	//These utility methods are also used by ByteArray
 	static bool isValidMultiname(SystemState* sys,const multiname& name, uint32_t& index);
@@ -131,11 +158,8 @@ public:
 	asAtom at(unsigned int index);
 	FORCE_INLINE void at_nocheck(asAtom& ret,unsigned int index)
 	{
-		if (index < ARRAY_SIZE_THRESHOLD)
-		{
-			if (index < data_first.size())
-				asAtomHandler::set(ret,data_first.at(index));
-		}
+		if (index < data_first.size())
+			asAtomHandler::set(ret,data_first[index]);
 		else
 		{
 			auto it = data_second.find(index);
@@ -162,12 +186,134 @@ public:
 	void nextName(asAtom &ret, uint32_t index);
 	void nextValue(asAtom &ret, uint32_t index);
 	//Serialization interface
-	void serialize(ByteArray* out, std::map<tiny_string, uint32_t>& stringMap,
-				std::map<const ASObject*, uint32_t>& objMap,
-				std::map<const Class_base*, uint32_t>& traitsMap);
+	void serialize(ByteArray* out, std::unordered_map<tiny_string, uint32_t>& stringMap,
+				std::unordered_map<const ASObject*, uint32_t>& objMap,
+				std::unordered_map<const Class_base*, uint32_t>& traitsMap);
 	virtual tiny_string toJSON(std::vector<ASObject *> &path,asAtom replacer, const tiny_string &spaces,const tiny_string& filter);
 };
 
+template<class T, class LESS>
+void mergeSortedRuns(std::vector<T>& v, std::vector<T>& buf, size_t lo, size_t mid, size_t hi, LESS& less)
+{
+	//Nothing to do if the runs are already in order
+	if(!less(v[mid],v[mid-1]))
+		return;
+	buf.clear();
+	for(size_t i=lo;i<mid;i++)
+		buf.push_back(std::move(v[i]));
+	size_t i=0;
+	size_t j=mid;
+	size_t k=lo;
+	//Take from the left run on ties to keep the sort stable
+	while(i<buf.size() && j<hi)
+	{
+		if(less(v[j],buf[i]))
+			v[k++]=std::move(v[j++]);
+		else
+			v[k++]=std::move(buf[i++]);
+	}
+	while(i<buf.size())
+		v[k++]=std::move(buf[i++]);
+}
+
+/*
+ * Stable natural merge sort. Ascending and strictly descending runs are detected
+ * first, so sorted input needs only n-1 calls to less. less does not have to be a
+ * strict weak ordering: inconsistent results give an unspecified order, but the
+ * sort always terminates and keeps all elements.
+ */
+template<class T, class LESS>
+void adaptiveSort(std::vector<T>& v, LESS less)
+{
+	//Short runs are extended to this length by insertion sort
+	const size_t minrun=32;
+	const size_t n=v.size();
+	if(n<2)
+		return;
+	//Start indexes of the runs, followed by n
+	std::vector<size_t> runs;
+	size_t start=0;
+	while(start<n)
+	{
+		size_t end=start+1;
+		if(end<n)
+		{
+			if(less(v[end],v[start]))
+			{
+				//Reversing a strictly descending run keeps the sort stable
+				while(end+1<n && less(v[end+1],v[end]))
+					end++;
+				end++;
+				std::reverse(v.begin()+start,v.begin()+end);
+			}
+			else
+			{
+				while(end+1<n && !less(v[end+1],v[end]))
+					end++;
+				end++;
+			}
+		}
+		const size_t runend=std::min(n,start+minrun);
+		for(;end<runend;end++)
+		{
+			//Binary insertion after all equal elements
+			T x=std::move(v[end]);
+			size_t l=start;
+			size_t h=end;
+			while(l<h)
+			{
+				size_t m=l+(h-l)/2;
+				if(less(x,v[m]))
+					h=m;
+				else
+					l=m+1;
+			}
+			std::move_backward(v.begin()+l,v.begin()+end,v.begin()+end+1);
+			v[l]=std::move(x);
+		}
+		runs.push_back(start);
+		start=end;
+	}
+	runs.push_back(n);
+	std::vector<T> buf;
+	std::vector<size_t> merged;
+	while(runs.size()>2)
+	{
+		merged.clear();
+		for(size_t i=0;i+1<runs.size();i+=2)
+		{
+			merged.push_back(runs[i]);
+			if(i+2<runs.size())
+				mergeSortedRuns(v,buf,runs[i],runs[i+1],runs[i+2],less);
+		}
+		merged.push_back(n);
+		runs.swap(merged);
+	}
+}
+
+template<class COMPARATOR>
+void Array::sortWithComparator(std::vector<asAtom>& values, asAtom comparator)
+{
+	std::vector<number_t> keys;
+	bool descending;
+	if(getNumericComparatorKeys(comparator,values,keys,descending))
+	{
+		std::vector<uint32_t> order(values.size());
+		for(uint32_t i=0;i<order.size();i++)
+			order[i]=i;
+		if(descending)
+			adaptiveSort(order,[&keys](uint32_t a, uint32_t b) { return keys[b]<keys[a]; });
+		else
+			adaptiveSort(order,[&keys](uint32_t a, uint32_t b) { return keys[a]<keys[b]; });
+		std::vector<asAtom> sorted(values.size());
+		for(uint32_t i=0;i<order.size();i++)
+			sorted[i]=values[order[i]];
+		values.swap(sorted);
+		return;
+	}
+	COMPARATOR c(comparator);
+	adaptiveSort(values,[&c](const asAtom& a, const asAtom& b) { return c.compare(a,b)<0; });
+}
 
 }
 #endif /* SCRIPTING_TOPLEVEL_ARRAY_H */
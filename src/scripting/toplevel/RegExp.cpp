@@ -19,6 +19,8 @@
 
 #include "scripting/argconv.h"
 #include "scripting/toplevel/RegExp.h"
+#include <list>
+#include <unordered_map>
 
 using namespace std;
 using namespace lightspark;
@@ -146,55 +148,22 @@ ASFUNCTIONBODY_ATOM(RegExp,exec)
 
 ASObject *RegExp::match(const tiny_string& str)
 {
-	pcre* pcreRE = compile();
-	if (!pcreRE)
+	_NR<CompiledRegExp> pcreRE = compile();
+	if (pcreRE.isNull())
 		return getSystemState()->getNullRef();
-	int capturingGroups;
-	int infoOk=pcre_fullinfo(pcreRE, NULL, PCRE_INFO_CAPTURECOUNT, &capturingGroups);
-	if(infoOk!=0)
-	{
-		pcre_free(pcreRE);
-		return getSystemState()->getNullRef();
-	}
-	//Get information about named capturing groups
-	int namedGroups;
-	infoOk=pcre_fullinfo(pcreRE, NULL, PCRE_INFO_NAMECOUNT, &namedGroups);
-	if(infoOk!=0)
-	{
-		pcre_free(pcreRE);
-		return getSystemState()->getNullRef();
-	}
-	//Get information about the size of named entries
-	int namedSize;
-	infoOk=pcre_fullinfo(pcreRE, NULL, PCRE_INFO_NAMEENTRYSIZE, &namedSize);
-	if(infoOk!=0)
-	{
-		pcre_free(pcreRE);
-		return getSystemState()->getNullRef();
-	}
+	int capturingGroups = pcreRE->capturingGroups;
 	struct nameEntry
 	{
 		uint16_t number;
 		char name[0];
 	};
-	char* entries;
-	infoOk=pcre_fullinfo(pcreRE, NULL, PCRE_INFO_NAMETABLE, &entries);
-	if(infoOk!=0)
-	{
-		pcre_free(pcreRE);
-		lastIndex=0;
-		return getSystemState()->getNullRef();
-	}
-	pcre_extra extra;
-	extra.match_limit_recursion=200;
-	extra.flags = PCRE_EXTRA_MATCH_LIMIT_RECURSION;
+	char* entries = pcreRE->nameTable;
 	int ovector[(capturingGroups+1)*3];
 	int offset=global?lastIndex:0;
-	int rc=pcre_exec(pcreRE,capturingGroups > 200 ? &extra : NULL, str.raw_buf(), str.numBytes(), offset, 0, ovector, (capturingGroups+1)*3);
+	int rc=pcreRE->exec(str, offset, ovector, (capturingGroups+1)*3, capturingGroups > 200);
 	if(rc<0)
 	{
 		//No matches or error
-		pcre_free(pcreRE);
 		lastIndex=0;
 		return getSystemState()->getNullRef();
 	}
@@ -210,21 +179,19 @@ ASObject *RegExp::match(const tiny_string& str)
 	a->setVariableByQName("input","",abstract_s(getSystemState(),str),DYNAMIC_TRAIT);
 
 	// pcre_exec returns byte position, so we have to convert it to character position 
-	tiny_string tmp = str.substr_bytes(0, ovector[0]);
-	int index = tmp.numChars();
+	int index = str.bytePosToIndex(ovector[0]);
 
 	a->setVariableByQName("index","",abstract_i(getSystemState(),index),DYNAMIC_TRAIT);
-	for(int i=0;i<namedGroups;i++)
+	for(int i=0;i<pcreRE->namedGroups;i++)
 	{
 		nameEntry* entry=reinterpret_cast<nameEntry*>(entries);
 		uint16_t num=GINT16_FROM_BE(entry->number);
 		asAtom captured=a->at(num);
 		ASATOM_INCREF(captured);
 		a->setVariableAtomByQName(getSystemState()->getUniqueStringId(tiny_string(entry->name, true)),nsNameAndKind(BUILTIN_NAMESPACES::EMPTY_NS),captured,DYNAMIC_TRAIT);
-		entries+=namedSize;
+		entries+=pcreRE->namedSize;
 	}
 	lastIndex=ovector[1];
-	pcre_free(pcreRE);
 	return a;
 }
 
@@ -238,29 +205,18 @@ ASFUNCTIONBODY_ATOM(RegExp,test)
 	RegExp* th=asAtomHandler::as<RegExp>(obj);
 
 	const tiny_string& arg0 = asAtomHandler::toString(args[0],sys);
-	pcre* pcreRE = th->compile();
-	if (!pcreRE)
+	_NR<CompiledRegExp> pcreRE = th->compile();
+	if (pcreRE.isNull())
 	{
 		asAtomHandler::setNull(ret);
 		return;
 	}
-	int capturingGroups;
-	int infoOk=pcre_fullinfo(pcreRE, NULL, PCRE_INFO_CAPTURECOUNT, &capturingGroups);
-	if(infoOk!=0)
-	{
-		pcre_free(pcreRE);
-		asAtomHandler::setNull(ret);
-		return;
-	}
+	int capturingGroups = pcreRE->capturingGroups;
 	int ovector[(capturingGroups+1)*3];
 	
 	int offset=(th->global)?th->lastIndex:0;
-	pcre_extra extra;
-	extra.match_limit_recursion=200;
-	extra.flags = PCRE_EXTRA_MATCH_LIMIT_RECURSION;
-	int rc = pcre_exec(pcreRE, &extra, arg0.raw_buf(), arg0.numBytes(), offset, 0, ovector, (capturingGroups+1)*3);
+	int rc = pcreRE->exec(arg0, offset, ovector, (capturingGroups+1)*3, true);
 	bool res = (rc >= 0);
-	pcre_free(pcreRE);
 	asAtomHandler::setBool(ret,res);
 }
 
@@ -290,7 +246,7 @@ ASFUNCTIONBODY_ATOM(RegExp,_toString)
 	ret = asAtomHandler::fromObject(abstract_s(sys,res));
 }
 
-pcre* RegExp::compile()
+_NR<CompiledRegExp> RegExp::compile()
 {
 	int options = PCRE_UTF8|PCRE_NEWLINE_ANY|PCRE_JAVASCRIPT_COMPAT;
 	if(ignoreCase)
@@ -302,19 +258,126 @@ pcre* RegExp::compile()
 	if(dotall)
 		options|=PCRE_DOTALL;
 
+	if (compiled.isNull() || compiled->options != options || compiled->source != source)
+		compiled = compilePattern(source, options);
+	return compiled;
+}
+
+// Most recently used compiled patterns, shared by all RegExp objects
+#define COMPILED_REGEXP_CACHE_SIZE 64
+typedef std::list<_R<CompiledRegExp>> CompiledRegExpList;
+static StaticMutex compiledRegExpMutex;
+static CompiledRegExpList compiledRegExpList;
+static std::unordered_map<tiny_string, CompiledRegExpList::iterator> compiledRegExpCache;
+
+static tiny_string compiledRegExpKey(const tiny_string& source, int options)
+{
+	// the options come last, so that the key is unique for any source
+	char buf[20];
+	snprintf(buf,20,"/%x",options);
+	tiny_string key(source);
+	key += buf;
+	return key;
+}
+
+_NR<CompiledRegExp> RegExp::compilePattern(const tiny_string& source, int options)
+{
+	tiny_string key = compiledRegExpKey(source, options);
+	{
+		Locker l(compiledRegExpMutex);
+		auto it = compiledRegExpCache.find(key);
+		if (it != compiledRegExpCache.end())
+		{
+			compiledRegExpList.splice(compiledRegExpList.begin(),compiledRegExpList,it->second);
+			return compiledRegExpList.front();
+		}
+	}
+
 	const char * error;
 	int errorOffset;
 	int errorcode;
 	pcre* pcreRE=pcre_compile2(source.raw_buf(), options,&errorcode,  &error, &errorOffset,NULL);
 	if(error)
 	{
-		if (errorcode == 64) // invalid pattern in javascript compatibility mode (we try again in normal mode to match flash behaviour)
-		{
-			options &= ~PCRE_JAVASCRIPT_COMPAT;
-			pcreRE=pcre_compile2(source.raw_buf(), options,&errorcode,  &error, &errorOffset,NULL);
-		}
+		if (errorcode == 64 && (options & PCRE_JAVASCRIPT_COMPAT)) // invalid pattern in javascript compatibility mode (we try again in normal mode to match flash behaviour)
+			pcreRE=pcre_compile2(source.raw_buf(), options & ~PCRE_JAVASCRIPT_COMPAT,&errorcode,  &error, &errorOffset,NULL);
 		if (error)
-			return NULL;
+			return NullRef;
+	}
+	_R<CompiledRegExp> res = _MR(new CompiledRegExp(pcreRE, source, options));
+
+	Locker l(compiledRegExpMutex);
+	auto it = compiledRegExpCache.find(key);
+	if (it != compiledRegExpCache.end())
+	{
+		// another thread compiled the same pattern in the meantime
+		compiledRegExpList.splice(compiledRegExpList.begin(),compiledRegExpList,it->second);
+		return compiledRegExpList.front();
+	}
+	compiledRegExpList.push_front(res);
+	compiledRegExpCache.insert(make_pair(key,compiledRegExpList.begin()));
+	if (compiledRegExpList.size() > COMPILED_REGEXP_CACHE_SIZE)
+	{
+		const _R<CompiledRegExp>& last = compiledRegExpList.back();
+		compiledRegExpCache.erase(compiledRegExpKey(last->source,last->options));
+		compiledRegExpList.pop_back();
+	}
+	return res;
+}
+
+CompiledRegExp::CompiledRegExp(pcre* _re, const tiny_string& _source, int _options):
+	re(_re),extra(NULL),source(_source),options(_options),capturingGroups(0),namedGroups(0),namedSize(0),nameTable(NULL)
+{
+	int studyoptions = 0;
+#ifdef PCRE_STUDY_JIT_COMPILE
+	studyoptions |= PCRE_STUDY_JIT_COMPILE;
+#endif
+	const char* error = NULL;
+	extra = pcre_study(re, studyoptions, &error);
+	if (error)
+		LOG(LOG_ERROR,"pcre_study failed:"<<error);
+	if (pcre_fullinfo(re, extra, PCRE_INFO_CAPTURECOUNT, &capturingGroups) != 0 ||
+		pcre_fullinfo(re, extra, PCRE_INFO_NAMECOUNT, &namedGroups) != 0 ||
+		pcre_fullinfo(re, extra, PCRE_INFO_NAMEENTRYSIZE, &namedSize) != 0 ||
+		pcre_fullinfo(re, extra, PCRE_INFO_NAMETABLE, &nameTable) != 0)
+	{
+		capturingGroups = 0;
+		namedGroups = 0;
+	}
+}
+
+CompiledRegExp::~CompiledRegExp()
+{
+#ifdef PCRE_STUDY_JIT_COMPILE
+	if (extra)
+		pcre_free_study(extra);
+#else
+	if (extra)
+		pcre_free(extra);
+#endif
+	pcre_free(re);
+}
+
+int CompiledRegExp::exec(const tiny_string& subject, int offset, int* ovector, int ovectorsize, bool limitRecursion) const
+{
+	pcre_extra localextra;
+	if (extra)
+		localextra = *extra;
+	else
+		memset(&localextra,0,sizeof(localextra));
+	if (limitRecursion)
+	{
+		localextra.match_limit_recursion=200;
+		localextra.flags |= PCRE_EXTRA_MATCH_LIMIT_RECURSION;
+	}
+	int rc = pcre_exec(re, &localextra, subject.raw_buf(), subject.numBytes(), offset, 0, ovector, ovectorsize);
+#ifdef PCRE_EXTRA_EXECUTABLE_JIT
+	if (rc == PCRE_ERROR_JIT_STACKLIMIT)
+	{
+		// the interpreter is not limited by the size of the jit stack
+		localextra.flags &= ~PCRE_EXTRA_EXECUTABLE_JIT;
+		rc = pcre_exec(re, &localextra, subject.raw_buf(), subject.numBytes(), offset, 0, ovector, ovectorsize);
 	}
-	return pcreRE;
+#endif
+	return rc;
 }
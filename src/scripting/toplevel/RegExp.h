@@ -26,12 +26,43 @@
 namespace lightspark
 {
 
+/*
+ * A compiled pattern with its study data and the pattern information needed for matching.
+ * Compiled patterns are immutable and shared by all RegExp objects with the same source and options.
+ */
+class CompiledRegExp: public RefCountable
+{
+private:
+	pcre* re;
+	pcre_extra* extra;
+public:
+	const tiny_string source;
+	const int options;
+	int capturingGroups;
+	int namedGroups;
+	int namedSize;
+	char* nameTable;
+	CompiledRegExp(pcre* _re, const tiny_string& _source, int _options);
+	~CompiledRegExp();
+	/*
+	 * Runs the pattern on subject starting at the byte offset
+	 * limitRecursion bounds the recursion depth of the pcre interpreter
+	 * returns the result of pcre_exec
+	 */
+	int exec(const tiny_string& subject, int offset, int* ovector, int ovectorsize, bool limitRecursion) const;
+};
+
 class RegExp: public ASObject
 {
+private:
+	_NR<CompiledRegExp> compiled;
 public:
 	RegExp(Class_base* c);
 	RegExp(Class_base* c, const tiny_string& _re);
-	pcre* compile();
+	// Returns the compiled pattern, NullRef if the source is not a valid pattern
+	_NR<CompiledRegExp> compile();
+	// Looks up the compiled pattern in the global cache, compiling it if needed
+	static _NR<CompiledRegExp> compilePattern(const tiny_string& source, int options);
 	static void sinit(Class_base* c);
 	static void buildTraits(ASObject* o);
 	ASObject *match(const tiny_string& str);
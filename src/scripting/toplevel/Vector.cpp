@@ -24,6 +24,7 @@
 #include "scripting/argconv.h"
 #include "scripting/toplevel/XML.h"
 #include <3rdparty/pugixml/src/pugixml.hpp>
+#include <algorithm>
 
 using namespace std;
 using namespace lightspark;
@@ -99,8 +100,11 @@ void Vector::sinit(Class_base* c)
 	c->prototype->setVariableByQName("unshift",AS3,Class<IFunction>::getFunction(c->getSystemState(),unshift),CONSTANT_TRAIT);
 }
 
-Vector::Vector(Class_base* c, const Type *vtype):ASObject(c,T_OBJECT,SUBTYPE_VECTOR),vec_type(vtype),fixed(false),vec(reporter_allocator<asAtom>(c->memoryAccount))
+Vector::Vector(Class_base* c, const Type *vtype):ASObject(c,T_OBJECT,SUBTYPE_VECTOR),vec_type(vtype),fixed(false),storage(STORAGE_ATOM),
+	vec(reporter_allocator<asAtom>(c->memoryAccount)),ivec(reporter_allocator<int32_t>(c->memoryAccount)),dvec(reporter_allocator<number_t>(c->memoryAccount)),
+	borrowedNumber(asAtomHandler::invalidAtom)
 {
+	setStorage();
 }
 
 Vector::~Vector()
@@ -109,21 +113,299 @@ Vector::~Vector()
 
 bool Vector::destruct()
 {
-	for(unsigned int i=0;i<size();i++)
+	for(unsigned int i=0;i<vec.size();i++)
 	{
 		ASATOM_DECREF(vec[i]);
 	}
 	vec.clear();
+	ivec.clear();
+	dvec.clear();
+	ASATOM_DECREF(borrowedNumber);
+	borrowedNumber=asAtomHandler::invalidAtom;
 	vec_type=nullptr;
+	storage=STORAGE_ATOM;
 	return destructIntern();
 }
 
+void Vector::traceReferences(std::vector<ASObject*>& refs)
+{
+	ASObject::traceReferences(refs);
+	for(unsigned int i=0;i<vec.size();i++)
+	{
+		if (asAtomHandler::isObject(vec[i]))
+			refs.push_back(asAtomHandler::getObjectNoCheck(vec[i]));
+	}
+}
+
+void Vector::clearReferences()
+{
+	//The elements are released after the Vector is emptied
+	std::vector<asAtom> tmp(vec.begin(),vec.end());
+	vec.clear();
+	for(unsigned int i=0;i<tmp.size();i++)
+	{
+		ASATOM_DECREF(tmp[i]);
+	}
+	ASObject::clearReferences();
+}
+
 void Vector::setTypes(const std::vector<const Type *> &types)
 {
 	assert(vec_type == NULL);
 	if(types.size() == 1)
 		vec_type = types[0];
+	setStorage();
+}
+
+void Vector::setStorage()
+{
+	storage = STORAGE_ATOM;
+	if (vec_type == nullptr)
+		return;
+	SystemState* sys = getSystemState();
+	if (vec_type == Class<Integer>::getClass(sys))
+		storage = STORAGE_INT;
+	else if (vec_type == Class<UInteger>::getClass(sys))
+		storage = STORAGE_UINT;
+	else if (vec_type == Class<Number>::getClass(sys))
+		storage = STORAGE_NUMBER;
+}
+
+void Vector::getElement(asAtom& ret, uint32_t index) const
+{
+	switch (storage)
+	{
+		case STORAGE_ATOM:
+			if (asAtomHandler::isValid(vec[index]))
+			{
+				ret = vec[index];
+				ASATOM_INCREF(ret);
+			}
+			else
+			{
+				asAtomHandler::setNull(ret);
+				vec_type->coerce(getSystemState(),ret);
+			}
+			break;
+		case STORAGE_INT:
+			asAtomHandler::setInt(ret,getSystemState(),ivec[index]);
+			break;
+		case STORAGE_UINT:
+			asAtomHandler::setUInt(ret,getSystemState(),(uint32_t)ivec[index]);
+			break;
+		case STORAGE_NUMBER:
+			asAtomHandler::setNumber(ret,getSystemState(),dvec[index]);
+			break;
+	}
+}
+
+void Vector::replaceWithElement(asAtom& ret, uint32_t index)
+{
+	if (storage == STORAGE_NUMBER)
+	{
+		//A Number only referenced by ret can just be overwritten
+		ASObject* o = asAtomHandler::getObject(ret);
+		if (asAtomHandler::replaceNumber(ret,getSystemState(),dvec[index]) && o)
+			o->decRef();
+		return;
+	}
+	ASObject* o = asAtomHandler::getObject(ret);
+	getElement(ret,index);
+	if (o)
+		o->decRef();
+}
+
+void Vector::setElement(uint32_t index, asAtom& o)
+{
+	switch (storage)
+	{
+		case STORAGE_ATOM:
+			ASATOM_DECREF(vec[index]);
+			vec[index] = o;
+			return;
+		case STORAGE_INT:
+			ivec[index] = asAtomHandler::toInt(o);
+			break;
+		case STORAGE_UINT:
+			ivec[index] = (int32_t)asAtomHandler::toUInt(o);
+			break;
+		case STORAGE_NUMBER:
+			dvec[index] = asAtomHandler::toNumber(o);
+			break;
+	}
+	ASATOM_DECREF(o);
+}
+
+void Vector::pushElement(asAtom& o)
+{
+	switch (storage)
+	{
+		case STORAGE_ATOM:
+			vec.push_back(o);
+			return;
+		case STORAGE_INT:
+			ivec.push_back(asAtomHandler::toInt(o));
+			break;
+		case STORAGE_UINT:
+			ivec.push_back((int32_t)asAtomHandler::toUInt(o));
+			break;
+		case STORAGE_NUMBER:
+			dvec.push_back(asAtomHandler::toNumber(o));
+			break;
+	}
+	ASATOM_DECREF(o);
+}
+
+void Vector::resizeElements(uint32_t len)
+{
+	switch (storage)
+	{
+		case STORAGE_ATOM:
+			for(size_t i=len; i< vec.size(); ++i)
+				ASATOM_DECREF(vec[i]);
+			vec.resize(len, asAtomHandler::invalidAtom);
+			break;
+		case STORAGE_NUMBER:
+			dvec.resize(len, 0);
+			break;
+		default:
+			ivec.resize(len, 0);
+			break;
+	}
+}
+
+void Vector::appendElements(Vector* src)
+{
+	if (storage == src->storage && storage != STORAGE_ATOM)
+	{
+		//Copy the raw values
+		if (storage == STORAGE_NUMBER)
+			dvec.insert(dvec.end(),src->dvec.begin(),src->dvec.end());
+		else
+			ivec.insert(ivec.end(),src->ivec.begin(),src->ivec.end());
+		return;
+	}
+	uint32_t count = src->size();
+	for(uint32_t i=0;i<count;i++)
+	{
+		if (src->storage == STORAGE_ATOM && asAtomHandler::isInvalid(src->vec[i]))
+		{
+			asAtom v = asAtomHandler::nullAtom;
+			if (storage == STORAGE_ATOM)
+				vec.push_back(asAtomHandler::invalidAtom);
+			else
+				pushElement(v);
+			continue;
+		}
+		asAtom v=asAtomHandler::invalidAtom;
+		src->getElement(v,i);
+		vec_type->coerceForTemplate(getSystemState(),v);
+		pushElement(v);
+	}
+}
+
+void Vector::moveElements(Vector* res, uint32_t start, uint32_t count)
+{
+	assert(res->storage == storage);
+	switch (storage)
+	{
+		case STORAGE_ATOM:
+			//The references are moved to res
+			res->vec.insert(res->vec.end(),vec.begin()+start,vec.begin()+start+count);
+			vec.erase(vec.begin()+start,vec.begin()+start+count);
+			break;
+		case STORAGE_NUMBER:
+			res->dvec.insert(res->dvec.end(),dvec.begin()+start,dvec.begin()+start+count);
+			dvec.erase(dvec.begin()+start,dvec.begin()+start+count);
+			break;
+		default:
+			res->ivec.insert(res->ivec.end(),ivec.begin()+start,ivec.begin()+start+count);
+			ivec.erase(ivec.begin()+start,ivec.begin()+start+count);
+			break;
+	}
+}
+
+void Vector::insertElements(uint32_t pos, uint32_t count)
+{
+	switch (storage)
+	{
+		case STORAGE_ATOM:
+			vec.insert(vec.begin()+pos,count,asAtomHandler::invalidAtom);
+			break;
+		case STORAGE_NUMBER:
+			dvec.insert(dvec.begin()+pos,count,0);
+			break;
+		default:
+			ivec.insert(ivec.begin()+pos,count,0);
+			break;
+	}
 }
+
+void Vector::eraseElement(uint32_t index)
+{
+	switch (storage)
+	{
+		case STORAGE_ATOM:
+			vec.erase(vec.begin()+index);
+			break;
+		case STORAGE_NUMBER:
+			dvec.erase(dvec.begin()+index);
+			break;
+		default:
+			ivec.erase(ivec.begin()+index);
+			break;
+	}
+}
+
+tiny_string Vector::elementToString(uint32_t index) const
+{
+	switch (storage)
+	{
+		case STORAGE_INT:
+			return Integer::toString(ivec[index]);
+		case STORAGE_UINT:
+			return UInteger::toString((uint32_t)ivec[index]);
+		case STORAGE_NUMBER:
+			return Number::toString(dvec[index]);
+		default:
+			break;
+	}
+	if (asAtomHandler::isValid(vec[index]))
+		return asAtomHandler::toString(vec[index],getSystemState());
+	// use the type's default value
+	asAtom natom = asAtomHandler::nullAtom;
+	vec_type->coerce(getSystemState(), natom);
+	return asAtomHandler::toString(natom,getSystemState());
+}
+
+int32_t Vector::findNumber(const asAtom& value, uint32_t from, bool backwards) const
+{
+	//Only numbers are strictly equal to the stored values, NaN never is
+	if (!asAtomHandler::isNumeric(value))
+		return -1;
+	number_t num = asAtomHandler::toNumber(value);
+	if (std::isnan(num))
+		return -1;
+	uint32_t count = size();
+	if (backwards)
+	{
+		for (int64_t i=min(from,count-1); i >= 0; i--)
+		{
+			if (numberAt(i) == num)
+				return i;
+		}
+	}
+	else
+	{
+		for (uint32_t i=from; i < count; i++)
+		{
+			if (numberAt(i) == num)
+				return i;
+		}
+	}
+	return -1;
+}
+
 bool Vector::sameType(const Class_base *cls) const
 {
 	tiny_string clsname = this->getClass()->getQualifiedClassName();
@@ -151,7 +433,7 @@ void Vector::generator(asAtom& ret,SystemState *sys, asAtom &o_class, asAtom* ar
 			//Convert the elements of the array to the type of this vector
 			if (!type->coerce(sys,obj))
 				ASATOM_INCREF(obj);
-			res->vec.push_back(obj);
+			res->pushElement(obj);
 		}
 	}
 	else if(asAtomHandler::getObject(args[0])->getClass()->getTemplate() == Template<Vector>::getTemplate(sys))
@@ -171,12 +453,14 @@ void Vector::generator(asAtom& ret,SystemState *sys, asAtom &o_class, asAtom* ar
 			//create object without calling _constructor
 			asAtomHandler::as<TemplatedClass<Vector>>(o_class)->getInstance(ret,false,NULL,0);
 			res = asAtomHandler::as<Vector>(ret);
-			for(auto i = arg->vec.begin(); i != arg->vec.end(); ++i)
+			for(uint32_t i = 0; i < arg->size(); ++i)
 			{
-				asAtom v = *i;
-				if (!type->coerce(sys,v))
-					ASATOM_INCREF(v);
-				res->vec.push_back(v);
+				asAtom v=asAtomHandler::invalidAtom;
+				arg->getElement(v,i);
+				asAtom c = v;
+				if (type->coerce(sys,c))
+					ASATOM_DECREF(v);
+				res->pushElement(c);
 			}
 		}
 	}
@@ -196,7 +480,7 @@ ASFUNCTIONBODY_ATOM(Vector,_constructor)
 	Vector* th=asAtomHandler::as<Vector>(obj);
 	assert(th->vec_type);
 	th->fixed = fixed;
-	th->vec.resize(len, asAtomHandler::invalidAtom);
+	th->resizeElements(len);
 }
 
 ASFUNCTIONBODY_ATOM(Vector,_concat)
@@ -205,42 +489,32 @@ ASFUNCTIONBODY_ATOM(Vector,_concat)
 	th->getClass()->getInstance(ret,true,NULL,0);
 	Vector* res = asAtomHandler::as<Vector>(ret);
 	// copy values into new Vector
-	res->vec.resize(th->size(), asAtomHandler::invalidAtom);
-	auto it=th->vec.begin();
-	uint32_t index = 0;
-	for(;it != th->vec.end();++it)
+	if (th->storage == STORAGE_ATOM)
 	{
-		res->vec[index]=*it;
-		ASATOM_INCREF(res->vec[index]);
-		index++;
+		res->vec.resize(th->size(), asAtomHandler::invalidAtom);
+		auto it=th->vec.begin();
+		uint32_t index = 0;
+		for(;it != th->vec.end();++it)
+		{
+			res->vec[index]=*it;
+			ASATOM_INCREF(res->vec[index]);
+			index++;
+		}
 	}
+	else
+		res->appendElements(th);
 	//Insert the arguments in the vector
 	int pos = sys->getSwfVersion() < 11 ? argslen-1 : 0;
 	for(unsigned int i=0;i<argslen;i++)
 	{
 		if (asAtomHandler::is<Vector>(args[pos]))
-		{
-			Vector* arg=asAtomHandler::as<Vector>(args[pos]);
-			res->vec.resize(index+arg->size(), asAtomHandler::invalidAtom);
-			auto it=arg->vec.begin();
-			for(;it != arg->vec.end();++it)
-			{
-				if (asAtomHandler::isValid(*it))
-				{
-					res->vec[index]= *it;
-					th->vec_type->coerceForTemplate(sys,res->vec[index]);
-					ASATOM_INCREF(res->vec[index]);
-				}
-				index++;
-			}
-		}
+			res->appendElements(asAtomHandler::as<Vector>(args[pos]));
 		else
 		{
 			asAtom v = args[pos];
 			if (!th->vec_type->coerce(sys,v))
 				ASATOM_INCREF(v);
-			res->vec[index] = v;
-			index++;
+			res->pushElement(v);
 		}
 		pos += (sys->getSwfVersion() < 11 ?-1 : 1);
 	}	
@@ -263,9 +537,9 @@ ASFUNCTIONBODY_ATOM(Vector,filter)
 
 	for(unsigned int i=0;i<th->size();i++)
 	{
-		if (asAtomHandler::isInvalid(th->vec[i]))
+		if (th->storage == STORAGE_ATOM && asAtomHandler::isInvalid(th->vec[i]))
 			continue;
-		params[0] = th->vec[i];
+		th->getElement(params[0],i);
 		params[1] = asAtomHandler::fromUInt(i);
 		params[2] = asAtomHandler::fromObject(th);
 
@@ -279,13 +553,15 @@ ASFUNCTIONBODY_ATOM(Vector,filter)
 		}
 		if(asAtomHandler::isValid(funcRet))
 		{
-			if(asAtomHandler::Boolean_concrete(funcRet))
+			bool keep = asAtomHandler::Boolean_concrete(funcRet);
+			ASATOM_DECREF(funcRet);
+			if(keep)
 			{
-				ASATOM_INCREF(th->vec[i]);
-				res->vec.push_back(th->vec[i]);
+				res->pushElement(params[0]);
+				continue;
 			}
-			ASATOM_DECREF(funcRet);
 		}
+		ASATOM_DECREF(params[0]);
 	}
 }
 
@@ -302,9 +578,9 @@ ASFUNCTIONBODY_ATOM(Vector, some)
 
 	for(unsigned int i=0; i < th->size(); i++)
 	{
-		if (asAtomHandler::isInvalid(th->vec[i]))
+		if (th->storage == STORAGE_ATOM && asAtomHandler::isInvalid(th->vec[i]))
 			continue;
-		params[0] = th->vec[i];
+		th->getElement(params[0],i);
 		params[1] = asAtomHandler::fromUInt(i);
 		params[2] = asAtomHandler::fromObject(th);
 
@@ -316,6 +592,7 @@ ASFUNCTIONBODY_ATOM(Vector, some)
 		{
 			asAtomHandler::callFunction(f,ret,args[1], params, 3,false);
 		}
+		ASATOM_DECREF(params[0]);
 		if(asAtomHandler::isValid(ret))
 		{
 			if(asAtomHandler::Boolean_concrete(ret))
@@ -341,8 +618,8 @@ ASFUNCTIONBODY_ATOM(Vector, every)
 
 	for(unsigned int i=0; i < th->size(); i++)
 	{
-		if (asAtomHandler::isValid(th->vec[i]))
-			params[0] = th->vec[i];
+		if (th->storage != STORAGE_ATOM || asAtomHandler::isValid(th->vec[i]))
+			th->getElement(params[0],i);
 		else
 			params[0] = asAtomHandler::nullAtom;
 		params[1] = asAtomHandler::fromUInt(i);
@@ -356,6 +633,7 @@ ASFUNCTIONBODY_ATOM(Vector, every)
 		{
 			asAtomHandler::callFunction(f,ret,args[1], params, 3,false);
 		}
+		ASATOM_DECREF(params[0]);
 		if(asAtomHandler::isValid(ret))
 		{
 			if (asAtomHandler::isUndefined(ret) || asAtomHandler::isNull(ret))
@@ -377,6 +655,11 @@ void Vector::append(asAtom &o)
 		ASATOM_DECREF(o);
 		throwError<RangeError>(kVectorFixedError);
 	}
+	if (storage != STORAGE_ATOM)
+	{
+		pushElement(o);
+		return;
+	}
 	asAtom v = o;
 	if (vec_type->coerce(getSystemState(),v))
 		ASATOM_DECREF(v);
@@ -435,9 +718,9 @@ ASFUNCTIONBODY_ATOM(Vector,push)
 		asAtom v = args[i];
 		if (!th->vec_type->coerce(sys,v))
 			ASATOM_INCREF(v);
-		th->vec.push_back(v);
+		th->pushElement(v);
 	}
-	asAtomHandler::setUInt(ret,sys,(uint32_t)th->vec.size());
+	asAtomHandler::setUInt(ret,sys,th->size());
 }
 
 ASFUNCTIONBODY_ATOM(Vector,_pop)
@@ -452,6 +735,12 @@ ASFUNCTIONBODY_ATOM(Vector,_pop)
 		th->vec_type->coerce(th->getSystemState(),ret);
 		return;
 	}
+	if (th->storage != STORAGE_ATOM)
+	{
+		th->getElement(ret,size-1);
+		th->resizeElements(size-1);
+		return;
+	}
 	ret = th->vec[size-1];
 	if (asAtomHandler::isInvalid(ret))
 	{
@@ -463,7 +752,7 @@ ASFUNCTIONBODY_ATOM(Vector,_pop)
 
 ASFUNCTIONBODY_ATOM(Vector,getLength)
 {
-	asAtomHandler::setUInt(ret,sys,(uint32_t)asAtomHandler::as<Vector>(obj)->vec.size());
+	asAtomHandler::setUInt(ret,sys,(uint32_t)asAtomHandler::as<Vector>(obj)->size());
 }
 
 ASFUNCTIONBODY_ATOM(Vector,setLength)
@@ -473,12 +762,7 @@ ASFUNCTIONBODY_ATOM(Vector,setLength)
 		throwError<RangeError>(kVectorFixedError);
 	uint32_t len;
 	ARG_UNPACK_ATOM (len);
-	if(len <= th->vec.size())
-	{
-		for(size_t i=len; i< th->vec.size(); ++i)
-			ASATOM_DECREF(th->vec[i]);
-	}
-	th->vec.resize(len, asAtomHandler::invalidAtom);
+	th->resizeElements(len);
 }
 
 ASFUNCTIONBODY_ATOM(Vector,getFixed)
@@ -507,9 +791,9 @@ ASFUNCTIONBODY_ATOM(Vector,forEach)
 
 	for(unsigned int i=0; i < th->size(); i++)
 	{
-		if (asAtomHandler::isInvalid(th->vec[i]))
+		if (th->storage == STORAGE_ATOM && asAtomHandler::isInvalid(th->vec[i]))
 			continue;
-		params[0] = th->vec[i];
+		th->getElement(params[0],i);
 		params[1] = asAtomHandler::fromUInt(i);
 		params[2] = asAtomHandler::fromObject(th);
 
@@ -522,6 +806,7 @@ ASFUNCTIONBODY_ATOM(Vector,forEach)
 		{
 			asAtomHandler::callFunction(f,funcret,args[1], params, 3,false);
 		}
+		ASATOM_DECREF(params[0]);
 		ASATOM_DECREF(funcret);
 	}
 }
@@ -530,16 +815,17 @@ ASFUNCTIONBODY_ATOM(Vector, _reverse)
 {
 	Vector* th = asAtomHandler::as<Vector>(obj);
 
-	std::vector<asAtom> tmp = std::vector<asAtom>(th->vec.begin(),th->vec.end());
-	uint32_t size = th->size();
-	th->vec.clear();
-	th->vec.resize(size, asAtomHandler::invalidAtom);
-	std::vector<asAtom>::iterator it=tmp.begin();
-	uint32_t index = size-1;
-	for(;it != tmp.end();++it)
- 	{
-		th->vec[index]=*it;
-		index--;
+	switch (th->storage)
+	{
+		case STORAGE_ATOM:
+			std::reverse(th->vec.begin(),th->vec.end());
+			break;
+		case STORAGE_NUMBER:
+			std::reverse(th->dvec.begin(),th->dvec.end());
+			break;
+		default:
+			std::reverse(th->ivec.begin(),th->ivec.end());
+			break;
 	}
 	th->incRef();
 	ret = asAtomHandler::fromObject(th);
@@ -552,7 +838,7 @@ ASFUNCTIONBODY_ATOM(Vector,lastIndexOf)
 	int32_t res=-1;
 	asAtom arg0=args[0];
 
-	if(th->vec.size() == 0)
+	if(th->size() == 0)
 	{
 		asAtomHandler::setInt(ret,sys,(int32_t)-1);
 		return;
@@ -584,6 +870,11 @@ ASFUNCTIONBODY_ATOM(Vector,lastIndexOf)
 				i = j;
 		}
 	}
+	if (th->storage != STORAGE_ATOM)
+	{
+		asAtomHandler::setInt(ret,sys,th->findNumber(arg0,i,true));
+		return;
+	}
 	do
 	{
 		if (asAtomHandler::isInvalid(th->vec[i]))
@@ -610,6 +901,12 @@ ASFUNCTIONBODY_ATOM(Vector,shift)
 		th->vec_type->coerce(th->getSystemState(),ret);
 		return;
 	}
+	if (th->storage != STORAGE_ATOM)
+	{
+		th->getElement(ret,0);
+		th->eraseElement(0);
+		return;
+	}
 	if(asAtomHandler::isValid(th->vec[0]))
 		ret=th->vec[0];
 	else
@@ -658,6 +955,20 @@ ASFUNCTIONBODY_ATOM(Vector,slice)
 	endIndex=th->capIndex(endIndex);
 	th->getClass()->getInstance(ret,true,NULL,0);
 	Vector* res= asAtomHandler::as<Vector>(ret);
+	if (endIndex <= startIndex)
+		return;
+	switch (th->storage)
+	{
+		case STORAGE_NUMBER:
+			res->dvec.assign(th->dvec.begin()+startIndex,th->dvec.begin()+endIndex);
+			return;
+		case STORAGE_INT:
+		case STORAGE_UINT:
+			res->ivec.assign(th->ivec.begin()+startIndex,th->ivec.begin()+endIndex);
+			return;
+		default:
+			break;
+	}
 	res->vec.resize(endIndex-startIndex, asAtomHandler::invalidAtom);
 	int j = 0;
 	for(int i=startIndex; i<endIndex; i++) 
@@ -665,8 +976,8 @@ ASFUNCTIONBODY_ATOM(Vector,slice)
 		if (asAtomHandler::isValid(th->vec[i]))
 		{
 			res->vec[j] =th->vec[i];
-			if (!th->vec_type->coerce(th->getSystemState(),th->vec[j]))
-				ASATOM_INCREF(th->vec[j]);
+			if (!th->vec_type->coerce(th->getSystemState(),res->vec[j]))
+				ASATOM_INCREF(res->vec[j]);
 		}
 		j++;
 	}
@@ -692,45 +1003,21 @@ ASFUNCTIONBODY_ATOM(Vector,splice)
 	if((startIndex+deleteCount)>totalSize)
 		deleteCount=totalSize-startIndex;
 
-	res->vec.resize(deleteCount, asAtomHandler::invalidAtom);
-	if(deleteCount)
-	{
-		// write deleted items to return array
-		for(int i=0;i<deleteCount;i++)
-		{
-			res->vec[i] = th->vec[startIndex+i];
-		}
-		// delete items from current array
-		for (int i = 0; i < deleteCount; i++)
-		{
-			th->vec[startIndex+i] = asAtomHandler::invalidAtom;
-		}
-	}
-	// remember items in current array that have to be moved to new position
-	vector<asAtom> tmp = vector<asAtom>(totalSize- (startIndex+deleteCount));
-	tmp.resize(totalSize- (startIndex+deleteCount), asAtomHandler::invalidAtom);
-	for (int i = startIndex+deleteCount; i < totalSize ; i++)
-	{
-		if (asAtomHandler::isValid(th->vec[i]))
-		{
-			tmp[i-(startIndex+deleteCount)] = th->vec[i];
-			th->vec[i] = asAtomHandler::invalidAtom;
-		}
-	}
-	th->vec.resize(startIndex, asAtomHandler::invalidAtom);
+	// move deleted items to the returned vector
+	if(deleteCount > 0)
+		th->moveElements(res,startIndex,deleteCount);
 
-	
 	//Insert requested values starting at startIndex
-	for(unsigned int i=2;i<argslen;i++)
-	{
-		ASATOM_INCREF(args[i]);
-		th->vec.push_back(args[i]);
-	}
-	// move remembered items to new position
-	th->vec.resize((totalSize-deleteCount)+(argslen > 2 ? argslen-2 : 0), asAtomHandler::invalidAtom);
-	for(int i=0;i<totalSize- (startIndex+deleteCount);i++)
+	if(argslen > 2)
 	{
-		th->vec[startIndex+i+(argslen > 2 ? argslen-2 : 0)] = tmp[i];
+		th->insertElements(startIndex,argslen-2);
+		for(unsigned int i=2;i<argslen;i++)
+		{
+			asAtom v = args[i];
+			if (!th->vec_type->coerce(sys,v))
+				ASATOM_INCREF(v);
+			th->setElement(startIndex+i-2,v);
+		}
 	}
 }
 
@@ -744,8 +1031,8 @@ ASFUNCTIONBODY_ATOM(Vector,join)
 	string res;
 	for(uint32_t i=0;i<th->size();i++)
 	{
-		if (asAtomHandler::isValid(th->vec[i]))
-			res+=asAtomHandler::toString(th->vec[i],sys).raw_buf();
+		if (th->storage != STORAGE_ATOM || asAtomHandler::isValid(th->vec[i]))
+			res+=th->elementToString(i).raw_buf();
 		if(i!=th->size()-1)
 			res+=del.raw_buf();
 	}
@@ -765,6 +1052,11 @@ ASFUNCTIONBODY_ATOM(Vector,indexOf)
 		i = asAtomHandler::toInt(args[1]);
 	}
 
+	if (th->storage != STORAGE_ATOM)
+	{
+		asAtomHandler::setInt(ret,sys,th->findNumber(arg0,i,false));
+		return;
+	}
 	for(;i<th->size();i++)
 	{
 		if (asAtomHandler::isInvalid(th->vec[i]))
@@ -837,49 +1129,6 @@ number_t Vector::sortComparatorWrapper::compare(const asAtom& d1, const asAtom&
 	return asAtomHandler::toNumber(ret);
 }
 
-// std::sort expects strict weak ordering for the comparison function
-// this is not guarranteed by user defined comparison functions, so we need our own sorting method.
-// TODO this is just a simple quicksort implementation, not optimized for performance
-void simplequicksortVector(std::vector<asAtom>& v, Vector::sortComparatorWrapper& comp, int32_t lo, int32_t hi)
-{
-	if (v.size() == 2)
-	{
-		if (comp.compare(v[0],v[1]) > 0)
-			std::swap(v[0],v[1]);
-		return;
-	}
-	if (lo < hi)
-	{
-		asAtom pivot = v[lo];
-		int32_t i = lo - 1;
-		int32_t j = hi + 1;
-		while (true)
-		{
-			do
-			{
-				i++;
-			}
-			while (i < hi && (comp.compare(v[i],pivot) < 0));
-			
-			do
-			{
-				j--;
-			}
-			while (j >= 0 && (comp.compare(v[j],pivot) > 0));
-	
-			if (i >= j)
-				break;
-	
-			std::swap(v[i],v[j]);
-		}
-		if (j >= lo)
-		{
-			simplequicksortVector(v, comp, lo, j);
-			simplequicksortVector(v, comp, j + 1, hi);
-		}
-	}
-}
-
 ASFUNCTIONBODY_ATOM(Vector,_sort)
 {
 	if (argslen != 1)
@@ -907,25 +1156,56 @@ ASFUNCTIONBODY_ATOM(Vector,_sort)
 		if(options&(~(Array::NUMERIC|Array::CASEINSENSITIVE|Array::DESCENDING)))
 			throw UnsupportedException("Vector::sort not completely implemented");
 	}
-	std::vector<asAtom> tmp = vector<asAtom>(th->vec.size());
-	int i = 0;
-	for(auto it=th->vec.begin();it != th->vec.end();++it)
+	if (th->storage != STORAGE_ATOM && isNumeric && asAtomHandler::isInvalid(comp))
 	{
-		tmp[i++]= *it;
+		//Numeric vectors are sorted in place
+		switch (th->storage)
+		{
+			case STORAGE_NUMBER:
+				if (std::any_of(th->dvec.begin(),th->dvec.end(),[](number_t v) { return std::isnan(v); }))
+					throw RunTimeException("Cannot sort non number with Array.NUMERIC option");
+				if (isDescending)
+					std::sort(th->dvec.begin(),th->dvec.end(),std::greater<number_t>());
+				else
+					std::sort(th->dvec.begin(),th->dvec.end());
+				break;
+			case STORAGE_INT:
+				if (isDescending)
+					std::sort(th->ivec.begin(),th->ivec.end(),std::greater<int32_t>());
+				else
+					std::sort(th->ivec.begin(),th->ivec.end());
+				break;
+			default:
+				std::sort(th->ivec.begin(),th->ivec.end(),[isDescending](int32_t a, int32_t b)
+				{
+					return isDescending ? (uint32_t)b < (uint32_t)a : (uint32_t)a < (uint32_t)b;
+				});
+				break;
+		}
+		ASATOM_INCREF(obj);
+		ret = obj;
+		return;
 	}
-	
-	if(asAtomHandler::isValid(comp))
+	std::vector<asAtom> tmp = vector<asAtom>(th->size());
+	for(uint32_t i=0;i<th->size();i++)
 	{
-		sortComparatorWrapper c(comp);
-		simplequicksortVector(tmp,c,0,tmp.size()-1);
+		if (th->storage == STORAGE_ATOM)
+			tmp[i]= th->vec[i];
+		else
+			th->getElement(tmp[i],i);
 	}
+	
+	if(asAtomHandler::isValid(comp))
+		Array::sortWithComparator<sortComparatorWrapper>(tmp,comp);
 	else
-		sort(tmp.begin(),tmp.end(),sortComparatorDefault(isNumeric,isCaseInsensitive,isDescending));
+		adaptiveSort(tmp,sortComparatorDefault(isNumeric,isCaseInsensitive,isDescending));
 
-	th->vec.clear();
-	for(auto ittmp=tmp.begin();ittmp != tmp.end();++ittmp)
+	if (th->storage == STORAGE_ATOM)
+		std::copy(tmp.begin(),tmp.end(),th->vec.begin());
+	else
 	{
-		th->vec.push_back(*ittmp);
+		for(uint32_t i=0;i<tmp.size();i++)
+			th->setElement(i,tmp[i]);
 	}
 	ASATOM_INCREF(obj);
 	ret = obj;
@@ -938,19 +1218,13 @@ ASFUNCTIONBODY_ATOM(Vector,unshift)
 		throwError<RangeError>(kVectorFixedError);
 	if (argslen > 0)
 	{
-		uint32_t s = th->size();
-		th->vec.resize(th->size()+argslen, asAtomHandler::invalidAtom);
-		for(uint32_t i=s;i> 0;i--)
-		{
-			th->vec[(i-1)+argslen]=th->vec[i-1];
-			th->vec[i-1] = asAtomHandler::invalidAtom;
-		}
-		
+		th->insertElements(0,argslen);
 		for(uint32_t i=0;i<argslen;i++)
 		{
-			th->vec[i] = args[i];
-			if (!th->vec_type->coerce(th->getSystemState(),th->vec[i]))
-				ASATOM_INCREF(th->vec[i]);
+			asAtom v = args[i];
+			if (!th->vec_type->coerce(th->getSystemState(),v))
+				ASATOM_INCREF(v);
+			th->setElement(i,v);
 		}
 	}
 	asAtomHandler::setInt(ret,sys,(int32_t)th->size());
@@ -972,14 +1246,18 @@ ASFUNCTIONBODY_ATOM(Vector,_map)
 	for(uint32_t i=0;i<th->size();i++)
 	{
 		asAtom funcArgs[3];
-		funcArgs[0]=th->vec[i];
+		th->getElement(funcArgs[0],i);
 		funcArgs[1]=asAtomHandler::fromUInt(i);
 		funcArgs[2]=asAtomHandler::fromObject(th);
 		asAtom funcRet=asAtomHandler::invalidAtom;
 		asAtomHandler::callFunction(func,funcRet,thisObject, funcArgs, 3,false);
+		ASATOM_DECREF(funcArgs[0]);
 		assert_and_throw(asAtomHandler::isValid(funcRet));
 		ASATOM_INCREF(funcRet);
-		res->vec.push_back(funcRet);
+		asAtom v = funcRet;
+		if (res->vec_type->coerce(sys,v))
+			ASATOM_DECREF(funcRet);
+		res->pushElement(v);
 	}
 
 	ret = asAtomHandler::fromObject(res);
@@ -989,19 +1267,11 @@ ASFUNCTIONBODY_ATOM(Vector,_toString)
 {
 	tiny_string res;
 	Vector* th = asAtomHandler::as<Vector>(obj);
-	for(size_t i=0; i < th->vec.size(); ++i)
+	for(size_t i=0; i < th->size(); ++i)
 	{
-		if (asAtomHandler::isValid(th->vec[i]))
-			res += asAtomHandler::toString(th->vec[i],sys);
-		else
-		{
-			// use the type's default value
-			asAtom natom = asAtomHandler::nullAtom;
-			th->vec_type->coerce(th->getSystemState(), natom);
-			res += asAtomHandler::toString(natom,sys);
-		}
+		res += th->elementToString(i);
 
-		if(i!=th->vec.size()-1)
+		if(i!=th->size()-1)
 			res += ',';
 	}
 	ret = asAtomHandler::fromObject(abstract_s(th->getSystemState(),res));
@@ -1016,19 +1286,17 @@ ASFUNCTIONBODY_ATOM(Vector,insertAt)
 	asAtom o=asAtomHandler::invalidAtom;
 	ARG_UNPACK_ATOM(index)(o);
 
-	if (index < 0 && th->vec.size() >= (uint32_t)(-index))
-		index = th->vec.size()+(index);
+	if (index < 0 && th->size() >= (uint32_t)(-index))
+		index = th->size()+(index);
 	if (index < 0)
 		index = 0;
-	if ((uint32_t)index >= th->vec.size())
-	{
-		ASATOM_INCREF(o);
-		th->vec.push_back(o);
-	}
+	ASATOM_INCREF(o);
+	if ((uint32_t)index >= th->size())
+		th->pushElement(o);
 	else
 	{
-		ASATOM_INCREF(o);
-		th->vec.insert(th->vec.begin()+index,o);
+		th->insertElements(index,1);
+		th->setElement(index,o);
 	}
 }
 
@@ -1040,13 +1308,16 @@ ASFUNCTIONBODY_ATOM(Vector,removeAt)
 	int32_t index;
 	ARG_UNPACK_ATOM(index);
 	if (index < 0)
-		index = th->vec.size()+index;
+		index = th->size()+index;
 	if (index < 0)
 		index = 0;
-	if ((uint32_t)index < th->vec.size())
+	if ((uint32_t)index < th->size())
 	{
-		ret = th->vec[index];
-		th->vec.erase(th->vec.begin()+index);
+		if (th->storage == STORAGE_ATOM)
+			ret = th->vec[index];
+		else
+			th->getElement(ret,index);
+		th->eraseElement(index);
 	}
 	else
 		throwError<RangeError>(kOutOfRangeError);
@@ -1064,7 +1335,7 @@ bool Vector::hasPropertyByMultiname(const multiname& name, bool considerDynamic,
 	if(!Vector::isValidMultiname(getSystemState(),name,index))
 		return ASObject::hasPropertyByMultiname(name, considerDynamic, considerPrototype);
 
-	if(index < vec.size())
+	if(index < size())
 		return true;
 	else
 		return false;
@@ -1086,32 +1357,32 @@ GET_VARIABLE_RESULT Vector::getVariableByMultiname(asAtom& ret, const multiname&
 
 	unsigned int index=0;
 	bool isNumber =false;
-	if(!Vector::isValidMultiname(getSystemState(),name,index,&isNumber) || index > vec.size())
+	if(!Vector::isValidMultiname(getSystemState(),name,index,&isNumber) || index > size())
 	{
 		switch(name.name_type) 
 		{
 			case multiname::NAME_NUMBER:
 				if (getSystemState()->getSwfVersion() >= 11 
 						|| (uint32_t(name.name_d) == name.name_d && name.name_d < UINT32_MAX))
-					throwError<RangeError>(kOutOfRangeError,name.normalizedName(getSystemState()),Integer::toString(vec.size()));
+					throwError<RangeError>(kOutOfRangeError,name.normalizedName(getSystemState()),Integer::toString(size()));
 				else
 					throwError<ReferenceError>(kReadSealedError, name.normalizedName(getSystemState()), this->getClass()->getQualifiedClassName());
 				break;
 			case multiname::NAME_INT:
 				if (getSystemState()->getSwfVersion() >= 11
-						|| name.name_i >= (int32_t)vec.size())
-					throwError<RangeError>(kOutOfRangeError,name.normalizedName(getSystemState()),Integer::toString(vec.size()));
+						|| name.name_i >= (int32_t)size())
+					throwError<RangeError>(kOutOfRangeError,name.normalizedName(getSystemState()),Integer::toString(size()));
 				else
 					throwError<ReferenceError>(kReadSealedError, name.normalizedName(getSystemState()), this->getClass()->getQualifiedClassName());
 				break;
 			case multiname::NAME_UINT:
-				throwError<RangeError>(kOutOfRangeError,name.normalizedName(getSystemState()),Integer::toString(vec.size()));
+				throwError<RangeError>(kOutOfRangeError,name.normalizedName(getSystemState()),Integer::toString(size()));
 				break;
 			case multiname::NAME_STRING:
 				if (isNumber)
 				{
 					if (getSystemState()->getSwfVersion() >= 11 )
-						throwError<RangeError>(kOutOfRangeError,name.normalizedName(getSystemState()),Integer::toString(vec.size()));
+						throwError<RangeError>(kOutOfRangeError,name.normalizedName(getSystemState()),Integer::toString(size()));
 					else
 						throwError<ReferenceError>(kReadSealedError, name.normalizedName(getSystemState()), this->getClass()->getQualifiedClassName());
 				}
@@ -1125,9 +1396,20 @@ GET_VARIABLE_RESULT Vector::getVariableByMultiname(asAtom& ret, const multiname&
 			throwError<ReferenceError>(kReadSealedError, name.normalizedName(getSystemState()), this->getClass()->getQualifiedClassName());
 		return res;
 	}
-	if(index < vec.size())
+	if(index < size())
 	{
-		if (asAtomHandler::isValid(vec[index]))
+		if (storage != STORAGE_ATOM)
+		{
+			if (opt & NO_INCREF)
+			{
+				ASATOM_DECREF(borrowedNumber);
+				getElement(borrowedNumber,index);
+				ret = borrowedNumber;
+			}
+			else
+				getElement(ret,index);
+		}
+		else if (asAtomHandler::isValid(vec[index]))
 		{
 			ret = vec[index];
 			if (!(opt & NO_INCREF))
@@ -1143,7 +1425,7 @@ GET_VARIABLE_RESULT Vector::getVariableByMultiname(asAtom& ret, const multiname&
 	{
 		throwError<RangeError>(kOutOfRangeError,
 				       Integer::toString(index),
-				       Integer::toString(vec.size()));
+				       Integer::toString(size()));
 	}
 	return GET_VARIABLE_RESULT::GETVAR_NORMAL;
 }
@@ -1161,20 +1443,20 @@ multiname *Vector::setVariableByMultiname(const multiname& name, asAtom& o, CONS
 		{
 			case multiname::NAME_NUMBER:
 				if (getSystemState()->getSwfVersion() >= 11 
-						|| (this->fixed && ((int32_t(name.name_d) != name.name_d) || name.name_d >= (int32_t)vec.size() || name.name_d < 0)))
-					throwError<RangeError>(kOutOfRangeError,name.normalizedName(getSystemState()),Integer::toString(vec.size()));
+						|| (this->fixed && ((int32_t(name.name_d) != name.name_d) || name.name_d >= (int32_t)size() || name.name_d < 0)))
+					throwError<RangeError>(kOutOfRangeError,name.normalizedName(getSystemState()),Integer::toString(size()));
 				else
 					throwError<ReferenceError>(kWriteSealedError, name.normalizedName(getSystemState()), this->getClass()->getQualifiedClassName());
 				break;
 			case multiname::NAME_INT:
 				if (getSystemState()->getSwfVersion() >= 11
-						|| (this->fixed && (name.name_i >= (int32_t)vec.size() || name.name_i < 0)))
-					throwError<RangeError>(kOutOfRangeError,name.normalizedName(getSystemState()),Integer::toString(vec.size()));
+						|| (this->fixed && (name.name_i >= (int32_t)size() || name.name_i < 0)))
+					throwError<RangeError>(kOutOfRangeError,name.normalizedName(getSystemState()),Integer::toString(size()));
 				else
 					throwError<ReferenceError>(kWriteSealedError, name.normalizedName(getSystemState()), this->getClass()->getQualifiedClassName());
 				break;
 			case multiname::NAME_UINT:
-				throwError<RangeError>(kOutOfRangeError,name.normalizedName(getSystemState()),Integer::toString(vec.size()));
+				throwError<RangeError>(kOutOfRangeError,name.normalizedName(getSystemState()),Integer::toString(size()));
 				break;
 			default:
 				break;
@@ -1184,10 +1466,22 @@ multiname *Vector::setVariableByMultiname(const multiname& name, asAtom& o, CONS
 			throwError<ReferenceError>(kWriteSealedError, name.normalizedName(getSystemState()), this->getClass()->getQualifiedClassName());
 		return ASObject::setVariableByMultiname(name, o, allowConst,alreadyset);
 	}
+	if (storage != STORAGE_ATOM)
+	{
+		if(index < size())
+			setElement(index,o);
+		else if(!fixed && index == size())
+			pushElement(o);
+		else
+			throwError<RangeError>(kOutOfRangeError,
+					       Integer::toString(index),
+					       Integer::toString(size()));
+		return nullptr;
+	}
 	asAtom v = o;
 	if (this->vec_type->coerce(getSystemState(), v))
 		ASATOM_DECREF(v);
-	if(index < vec.size())
+	if(index < size())
 	{
 		if (vec[index].uintval == o.uintval)
 		{
@@ -1200,7 +1494,7 @@ multiname *Vector::setVariableByMultiname(const multiname& name, asAtom& o, CONS
 			vec[index] = o;
 		}
 	}
-	else if(!fixed && index == vec.size())
+	else if(!fixed && index == size())
 	{
 		vec.push_back( o );
 	}
@@ -1210,7 +1504,7 @@ multiname *Vector::setVariableByMultiname(const multiname& name, asAtom& o, CONS
 		 * one beyond the current final index. */
 		throwError<RangeError>(kOutOfRangeError,
 				       Integer::toString(index),
-				       Integer::toString(vec.size()));
+				       Integer::toString(size()));
 	}
 	return nullptr;
 }
@@ -1219,25 +1513,18 @@ tiny_string Vector::toString()
 {
 	//TODO: test
 	tiny_string t;
-	for(size_t i = 0; i < vec.size(); ++i)
+	for(size_t i = 0; i < size(); ++i)
 	{
 		if( i )
 			t += ",";
-		if (asAtomHandler::isValid(vec[i])) 
-			t += asAtomHandler::toString(vec[i],getSystemState());
-		else
-		{
-			asAtom natom = asAtomHandler::nullAtom;
-			vec_type->coerce(getSystemState(), natom );
-			t += asAtomHandler::toString(natom,getSystemState());
-		}
+		t += elementToString(i);
 	}
 	return t;
 }
 
 uint32_t Vector::nextNameIndex(uint32_t cur_index)
 {
-	if(cur_index < vec.size())
+	if(cur_index < size())
 		return cur_index+1;
 	else
 		return 0;
@@ -1245,7 +1532,7 @@ uint32_t Vector::nextNameIndex(uint32_t cur_index)
 
 void Vector::nextName(asAtom& ret,uint32_t index)
 {
-	if(index<=vec.size())
+	if(index<=size())
 		asAtomHandler::setUInt(ret,this->getSystemState(),index-1);
 	else
 		throw RunTimeException("Vector::nextName out of bounds");
@@ -1253,9 +1540,11 @@ void Vector::nextName(asAtom& ret,uint32_t index)
 
 void Vector::nextValue(asAtom& ret,uint32_t index)
 {
-	if(index<=vec.size())
+	if(index<=size())
 	{
-		if (asAtomHandler::isValid(vec[index-1]))
+		if (storage != STORAGE_ATOM)
+			getElement(ret,index-1);
+		else if (asAtomHandler::isValid(vec[index-1]))
 		{
 			ASATOM_INCREF(vec[index-1]);
 			ret = vec[index-1];
@@ -1298,12 +1587,17 @@ tiny_string Vector::toJSON(std::vector<ASObject *> &path, asAtom replacer, const
 	bool bfirst = true;
 	tiny_string newline = (spaces.empty() ? "" : "\n");
 	asAtom closure = asAtomHandler::isValid(replacer) && asAtomHandler::getClosure(replacer) ? asAtomHandler::fromObject(asAtomHandler::getClosure(replacer)) : asAtomHandler::nullAtom;
-	for (unsigned int i =0;  i < vec.size(); i++)
+	for (unsigned int i =0;  i < size(); i++)
 	{
 		tiny_string subres;
-		asAtom o = vec[i];
-		if (asAtomHandler::isInvalid(o))
-			o= asAtomHandler::nullAtom;
+		asAtom o = asAtomHandler::nullAtom;
+		if (storage != STORAGE_ATOM)
+			getElement(o,i);
+		else if (asAtomHandler::isValid(vec[i]))
+		{
+			o = vec[i];
+			ASATOM_INCREF(o);
+		}
 		if (asAtomHandler::isValid(replacer))
 		{
 			asAtom params[2];
@@ -1319,6 +1613,7 @@ tiny_string Vector::toJSON(std::vector<ASObject *> &path, asAtom replacer, const
 		{
 			subres = asAtomHandler::toObject(o,getSystemState())->toJSON(path,replacer,spaces,filter);
 		}
+		ASATOM_DECREF(o);
 		if (!subres.empty())
 		{
 			if (!bfirst)
@@ -1336,17 +1631,120 @@ tiny_string Vector::toJSON(std::vector<ASObject *> &path, asAtom replacer, const
 	return res;
 }
 
-asAtom Vector::at(unsigned int index, asAtom defaultValue) const
+asAtom Vector::at(unsigned int index) const
 {
-	if (index < vec.size())
+	if (storage == STORAGE_ATOM)
 		return vec.at(index);
+	if (index >= size())
+		throw std::out_of_range("Vector::at");
+	asAtom ret=asAtomHandler::invalidAtom;
+	getElement(ret,index);
+	return ret;
+}
+
+asAtom Vector::at(unsigned int index, asAtom defaultValue) const
+{
+	if (index < size())
+		return at(index);
 	else
 		return defaultValue;
 }
 
-void Vector::serialize(ByteArray* out, std::map<tiny_string, uint32_t>& stringMap,
-				std::map<const ASObject*, uint32_t>& objMap,
-				std::map<const Class_base*, uint32_t>& traitsMap)
+number_t Vector::numberAt(unsigned int index, number_t defaultValue) const
+{
+	if (index >= size())
+		return defaultValue;
+	switch (storage)
+	{
+		case STORAGE_INT:
+			return ivec[index];
+		case STORAGE_UINT:
+			return (uint32_t)ivec[index];
+		case STORAGE_NUMBER:
+			return dvec[index];
+		default:
+			return asAtomHandler::isValid(vec[index]) ? asAtomHandler::toNumber(vec[index]) : defaultValue;
+	}
+}
+
+uint32_t Vector::uintAt(unsigned int index, uint32_t defaultValue) const
+{
+	if (index >= size())
+		return defaultValue;
+	switch (storage)
+	{
+		case STORAGE_INT:
+		case STORAGE_UINT:
+			return (uint32_t)ivec[index];
+		case STORAGE_NUMBER:
+			return (uint32_t)Number::toInt(dvec[index]);
+		default:
+			return asAtomHandler::isValid(vec[index]) ? (uint32_t)Number::toInt(asAtomHandler::toNumber(vec[index])) : defaultValue;
+	}
+}
+
+void Vector::set(uint32_t index, asAtom v)
+{
+	if (index < size())
+		setElement(index,v);
+	else
+		ASATOM_DECREF(v);
+}
+
+void Vector::appendInt(int32_t v)
+{
+	if (storage == STORAGE_INT || storage == STORAGE_UINT)
+		ivec.push_back(v);
+	else
+	{
+		asAtom a = asAtomHandler::fromInt(v);
+		append(a);
+	}
+}
+
+void Vector::appendUInt(uint32_t v)
+{
+	if (storage == STORAGE_INT || storage == STORAGE_UINT)
+		ivec.push_back((int32_t)v);
+	else
+	{
+		asAtom a = asAtomHandler::invalidAtom;
+		asAtomHandler::setUInt(a,getSystemState(),v);
+		append(a);
+	}
+}
+
+void Vector::appendNumber(number_t v)
+{
+	if (storage == STORAGE_NUMBER)
+		dvec.push_back(v);
+	else
+	{
+		asAtom a = asAtomHandler::invalidAtom;
+		asAtomHandler::setNumber(a,getSystemState(),v);
+		append(a);
+	}
+}
+
+void Vector::reserve(uint32_t n)
+{
+	switch (storage)
+	{
+		case STORAGE_ATOM:
+			vec.reserve(n);
+			break;
+		case STORAGE_NUMBER:
+			dvec.reserve(n);
+			break;
+		default:
+			ivec.reserve(n);
+			break;
+	}
+}
+
+void Vector::serialize(ByteArray* out, std::unordered_map<tiny_string, uint32_t>& stringMap,
+				std::unordered_map<const ASObject*, uint32_t>& objMap,
+				std::unordered_map<const Class_base*, uint32_t>& traitsMap)
 {
 	if (out->getObjectEncoding() == ObjectEncoding::AMF0)
 	{
@@ -1383,30 +1781,65 @@ void Vector::serialize(ByteArray* out, std::map<tiny_string, uint32_t>& stringMa
 		if (marker == vector_object_marker)
 		{
 			out->writeStringVR(stringMap,vec_type->getName());
+			for(uint32_t i=0;i<count;i++)
+			{
+				if (asAtomHandler::isInvalid(vec[i]))
+				{
+					//TODO should we write a null_marker here?
+					LOG(LOG_NOT_IMPLEMENTED,"serialize unset vector objects");
+					continue;
+				}
+				asAtomHandler::toObject(vec[i],getSystemState())->serialize(out, stringMap, objMap, traitsMap);
+			}
+			return;
+		}
+		//Numeric vectors are written directly into the output buffer
+		const uint32_t elemSize = (marker == vector_double_marker) ? 8 : 4;
+		if (count == 0)
+			return;
+		uint8_t* buf = out->reserveBytes(count*elemSize);
+		if (storage == STORAGE_NUMBER)
+		{
+			for(uint32_t i=0;i<count;i++)
+			{
+				//Doubles are always written in network byte order (big endian)
+				uint64_t tmp;
+				memcpy(&tmp,&dvec[i],8);
+				tmp = GINT64_TO_BE(tmp);
+				memcpy(buf+i*8,&tmp,8);
+			}
+			return;
+		}
+		if (storage != STORAGE_ATOM)
+		{
+			for(uint32_t i=0;i<count;i++)
+			{
+				uint32_t tmp = out->endianIn((uint32_t)ivec[i]);
+				memcpy(buf+i*4,&tmp,4);
+			}
+			return;
 		}
 		for(uint32_t i=0;i<count;i++)
 		{
+			//Unset entries are written as 0, so the count stays valid
 			if (asAtomHandler::isInvalid(vec[i]))
+				memset(buf,0,elemSize);
+			else if (marker == vector_double_marker)
 			{
-				//TODO should we write a null_marker here?
-				LOG(LOG_NOT_IMPLEMENTED,"serialize unset vector objects");
-				continue;
+				//Doubles are always written in network byte order (big endian)
+				number_t val = asAtomHandler::toNumber(vec[i]);
+				uint64_t tmp;
+				memcpy(&tmp,&val,8);
+				tmp = GINT64_TO_BE(tmp);
+				memcpy(buf,&tmp,8);
 			}
-			switch (marker)
+			else
 			{
-				case vector_int_marker:
-					out->writeUnsignedInt(out->endianIn((uint32_t)asAtomHandler::toInt(vec[i])));
-					break;
-				case vector_uint_marker:
-					out->writeUnsignedInt(out->endianIn(asAtomHandler::toUInt(vec[i])));
-					break;
-				case vector_double_marker:
-					out->serializeDouble(asAtomHandler::toNumber(vec[i]));
-					break;
-				case vector_object_marker:
-					asAtomHandler::toObject(vec[i],getSystemState())->serialize(out, stringMap, objMap, traitsMap);
-					break;
+				uint32_t tmp = (marker == vector_int_marker) ? (uint32_t)asAtomHandler::toInt(vec[i]) : asAtomHandler::toUInt(vec[i]);
+				tmp = out->endianIn(tmp);
+				memcpy(buf,&tmp,4);
 			}
+			buf += elemSize;
 		}
 	}
 }
@@ -28,10 +28,35 @@ namespace lightspark
 template<class T> class TemplatedClass;
 class Vector: public ASObject
 {
+	// Vector.<int> and Vector.<uint> store their elements unboxed in ivec,
+	// Vector.<Number> in dvec. All other vectors store atoms in vec
+	enum STORAGE_TYPE { STORAGE_ATOM, STORAGE_INT, STORAGE_UINT, STORAGE_NUMBER };
 	const Type* vec_type;
 	bool fixed;
+	STORAGE_TYPE storage;
 	std::vector<asAtom, reporter_allocator<asAtom>> vec;
+	std::vector<int32_t, reporter_allocator<int32_t>> ivec;
+	std::vector<number_t, reporter_allocator<number_t>> dvec;
+	// Number handed out without a reference by getVariableByMultiname,
+	// it is kept alive until the next such access
+	asAtom borrowedNumber;
 	int capIndex(int i) const;
+	void setStorage();
+	//Stores o, which has to be coerced to vec_type already. Takes ownership of o
+	void setElement(uint32_t index, asAtom& o);
+	void pushElement(asAtom& o);
+	void resizeElements(uint32_t len);
+	//Appends the elements of src, coerced to vec_type
+	void appendElements(Vector* src);
+	//Moves count elements starting at start into res, which has the same type
+	void moveElements(Vector* res, uint32_t start, uint32_t count);
+	//Inserts count default elements at pos
+	void insertElements(uint32_t pos, uint32_t count);
+	//Removes the element at index without releasing it
+	void eraseElement(uint32_t index);
+	tiny_string elementToString(uint32_t index) const;
+	//indexOf/lastIndexOf for numeric storage
+	int32_t findNumber(const asAtom& value, uint32_t from, bool backwards) const;
 	class sortComparatorDefault
 	{
 	private:
@@ -54,6 +79,8 @@ public:
 	Vector(Class_base* c, const Type *vtype=NULL);
 	~Vector();
 	bool destruct();
+	void traceReferences(std::vector<ASObject*>& refs);
+	void clearReferences();
 	
 	
 	static void sinit(Class_base* c);
@@ -78,24 +105,43 @@ public:
 
 	uint32_t size() const
 	{
-		return vec.size();
-	}
-	asAtom at(unsigned int index) const
-	{
-		return vec.at(index);
-	}
-	void set(uint32_t index, asAtom v)
-	{
-		if (index < size())
-			vec[index] = v;
+		switch (storage)
+		{
+			case STORAGE_ATOM:
+				return vec.size();
+			case STORAGE_NUMBER:
+				return dvec.size();
+			default:
+				return ivec.size();
+		}
 	}
+	//Returns the element at index. For Vector.<int>, Vector.<uint> and
+	//Vector.<Number> the atom is created on the fly and owned by the
+	//caller, use numberAt to read those without creating objects
+	asAtom at(unsigned int index) const;
 	//Get value at index, or return defaultValue (a borrowed
 	//reference) if index is out-of-range
 	asAtom at(unsigned int index, asAtom defaultValue) const;
+	number_t numberAt(unsigned int index, number_t defaultValue=0) const;
+	//Same as numberAt, converted with ToUint32
+	uint32_t uintAt(unsigned int index, uint32_t defaultValue=0) const;
+	//Gets the element at index with its own reference, unset elements
+	//are returned as the default value of the type
+	void getElement(asAtom& ret, uint32_t index) const;
+	//Like getElement, but reuses a Number in ret if possible.
+	//The previous reference in ret is released
+	void replaceWithElement(asAtom& ret, uint32_t index);
+	//Takes ownership of v
+	void set(uint32_t index, asAtom v);
 
 	//Appends an object to the Vector. o is coerced to vec_type.
 	//Takes ownership of o.
 	void append(asAtom& o);
+	//Append numbers without boxing them for numeric vectors
+	void appendInt(int32_t v);
+	void appendUInt(uint32_t v);
+	void appendNumber(number_t v);
+	void reserve(uint32_t n);
 	void setFixed(bool v) { fixed = v; }
 	
 	void remove(ASObject* o);
@@ -132,9 +178,9 @@ public:
 
 	ASObject* describeType() const;
 	//Serialization interface
-	void serialize(ByteArray* out, std::map<tiny_string, uint32_t>& stringMap,
-				std::map<const ASObject*, uint32_t>& objMap,
-				std::map<const Class_base*, uint32_t>& traitsMap);
+	void serialize(ByteArray* out, std::unordered_map<tiny_string, uint32_t>& stringMap,
+				std::unordered_map<const ASObject*, uint32_t>& objMap,
+				std::unordered_map<const Class_base*, uint32_t>& traitsMap);
 };
 
 }
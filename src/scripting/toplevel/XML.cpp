@@ -66,7 +66,8 @@ XML::XML(Class_base* c, const pugi::xml_node& _n, XML* parent, bool fromXMLList)
 
 bool XML::destruct()
 {
-	xmldoc.reset();
+	sharedDocument.reset();
+	pendingChildren = pugi::xml_node();
 	parentNode.reset();
 	nodetype =(pugi::xml_node_type)0;
 	isAttribute = false;
@@ -390,6 +391,7 @@ void XML::handleNotification(const tiny_string& command, asAtom value, asAtom de
 }
 void XML::appendChild(_R<XML> newChild)
 {
+	materializeChildren();
 	if (newChild->constructed)
 	{
 		if (this == newChild.getPtr())
@@ -453,6 +455,7 @@ XMLList* XML::getAllAttributes()
 
 const tiny_string XML::toXMLString_internal(bool pretty, uint32_t defaultnsprefix, const char *indent,bool bfirst)
 {
+	materializeChildren();
 	tiny_string res;
 	set<uint32_t> seen_prefix;
 
@@ -749,6 +752,7 @@ ASFUNCTIONBODY_ATOM(XML,toXMLString)
 
 void XML::childrenImpl(XMLVector& ret, const tiny_string& name)
 {
+	materializeChildren();
 	if (!childrenlist.isNull())
 	{
 		for (uint32_t i = 0; i < childrenlist->nodes.size(); i++)
@@ -764,6 +768,7 @@ void XML::childrenImpl(XMLVector& ret, const tiny_string& name)
 
 void XML::childrenImpl(XMLVector& ret, uint32_t index)
 {
+	materializeChildren();
 	if (constructed && !childrenlist.isNull() && index < childrenlist->nodes.size())
 	{
 		_R<XML> child= childrenlist->nodes[index];
@@ -811,6 +816,7 @@ ASFUNCTIONBODY_ATOM(XML,childIndex)
 	XML* th=asAtomHandler::as<XML>(obj);
 	if (th->parentNode && !th->parentNode->childrenlist.isNull())
 	{
+		// th exists, so the children of its parent are already created
 		XML* parent = th->parentNode.getPtr();
 		for (uint32_t i = 0; i < parent->childrenlist->nodes.size(); i++)
 		{
@@ -845,6 +851,7 @@ ASFUNCTIONBODY_ATOM(XML,valueOf)
 
 void XML::getText(XMLVector& ret)
 {
+	materializeChildren();
 	if (childrenlist.isNull())
 		return;
 	for (uint32_t i = 0; i < childrenlist->nodes.size(); i++)
@@ -883,6 +890,7 @@ ASFUNCTIONBODY_ATOM(XML,elements)
 
 void XML::getElementNodes(const tiny_string& name, XMLVector& foundElements)
 {
+	materializeChildren();
 	if (childrenlist.isNull())
 		return;
 	for (uint32_t i = 0; i < childrenlist->nodes.size(); i++)
@@ -929,6 +937,8 @@ ASFUNCTIONBODY_ATOM(XML,addNamespace)
 	XML* th=asAtomHandler::as<XML>(obj);
 	_NR<ASObject> newNamespace;
 	ARG_UNPACK_ATOM(newNamespace);
+	// descendants resolve their prefixes against the namespaces in effect when they are created
+	th->materializeSubtree();
 
 
 	uint32_t ns_uri = BUILTIN_STRINGS::EMPTY;
@@ -1135,6 +1145,7 @@ ASFUNCTIONBODY_ATOM(XML,_setNamespace)
 	if (th->isAttribute && th->parentNode)
 	{
 		XML* tmp = th->parentNode.getPtr();
+		tmp->materializeSubtree();
 		for (uint32_t i = 0; i < tmp->namespacedefs.size(); i++)
 		{
 			bool b;
@@ -1151,6 +1162,8 @@ ASFUNCTIONBODY_ATOM(XML,_setNamespace)
 
 void XML::setNamespace(uint32_t ns_uri, uint32_t ns_prefix)
 {
+	// children inherit the namespace of their parent when they are created
+	materializeChildren();
 	this->nodenamespace_prefix = ns_prefix;
 	this->nodenamespace_uri = ns_uri;
 	handleNotification("namespaceSet",asAtomHandler::fromObject(this),asAtomHandler::nullAtom);
@@ -1170,6 +1183,7 @@ XML *XML::copy()
 ASFUNCTIONBODY_ATOM(XML,_setChildren)
 {
 	XML* th=asAtomHandler::as<XML>(obj);
+	th->materializeChildren();
 	_NR<ASObject> newChildren;
 	ARG_UNPACK_ATOM(newChildren);
 
@@ -1214,6 +1228,7 @@ ASFUNCTIONBODY_ATOM(XML,_normalize)
 
 void XML::normalize()
 {
+	materializeChildren();
 	childrenlist->normalize();
 }
 
@@ -1242,6 +1257,16 @@ bool XML::hasSimpleContent() const
 	if (getNodeKind() == pugi::node_comment ||
 		getNodeKind() == pugi::node_pi)
 		return false;
+	if (pendingChildren)
+	{
+		// answer from the parsed document without creating the children
+		for (pugi::xml_node child = pendingChildren.first_child(); child; child = child.next_sibling())
+		{
+			if (child.type() == pugi::node_element)
+				return false;
+		}
+		return true;
+	}
 	if (childrenlist.isNull())
 		return true;
 	for(size_t i=0; i<childrenlist->nodes.size(); i++)
@@ -1280,6 +1305,13 @@ void XML::getDescendantsByQName(const tiny_string& name, uint32_t ns, bool bIsAt
 			}
 		}
 	}
+	if (pendingChildren)
+	{
+		// skip subtrees that the parsed document shows to contain no match
+		if (name != "" && name != "*" && !sharedDocument->subtreeMayContain(pendingChildren,name,bIsAttribute))
+			return;
+		const_cast<XML*>(this)->createPendingChildren();
+	}
 	if (childrenlist.isNull())
 		return;
 	for (uint32_t i = 0; i < childrenlist->nodes.size(); i++)
@@ -1493,6 +1525,7 @@ XML::XMLVector XML::getValuesByMultiname(_NR<XMLList> nodelist, const multiname&
 
 GET_VARIABLE_RESULT XML::getVariableByMultiname(asAtom& ret, const multiname& name, GET_VARIABLE_OPTION opt)
 {
+	materializeChildren();
 	if((opt & SKIP_IMPL)!=0)
 	{
 		GET_VARIABLE_RESULT res = getVariableByMultinameIntern(ret,name,this->getClass(),opt);
@@ -1566,6 +1599,7 @@ multiname *XML::setVariableByMultiname(const multiname& name, asAtom& o, CONST_A
 }
 multiname* XML::setVariableByMultinameIntern(const multiname& name, asAtom& o, CONST_ALLOWED_FLAG allowConst, bool replacetext)
 {
+	materializeChildren();
 	unsigned int index=0;
 	bool isAttr=name.isAttribute;
 	//Normalize the name to the string form
@@ -1694,6 +1728,7 @@ multiname* XML::setVariableByMultinameIntern(const multiname& name, asAtom& o, C
 							tmp->nodenamespace_prefix = BUILTIN_STRINGS::EMPTY;
 							tmp->nodevalue = asAtomHandler::toString(o,getSystemState());
 							tmp->constructed = true;
+							tmpnode->materializeChildren();
 							tmpnode->childrenlist->clear();
 							tmpnode->childrenlist->append(tmp);
 						}
@@ -1714,6 +1749,7 @@ multiname* XML::setVariableByMultinameIntern(const multiname& name, asAtom& o, C
 				}
 				else
 				{
+					tmpnode->materializeChildren();
 					if (tmpnode->childrenlist.isNull())
 						tmpnode->childrenlist = _MR(Class<XMLList>::getInstanceSNoArgs(getSystemState()));
 					
@@ -1802,6 +1838,7 @@ multiname* XML::setVariableByMultinameIntern(const multiname& name, asAtom& o, C
 
 bool XML::hasProperty(const multiname& name, bool checkXMLPropsOnly, bool considerDynamic, bool considerPrototype)
 {
+	materializeChildren();
 	if(considerDynamic == false && !checkXMLPropsOnly)
 		return ASObject::hasPropertyByMultiname(name, considerDynamic, considerPrototype);
 	if (!isConstructed())
@@ -1875,6 +1912,7 @@ bool XML::hasPropertyByMultiname(const multiname& name, bool considerDynamic, bo
 
 bool XML::deleteVariableByMultiname(const multiname& name)
 {
+	materializeChildren();
 	unsigned int index=0;
 	if(name.isAttribute)
 	{
@@ -2170,6 +2208,12 @@ void XML::CheckCyclicReference(XML* node)
 	}
 }
 
+const pugi::xml_node XML::buildFromString(const tiny_string& str, unsigned int xmlparsemode, const tiny_string& default_ns)
+{
+	sharedDocument = _MR(new XMLSharedDocument(getVm(getSystemState())->getDefaultXMLNamespaceID(),ignoreWhitespace));
+	return XMLBase::buildFromString(sharedDocument->doc,str,xmlparsemode,default_ns);
+}
+
 XML *XML::createFromString(SystemState* sys, const tiny_string &s,bool usefirstchild)
 {
 	XML* res = Class<XML>::getInstanceSNoArgs(sys);
@@ -2178,7 +2222,7 @@ XML *XML::createFromString(SystemState* sys, const tiny_string &s,bool usefirstc
 	return res;
 }
 
-XML *XML::createFromNode(const pugi::xml_node &_n, XML *parent, bool fromXMLList)
+XML *XML::createFromNode(const pugi::xml_node &_n, XML *parent, bool fromXMLList, _NR<XMLSharedDocument> doc)
 {
 	XML* res = Class<XML>::getInstanceSNoArgs(parent ? parent->getSystemState() : getSys());
 	if (parent)
@@ -2186,6 +2230,7 @@ XML *XML::createFromNode(const pugi::xml_node &_n, XML *parent, bool fromXMLList
 		parent->incRef();
 		res->parentNode = _NR<XML>(parent);
 	}
+	res->sharedDocument = doc;
 	res->createTree(_n,fromXMLList);
 	return res;
 }
@@ -2193,6 +2238,7 @@ XML *XML::createFromNode(const pugi::xml_node &_n, XML *parent, bool fromXMLList
 ASFUNCTIONBODY_ATOM(XML,insertChildAfter)
 {
 	XML* th=asAtomHandler::as<XML>(obj);
+	th->materializeChildren();
 	_NR<ASObject> child1;
 	_NR<ASObject> child2;
 	ARG_UNPACK_ATOM(child1)(child2);
@@ -2279,6 +2325,7 @@ ASFUNCTIONBODY_ATOM(XML,insertChildAfter)
 ASFUNCTIONBODY_ATOM(XML,insertChildBefore)
 {
 	XML* th=asAtomHandler::as<XML>(obj);
+	th->materializeChildren();
 	_NR<ASObject> child1;
 	_NR<ASObject> child2;
 	ARG_UNPACK_ATOM(child1)(child2);
@@ -2393,6 +2440,7 @@ ASFUNCTIONBODY_ATOM(XML,removeNamespace)
 }
 void XML::RemoveNamespace(Namespace *ns)
 {
+	materializeChildren();
 	if (this->nodenamespace_uri == ns->getURI())
 	{
 		this->nodenamespace_uri = BUILTIN_STRINGS::EMPTY;
@@ -2428,6 +2476,7 @@ ASFUNCTIONBODY_ATOM(XML,comments)
 }
 void XML::getComments(XMLVector& ret)
 {
+	materializeChildren();
 	if (childrenlist)
 	{
 		for (auto it = childrenlist->nodes.begin(); it != childrenlist->nodes.end(); it++)
@@ -2452,6 +2501,7 @@ ASFUNCTIONBODY_ATOM(XML,processingInstructions)
 }
 void XML::getprocessingInstructions(XMLVector& ret, tiny_string name)
 {
+	materializeChildren();
 	if (childrenlist)
 	{
 		for (auto it = childrenlist->nodes.begin(); it != childrenlist->nodes.end(); it++)
@@ -2497,6 +2547,7 @@ ASFUNCTIONBODY_ATOM(XML,_hasOwnProperty)
 
 tiny_string XML::toString_priv()
 {
+	materializeChildren();
 	tiny_string ret;
 	if (getNodeKind() == pugi::node_pcdata ||
 		isAttribute ||
@@ -2646,6 +2697,8 @@ bool XML::nodesEqual(XML *a, XML *b) const
 	}
 	
 	// children
+	a->materializeChildren();
+	b->materializeChildren();
 	if (a->childrenlist.isNull())
 		return b->childrenlist.isNull() || b->childrenlist->nodes.size() == 0;
 	if (b->childrenlist.isNull())
@@ -2697,9 +2750,9 @@ bool XML::isEqual(ASObject* r)
 	return false;
 }
 
-void XML::serialize(ByteArray* out, std::map<tiny_string, uint32_t>& stringMap,
-		    std::map<const ASObject*, uint32_t>& objMap,
-		    std::map<const Class_base*, uint32_t>& traitsMap)
+void XML::serialize(ByteArray* out, std::unordered_map<tiny_string, uint32_t>& stringMap,
+		    std::unordered_map<const ASObject*, uint32_t>& objMap,
+		    std::unordered_map<const Class_base*, uint32_t>& traitsMap)
 {
 	if (out->getObjectEncoding() == ObjectEncoding::AMF0)
 	{
@@ -2715,6 +2768,7 @@ void XML::createTree(const pugi::xml_node& rootnode,bool fromXMLList)
 {
 	pugi::xml_node node = rootnode;
 	bool done = false;
+	pendingChildren = pugi::xml_node();
 	if (this->childrenlist.isNull() || this->childrenlist->nodes.size() > 0)
 	{
 		this->childrenlist = _MR(Class<XMLList>::getInstanceSNoArgs(getSystemState()));
@@ -2759,14 +2813,7 @@ void XML::createTree(const pugi::xml_node& rootnode,bool fromXMLList)
 				case pugi::node_element: // Element tag, i.e. '<node/>'
 				{
 					fillNode(this,node);
-					pugi::xml_node_iterator it=node.begin();
-					while(it!=node.end())
-					{
-						//LOG(LOG_INFO,"rootchildnode1:"<<it->name()<<" "<<it->value()<<" "<<it->type()<<" "<<parentNode.isNull());
-						_NR<XML> tmp = _MR<XML>(XML::createFromNode(*it,this));
-						this->childrenlist->append(_R<XML>(tmp));
-						it++;
-					}
+					createChildren(node,true);
 					done = true;
 					break;
 				}
@@ -2798,15 +2845,7 @@ void XML::createTree(const pugi::xml_node& rootnode,bool fromXMLList)
 			case pugi::node_element: // Element tag, i.e. '<node/>'
 			{
 				fillNode(this,node);
-				pugi::xml_node_iterator it=node.begin();
-				{
-					while(it!=node.end())
-					{
-						_NR<XML> tmp = _MR<XML>(XML::createFromNode(*it,this));
-						this->childrenlist->append(_R<XML>(tmp));
-						it++;
-					}
-				}
+				createChildren(node,true);
 				break;
 			}
 			default:
@@ -2814,6 +2853,45 @@ void XML::createTree(const pugi::xml_node& rootnode,bool fromXMLList)
 				break;
 		}
 	}
+	// the document is only kept alive by nodes that still have to create their children
+	if (!pendingChildren)
+		sharedDocument.reset();
+}
+
+void XML::createChildren(const pugi::xml_node& node, bool lazy)
+{
+	if (lazy && !sharedDocument.isNull() && node.first_child())
+	{
+		// the children will be created on first access
+		pendingChildren = node;
+		return;
+	}
+	// all children get their own reference to the document, so it is
+	// kept alive until the last pending node has been created
+	pugi::xml_node_iterator it=node.begin();
+	while(it!=node.end())
+	{
+		_NR<XML> tmp = _MR<XML>(XML::createFromNode(*it,this,false,sharedDocument));
+		this->childrenlist->append(_R<XML>(tmp));
+		it++;
+	}
+}
+
+void XML::createPendingChildren()
+{
+	pugi::xml_node node = pendingChildren;
+	pendingChildren = pugi::xml_node();
+	createChildren(node,false);
+	sharedDocument.reset();
+}
+
+void XML::materializeSubtree()
+{
+	materializeChildren();
+	if (childrenlist.isNull())
+		return;
+	for (uint32_t i = 0; i < childrenlist->nodes.size(); i++)
+		childrenlist->nodes[i]->materializeSubtree();
 }
 
 void XML::fillNode(XML* node, const pugi::xml_node &srcnode)
@@ -2826,11 +2904,14 @@ void XML::fillNode(XML* node, const pugi::xml_node &srcnode)
 	node->nodetype = srcnode.type();
 	node->nodename = srcnode.name();
 	node->nodevalue = srcnode.value();
+	// nodes created after parsing have to use the settings the document was parsed with
+	uint32_t defaultns = node->sharedDocument.isNull() ? getVm(node->getSystemState())->getDefaultXMLNamespaceID() : node->sharedDocument->defaultNamespace;
+	bool ignorews = node->sharedDocument.isNull() ? ignoreWhitespace : node->sharedDocument->ignoreWhitespace;
 	if (!node->parentNode.isNull() && node->parentNode->nodenamespace_prefix == BUILTIN_STRINGS::EMPTY)
 		node->nodenamespace_uri = node->parentNode->nodenamespace_uri;
 	else
-		node->nodenamespace_uri = getVm(node->getSystemState())->getDefaultXMLNamespaceID();
-	if (ignoreWhitespace && node->nodetype == pugi::node_pcdata)
+		node->nodenamespace_uri = defaultns;
+	if (ignorews && node->nodetype == pugi::node_pcdata)
 		node->nodevalue = node->removeWhitespace(node->nodevalue);
 	node->attributelist = _MR(Class<XMLList>::getInstanceSNoArgs(node->getSystemState()));
 	pugi::xml_attribute_iterator itattr;
@@ -2895,7 +2976,7 @@ void XML::fillNode(XML* node, const pugi::xml_node &srcnode)
 		tmp->nodetype = pugi::node_null;
 		tmp->isAttribute = true;
 		tmp->nodename = aname;
-		tmp->nodenamespace_uri = getVm(node->getSystemState())->getDefaultXMLNamespaceID();
+		tmp->nodenamespace_uri = defaultns;
 		pos = tmp->nodename.find(":");
 		if (pos != tiny_string::npos)
 		{
@@ -2985,6 +3066,7 @@ ASFUNCTIONBODY_ATOM(XML,_prependChild)
 }
 void XML::prependChild(_R<XML> newChild)
 {
+	materializeChildren();
 	if (newChild->constructed)
 	{
 		if (this == newChild.getPtr())
@@ -3005,6 +3087,7 @@ void XML::prependChild(_R<XML> newChild)
 ASFUNCTIONBODY_ATOM(XML,_replace)
 {
 	XML* th=asAtomHandler::as<XML>(obj);
+	th->materializeChildren();
 	_NR<ASObject> propertyName;
 	_NR<ASObject> value;
 	ARG_UNPACK_ATOM(propertyName) (value);
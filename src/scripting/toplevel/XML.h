@@ -45,8 +45,24 @@ private:
 	_NR<XMLList> procinstlist;
 	_NR<IFunction> notifierfunction;
 	NSVector namespacedefs;
+	// the parsed document this node was created from, if it is still needed
+	_NR<XMLSharedDocument> sharedDocument;
+	// element whose children have not been created yet
+	pugi::xml_node pendingChildren;
 
+	const pugi::xml_node buildFromString(const tiny_string& str,
+										unsigned int xmlparsemode,
+										const tiny_string& default_ns=tiny_string());
 	void createTree(const pugi::xml_node &rootnode, bool fromXMLList);
+	void createChildren(const pugi::xml_node& node, bool lazy);
+	// Create the XML objects for the children that are still only in the parsed document
+	void materializeChildren()
+	{
+		if (pendingChildren)
+			createPendingChildren();
+	}
+	void createPendingChildren();
+	void materializeSubtree();
 	static void fillNode(XML* node, const pugi::xml_node &srcnode);
 	tiny_string toString_priv();
 	const char* nodekindString();
@@ -149,11 +165,11 @@ public:
 	static bool getPrettyPrinting();
 	static unsigned int getParseMode();
 	static XML* createFromString(SystemState *sys, const tiny_string& s, bool usefirstchild=false);
-	static XML* createFromNode(const pugi::xml_node& _n, XML* parent=NULL, bool fromXMLList=false);
+	static XML* createFromNode(const pugi::xml_node& _n, XML* parent=NULL, bool fromXMLList=false, _NR<XMLSharedDocument> doc=NullRef);
 
 	const tiny_string getName() const { return nodename;}
 	uint32_t getNamespaceURI() const { return nodenamespace_uri;}
-	XMLList* getChildrenlist() { return childrenlist ? childrenlist.getPtr() : NULL; }
+	XMLList* getChildrenlist() { materializeChildren(); return childrenlist ? childrenlist.getPtr() : NULL; }
 	
 	
 	void getDescendantsByQName(const tiny_string& name, uint32_t ns, bool bIsAttribute, XMLVector& ret) const;
@@ -183,9 +199,9 @@ public:
 	void nextName(asAtom &ret, uint32_t index);
 	void nextValue(asAtom &ret, uint32_t index);
 	//Serialization interface
-	void serialize(ByteArray* out, std::map<tiny_string, uint32_t>& stringMap,
-				std::map<const ASObject*, uint32_t>& objMap,
-				std::map<const Class_base*, uint32_t>& traitsMap);
+	void serialize(ByteArray* out, std::unordered_map<tiny_string, uint32_t>& stringMap,
+				std::unordered_map<const ASObject*, uint32_t>& objMap,
+				std::unordered_map<const Class_base*, uint32_t>& traitsMap);
 };
 }
 #endif /* SCRIPTING_TOPLEVEL_XML_H */
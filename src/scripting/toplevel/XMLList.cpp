@@ -216,9 +216,12 @@ ASFUNCTIONBODY_ATOM(XMLList,_constructor)
 
 void XMLList::buildFromString(const tiny_string &str)
 {
-	pugi::xml_document xmldoc;
+	unsigned int parsemode = XML::getParseMode();
+	// the document is shared with the parsed nodes, which create their children from it on demand
+	_R<XMLSharedDocument> shareddoc = _MR(new XMLSharedDocument(getVm(getSystemState())->getDefaultXMLNamespaceID(),(parsemode & pugi::parse_ws_pcdata) == 0));
+	pugi::xml_document& xmldoc = shareddoc->doc;
 
-	pugi::xml_parse_result res = xmldoc.load_buffer((void*)str.raw_buf(),str.numBytes(),XML::getParseMode());
+	pugi::xml_parse_result res = xmldoc.load_buffer((void*)str.raw_buf(),str.numBytes(),parsemode);
 	switch (res.status)
 	{
 		case pugi::status_ok:
@@ -252,7 +255,7 @@ void XMLList::buildFromString(const tiny_string &str)
 	pugi::xml_node_iterator it=xmldoc.begin();
 	for(;it!=xmldoc.end();++it)
 	{
-		_R<XML> tmp = _MR(XML::createFromNode(*it,(XML*)NULL,true));
+		_R<XML> tmp = _MR(XML::createFromNode(*it,(XML*)NULL,true,shareddoc));
 		if (tmp->constructed)
 			nodes.push_back(tmp);
 	}
@@ -722,6 +725,7 @@ void XMLList::getTargetVariables(const multiname& name,XML::XMLVector& retnodes)
 			{
 				retnodes.push_back(child);
 			}
+			child->materializeChildren();
 			if (child->childrenlist)
 				child->childrenlist->getTargetVariables(name,retnodes);
 		}
@@ -1045,6 +1049,7 @@ void XMLList::replace(unsigned int idx, ASObject *o, const XML::XMLVector &retno
 {
 	if (idx >= nodes.size())
 		return;
+	nodes[idx]->materializeChildren();
 
 	if (nodes[idx]->isAttribute)
 	{
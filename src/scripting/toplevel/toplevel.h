@@ -191,6 +191,11 @@ public:
 	
 	// indicates if objects can be reused after they have lost their last reference
 	bool isReusable:1;
+	// indicates if serializedTraits has been collected
+	bool serializedTraitsBuilt:1;
+	// public declared traits written by AMF serialization, as pairs of name id
+	// and slot id (0 if the trait has no slot), see ASObject::serialize
+	std::vector<std::pair<uint32_t,uint32_t>> serializedTraits;
 private:
 	//TODO: move in Class_inherit
 	bool use_protected:1;
@@ -425,6 +430,8 @@ public:
 		prototype.reset();
 		return destructIntern();
 	}
+	void traceReferences(std::vector<ASObject*>& refs);
+	void clearReferences();
 	IFunction* bind(_NR<ASObject> c)
 	{
 		IFunction* ret=NULL;
@@ -757,9 +764,9 @@ public:
 	TRISTATE isLessAtom(asAtom& r);
 	ASObject *describeType() const;
 	//Serialization interface
-	void serialize(ByteArray* out, std::map<tiny_string, uint32_t>& stringMap,
-				std::map<const ASObject*, uint32_t>& objMap,
-				std::map<const Class_base*, uint32_t>& traitsMap);
+	void serialize(ByteArray* out, std::unordered_map<tiny_string, uint32_t>& stringMap,
+				std::unordered_map<const ASObject*, uint32_t>& objMap,
+				std::unordered_map<const Class_base*, uint32_t>& traitsMap);
 	multiname* setVariableByMultiname(const multiname& name, asAtom &o, CONST_ALLOWED_FLAG allowConst, bool *alreadyset=nullptr);
 };
 
@@ -777,9 +784,9 @@ public:
 	multiname* setVariableByMultiname(const multiname& name, asAtom &o, CONST_ALLOWED_FLAG allowConst, bool *alreadyset=nullptr);
 
 	//Serialization interface
-	void serialize(ByteArray* out, std::map<tiny_string, uint32_t>& stringMap,
-				std::map<const ASObject*, uint32_t>& objMap,
-				std::map<const Class_base*, uint32_t>& traitsMap);
+	void serialize(ByteArray* out, std::unordered_map<tiny_string, uint32_t>& stringMap,
+				std::unordered_map<const ASObject*, uint32_t>& objMap,
+				std::unordered_map<const Class_base*, uint32_t>& traitsMap);
 };
 
 class ASQName: public ASObject
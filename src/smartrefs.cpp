@@ -0,0 +1,173 @@
+/**************************************************************************
+    Lightspark, a free flash player implementation
+
+    Copyright (C) 2009-2013  Alessandro Pignotti (a.pignotti@sssup.it)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Lesser General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+**************************************************************************/
+
+#include <algorithm>
+#include <typeinfo>
+#include <unordered_set>
+#include <vector>
+#include "smartrefs.h"
+#include "threading.h"
+#include "logger.h"
+
+using namespace std;
+using namespace lightspark;
+
+namespace
+{
+//Objects whose references have been released by other threads than their owner
+struct ownerQueue
+{
+	const void* token;
+	unordered_set<RefCountable*> objects;
+};
+StaticMutex foreignReleaseMutex;
+//Protected by foreignReleaseMutex
+vector<ownerQueue*> ownerQueues;
+thread_local ownerQueue* currentOwnerQueue=NULL;
+
+ownerQueue* findOwnerQueue(const void* token)
+{
+	for(auto it=ownerQueues.begin();it!=ownerQueues.end();++it)
+	{
+		if((*it)->token==token)
+			return *it;
+	}
+	return NULL;
+}
+}
+
+const void* RefCountable::getOwnerToken()
+{
+	return currentOwnerQueue ? compat_thread_token() : NULL;
+}
+
+void RefCountable::registerOwnerThread()
+{
+	if(currentOwnerQueue)
+		return;
+	ownerQueue* q=new ownerQueue();
+	q->token=compat_thread_token();
+	Locker l(foreignReleaseMutex);
+	ownerQueues.push_back(q);
+	currentOwnerQueue=q;
+}
+
+void RefCountable::unregisterOwnerThread()
+{
+	ownerQueue* q=currentOwnerQueue;
+	if(q==NULL)
+		return;
+	while(true)
+	{
+		processForeignReleases();
+		Locker l(foreignReleaseMutex);
+		//Releases may have been queued while processing
+		if(!q->objects.empty())
+			continue;
+		ownerQueues.erase(find(ownerQueues.begin(),ownerQueues.end(),q));
+		break;
+	}
+	//From now on other threads decide about the destruction of the objects left
+	currentOwnerQueue=NULL;
+	delete q;
+}
+
+void RefCountable::processForeignReleases()
+{
+	ownerQueue* q=currentOwnerQueue;
+	if(q==NULL)
+		return;
+	while(true)
+	{
+		RefCountable* o;
+		{
+			Locker l(foreignReleaseMutex);
+			if(q->objects.empty())
+				return;
+			auto it=q->objects.begin();
+			o=*it;
+			q->objects.erase(it);
+			RELEASE_WRITE(o->foreignQueued,false);
+		}
+		//Only the owner destroys its objects, so o is still valid here.
+		//The foreign releases are already subtracted, so like in decRef the
+		//object goes away when its count drops below the activation count
+		if(o->isConstant || o->cached)
+			continue;
+		if(o->getRefCount()<o->activation_refcount)
+			o->handleDestruction();
+		else if(o->cycleTraceable && !o->cycleBuffered)
+			o->addCycleCandidate();
+	}
+}
+
+bool RefCountable::decRefForeign()
+{
+#ifdef REFCOUNT_DEBUG
+	checkForeignAccess();
+#endif
+	if(owner)
+	{
+		Locker l(foreignReleaseMutex);
+		ownerQueue* q=findOwnerQueue(owner);
+		if(q)
+		{
+			//The owner takes the mutex to dequeue the object before destroying it,
+			//so the object stays valid until the lock is released
+			bool ret=cached;
+			if(!ACQUIRE_READ(foreignQueued))
+			{
+				RELEASE_WRITE(foreignQueued,true);
+				q->objects.insert(this);
+			}
+			shared_ref_count.fetch_sub(1,std::memory_order_acq_rel);
+			return ret;
+		}
+	}
+	//The object has no owner or its owner has terminated
+	int32_t previous=shared_ref_count.fetch_sub(1,std::memory_order_acq_rel);
+	if(previous+ref_count==activation_refcount)
+		return handleDestruction();
+#ifdef REFCOUNT_DEBUG
+	if(previous+ref_count<activation_refcount)
+		LOG(LOG_ERROR,"reference count of " << typeid(*this).name() << " released more often than taken");
+#endif
+	//Cycle candidates are only buffered by the owner thread
+	return cached;
+}
+
+void RefCountable::removeForeignRelease()
+{
+	Locker l(foreignReleaseMutex);
+	ownerQueue* q=findOwnerQueue(owner);
+	if(q)
+		q->objects.erase(this);
+	RELEASE_WRITE(foreignQueued,false);
+}
+
+#ifdef REFCOUNT_DEBUG
+void RefCountable::checkForeignAccess()
+{
+	if(owner && !isShared && !foreignAccessReported)
+	{
+		foreignAccessReported=true;
+		LOG(LOG_ERROR,"reference count of " << typeid(*this).name() << " changed by a thread that does not own it, use setShared() if this is intended");
+	}
+}
+#endif
@@ -26,46 +26,124 @@
 namespace lightspark
 {
 
+/*
+ * Reference counts are biased towards the thread that created an object, if that thread
+ * registered itself with registerOwnerThread() (the VM threads do). The owner changes
+ * ref_count without atomic operations, all other threads use the atomic shared_ref_count,
+ * which may become negative if they release references taken by the owner.
+ * References released by other threads are queued for the owner, which checks the objects
+ * for destruction in processForeignReleases(). Objects created by threads that are not
+ * registered have no owner and are always counted atomically.
+ * When built with REFCOUNT_DEBUG, changes from other threads to objects not marked
+ * with setShared() and releases of references that were never taken are reported.
+ */
 class RefCountable {
 private:
-	ATOMIC_INT32(ref_count);
+	//References held by the owner thread
+	int32_t ref_count;
+	//References held by all other threads
+	ATOMIC_INT32(shared_ref_count);
 	int32_t activation_refcount;
+	//Slot in the candidate buffer of the cycle collector while cycleBuffered is set
+	uint32_t cycleIndex;
+	//The thread the object is biased to, NULL if all threads use shared_ref_count
+	const void* owner;
+	//Set while the object is queued for its owner after a release by another thread
+	ACQUIRE_RELEASE_FLAG(foreignQueued);
 	bool isConstant:1;
 	bool inDestruction:1;
 	bool cached:1;
+	// set for objects the cycle collector can inspect, see scripting/cyclecollector.h
+	bool cycleTraceable:1;
+	// set while the object is buffered as a possible cycle root
+	bool cycleBuffered:1;
+#ifdef REFCOUNT_DEBUG
+	bool isShared:1;
+	bool foreignAccessReported:1;
+	void checkForeignAccess();
+#endif
+	void addCycleCandidate();
+	static const void* getOwnerToken();
+	bool decRefForeign();
+	void removeForeignRelease();
+	inline void resetRefCount()
+	{
+		ref_count=owner ? 1 : 0;
+		shared_ref_count=owner ? 0 : 1;
+	}
 protected:
-	RefCountable() : ref_count(1),activation_refcount(1),isConstant(false),inDestruction(false),cached(false) {}
+	RefCountable() : ref_count(0),shared_ref_count(0),activation_refcount(1),cycleIndex(0),owner(getOwnerToken()),foreignQueued(false),
+		isConstant(false),inDestruction(false),cached(false),cycleTraceable(false),cycleBuffered(false)
+#ifdef REFCOUNT_DEBUG
+		,isShared(false),foreignAccessReported(false)
+#endif
+	{
+		resetRefCount();
+	}
+	void removeCycleCandidate();
 
 public:
 	virtual ~RefCountable() {}
 
-	int getRefCount() const { return ref_count; }
-	inline bool isLastRef() const { return !isConstant && ref_count == activation_refcount; }
+	/* Makes the calling thread the owner of the objects it creates from now on.
+	 * The thread has to call processForeignReleases() regularly and unregisterOwnerThread()
+	 * before it terminates */
+	static void registerOwnerThread();
+	static void unregisterOwnerThread();
+	//Destroys the objects of the calling thread whose last reference was released by another thread
+	static void processForeignReleases();
+
+	int getRefCount() const { return ref_count+shared_ref_count.load(std::memory_order_acquire); }
+	inline bool isLastRef() const { return !isConstant && getRefCount() == activation_refcount; }
 	inline void setConstant()
 	{
 		isConstant=true;
 	}
+	//Marks the object as used by multiple threads, this is only checked by REFCOUNT_DEBUG builds
+	inline void setShared()
+	{
+#ifdef REFCOUNT_DEBUG
+		isShared=true;
+#endif
+	}
 	inline bool getConstant() const { return isConstant; }
 	inline bool getInDestruction() const { return inDestruction; }
 	inline bool getCached() const { return cached; }
 	inline void setCached() { cached=true; }
 	inline void resetCached() { cached=false; }
+	inline bool getCycleBuffered() const { return cycleBuffered; }
+	inline void setCycleBuffered(bool b) { cycleBuffered=b; }
+	inline uint32_t getCycleIndex() const { return cycleIndex; }
+	inline void setCycleIndex(uint32_t i) { cycleIndex=i; }
+	inline bool getCycleTraceable() const { return cycleTraceable; }
+	inline void setCycleTraceable(bool t) { cycleTraceable=t; }
 	inline void incActivationCount() { activation_refcount++; }
 	inline void decActivationCount() { activation_refcount--; }
 	inline void setActivationCount(int32_t c) { activation_refcount=c; }
 	inline int32_t getActivationCount() const { return activation_refcount; }
 	inline void incRef()
 	{
-		if (!isConstant)
+		if (isConstant)
+			return;
+		if (owner == compat_thread_token())
 			++ref_count;
+		else
+		{
+#ifdef REFCOUNT_DEBUG
+			checkForeignAccess();
+#endif
+			shared_ref_count.fetch_add(1,std::memory_order_relaxed);
+		}
 	}
 	bool handleDestruction()
 	{
 		if (inDestruction)
 			return true;
+		if (ACQUIRE_READ(foreignQueued))
+			removeForeignRelease();
 		inDestruction = true;
 		activation_refcount=1;
-		ref_count=1;
+		resetRefCount();
 		if (destruct())
 		{
 			//Let's make refcount very invalid
@@ -81,11 +159,18 @@ public:
 	{
 		if (!isConstant && !cached)
 		{
-			assert(ref_count>0);
-			if (ref_count == activation_refcount)
+			if (owner != compat_thread_token())
+				return decRefForeign();
+			assert(getRefCount()>0);
+			if (ref_count+shared_ref_count.load(std::memory_order_acquire) == activation_refcount)
 				return handleDestruction();
 			else
+			{
 				--ref_count;
+				//The object survived, it may be kept alive only by a cycle
+				if (cycleTraceable && !cycleBuffered)
+					addCycleCandidate();
+			}
 		}
 		return cached;
 	}
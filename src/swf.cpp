@@ -27,12 +27,15 @@
 #include "scripting/toplevel/ASString.h"
 #include "scripting/toplevel/Vector.h"
 #include "scripting/avm1/avm1display.h"
+#include "scripting/cyclecollector.h"
 #include "logger.h"
 #include "parsing/streams.h"
 #include "asobject.h"
 #include "scripting/class.h"
 #include "backends/audio.h"
 #include "backends/config.h"
+#include "backends/streamcache.h"
+#include "backends/socketreactor.h"
 #include "backends/rendering.h"
 #include "backends/image.h"
 #include "backends/extscriptobject.h"
@@ -51,6 +54,10 @@ extern "C" {
 }
 #endif
 
+// Amount of lazily decoded tag data (bitmaps, shape tokens) a movie keeps
+// resident before unused tags are purged again
+#define DECODED_TAGS_BUDGET (64*1024*1024)
+
 using namespace std;
 using namespace lightspark;
 
@@ -87,7 +94,7 @@ ASWorker* lightspark::getWorker()
 
 RootMovieClip::RootMovieClip(_NR<LoaderInfo> li, _NR<ApplicationDomain> appDomain, _NR<SecurityDomain> secDomain, Class_base* c):
 	MovieClip(c),
-	parsingIsFailed(false),Background(0xFF,0xFF,0xFF),frameRate(0),
+	parsingIsFailed(false),Background(0xFF,0xFF,0xFF),decodedTagsSize(0),frameRate(0),
 	finishedLoading(false),applicationDomain(appDomain),securityDomain(secDomain)
 {
 	subtype=SUBTYPE_ROOTMOVIECLIP;
@@ -207,7 +214,7 @@ SystemState::SystemState(uint32_t fileSize, FLASH_MODE mode):
 	invalidateQueueHead(NullRef),invalidateQueueTail(NullRef),lastUsedStringId(0),lastUsedNamespaceId(0x7fffffff),
 	showProfilingData(false),flashMode(mode),swffilesize(fileSize),
 	currentVm(NULL),builtinClasses(NULL),useInterpreter(true),useFastInterpreter(false),useJit(false),exitOnError(ERROR_NONE),singleworker(true),
-	downloadManager(NULL),extScriptObject(NULL),scaleMode(SHOW_ALL),unaccountedMemory(NULL),tagsMemory(NULL),stringMemory(NULL),textTokenMemory(NULL),shapeTokenMemory(NULL),morphShapeTokenMemory(NULL),bitmapTokenMemory(NULL),spriteTokenMemory(NULL),
+	downloadManager(NULL),cycleCollector(NULL),extScriptObject(NULL),scaleMode(SHOW_ALL),unaccountedMemory(NULL),tagsMemory(NULL),stringMemory(NULL),textTokenMemory(NULL),shapeTokenMemory(NULL),morphShapeTokenMemory(NULL),bitmapTokenMemory(NULL),spriteTokenMemory(NULL),
 	static_SoundMixer_bufferTime(0),isinitialized(false)
 {
 	//Forge the builtin strings
@@ -288,6 +295,9 @@ SystemState::SystemState(uint32_t fileSize, FLASH_MODE mode):
 	audioManager=NULL;
 	intervalManager=new IntervalManager();
 	securityManager=new SecurityManager();
+	streamCacheBudget=new StreamCacheBudget((size_t)Config::getConfig()->getStreamCacheMemorySize()<<20);
+	socketReactor=NULL;
+	cycleCollector=new CycleCollector(this);
 
 	_NR<LoaderInfo> loaderInfo=_MR(Class<LoaderInfo>::getInstanceS(this));
 	loaderInfo->applicationDomain = applicationDomain;
@@ -489,10 +499,16 @@ void SystemState::stopEngines()
 	downloadManager=NULL;
 	delete securityManager;
 	securityManager=NULL;
+	if(streamCacheBudget)
+		streamCacheBudget->decRef();
+	streamCacheBudget=NULL;
 	delete threadPool;
 	threadPool=NULL;
 	delete downloadThreadPool;
 	downloadThreadPool=NULL;
+	//Sockets are handed to the reactor by thread pool jobs, stop it afterwards
+	delete socketReactor;
+	socketReactor=NULL;
 	//Now stop the managers
 	delete audioManager;
 	audioManager=NULL;
@@ -688,6 +704,9 @@ void SystemState::destroy()
 
 	for(auto it=profilingData.begin();it!=profilingData.end();it++)
 		delete *it;
+
+	delete cycleCollector;
+	cycleCollector=NULL;
 }
 
 bool SystemState::isOnError() const
@@ -1092,6 +1111,14 @@ void SystemState::addDownloadJob(IThreadJob* j)
 	downloadThreadPool->addJob(j);
 }
 
+SocketReactor* SystemState::getSocketReactor()
+{
+	Locker l(socketReactorMutex);
+	if(socketReactor==NULL)
+		socketReactor=new SocketReactor();
+	return socketReactor;
+}
+
 void SystemState::addTick(uint32_t tickTime, ITickJob* job)
 {
 	timerThread->addTick(tickTime,job);
@@ -1797,6 +1824,58 @@ DictionaryTag* RootMovieClip::dictionaryLookup(int id)
 	}
 	return *it;
 }
+/* called in vm's and render thread's context */
+void RootMovieClip::registerDecodedTag(DictionaryTag* tag, uint32_t size)
+{
+	Locker l(decodedTagsMutex);
+	decodedTags.push_back(tag);
+	decodedTagsSize+=size;
+	auto it=decodedTags.begin();
+	while(decodedTagsSize>DECODED_TAGS_BUDGET && it!=decodedTags.end())
+	{
+		if(*it==tag)
+		{
+			++it;
+			continue;
+		}
+		uint32_t released=(*it)->purgeDecodedData();
+		if(released==0)
+		{
+			//Still in use, try the next one
+			++it;
+			continue;
+		}
+		decodedTagsSize-=min<uint64_t>(released,decodedTagsSize);
+		it=decodedTags.erase(it);
+	}
+}
+
+uint64_t RootMovieClip::purgeDecodedTags()
+{
+	Locker l(decodedTagsMutex);
+	uint64_t ret=0;
+	auto it=decodedTags.begin();
+	while(it!=decodedTags.end())
+	{
+		uint32_t released=(*it)->purgeDecodedData();
+		if(released==0)
+			++it;
+		else
+		{
+			ret+=released;
+			it=decodedTags.erase(it);
+		}
+	}
+	decodedTagsSize-=min(ret,decodedTagsSize);
+	return ret;
+}
+
+uint64_t RootMovieClip::getDecodedTagsSize()
+{
+	Locker l(decodedTagsMutex);
+	return decodedTagsSize;
+}
+
 DictionaryTag* RootMovieClip::dictionaryLookupByName(uint32_t nameID)
 {
 	SpinlockLocker l(dictSpinlock);
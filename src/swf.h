@@ -54,6 +54,9 @@ class ParseThread;
 class PluginManager;
 class RenderThread;
 class SecurityManager;
+class StreamCacheBudget;
+class SocketReactor;
+class CycleCollector;
 class Tag;
 class ApplicationDomain;
 class ASWorker;
@@ -76,6 +79,14 @@ private:
 	std::list< std::pair<tiny_string, DictionaryTag*> > classesToBeBound;
 	std::map < tiny_string,FontTag* > embeddedfonts;
 	std::map < uint32_t,FontTag* > embeddedfontsByID;
+	/*
+	 * Dictionary tags holding lazily decoded data, in decoding order.
+	 * When decodedTagsSize grows over DECODED_TAGS_BUDGET the oldest
+	 * tags which are not in use are purged.
+	 */
+	Mutex decodedTagsMutex;
+	std::list < DictionaryTag* > decodedTags;
+	uint64_t decodedTagsSize;
 
 	//frameSize and frameRate are valid only after the header has been parsed
 	RECT frameSize;
@@ -105,6 +116,11 @@ public:
 	void addToDictionary(DictionaryTag* r);
 	DictionaryTag* dictionaryLookup(int id);
 	DictionaryTag* dictionaryLookupByName(uint32_t nameID);
+	void registerDecodedTag(DictionaryTag* tag, uint32_t size);
+	/* Drop the decoded data of all dictionary tags which are not in use.
+	 * Returns the number of bytes released */
+	uint64_t purgeDecodedTags();
+	uint64_t getDecodedTagsSize();
 	void labelCurrentFrame(const STRING& name);
 	void commitFrame(bool another);
 	void revertFrame();
@@ -277,6 +293,8 @@ private:
 	
 	Mutex mainsignalMutex;
 	Cond mainsignalCond;
+	Mutex socketReactorMutex;
+	SocketReactor* socketReactor;
 	void systemFinalize();
 public:
 	void setURL(const tiny_string& url) DLL_PUBLIC;
@@ -394,6 +412,8 @@ public:
 
 	//Interfaces to the internal thread pool and timer thread
 	void addJob(IThreadJob* j) DLL_PUBLIC;
+	//Services the connections of Socket and XMLSocket, created on first use
+	SocketReactor* getSocketReactor();
 	// downloaders may be executed from inside a job from the main threadpool,
 	// so we use a second threadpool for them, to avoid deadlocks
 	void addDownloadJob(IThreadJob* j) DLL_PUBLIC;
@@ -424,6 +444,9 @@ public:
 	DownloadManager* downloadManager;
 	IntervalManager* intervalManager;
 	SecurityManager* securityManager;
+	//Memory limit shared by the MemoryStreamCaches, they hold a reference to it
+	StreamCacheBudget* streamCacheBudget;
+	CycleCollector* cycleCollector;
 	ExtScriptObject* extScriptObject;
 
 	enum SCALE_MODE { EXACT_FIT=0, NO_BORDER=1, NO_SCALE=2, SHOW_ALL=3 };
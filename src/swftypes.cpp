@@ -870,32 +870,9 @@ std::istream& lightspark::operator>>(std::istream& s, FILLSTYLE& v)
 	{
 		UI16_SWF bitmapId;
 		s >> bitmapId >> v.Matrix;
-		//Lookup the bitmap in the dictionary
-		if(bitmapId!=65535)
-		{
-			try
-			{
-				const DictionaryTag* dict=getParseThread()->getRootMovie()->dictionaryLookup(bitmapId);
-				const BitmapTag* b = dynamic_cast<const BitmapTag*>(dict);
-				if(!b)
-				{
-					LOG(LOG_ERROR,"Invalid bitmap ID " << bitmapId);
-					throw ParseException("Invalid ID for bitmap");
-				}
-				v.bitmap = b->getBitmap();
-			}
-			catch(RunTimeException& e)
-			{
-				//Thrown if the bitmapId does not exists in dictionary
-				LOG(LOG_ERROR,"Exception in FillStyle parsing: " << e.what());
-				v.bitmap.reset();
-			}
-		}
-		else
-		{
-			//The bitmap might be invalid, the style should not be used
-			v.bitmap.reset();
-		}
+		//The bitmap is resolved from the dictionary by DefineShapeTag::instance
+		v.bitmapId=bitmapId;
+		v.bitmap.reset();
 	}
 	else
 	{
@@ -1671,12 +1648,12 @@ QName::operator multiname() const
 	return ret;
 }
 
-FILLSTYLE::FILLSTYLE(uint8_t v):Gradient(v),version(v)
+FILLSTYLE::FILLSTYLE(uint8_t v):Gradient(v),bitmapId(65535),version(v)
 {
 }
 
 FILLSTYLE::FILLSTYLE(const FILLSTYLE& r):Matrix(r.Matrix),Gradient(r.Gradient),FocalGradient(r.FocalGradient),
-	bitmap(r.bitmap),Color(r.Color),FillStyleType(r.FillStyleType),version(r.version)
+	bitmap(r.bitmap),bitmapId(r.bitmapId),Color(r.Color),FillStyleType(r.FillStyleType),version(r.version)
 {
 }
 
@@ -1690,6 +1667,7 @@ FILLSTYLE& FILLSTYLE::operator=(FILLSTYLE r)
 	Gradient = r.Gradient;
 	FocalGradient = r.FocalGradient;
 	bitmap = r.bitmap;
+	bitmapId = r.bitmapId;
 	Color = r.Color;
 	FillStyleType = r.FillStyleType;
 	version = r.version;
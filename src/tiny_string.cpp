@@ -70,6 +70,29 @@ tiny_string::tiny_string(const tiny_string& r):
 	memcpy(buf,r.buf,stringSize);
 }
 
+tiny_string::tiny_string(tiny_string&& r):
+	_buf_static(),buf(_buf_static),stringSize(r.stringSize),numchars(r.numchars),type(STATIC),isASCII(r.isASCII),hasNull(r.hasNull)
+{
+	if(r.type==READONLY)
+	{
+		type=READONLY;
+		buf=r.buf;
+		return;
+	}
+	if(r.type==DYNAMIC)
+	{
+		//Take over the buffer of the temporary
+		type=DYNAMIC;
+		buf=r.buf;
+		capacity=r.capacity;
+		r.type=STATIC;
+		r.buf=r._buf_static;
+		r.clear();
+		return;
+	}
+	memcpy(buf,r.buf,stringSize);
+}
+
 tiny_string::tiny_string(const std::string& r):_buf_static(),buf(_buf_static),stringSize(r.size()+1),type(STATIC)
 {
 	if(stringSize > STATIC_SIZE)
@@ -105,6 +128,24 @@ tiny_string& tiny_string::operator=(const tiny_string& s)
 	return *this;
 }
 
+tiny_string& tiny_string::operator=(tiny_string&& s)
+{
+	if(s.type!=DYNAMIC || this==&s)
+		return *this=(const tiny_string&)s;
+	resetToStatic();
+	type=DYNAMIC;
+	buf=s.buf;
+	stringSize=s.stringSize;
+	capacity=s.capacity;
+	isASCII=s.isASCII;
+	hasNull=s.hasNull;
+	numchars=s.numchars;
+	s.type=STATIC;
+	s.buf=s._buf_static;
+	s.clear();
+	return *this;
+}
+
 tiny_string& tiny_string::operator=(const std::string& s)
 {
 	resetToStatic();
@@ -338,31 +379,67 @@ bool tiny_string::endsWith(const char* o) const
  * returns index of character */
 uint32_t tiny_string::find(const tiny_string& needle, uint32_t start) const
 {
-	//TODO: omit copy into std::string
-	size_t bytestart = g_utf8_offset_to_pointer(buf,start) - buf;
-	size_t bytepos = std::string(*this).find(needle.raw_buf(),bytestart,needle.numBytes());
-	if(bytepos == std::string::npos)
-		return npos;
+	size_t bytestart = isASCII ? start : g_utf8_offset_to_pointer(buf,start) - buf;
+	uint32_t bytepos = findBytes(needle,bytestart);
+	if(bytepos == npos || isASCII)
+		return bytepos;
 	else
 		return g_utf8_pointer_to_offset(buf,buf+bytepos);
 }
 
 uint32_t tiny_string::rfind(const tiny_string& needle, uint32_t start) const
 {
-	//TODO: omit copy into std::string
-	size_t bytestart;
-	if(start == npos)
-		bytestart = std::string::npos;
+	uint32_t bytestart;
+	if(start == npos || isASCII)
+		bytestart = start;
 	else
 		bytestart = g_utf8_offset_to_pointer(buf,start) - buf;
 
-	size_t bytepos = std::string(*this).rfind(needle.raw_buf(),bytestart,needle.numBytes());
-	if(bytepos == std::string::npos)
-		return npos;
+	uint32_t bytepos = rfindBytes(needle,bytestart);
+	if(bytepos == npos || isASCII)
+		return bytepos;
 	else
 		return g_utf8_pointer_to_offset(buf,buf+bytepos);
 }
 
+uint32_t tiny_string::findBytes(const tiny_string& needle, uint32_t bytestart) const
+{
+	uint32_t len = numBytes();
+	uint32_t n = needle.numBytes();
+	if(bytestart > len || n > len-bytestart)
+		return npos;
+	if(n == 0)
+		return bytestart;
+	const char* p = buf+bytestart;
+	const char* last = buf+len-n;
+	while(p <= last)
+	{
+		p = (const char*)memchr(p,needle.buf[0],last-p+1);
+		if(p == NULL)
+			break;
+		if(memcmp(p,needle.buf,n) == 0)
+			return p-buf;
+		p++;
+	}
+	return npos;
+}
+
+uint32_t tiny_string::rfindBytes(const tiny_string& needle, uint32_t bytestart) const
+{
+	uint32_t len = numBytes();
+	uint32_t n = needle.numBytes();
+	if(n > len)
+		return npos;
+	uint32_t pos = std::min(bytestart,len-n);
+	while(memcmp(buf+pos,needle.buf,n) != 0)
+	{
+		if(pos == 0)
+			return npos;
+		pos--;
+	}
+	return pos;
+}
+
 void tiny_string::makePrivateCopy(const char* s)
 {
 	resetToStatic();
@@ -377,24 +454,57 @@ void tiny_string::createBuffer(uint32_t s)
 	type=DYNAMIC;
 	reportMemoryChange(s);
 	buf=new char[s];
+	capacity=s;
 }
 
 void tiny_string::resizeBuffer(uint32_t s)
 {
 	assert(type==DYNAMIC);
-	char* oldBuf=buf;
-	reportMemoryChange(s-stringSize);
-	buf=new char[s];
 	assert(s >= stringSize);
+	if(s <= capacity)
+		return;
+	//Grow geometrically, so that appending repeatedly to the same string
+	//takes amortized linear time
+	uint32_t newCapacity=std::max(s,capacity*2);
+	char* oldBuf=buf;
+	reportMemoryChange(newCapacity-capacity);
+	buf=new char[newCapacity];
 	memcpy(buf,oldBuf,stringSize);
 	delete[] oldBuf;
+	capacity=newCapacity;
+}
+
+void tiny_string::reserve(uint32_t bytes)
+{
+	if(type==READONLY)
+	{
+		char* tmp=buf;
+		makePrivateCopy(tmp);
+	}
+	if(bytes+1 <= STATIC_SIZE || (type==DYNAMIC && bytes+1 <= capacity))
+		return;
+	if(type==STATIC)
+	{
+		createBuffer(bytes+1);
+		memcpy(buf,_buf_static,stringSize);
+	}
+	else
+	{
+		//Reserve exactly what was asked for
+		char* oldBuf=buf;
+		reportMemoryChange(bytes+1-capacity);
+		buf=new char[bytes+1];
+		memcpy(buf,oldBuf,stringSize);
+		delete[] oldBuf;
+		capacity=bytes+1;
+	}
 }
 
 void tiny_string::resetToStatic()
 {
 	if(type==DYNAMIC)
 	{
-		reportMemoryChange(-stringSize);
+		reportMemoryChange(-capacity);
 		delete[] buf;
 	}
 	stringSize=1;
@@ -1165,7 +1275,7 @@ tiny_string tiny_string::uppercase() const
 
 /* like strcasecmp(s1.raw_buf(),s2.raw_buf()) but for unicode
  * TODO: slow! */
-int tiny_string::strcasecmp(tiny_string& s2) const
+int tiny_string::strcasecmp(const tiny_string& s2) const
 {
 	char* str1 = g_utf8_casefold(this->raw_buf(),this->numBytes());
 	char* str2 = g_utf8_casefold(s2.raw_buf(),s2.numBytes());
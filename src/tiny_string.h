@@ -22,6 +22,7 @@
 
 #include <cstring>
 #include <cstdint>
+#include <functional>
 #include <ostream>
 #include <list>
 /* for utf8 handling */
@@ -99,6 +100,10 @@ private:
 	   stringSize includes the trailing \0
 	*/
 	uint32_t stringSize;
+	/*
+	   size of the allocated buffer, only meaningful for DYNAMIC strings
+	*/
+	uint32_t capacity;
 	uint32_t numchars;
 	TYPE type;
 #ifdef MEMORY_USAGE_PROFILING
@@ -119,16 +124,18 @@ private:
 public:
 	static const uint32_t npos = (uint32_t)(-1);
 
-	tiny_string():_buf_static(),buf(_buf_static),stringSize(1),numchars(0),type(STATIC),isASCII(true),hasNull(false){buf[0]=0;}
+	tiny_string():_buf_static(),buf(_buf_static),stringSize(1),capacity(0),numchars(0),type(STATIC),isASCII(true),hasNull(false){buf[0]=0;}
 	/* construct from utf character */
 	static tiny_string fromChar(uint32_t c);
 	tiny_string(const char* s,bool copy=false);
 	tiny_string(const tiny_string& r);
+	tiny_string(tiny_string&& r);
 	tiny_string(const std::string& r);
 	tiny_string(const Glib::ustring& r);
 	tiny_string(std::istream& in, int len);
 	~tiny_string();
 	tiny_string& operator=(const tiny_string& s);
+	tiny_string& operator=(tiny_string&& s);
 	tiny_string& operator=(const std::string& s);
 	tiny_string& operator=(const char* s);
 	tiny_string& operator=(const Glib::ustring& s);
@@ -160,6 +167,8 @@ public:
 	{
 		return stringSize == 1;
 	}
+	/* makes room for at least the given number of bytes without reallocating */
+	void reserve(uint32_t bytes);
 	inline void clear()
 	{
 		resetToStatic();
@@ -207,12 +216,15 @@ public:
 	 * returns index of character */
 	uint32_t find(const tiny_string& needle, uint32_t start = 0) const;
 	uint32_t rfind(const tiny_string& needle, uint32_t start = npos) const;
+	/* like find/rfind, but start and the result are byte positions */
+	uint32_t findBytes(const tiny_string& needle, uint32_t bytestart = 0) const;
+	uint32_t rfindBytes(const tiny_string& needle, uint32_t bytestart = npos) const;
 	tiny_string& replace(uint32_t pos1, uint32_t n1, const tiny_string& o);
 	tiny_string& replace_bytes(uint32_t bytestart, uint32_t bytenum, const tiny_string& o);
 	tiny_string lowercase() const;
 	tiny_string uppercase() const;
 	/* like strcasecmp(s1.raw_buf(),s2.raw_buf()) but for unicode */
-	int strcasecmp(tiny_string& s2) const;
+	int strcasecmp(const tiny_string& s2) const;
 	/* split string at each occurrence of delimiter character */
 	std::list<tiny_string> split(uint32_t delimiter) const;
 	/* Convert from byte offset to UTF-8 character index */
@@ -226,4 +238,25 @@ public:
 };
 
 };
+
+namespace std
+{
+/* allows tiny_string as key of unordered containers, using FNV-1a on the bytes */
+template<>
+struct hash<lightspark::tiny_string>
+{
+	size_t operator()(const lightspark::tiny_string& s) const
+	{
+		const unsigned char* p=(const unsigned char*)s.raw_buf();
+		const unsigned char* end=p+s.numBytes();
+		uint32_t h=2166136261u;
+		for(;p!=end;++p)
+		{
+			h^=*p;
+			h*=16777619u;
+		}
+		return h;
+	}
+};
+}
 #endif /* TINY_STRING_H */
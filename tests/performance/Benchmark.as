@@ -0,0 +1,30 @@
+// Timing helper of the benchmarks in this directory, which trace their
+// results and quit instead of reporting assertions
+//
+// USAGE:
+// run(name, f, iterations):
+// 	Calls f(i) for i from 0 to iterations-1, or f() once if f takes no
+// 	argument, and traces the elapsed time as "name: <time> ms"
+
+package
+{
+	import flash.utils.getTimer;
+	public class Benchmark
+	{
+		public static function run(name:String, f:Function, iterations:int=1):void
+		{
+			var start:int = getTimer();
+			if (f.length == 0)
+			{
+				for (var i:int=0; i<iterations; i++)
+					f();
+			}
+			else
+			{
+				for (i=0; i<iterations; i++)
+					f(i);
+			}
+			trace(name + ": " + (getTimer() - start) + " ms");
+		}
+	}
+}
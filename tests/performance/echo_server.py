@@ -0,0 +1,38 @@
+#!/usr/bin/env python3
+# Loopback echo server for net_Socket_echo_test.mxml
+#
+# Every connection gets back the data it sends. A connection starting with
+# a policy file request is answered with a policy allowing all the ports,
+# so the server can also be used as the socket policy server.
+import socket
+import sys
+import threading
+
+POLICY_REQUEST = b"<policy-file-request/>\0"
+POLICY = (b'<?xml version="1.0"?><cross-domain-policy>'
+          b'<allow-access-from domain="*" to-ports="*"/>'
+          b'</cross-domain-policy>\0')
+
+def serve(conn):
+	with conn:
+		data = conn.recv(65536)
+		if data.startswith(POLICY_REQUEST):
+			conn.sendall(POLICY)
+			return
+		while data:
+			conn.sendall(data)
+			data = conn.recv(65536)
+
+def main():
+	port = int(sys.argv[1]) if len(sys.argv) > 1 else 8765
+	server = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+	server.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+	server.bind(("127.0.0.1", port))
+	server.listen(128)
+	while True:
+		conn, _ = server.accept()
+		conn.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+		threading.Thread(target=serve, args=(conn,), daemon=True).start()
+
+if __name__ == "__main__":
+	main()